@@ -24,6 +24,7 @@
 #include <command.h>
 #include <cpu_func.h>
 #include <irq_func.h>
+#include <serial.h>
 #include <linux/delay.h>
 
 __weak void reset_misc(void)
@@ -35,6 +36,7 @@ int do_reset(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	puts ("resetting ...\n");
 
 	mdelay(50);				/* wait 50 ms */
+	serial_flush();
 
 	disable_interrupts();
 
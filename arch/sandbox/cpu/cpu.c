@@ -12,6 +12,8 @@
 #include <linux/delay.h>
 #include <linux/libfdt.h>
 #include <os.h>
+#include <profile.h>
+#include <serial.h>
 #include <asm/io.h>
 #include <asm/malloc.h>
 #include <asm/setjmp.h>
@@ -32,6 +34,7 @@ unsigned long map_len;
 void sandbox_exit(void)
 {
 	/* Do this here while it still has an effect */
+	serial_flush();
 	os_fd_restore();
 	if (state_uninit())
 		os_exit(2);
@@ -344,3 +347,18 @@ ulong timer_get_boot_us(void)
 
 	return (count - base_count) / 1000;
 }
+
+#ifdef CONFIG_PROFILE
+int arch_profile_start(uint rate)
+{
+	if (os_profile_start(rate, profile_sample))
+		return -EPERM;
+
+	return 0;
+}
+
+void arch_profile_stop(void)
+{
+	os_profile_stop();
+}
+#endif
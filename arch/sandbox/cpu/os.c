@@ -3,6 +3,8 @@
  * Copyright (c) 2011 The Chromium OS Authors.
  */
 
+#define _GNU_SOURCE
+
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
@@ -15,6 +17,7 @@
 #include <string.h>
 #include <termios.h>
 #include <time.h>
+#include <ucontext.h>
 #include <unistd.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -814,3 +817,93 @@ void *os_find_text_base(void)
 
 	return base;
 }
+
+static void (*os_profile_func)(unsigned long pc, unsigned long fp,
+			       unsigned long sp, unsigned long stack_top);
+static unsigned long os_profile_stack_top;
+
+/* Find the end of the stack mapping which holds the current stack */
+static unsigned long os_find_stack_top(void)
+{
+	unsigned long here = (unsigned long)__builtin_frame_address(0);
+	unsigned long start, end, top = 0;
+	char line[500];
+	FILE *fp;
+
+	fp = fopen("/proc/self/maps", "r");
+	if (!fp)
+		return 0;
+	while (fgets(line, sizeof(line), fp)) {
+		if (sscanf(line, "%lx-%lx", &start, &end) == 2 &&
+		    here >= start && here < end) {
+			top = end;
+			break;
+		}
+	}
+	fclose(fp);
+
+	return top;
+}
+
+static void os_profile_handler(int sig, siginfo_t *info, void *ctx)
+{
+	ucontext_t *uc = ctx;
+	unsigned long pc, fp, sp;
+
+#if defined(__x86_64__)
+	pc = uc->uc_mcontext.gregs[REG_RIP];
+	fp = uc->uc_mcontext.gregs[REG_RBP];
+	sp = uc->uc_mcontext.gregs[REG_RSP];
+#elif defined(__i386__)
+	pc = uc->uc_mcontext.gregs[REG_EIP];
+	fp = uc->uc_mcontext.gregs[REG_EBP];
+	sp = uc->uc_mcontext.gregs[REG_ESP];
+#elif defined(__aarch64__)
+	pc = uc->uc_mcontext.pc;
+	fp = uc->uc_mcontext.regs[29];
+	sp = uc->uc_mcontext.sp;
+#else
+	return;
+#endif
+	os_profile_func(pc, fp, sp, os_profile_stack_top);
+}
+
+int os_profile_start(unsigned int rate,
+		     void (*func)(unsigned long pc, unsigned long fp,
+				  unsigned long sp, unsigned long stack_top))
+{
+	struct itimerval timer;
+	struct sigaction act;
+	unsigned int usec;
+
+	if (!rate || rate > 1000000)
+		return -1;
+	os_profile_stack_top = os_find_stack_top();
+	os_profile_func = func;
+
+	memset(&act, '\0', sizeof(act));
+	act.sa_sigaction = os_profile_handler;
+	act.sa_flags = SA_SIGINFO | SA_RESTART;
+	sigemptyset(&act.sa_mask);
+	if (sigaction(SIGPROF, &act, NULL))
+		return -1;
+
+	/* tv_usec must be below one second */
+	usec = 1000000 / rate;
+	timer.it_interval.tv_sec = usec / 1000000;
+	timer.it_interval.tv_usec = usec % 1000000;
+	timer.it_value = timer.it_interval;
+	if (setitimer(ITIMER_PROF, &timer, NULL))
+		return -1;
+
+	return 0;
+}
+
+void os_profile_stop(void)
+{
+	struct itimerval timer;
+
+	memset(&timer, '\0', sizeof(timer));
+	setitimer(ITIMER_PROF, &timer, NULL);
+	signal(SIGPROF, SIG_IGN);
+}
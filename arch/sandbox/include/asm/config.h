@@ -10,7 +10,7 @@
 
 /* Used by drivers/spi/sandbox_spi.c and arch/sandbox/include/asm/state.h */
 #ifndef CONFIG_SANDBOX_SPI_MAX_BUS
-#define CONFIG_SANDBOX_SPI_MAX_BUS 1
+#define CONFIG_SANDBOX_SPI_MAX_BUS 3
 #endif
 #ifndef CONFIG_SANDBOX_SPI_MAX_CS
 #define CONFIG_SANDBOX_SPI_MAX_CS 10
@@ -13,6 +13,9 @@
 
 #include <linux/types.h>
 
+/* Size of the memory-mapped window used for direct-mapped reads */
+#define SANDBOX_SPI_DIRMAP_SIZE		0x100000
+
 /*
  * The interface between the SPI bus and the SPI client.  The bus will
  * instantiate a client, and that then call into it via these entry
@@ -139,6 +139,16 @@ int sandbox_pwm_get_config(struct udevice *dev, uint channel, uint *period_nsp,
  */
 void sandbox_sf_set_block_protect(struct udevice *dev, int bp_mask);
 
+/**
+ * sandbox_sf_get_erase_count() - Get the number of erase commands carried out
+ *
+ * @dev: Device to check
+ * @opcode: Erase command (SPINOR_OP_BE_4K, SPINOR_OP_SE or
+ *	SPINOR_OP_CHIP_ERASE)
+ * @return number of these commands since the device was probed
+ */
+uint sandbox_sf_get_erase_count(struct udevice *dev, uint opcode);
+
 /**
  * sandbox_get_codec_params() - Read back codec parameters
  *
@@ -233,6 +243,22 @@ int sandbox_get_pci_ep_irq_count(struct udevice *dev);
  */
 uint sandbox_pci_read_bar(u32 barval, int type, uint size);
 
+/**
+ * sandbox_mmc_get_cmd_count() - Get the number of times a command was sent
+ *
+ * @dev: Sandbox MMC device
+ * @cmdidx: Command index, e.g. MMC_CMD_SET_BLOCK_COUNT
+ * @return number of times the command was sent since the counts were reset
+ */
+uint sandbox_mmc_get_cmd_count(struct udevice *dev, uint cmdidx);
+
+/**
+ * sandbox_mmc_reset_cmd_counts() - Reset the command counts to zero
+ *
+ * @dev: Sandbox MMC device
+ */
+void sandbox_mmc_reset_cmd_counts(struct udevice *dev);
+
 /**
  * sandbox_set_enable_memio() - Enable readl/writel() for sandbox
  *
@@ -12,6 +12,7 @@
 #include <command.h>
 #include <hang.h>
 #include <log.h>
+#include <serial.h>
 #include <dm/device.h>
 #include <dm/root.h>
 #include <errno.h>
@@ -33,6 +34,7 @@ DECLARE_GLOBAL_DATA_PTR;
 void bootm_announce_and_cleanup(void)
 {
 	printf("\nStarting kernel ...\n\n");
+	serial_flush();
 
 #ifdef CONFIG_SYS_COREBOOT
 	timestamp_add_now(TS_U_BOOT_START_KERNEL);
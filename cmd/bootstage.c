@@ -6,6 +6,9 @@
 #include <common.h>
 #include <bootstage.h>
 #include <command.h>
+#include <fs.h>
+#include <malloc.h>
+#include <mapmem.h>
 
 static int do_bootstage_report(struct cmd_tbl *cmdtp, int flag, int argc,
 			       char *const argv[])
@@ -59,10 +62,40 @@ static int do_bootstage_stash(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int do_bootstage_save(struct cmd_tbl *cmdtp, int flag, int argc,
+			     char *const argv[])
+{
+	loff_t actwrite;
+	char *buf;
+	int len, ret;
+
+	if (argc != 4)
+		return CMD_RET_USAGE;
+
+	len = bootstage_export_trace(NULL, 0);
+	buf = malloc(len + 1);
+	if (!buf) {
+		printf("Out of memory for %d-byte trace\n", len);
+		return CMD_RET_FAILURE;
+	}
+	bootstage_export_trace(buf, len + 1);
+
+	ret = fs_set_blk_dev(argv[1], argv[2], FS_TYPE_ANY);
+	if (!ret)
+		ret = fs_write(argv[3], map_to_sysmem(buf), 0, len, &actwrite);
+	free(buf);
+	if (ret)
+		return CMD_RET_FAILURE;
+	printf("%llu bytes written\n", actwrite);
+
+	return 0;
+}
+
 static struct cmd_tbl cmd_bootstage_sub[] = {
 	U_BOOT_CMD_MKENT(report, 2, 1, do_bootstage_report, "", ""),
 	U_BOOT_CMD_MKENT(stash, 4, 0, do_bootstage_stash, "", ""),
 	U_BOOT_CMD_MKENT(unstash, 4, 0, do_bootstage_stash, "", ""),
+	U_BOOT_CMD_MKENT(save, 4, 0, do_bootstage_save, "", ""),
 };
 
 /*
@@ -92,5 +125,7 @@ U_BOOT_CMD(bootstage, 4, 1, do_boostage,
 	" - check boot progress and timing\n"
 	"report                      - Print a report\n"
 	"stash [<start> [<size>]]    - Stash data into memory\n"
-	"unstash [<start> [<size>]]  - Unstash data from memory"
+	"unstash [<start> [<size>]]  - Unstash data from memory\n"
+	"save <interface> <dev[:part]> <filename>\n"
+	"                            - Save a Chrome trace-event file"
 );
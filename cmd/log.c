@@ -103,6 +103,44 @@ static int do_log_rec(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+#ifdef CONFIG_LOG_RING
+static int do_log_ring(struct cmd_tbl *cmdtp, int flag, int argc,
+		       char *const argv[])
+{
+	struct log_ring_stats stats;
+	const char *op;
+	int ret;
+
+	if (argc < 2) {
+		log_ring_show();
+		return 0;
+	}
+	op = argv[1];
+	if (!strcmp(op, "clear")) {
+		log_ring_clear();
+	} else if (!strcmp(op, "info")) {
+		if (log_ring_get_stats(&stats)) {
+			printf("No log ring\n");
+			return CMD_RET_FAILURE;
+		}
+		printf("Size:    %#x bytes, %#x used\n", stats.size, stats.used);
+		printf("Records: %lu, %lu added, %lu dropped\n", stats.count,
+		       stats.added, stats.dropped);
+		printf("Text:    %lu formatted when added\n", stats.text);
+	} else if (IS_ENABLED(CONFIG_BLOBLIST) && !strcmp(op, "export")) {
+		ret = log_ring_export();
+		if (ret) {
+			printf("Cannot export log ring (err=%d)\n", ret);
+			return CMD_RET_FAILURE;
+		}
+	} else {
+		return CMD_RET_USAGE;
+	}
+
+	return 0;
+}
+#endif
+
 static struct cmd_tbl log_sub[] = {
 	U_BOOT_CMD_MKENT(level, CONFIG_SYS_MAXARGS, 1, do_log_level, "", ""),
 #ifdef CONFIG_LOG_TEST
@@ -110,6 +148,9 @@ static struct cmd_tbl log_sub[] = {
 #endif
 	U_BOOT_CMD_MKENT(format, CONFIG_SYS_MAXARGS, 1, do_log_format, "", ""),
 	U_BOOT_CMD_MKENT(rec, CONFIG_SYS_MAXARGS, 1, do_log_rec, "", ""),
+#ifdef CONFIG_LOG_RING
+	U_BOOT_CMD_MKENT(ring, 2, 1, do_log_ring, "", ""),
+#endif
 };
 
 static int do_log(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
@@ -142,6 +183,14 @@ static char log_help_text[] =
 	"\tor 'default', or 'all' for all\n"
 	"log rec <category> <level> <file> <line> <func> <message> - "
 		"output a log record"
+#ifdef CONFIG_LOG_RING
+	"\nlog ring [clear | info"
+#ifdef CONFIG_BLOBLIST
+	" | export"
+#endif
+	"] - show the records in the log ring, clear it, show\n"
+	"\tinformation about it or add it to the bloblist"
+#endif
 	;
 #endif
 
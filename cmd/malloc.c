@@ -0,0 +1,110 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Show statistics about the malloc() heap
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static int do_malloc_info(struct cmd_tbl *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	struct malloc_info info;
+	int i;
+
+	malloc_get_info(&info);
+	printf("Heap size:      %#lx\n", info.heap_size);
+	printf("In use:         %lu bytes in %lu blocks\n", info.live_bytes,
+	       info.live_count);
+	printf("Peak use:       %lu bytes\n", info.peak_bytes);
+	printf("Calls:          %lu malloc, %lu realloc, %lu free, %lu failed\n",
+	       info.mallocs, info.reallocs, info.frees, info.failures);
+	if (IS_ENABLED(CONFIG_SYS_MALLOC_SIZE_CLASSES))
+		printf("Size classes:   %lu hits, %lu bytes held\n",
+		       info.class_hits, info.class_bytes);
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	printf("Pre-relocation: %#lx of %#x bytes used\n", gd->malloc_ptr,
+	       CONFIG_VAL(SYS_MALLOC_F_LEN));
+#endif
+
+	/* Each bucket is shown by its largest size; the last has no limit */
+	printf("\n%10s %10s %10s\n", "Size", "Allocs", "Live");
+	for (i = 0; i < MALLOC_HIST_BUCKETS; i++) {
+		bool last = i == MALLOC_HIST_BUCKETS - 1;
+		char size[20];
+
+		if (!info.allocs[i])
+			continue;
+		snprintf(size, sizeof(size), "%s%lu", last ? ">" : "<=",
+			 16UL << (last ? i - 1 : i));
+		printf("%10s %10lu %10lu\n", size, info.allocs[i],
+		       info.live[i]);
+	}
+
+	return 0;
+}
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_TRACK)
+static int do_malloc_callers(struct cmd_tbl *cmdtp, int flag, int argc,
+			     char *const argv[])
+{
+	bool early = false;
+
+	if (argc > 1) {
+		if (strcmp(argv[1], "early"))
+			return CMD_RET_USAGE;
+		early = true;
+	}
+	malloc_track_show_callers(early);
+
+	return 0;
+}
+
+static int do_malloc_phases(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	malloc_track_show_phases();
+
+	return 0;
+}
+#endif
+
+static struct cmd_tbl cmd_malloc_sub[] = {
+	U_BOOT_CMD_MKENT(info, 1, 0, do_malloc_info, "", ""),
+#if CONFIG_IS_ENABLED(SYS_MALLOC_TRACK)
+	U_BOOT_CMD_MKENT(callers, 2, 0, do_malloc_callers, "", ""),
+	U_BOOT_CMD_MKENT(phases, 1, 0, do_malloc_phases, "", ""),
+#endif
+};
+
+static int do_malloc(struct cmd_tbl *cmdtp, int flag, int argc,
+		     char *const argv[])
+{
+	struct cmd_tbl *c;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	/* Strip off leading 'malloc' command argument */
+	argc--;
+	argv++;
+
+	c = find_cmd_tbl(argv[0], cmd_malloc_sub, ARRAY_SIZE(cmd_malloc_sub));
+	if (!c)
+		return CMD_RET_USAGE;
+
+	return c->cmd(cmdtp, flag, argc, argv);
+}
+
+U_BOOT_CMD(malloc, 3, 0, do_malloc,
+	"Heap statistics",
+	"info - show heap use and a histogram of block sizes"
+#if CONFIG_IS_ENABLED(SYS_MALLOC_TRACK)
+	"\nmalloc callers [early] - show live blocks by caller, with the\n"
+	"    average lifetime of freed blocks in allocations\n"
+	"malloc phases - show heap use in each boot phase"
+#endif
+);
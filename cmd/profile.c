@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Control of the sampling profiler
+ */
+
+#include <common.h>
+#include <command.h>
+#include <env.h>
+#include <mapmem.h>
+#include <profile.h>
+
+static int do_profile_start(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	uint rate = CONFIG_PROFILE_RATE;
+	int ret;
+
+	if (argc > 1)
+		rate = simple_strtoul(argv[1], NULL, 10);
+	ret = profile_start(rate);
+	if (ret) {
+		printf("Cannot start profiling (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	return 0;
+}
+
+static int do_profile_stop(struct cmd_tbl *cmdtp, int flag, int argc,
+			   char *const argv[])
+{
+	profile_stop();
+
+	return 0;
+}
+
+static int do_profile_stats(struct cmd_tbl *cmdtp, int flag, int argc,
+			    char *const argv[])
+{
+	profile_print_stats();
+
+	return 0;
+}
+
+/*
+ * This writes to the same buffer as the 'trace' command, following any data
+ * already there, so that both can be saved to one file for proftool
+ */
+static int do_profile_dump(struct cmd_tbl *cmdtp, int flag, int argc,
+			   char *const argv[])
+{
+	size_t buff_size, avail, buff_ptr, needed, used;
+	char *buff;
+
+	if (argc == 3) {
+		buff_size = simple_strtoul(argv[2], NULL, 16);
+		buff = map_sysmem(simple_strtoul(argv[1], NULL, 16),
+				  buff_size);
+		buff_ptr = 0;
+	} else if (argc == 1) {
+		buff_size = env_get_ulong("profsize", 16, 0);
+		buff = map_sysmem(env_get_ulong("profbase", 16, 0),
+				  buff_size);
+		buff_ptr = env_get_ulong("profoffset", 16, 0);
+	} else {
+		return CMD_RET_USAGE;
+	}
+	if (buff_ptr > buff_size) {
+		printf("Buffer offset %#zx is past its end\n", buff_ptr);
+		return CMD_RET_FAILURE;
+	}
+
+	avail = buff_size - buff_ptr;
+	if (profile_list_samples(buff + buff_ptr, avail, &needed))
+		printf("Error: truncated (%#zx bytes needed)\n", needed);
+	used = min(avail, needed);
+	printf("Samples dumped to %08lx, size %#zx\n",
+	       (ulong)map_to_sysmem(buff + buff_ptr), used);
+	env_set_hex("profbase", map_to_sysmem(buff));
+	env_set_hex("profsize", buff_size);
+	env_set_hex("profoffset", buff_ptr + used);
+
+	return 0;
+}
+
+static struct cmd_tbl cmd_profile_sub[] = {
+	U_BOOT_CMD_MKENT(start, 2, 0, do_profile_start, "", ""),
+	U_BOOT_CMD_MKENT(stop, 1, 0, do_profile_stop, "", ""),
+	U_BOOT_CMD_MKENT(stats, 1, 0, do_profile_stats, "", ""),
+	U_BOOT_CMD_MKENT(dump, 3, 0, do_profile_dump, "", ""),
+};
+
+static int do_profile(struct cmd_tbl *cmdtp, int flag, int argc,
+		      char *const argv[])
+{
+	struct cmd_tbl *c;
+
+	if (argc < 2)
+		return CMD_RET_USAGE;
+
+	/* Strip off leading 'profile' command argument */
+	argc--;
+	argv++;
+
+	c = find_cmd_tbl(argv[0], cmd_profile_sub, ARRAY_SIZE(cmd_profile_sub));
+	if (!c)
+		return CMD_RET_USAGE;
+
+	return c->cmd(cmdtp, flag, argc, argv);
+}
+
+U_BOOT_CMD(profile, 4, 0, do_profile,
+	"Sampling profiler",
+	"start [<rate>]        - start sampling <rate> times a second\n"
+	"profile stop                  - stop sampling\n"
+	"profile stats                 - show sampling statistics\n"
+	"profile dump [<addr> <size>]  - dump samples into buffer for proftool"
+);
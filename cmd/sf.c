@@ -18,6 +18,7 @@
 #include <asm/cache.h>
 #include <jffs2/jffs2.h>
 #include <linux/mtd/mtd.h>
+#include <u-boot/crc.h>
 
 #include <asm/io.h>
 #include <dm/device-internal.h>
@@ -26,6 +27,28 @@
 
 static struct spi_flash *flash;
 
+#define SF_CRCMAP_MAGIC		0x50414d43	/* "CMAP" */
+
+/**
+ * struct sf_crcmap - CRC32 of each sector in an area of SPI flash
+ *
+ * This is made by 'sf crcmap' and used by 'sf update -m' to find the sectors
+ * which change without reading them back. All fields are little-endian.
+ *
+ * @magic:		SF_CRCMAP_MAGIC
+ * @sector_size:	flash sector size the map was made for
+ * @offset:		flash offset of the first sector
+ * @count:		number of sectors
+ * @crc:		CRC32 of the contents of each sector
+ */
+struct sf_crcmap {
+	__le32 magic;
+	__le32 sector_size;
+	__le32 offset;
+	__le32 count;
+	__le32 crc[];
+};
+
 /*
  * This function computes the length argument for the erase command.
  * The length on which the command is to operate can be given in two forms:
@@ -200,28 +223,134 @@ static const char *spi_flash_update_block(struct spi_flash *flash, u32 offset,
 	return NULL;
 }
 
+/**
+ * Find the entry for a sector in a CRC map
+ *
+ * @param map		CRC map, or NULL if none
+ * @param offset	flash offset of the sector
+ * @return pointer to the entry, or NULL if the map does not cover the sector
+ */
+static __le32 *sf_crcmap_entry(struct sf_crcmap *map, u32 offset)
+{
+	u32 sector_size, start;
+
+	if (!map)
+		return NULL;
+	sector_size = le32_to_cpu(map->sector_size);
+	start = le32_to_cpu(map->offset);
+	if (offset < start || (offset - start) % sector_size ||
+	    (offset - start) / sector_size >= le32_to_cpu(map->count))
+		return NULL;
+
+	return &map->crc[(offset - start) / sector_size];
+}
+
+/**
+ * Check whether a CRC map was made for this flash and covers an area of it
+ *
+ * @param map		CRC map
+ * @param offset	flash offset of the area, which must start a sector
+ * @param len		length of the area in bytes
+ * @return true if the map can be used for the area
+ */
+static bool sf_crcmap_covers(struct sf_crcmap *map, u32 offset, size_t len)
+{
+	if (le32_to_cpu(map->magic) != SF_CRCMAP_MAGIC ||
+	    le32_to_cpu(map->sector_size) != flash->sector_size)
+		return false;
+
+	return sf_crcmap_entry(map, offset) &&
+		sf_crcmap_entry(map, offset + ROUND(len, flash->sector_size) -
+				flash->sector_size);
+}
+
+/**
+ * Check whether a whole sector of SPI flash differs from the new data
+ *
+ * With a CRC map this compares the CRC32 of the new data with the map entry,
+ * which is then set to the new CRC. Otherwise the sector is read back.
+ *
+ * @param flash		flash context pointer
+ * @param offset	flash offset of the sector
+ * @param buf		new data for the sector
+ * @param cmp_buf	read buffer to use to compare data
+ * @param map		CRC map, or NULL if none
+ * @param changed	returns true if the sector must be written
+ * @return NULL if OK, else a string containing the stage which failed
+ */
+static const char *spi_flash_sector_changed(struct spi_flash *flash,
+		u32 offset, const char *buf, char *cmp_buf,
+		struct sf_crcmap *map, bool *changed)
+{
+	__le32 *entry = sf_crcmap_entry(map, offset);
+	u32 crc;
+
+	if (entry) {
+		crc = crc32(0, (const uchar *)buf, flash->sector_size);
+		*changed = le32_to_cpu(*entry) != crc;
+		*entry = cpu_to_le32(crc);
+		return NULL;
+	}
+
+	if (spi_flash_read(flash, offset, flash->sector_size, cmp_buf))
+		return "read";
+	*changed = memcmp(cmp_buf, buf, flash->sector_size) != 0;
+
+	return NULL;
+}
+
+/**
+ * Erase and write a run of whole sectors which have changed. Doing the run
+ * in one go lets the flash use its larger erase blocks and keeps page
+ * programming going without a break after each sector.
+ *
+ * @param flash		flash context pointer
+ * @param offset	flash offset of the run
+ * @param len		length of the run, a multiple of the sector size
+ * @param buf		buffer to write from
+ * @return NULL if OK, else a string containing the stage which failed
+ */
+static const char *spi_flash_update_run(struct spi_flash *flash, u32 offset,
+		size_t len, const char *buf)
+{
+	if (!len)
+		return NULL;
+	debug("Update region %x size %zx\n", offset, len);
+	if (spi_flash_erase(flash, offset, len))
+		return "erase";
+	if (spi_flash_write(flash, offset, len, buf))
+		return "write";
+
+	return NULL;
+}
+
 /**
  * Update an area of SPI flash by erasing and writing any blocks which need
  * to change. Existing blocks with the correct data are left unchanged.
+ * Neighbouring blocks which change are erased and written together.
  *
  * @param flash		flash context pointer
  * @param offset	flash offset to write
  * @param len		number of bytes to write
  * @param buf		buffer to write from
+ * @param map		CRC map of the area to use instead of reading it back,
+ *			or NULL if none. This is updated to match the new data.
  * @return 0 if ok, 1 on error
  */
 static int spi_flash_update(struct spi_flash *flash, u32 offset,
-		size_t len, const char *buf)
+		size_t len, const char *buf, struct sf_crcmap *map)
 {
 	const char *err_oper = NULL;
 	char *cmp_buf;
 	const char *end = buf + len;
 	size_t todo;		/* number of bytes to do in this pass */
+	size_t run = 0;		/* changed bytes just before this pass */
 	size_t skipped = 0;	/* statistics */
 	const ulong start_time = get_timer(0);
 	size_t scale = 1;
 	const char *start_buf = buf;
 	ulong delta;
+	bool changed;
 
 	if (end - buf >= 200)
 		scale = (end - buf) / 100;
@@ -238,9 +367,38 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 							 start_time));
 				last_update = get_timer(0);
 			}
-			err_oper = spi_flash_update_block(flash, offset, todo,
-					buf, cmp_buf, &skipped);
+			if (todo == flash->sector_size) {
+				err_oper = spi_flash_sector_changed(flash,
+						offset, buf, cmp_buf, map,
+						&changed);
+				if (!err_oper && changed) {
+					run += todo;
+					continue;
+				}
+				if (!err_oper)
+					skipped += todo;
+			}
+			if (!err_oper)
+				err_oper = spi_flash_update_run(flash,
+						offset - run, run, buf - run);
+			run = 0;
+
+			/* A partial sector keeps the rest of its contents */
+			if (!err_oper && todo < flash->sector_size) {
+				__le32 *entry = sf_crcmap_entry(map, offset);
+
+				err_oper = spi_flash_update_block(flash,
+						offset, todo, buf, cmp_buf,
+						&skipped);
+				if (!err_oper && entry)
+					*entry = cpu_to_le32(crc32(0,
+						(const uchar *)cmp_buf,
+						flash->sector_size));
+			}
 		}
+		if (!err_oper)
+			err_oper = spi_flash_update_run(flash, offset - run,
+							run, buf - run);
 	} else {
 		err_oper = "malloc";
 	}
@@ -248,6 +406,9 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 	putc('\r');
 	if (err_oper) {
 		printf("SPI flash failed in %s step\n", err_oper);
+		/* Some entries may not match the flash now */
+		if (map)
+			map->magic = 0;
 		return 1;
 	}
 
@@ -262,13 +423,27 @@ static int spi_flash_update(struct spi_flash *flash, u32 offset,
 
 static int do_spi_flash_read_write(int argc, char *const argv[])
 {
-	unsigned long addr;
+	const char *cmd = argv[0];
+	unsigned long addr, map_addr = 0;
+	struct sf_crcmap *map = NULL;
+	ulong map_size = 0;
 	void *buf;
 	char *endp;
 	int ret = 1;
 	int dev = 0;
 	loff_t offset, len, maxsize;
 
+	if (IS_ENABLED(CONFIG_CMD_SF_CRCMAP) && strcmp(cmd, "update") == 0 &&
+	    argc > 2 && strcmp(argv[1], "-m") == 0) {
+		map_addr = simple_strtoul(argv[2], &endp, 16);
+		if (*argv[2] == 0 || *endp != 0)
+			return -1;
+		map_size = sizeof(*map) + sizeof(map->crc[0]) *
+			DIV_ROUND_UP(flash->size, flash->sector_size);
+		argc -= 2;
+		argv += 2;
+	}
+
 	if (argc < 3)
 		return -1;
 
@@ -283,23 +458,33 @@ static int do_spi_flash_read_write(int argc, char *const argv[])
 	/* Consistency checking */
 	if (offset + len > flash->size) {
 		printf("ERROR: attempting %s past flash size (%#x)\n",
-		       argv[0], flash->size);
+		       cmd, flash->size);
 		return 1;
 	}
 
+	if (map_size) {
+		map = map_physmem(map_addr, map_size, MAP_WRBACK);
+		if (!sf_crcmap_covers(map, offset, len)) {
+			printf("ERROR: no CRC map for %#llx bytes @ %#llx at %lx\n",
+			       len, offset, map_addr);
+			unmap_physmem(map, map_size);
+			return 1;
+		}
+	}
+
 	buf = map_physmem(addr, len, MAP_WRBACK);
 	if (!buf && addr) {
 		puts("Failed to map physical memory\n");
 		return 1;
 	}
 
-	if (strcmp(argv[0], "update") == 0) {
-		ret = spi_flash_update(flash, offset, len, buf);
-	} else if (strncmp(argv[0], "read", 4) == 0 ||
-			strncmp(argv[0], "write", 5) == 0) {
+	if (strcmp(cmd, "update") == 0) {
+		ret = spi_flash_update(flash, offset, len, buf, map);
+	} else if (strncmp(cmd, "read", 4) == 0 ||
+			strncmp(cmd, "write", 5) == 0) {
 		int read;
 
-		read = strncmp(argv[0], "read", 4) == 0;
+		read = strncmp(cmd, "read", 4) == 0;
 		if (read)
 			ret = spi_flash_read(flash, offset, len, buf);
 		else
@@ -314,10 +499,78 @@ static int do_spi_flash_read_write(int argc, char *const argv[])
 	}
 
 	unmap_physmem(buf, len);
+	if (map)
+		unmap_physmem(map, map_size);
 
 	return ret == 0 ? 0 : 1;
 }
 
+#ifdef CONFIG_CMD_SF_CRCMAP
+static int do_spi_flash_crcmap(int argc, char *const argv[])
+{
+	struct sf_crcmap *map;
+	unsigned long addr;
+	char *endp, *buf;
+	int dev = 0;
+	loff_t offset, len, maxsize;
+	u32 count, i;
+	ulong size;
+	int ret = 0;
+
+	if (argc < 3)
+		return -1;
+
+	addr = simple_strtoul(argv[1], &endp, 16);
+	if (*argv[1] == 0 || *endp != 0)
+		return -1;
+
+	if (mtd_arg_off_size(argc - 2, &argv[2], &dev, &offset, &len,
+			     &maxsize, MTD_DEV_TYPE_NOR, flash->size))
+		return -1;
+
+	/* Consistency checking */
+	if (offset % flash->sector_size ||
+	    offset + ROUND(len, flash->sector_size) > flash->size) {
+		printf("ERROR: %#llx bytes @ %#llx is not in whole sectors\n",
+		       len, offset);
+		return 1;
+	}
+
+	count = DIV_ROUND_UP(len, flash->sector_size);
+	size = sizeof(*map) + count * sizeof(map->crc[0]);
+	buf = memalign(ARCH_DMA_MINALIGN, flash->sector_size);
+	if (!buf) {
+		puts("SF: Out of memory\n");
+		return 1;
+	}
+
+	map = map_physmem(addr, size, MAP_WRBACK);
+	map->magic = cpu_to_le32(SF_CRCMAP_MAGIC);
+	map->sector_size = cpu_to_le32(flash->sector_size);
+	map->offset = cpu_to_le32(offset);
+	map->count = cpu_to_le32(count);
+	for (i = 0; i < count && !ret; i++) {
+		ret = spi_flash_read(flash, offset + i * flash->sector_size,
+				     flash->sector_size, buf);
+		map->crc[i] = cpu_to_le32(crc32(0, (const uchar *)buf,
+						flash->sector_size));
+	}
+	if (ret)
+		map->magic = 0;
+	unmap_physmem(map, size);
+	free(buf);
+
+	printf("SF: CRC map of %u sectors @ %#x: ", count, (u32)offset);
+	if (ret) {
+		printf("ERROR %d\n", ret);
+		return 1;
+	}
+	printf("%#lx bytes at %lx\n", size, addr);
+
+	return 0;
+}
+#endif
+
 static int do_spi_flash_erase(int argc, char *const argv[])
 {
 	int ret;
@@ -575,6 +828,10 @@ static int do_spi_flash(struct cmd_tbl *cmdtp, int flag, int argc,
 		ret = do_spi_flash_erase(argc, argv);
 	else if (strcmp(cmd, "protect") == 0)
 		ret = do_spi_protect(argc, argv);
+#ifdef CONFIG_CMD_SF_CRCMAP
+	else if (strcmp(cmd, "crcmap") == 0)
+		ret = do_spi_flash_crcmap(argc, argv);
+#endif
 #ifdef CONFIG_CMD_SF_TEST
 	else if (!strcmp(cmd, "test"))
 		ret = do_spi_flash_test(argc, argv);
@@ -590,6 +847,19 @@ usage:
 	return CMD_RET_USAGE;
 }
 
+#ifdef CONFIG_CMD_SF_CRCMAP
+#define SF_CRCMAP_HELP "\nsf crcmap addr offset|partition len	" \
+		"- store the CRC32 of each sector\n" \
+		"					  at `addr', for `sf update -m'\n" \
+		"sf update -m mapaddr addr offset|partition len\n" \
+		"					- as update, but use the CRC\n" \
+		"					  map at `mapaddr' to find the\n" \
+		"					  sectors which change, and\n" \
+		"					  update the map to match"
+#else
+#define SF_CRCMAP_HELP
+#endif
+
 #ifdef CONFIG_CMD_SF_TEST
 #define SF_TEST_HELP "\nsf test offset len		" \
 		"- run a very basic destructive test"
@@ -598,7 +868,7 @@ usage:
 #endif
 
 U_BOOT_CMD(
-	sf,	5,	1,	do_spi_flash,
+	sf,	7,	1,	do_spi_flash,
 	"SPI flash sub-system",
 	"probe [[bus:]cs] [hz] [mode]	- init flash device on given SPI bus\n"
 	"				  and chip select\n"
@@ -616,5 +886,6 @@ U_BOOT_CMD(
 	"					  or to start of mtd `partition'\n"
 	"sf protect lock/unlock sector len	- protect/unprotect 'len' bytes starting\n"
 	"					  at address 'sector'\n"
+	SF_CRCMAP_HELP
 	SF_TEST_HELP
 );
@@ -13,6 +13,7 @@
 #include <errno.h>
 #include <g_dnl.h>
 #include <malloc.h>
+#include <mmc.h>
 #include <part.h>
 #include <usb.h>
 #include <usb_mass_storage.h>
@@ -37,6 +38,26 @@ static int ums_write_sector(struct ums *ums_dev,
 	return blk_dwrite(block_dev, blkstart, blkcnt, buf);
 }
 
+static int ums_sync_mmc(struct ums *ums_dev)
+{
+	struct mmc *mmc = find_mmc_device(ums_dev->block_dev.devnum);
+
+	return mmc ? mmc_flush_cache(mmc) : -ENODEV;
+}
+
+/* Let an eMMC cache writes while it is exported, if it can */
+static void ums_set_write_cache(struct ums *ums_dev, bool enable)
+{
+	struct mmc *mmc;
+
+	if (!CONFIG_IS_ENABLED(MMC_FAST_WRITE) ||
+	    ums_dev->block_dev.if_type != IF_TYPE_MMC)
+		return;
+	mmc = find_mmc_device(ums_dev->block_dev.devnum);
+	if (mmc && !mmc_set_write_cache(mmc, enable) && enable)
+		ums_dev->sync = ums_sync_mmc;
+}
+
 static struct ums *ums;
 static int ums_count;
 
@@ -44,8 +65,10 @@ static void ums_fini(void)
 {
 	int i;
 
-	for (i = 0; i < ums_count; i++)
+	for (i = 0; i < ums_count; i++) {
+		ums_set_write_cache(&ums[i], false);
 		free((void *)ums[i].name);
+	}
 	free(ums);
 	ums = NULL;
 	ums_count = 0;
@@ -107,6 +130,7 @@ static int ums_init(const char *devtype, const char *devnums_part_str)
 
 		ums[ums_count].read_sector = ums_read_sector;
 		ums[ums_count].write_sector = ums_write_sector;
+		ums[ums_count].sync = NULL;
 
 		name = malloc(UMS_NAME_LEN);
 		if (!name)
@@ -114,6 +138,7 @@ static int ums_init(const char *devtype, const char *devnums_part_str)
 		snprintf(name, UMS_NAME_LEN, "UMS disk %d", ums_count);
 		ums[ums_count].name = name;
 		ums[ums_count].block_dev = *block_dev;
+		ums_set_write_cache(&ums[ums_count], true);
 
 		printf("UMS: LUN %d, dev %d, hwpart %d, sector %#x, count %#x\n",
 		       ums_count, ums[ums_count].block_dev.devnum,
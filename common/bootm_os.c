@@ -612,6 +612,9 @@ int boot_selected_os(int argc, char *const argv[], int state,
 {
 	arch_preboot_os();
 	board_preboot_os();
+	if (CONFIG_IS_ENABLED(LOG_RING_BLOBLIST) &&
+	    state != BOOTM_STATE_OS_FAKE_GO && log_ring_export())
+		printf("Cannot pass log to OS\n");
 	boot_fn(state, argc, argv, images);
 
 	/* Stand-alone may return when 'autostart' is 'no' */
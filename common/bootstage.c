@@ -16,6 +16,8 @@
 #include <malloc.h>
 #include <sort.h>
 #include <spl.h>
+#include <time.h>
+#include <div64.h>
 #include <linux/compiler.h>
 #include <linux/libfdt.h>
 
@@ -23,6 +25,7 @@ DECLARE_GLOBAL_DATA_PTR;
 
 enum {
 	RECORD_COUNT = CONFIG_VAL(BOOTSTAGE_RECORD_COUNT),
+	SPAN_COUNT = CONFIG_VAL(BOOTSTAGE_SPAN_COUNT),
 };
 
 struct bootstage_record {
@@ -33,15 +36,62 @@ struct bootstage_record {
 	enum bootstage_id id;
 };
 
+/**
+ * struct bootstage_span - a timed span of boot activity
+ *
+ * @start: Timer ticks when the span first started
+ * @last: Timer ticks when the span was last started or resumed
+ * @end: Timer ticks when the span last ended, 0 while it is open
+ * @busy: Total ticks spent in the span, less than @end - @start if other
+ *	spans were merged into it
+ * @bytes: Number of bytes processed
+ * @name: Name of the span
+ * @parent: Index of the enclosing span, -1 if none
+ * @count: Number of times the span was run (see BOOTSTAGEF_MERGE)
+ */
+struct bootstage_span {
+	u64 start;
+	u64 last;
+	u64 end;
+	u64 busy;
+	u64 bytes;
+	const char *name;
+	int parent;
+	uint count;
+};
+
+/**
+ * struct bootstage_data - all bootstage information
+ *
+ * @rec_count: Number of records used
+ * @next_id: Next ID to allocate for BOOTSTAGEF_ALLOC
+ * @span_count: Number of spans used
+ * @span_max: Number of spans that fit in @span
+ * @span_dropped: Number of spans which did not fit in the table
+ * @cur_span: Index of the innermost open span, -1 if none
+ * @base_ticks: Timer ticks at @base_us, used to put spans on the same time
+ *	line as the records
+ * @base_us: Boot time in microseconds at @base_ticks
+ * @record: Records (marks and accumulated times)
+ * @span: Spans, allocated when first needed (see bootstage_grow_spans())
+ */
 struct bootstage_data {
 	uint rec_count;
 	uint next_id;
+	uint span_count;
+	uint span_max;
+	uint span_dropped;
+	int cur_span;
+	u64 base_ticks;
+	u64 base_us;
 	struct bootstage_record record[RECORD_COUNT];
+	struct bootstage_span *span;
 };
 
 enum {
 	BOOTSTAGE_VERSION	= 0,
 	BOOTSTAGE_MAGIC		= 0xb00757a3,
+	BOOTSTAGE_SPAN_MAGIC	= 0xb00757a4,
 	BOOTSTAGE_DIGITS	= 9,
 };
 
@@ -53,15 +103,39 @@ struct bootstage_hdr {
 	u32 next_id;		/* Next ID to use for bootstage */
 };
 
+/*
+ * Spans are stashed after the record names, so that readers which only know
+ * about records still work
+ */
+struct bootstage_span_hdr {
+	u32 magic;		/* BOOTSTAGE_SPAN_MAGIC */
+	u32 count;		/* Number of spans */
+	u64 base_ticks;		/* Timer ticks at base_us */
+	u64 base_us;		/* Boot time in microseconds at base_ticks */
+};
+
 int bootstage_relocate(void)
 {
 	struct bootstage_data *data = gd->bootstage;
 	int i;
 	char *ptr;
 
-	/* Figure out where to relocate the strings to */
+	/* Figure out where to relocate the spans and strings to */
 	ptr = (char *)(data + 1);
 
+	/*
+	 * The span table may be in the pre-relocation heap, so move it too.
+	 * It is replaced by a full-sized one when the next span is started.
+	 */
+	if (data->span_count) {
+		memcpy(ptr, data->span, data->span_count * sizeof(*data->span));
+		data->span = (struct bootstage_span *)ptr;
+		ptr += data->span_count * sizeof(*data->span);
+	} else {
+		data->span = NULL;
+	}
+	data->span_max = data->span_count;
+
 	/*
 	 * Duplicate all strings.  They may point to an old location in the
 	 * program .text section that can eventually get trashed.
@@ -74,6 +148,11 @@ int bootstage_relocate(void)
 		data->record[i].name = ptr;
 		ptr += strlen(ptr) + 1;
 	}
+	for (i = 0; i < data->span_count; i++) {
+		strcpy(ptr, data->span[i].name);
+		data->span[i].name = ptr;
+		ptr += strlen(ptr) + 1;
+	}
 
 	return 0;
 }
@@ -217,6 +296,112 @@ uint32_t bootstage_accum(enum bootstage_id id)
 	return duration;
 }
 
+/**
+ * bootstage_grow_spans() - Make room for more spans
+ *
+ * The span table is too big for the pre-relocation heap, so it is only
+ * allocated in full when first needed after relocation. Before relocation in
+ * U-Boot proper, it is made just big enough for the spans from a previous
+ * phase.
+ *
+ * @data: Bootstage data
+ * @extra: Number of spans to make room for
+ * @return 0 if OK, -ENOSPC if the table is full, -ENOMEM if out of memory
+ */
+static int bootstage_grow_spans(struct bootstage_data *data, uint extra)
+{
+	uint need = data->span_count + extra;
+	struct bootstage_span *span;
+	uint max = SPAN_COUNT;
+
+	if (need <= data->span_max)
+		return 0;
+	if (need > SPAN_COUNT)
+		return -ENOSPC;
+	if (spl_phase() == PHASE_BOARD_F)
+		max = need;
+
+	span = malloc(max * sizeof(*span));
+	if (!span)
+		return -ENOMEM;
+	if (data->span_count)
+		memcpy(span, data->span, data->span_count * sizeof(*span));
+
+	/*
+	 * An old table is not freed, since it is either in the pre-relocation
+	 * heap or in the memory reserved for bootstage at relocation
+	 */
+	data->span = span;
+	data->span_max = max;
+
+	return 0;
+}
+
+int bootstage_span_start(const char *name, int flags)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_span *span;
+	u64 now;
+	int ret;
+
+	if (!data)
+		return -ENOENT;
+	now = get_ticks();
+	if (!data->base_ticks && !data->base_us) {
+		data->base_ticks = now;
+		data->base_us = timer_get_boot_us();
+	}
+
+	/* Resume the previous span if it is the same operation again */
+	if ((flags & BOOTSTAGEF_MERGE) && data->span_count) {
+		span = &data->span[data->span_count - 1];
+		if (span->end && span->parent == data->cur_span &&
+		    !strcmp(span->name, name)) {
+			span->last = now;
+			span->end = 0;
+			span->count++;
+			data->cur_span = data->span_count - 1;
+
+			return data->cur_span;
+		}
+	}
+
+	/* Spans are only recorded after relocation in U-Boot proper */
+	if (spl_phase() == PHASE_BOARD_F && data->span_count >= data->span_max)
+		return -EAGAIN;
+	ret = bootstage_grow_spans(data, 1);
+	if (ret) {
+		data->span_dropped++;
+		return ret;
+	}
+	span = &data->span[data->span_count];
+	memset(span, '\0', sizeof(*span));
+	span->start = now;
+	span->last = now;
+	span->name = name;
+	span->parent = data->cur_span;
+	span->count = 1;
+	data->cur_span = data->span_count++;
+
+	return data->cur_span;
+}
+
+void bootstage_span_end(int num, ulong bytes)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_span *span;
+	u64 now;
+
+	if (!data || num < 0 || num >= data->span_count)
+		return;
+	now = get_ticks();
+	span = &data->span[num];
+	span->end = now;
+	span->busy += now - span->last;
+	span->bytes += bytes;
+	data->cur_span = span->parent;
+}
+
 /**
  * Get a record name as a printable string
  *
@@ -326,6 +511,71 @@ int bootstage_fdt_add_report(void)
 }
 #endif
 
+/* Convert a number of timer ticks to nanoseconds */
+static u64 ticks_to_ns(u64 ticks, ulong rate)
+{
+	u64 sec = lldiv(ticks, rate);
+
+	return sec * 1000000000ULL +
+		lldiv((ticks - sec * rate) * 1000000000ULL, rate);
+}
+
+static ulong get_tick_rate(void)
+{
+	ulong rate = get_tbclk();
+
+	/* Without a usable timer rate, assume microsecond ticks */
+	return rate && (long)rate > 0 ? rate : 1000000;
+}
+
+/* Get the boot time of a timer tick value, in nanoseconds */
+static u64 span_time_ns(const struct bootstage_data *data, u64 ticks,
+			ulong rate)
+{
+	u64 ns = data->base_us * 1000;
+
+	if (ticks > data->base_ticks)
+		ns += ticks_to_ns(ticks - data->base_ticks, rate);
+
+	return ns;
+}
+
+/* Get the end of a span, using the current time if it is still open */
+static u64 span_end(const struct bootstage_span *span)
+{
+	return span->end ? span->end : get_ticks();
+}
+
+static void print_spans(const struct bootstage_data *data)
+{
+	const struct bootstage_span *span;
+	ulong rate = get_tick_rate();
+	int depth, parent;
+	uint i;
+
+	printf("\nSpans in microseconds (%d spans):\n", data->span_count);
+	printf("%11s%11s  %s\n", "Start", "Elapsed", "Span");
+	for (i = 0, span = data->span; i < data->span_count; i++, span++) {
+		for (depth = 0, parent = span->parent; parent >= 0;
+		     parent = data->span[parent].parent)
+			depth++;
+		print_grouped_ull(lldiv(span_time_ns(data, span->start, rate),
+					1000), BOOTSTAGE_DIGITS);
+		print_grouped_ull(lldiv(ticks_to_ns(span->busy, rate), 1000),
+				  BOOTSTAGE_DIGITS);
+		printf("  %*s%s", depth * 2, "", span->name);
+		if (span->count > 1)
+			printf(" x%u", span->count);
+		if (span->bytes)
+			printf(", %llu bytes", span->bytes);
+		printf("%s\n", span->end ? "" : " (open)");
+	}
+	if (data->span_dropped)
+		printf("Dropped %u spans\n"
+		       "Please increase CONFIG_(SPL_)BOOTSTAGE_SPAN_COUNT\n",
+		       data->span_dropped);
+}
+
 void bootstage_report(void)
 {
 	struct bootstage_data *data = gd->bootstage;
@@ -356,6 +606,114 @@ void bootstage_report(void)
 		if (rec->start_us)
 			prev = print_time_record(rec, -1);
 	}
+
+	if (data->span_count || data->span_dropped)
+		print_spans(data);
+}
+
+/**
+ * struct trace_out - output buffer for the Chrome trace
+ *
+ * @buf: Buffer
+ * @size: Size of buffer
+ * @len: Length of the trace so far, which may be larger than @size
+ */
+struct trace_out {
+	char *buf;
+	int size;
+	int len;
+};
+
+static void trace_printf(struct trace_out *out, const char *fmt, ...)
+{
+	int avail = max(out->size - out->len, 0);
+	va_list args;
+
+	va_start(args, fmt);
+	out->len += vsnprintf(avail ? out->buf + out->len : NULL, avail, fmt,
+			      args);
+	va_end(args);
+}
+
+/* Write a JSON string, escaping the characters which need it */
+static void trace_string(struct trace_out *out, const char *str)
+{
+	const char *p;
+
+	trace_printf(out, "\"");
+	for (p = str; *p; p++) {
+		if (*p == '"' || *p == '\\')
+			trace_printf(out, "\\%c", *p);
+		else if ((u8)*p < ' ')
+			trace_printf(out, "\\u%04x", *p);
+		else
+			trace_printf(out, "%c", *p);
+	}
+	trace_printf(out, "\"");
+}
+
+/* Write a time in nanoseconds as fractional microseconds */
+static void trace_time(struct trace_out *out, const char *field, u64 ns)
+{
+	trace_printf(out, ",\"%s\":%llu.%03u", field, lldiv(ns, 1000),
+		     (uint)(ns % 1000));
+}
+
+int bootstage_export_trace(char *buf, int size)
+{
+	const struct bootstage_data *data = gd->bootstage;
+	const struct bootstage_record *rec;
+	const struct bootstage_span *span;
+	struct trace_out out = { .buf = buf, .size = size };
+	ulong rate = get_tick_rate();
+	const char *sep = "";
+	char name[20];
+	uint i;
+
+	trace_printf(&out, "{\"traceEvents\":[");
+	for (i = 0, rec = data->record; i < data->rec_count; i++, rec++) {
+		if (rec->start_us ||
+		    (rec->id != BOOTSTAGE_ID_AWAKE && !rec->time_us))
+			continue;
+		trace_printf(&out, "%s\n{\"name\":", sep);
+		trace_string(&out, get_record_name(name, sizeof(name), rec));
+		trace_printf(&out, ",\"cat\":\"%s\",\"ph\":\"i\",\"s\":\"g\"",
+			     rec->flags & BOOTSTAGEF_ERROR ? "error" : "mark");
+		trace_printf(&out, ",\"ts\":%lu,\"pid\":0,\"tid\":0}",
+			     rec->time_us);
+		sep = ",";
+	}
+	for (i = 0, span = data->span; i < data->span_count; i++, span++) {
+		u64 start = span_time_ns(data, span->start, rate);
+
+		trace_printf(&out, "%s\n{\"name\":", sep);
+		trace_string(&out, span->name);
+		trace_printf(&out, ",\"cat\":\"span\",\"ph\":\"X\"");
+		trace_time(&out, "ts", start);
+		trace_time(&out, "dur",
+			   span_time_ns(data, span_end(span), rate) - start);
+		trace_printf(&out, ",\"pid\":0,\"tid\":0,\"args\":{");
+		trace_printf(&out, "\"bytes\":%llu,\"count\":%u", span->bytes,
+			     span->count);
+		trace_time(&out, "busy_us", ticks_to_ns(span->busy, rate));
+		trace_printf(&out, "}}");
+		sep = ",";
+	}
+	trace_printf(&out, "\n],\"displayTimeUnit\":\"ns\",\"otherData\":{");
+
+	/* Accumulated times have no position on the time line */
+	sep = "";
+	for (i = 0, rec = data->record; i < data->rec_count; i++, rec++) {
+		if (!rec->start_us)
+			continue;
+		trace_printf(&out, "%s\n", sep);
+		trace_string(&out, get_record_name(name, sizeof(name), rec));
+		trace_printf(&out, ":\"%lu us\"", rec->time_us);
+		sep = ",";
+	}
+	trace_printf(&out, "\n}}\n");
+
+	return out.len;
 }
 
 /**
@@ -415,6 +773,24 @@ int bootstage_stash(void *base, int size)
 		append_data(&ptr, end, name, strlen(name) + 1);
 	}
 
+	/* Write the spans and their names */
+	if (data->span_count) {
+		struct bootstage_span_hdr span_hdr;
+		const struct bootstage_span *span;
+
+		span_hdr.magic = BOOTSTAGE_SPAN_MAGIC;
+		span_hdr.count = data->span_count;
+		span_hdr.base_ticks = data->base_ticks;
+		span_hdr.base_us = data->base_us;
+		append_data(&ptr, end, &span_hdr, sizeof(span_hdr));
+		append_data(&ptr, end, data->span,
+			    data->span_count * sizeof(*span));
+		for (span = data->span, i = 0; i < data->span_count;
+		     i++, span++)
+			append_data(&ptr, end, span->name,
+				    strlen(span->name) + 1);
+	}
+
 	/* Check for buffer overflow */
 	if (ptr > end) {
 		debug("%s: Not enough space for bootstage stash\n", __func__);
@@ -428,6 +804,65 @@ int bootstage_stash(void *base, int size)
 	return 0;
 }
 
+/**
+ * unstash_spans() - Read the spans which follow the records in a stash
+ *
+ * @ptr: Start of the span data, directly after the record names
+ * @end: End of the stashed data
+ * @return 0 if OK (including if there are no spans), -ENOSPC if there is not
+ *	space for the stashed spans
+ */
+static int unstash_spans(const char *ptr, const char *end)
+{
+	struct bootstage_data *data = gd->bootstage;
+	struct bootstage_span_hdr span_hdr;
+	struct bootstage_span *span;
+	uint i;
+
+	if (ptr + sizeof(span_hdr) > end)
+		return 0;
+	memcpy(&span_hdr, ptr, sizeof(span_hdr));
+	if (span_hdr.magic != BOOTSTAGE_SPAN_MAGIC)
+		return 0;
+	ptr += sizeof(span_hdr);
+	if (ptr + span_hdr.count * sizeof(*span) > end) {
+		debug("%s: Bootstage spans run past data end\n", __func__);
+		return -ENOSPC;
+	}
+	if (data->span_count + span_hdr.count > SPAN_COUNT) {
+		debug("%s: Bootstage has %d spans, we have space for %d\n"
+		      "Please increase CONFIG_(SPL_)BOOTSTAGE_SPAN_COUNT\n",
+		      __func__, span_hdr.count, SPAN_COUNT - data->span_count);
+		return -ENOSPC;
+	}
+	if (!span_hdr.count)
+		return 0;
+	if (bootstage_grow_spans(data, span_hdr.count))
+		return -ENOMEM;
+
+	span = data->span + data->span_count;
+	memcpy(span, ptr, span_hdr.count * sizeof(*span));
+	ptr += span_hdr.count * sizeof(*span);
+	for (i = 0; i < span_hdr.count; i++, span++) {
+		if (span->parent >= 0)
+			span->parent += data->span_count;
+		span->name = ptr;
+		if (spl_phase() == PHASE_SPL)
+			span->name = strdup(ptr);
+		ptr += strlen(ptr) + 1;
+	}
+	data->span_count += span_hdr.count;
+
+	/* Both phases use the same timer, so one time base is enough */
+	if (!data->base_ticks && !data->base_us) {
+		data->base_ticks = span_hdr.base_ticks;
+		data->base_us = span_hdr.base_us;
+	}
+	debug("Unstashed %d spans\n", span_hdr.count);
+
+	return 0;
+}
+
 int bootstage_unstash(const void *base, int size)
 {
 	const struct bootstage_hdr *hdr = (struct bootstage_hdr *)base;
@@ -498,7 +933,7 @@ int bootstage_unstash(const void *base, int size)
 	data->next_id = hdr->next_id;
 	debug("Unstashed %d records\n", hdr->count);
 
-	return 0;
+	return unstash_spans(ptr, (const char *)base + hdr->size);
 }
 
 int bootstage_get_size(void)
@@ -512,6 +947,9 @@ int bootstage_get_size(void)
 	for (rec = data->record, i = 0; i < data->rec_count;
 	     i++, rec++)
 		size += strlen(rec->name) + 1;
+	size += data->span_count * sizeof(*data->span);
+	for (i = 0; i < data->span_count; i++)
+		size += strlen(data->span[i].name) + 1;
 
 	return size;
 }
@@ -526,6 +964,7 @@ int bootstage_init(bool first)
 		return -ENOMEM;
 	data = gd->bootstage;
 	memset(data, '\0', size);
+	data->cur_span = -1;
 	if (first) {
 		data->next_id = BOOTSTAGE_ID_USER;
 		bootstage_add_record(BOOTSTAGE_ID_AWAKE, "reset", 0, 0);
@@ -533,3 +972,14 @@ int bootstage_init(bool first)
 
 	return 0;
 }
+
+void bootstage_uninit(void)
+{
+	struct bootstage_data *data = gd->bootstage;
+
+	if (!data)
+		return;
+	free(data->span);
+	free(data);
+	gd->bootstage = NULL;
+}
@@ -41,6 +41,7 @@ int run_usb_dnl_gadget(int usbctrl_index, char *usb_dnl_gadget)
 	unsigned long start_time = get_timer(0);
 #endif
 
+	dfu_set_write_behind(true);
 	while (1) {
 		if (g_dnl_detach()) {
 			/*
@@ -98,10 +99,14 @@ int run_usb_dnl_gadget(int usbctrl_index, char *usb_dnl_gadget)
 		}
 #endif
 
+		/* Write out what has arrived while the host sends more */
+		dfu_write_pending();
+
 		WATCHDOG_RESET();
 		usb_gadget_handle_interrupts(usbctrl_index);
 	}
 exit:
+	dfu_set_write_behind(false);
 	g_dnl_unregister();
 	usb_gadget_release(usbctrl_index);
 
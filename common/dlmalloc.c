@@ -20,6 +20,8 @@ void malloc_stats();
 
 DECLARE_GLOBAL_DATA_PTR;
 
+static void free_core(Void_t *mem);
+
 /*
   Emulation of sbrk for WIN32
   All code within the ifdef WIN32 is untested by me.
@@ -579,6 +581,7 @@ static inline void malloc_bin_reloc(void) {}
 #ifdef CONFIG_SYS_MALLOC_DEFAULT_TO_INIT
 static void malloc_init(void);
 #endif
+static void size_class_init(void);
 
 ulong mem_malloc_start = 0;
 ulong mem_malloc_end = 0;
@@ -613,6 +616,7 @@ void mem_malloc_init(ulong start, ulong size)
 #ifdef CONFIG_SYS_MALLOC_DEFAULT_TO_INIT
 	malloc_init();
 #endif
+	size_class_init();
 
 	debug("using memory %#lx-%#lx for malloc()\n", mem_malloc_start,
 	      mem_malloc_end);
@@ -718,6 +722,141 @@ static unsigned int max_n_mmaps = 0;
 static unsigned long max_mmapped_mem = 0;
 #endif
 
+/*
+  Size classes
+
+    Freed chunks of up to SIZE_CLASS_MAX bytes are kept on a list for
+    their exact size without being coalesced, and a later request of the
+    same size takes them straight back. This avoids the cost of free()
+    and of searching the bins for the many short-lived small blocks used
+    by driver model, FDT and filesystem code. The chunks stay marked as
+    in use, so the bins never see them. They are all released to the bins
+    if malloc() would otherwise fail, and before mallinfo() so that
+    it reports them as free.
+*/
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SIZE_CLASSES)
+#define SIZE_CLASS_MAX		CONFIG_SYS_MALLOC_SIZE_CLASS_MAX
+#define SIZE_CLASS_LIMIT	CONFIG_SYS_MALLOC_SIZE_CLASS_LIMIT
+#define NSIZE_CLASSES		(SIZE_CLASS_MAX / MALLOC_ALIGNMENT + 1)
+#define size_class_index(sz)	((unsigned long)(sz) / MALLOC_ALIGNMENT)
+
+static mchunkptr size_classes[NSIZE_CLASSES];
+static unsigned long size_class_bytes;	/* total size of the chunks held */
+static unsigned long size_class_hits;	/* requests met from a size class */
+
+static int size_class_put(mchunkptr p)
+{
+	INTERNAL_SIZE_T sz = chunksize(p);
+	int idx = size_class_index(sz);
+
+	if (chunk_is_mmapped(p) || sz > SIZE_CLASS_MAX ||
+	    size_class_bytes + sz > SIZE_CLASS_LIMIT)
+		return 0;
+	p->fd = size_classes[idx];
+	size_classes[idx] = p;
+	size_class_bytes += sz;
+
+	return 1;
+}
+
+static mchunkptr size_class_get(INTERNAL_SIZE_T nb)
+{
+	int idx = size_class_index(nb);
+	mchunkptr p;
+
+	if (nb > SIZE_CLASS_MAX || !size_classes[idx])
+		return NULL;
+	p = size_classes[idx];
+	size_classes[idx] = p->fd;
+	size_class_bytes -= nb;
+	size_class_hits++;
+
+	return p;
+}
+
+static int size_class_release(void)
+{
+	int released = size_class_bytes != 0;
+	mchunkptr p;
+	int i;
+
+	for (i = 0; i < NSIZE_CLASSES; i++) {
+		while ((p = size_classes[i])) {
+			size_classes[i] = p->fd;
+			free_core(chunk2mem(p));
+		}
+	}
+	size_class_bytes = 0;
+
+	return released;
+}
+
+static void size_class_init(void)
+{
+	memset(size_classes, '\0', sizeof(size_classes));
+	size_class_bytes = 0;
+	size_class_hits = 0;
+}
+#else
+static inline int size_class_put(mchunkptr p) { return 0; }
+static inline mchunkptr size_class_get(INTERNAL_SIZE_T nb) { return NULL; }
+static inline int size_class_release(void) { return 0; }
+static inline void size_class_init(void) {}
+#endif
+
+/*
+  Statistics for 'malloc info'
+
+    These are kept by the public entry points, using chunk sizes, so that
+    the allocator's calls to itself (e.g. from realloc()) are not counted.
+*/
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_STATS)
+static struct malloc_info heap_stats;
+
+static int malloc_hist_bucket(INTERNAL_SIZE_T sz)
+{
+	int bucket = fls(sz - 1) - 4;
+
+	return clamp(bucket, 0, MALLOC_HIST_BUCKETS - 1);
+}
+
+static void malloc_account(INTERNAL_SIZE_T sz, int alloc)
+{
+	struct malloc_info *info = &heap_stats;
+	int bucket = malloc_hist_bucket(sz);
+
+	if (alloc) {
+		info->live_bytes += sz;
+		info->live_count++;
+		info->live[bucket]++;
+		info->allocs[bucket]++;
+		if (info->live_bytes > info->peak_bytes)
+			info->peak_bytes = info->live_bytes;
+	} else {
+		info->live_bytes -= sz;
+		info->live_count--;
+		info->live[bucket]--;
+	}
+}
+
+#define malloc_count(field)	(heap_stats.field++)
+
+void malloc_get_info(struct malloc_info *info)
+{
+	*info = heap_stats;
+	info->heap_size = mem_malloc_end - mem_malloc_start;
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SIZE_CLASSES)
+	info->class_hits = size_class_hits;
+	info->class_bytes = size_class_bytes;
+#endif
+}
+#else
+static inline void malloc_account(INTERNAL_SIZE_T sz, int alloc) {}
+#define malloc_count(field)
+#endif
+
 #ifdef CONFIG_SYS_MALLOC_DEFAULT_TO_INIT
 static void malloc_init(void)
 {
@@ -746,6 +885,9 @@ static void malloc_init(void)
 #ifdef DEBUG
 	memset((void *)&current_mallinfo, 0, sizeof(struct mallinfo));
 #endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_STATS)
+	memset(&heap_stats, '\0', sizeof(heap_stats));
+#endif
 }
 #endif
 
@@ -1191,7 +1333,7 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 	SIZE_SZ|PREV_INUSE;
       /* If possible, release the rest. */
       if (old_top_size >= MINSIZE)
-	fREe(chunk2mem(old_top));
+	free_core(chunk2mem(old_top));
     }
   }
 
@@ -1270,9 +1412,9 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 */
 
 #if __STD_C
-Void_t* mALLOc(size_t bytes)
+static Void_t* malloc_core(size_t bytes)
 #else
-Void_t* mALLOc(bytes) size_t bytes;
+static Void_t* malloc_core(bytes) size_t bytes;
 #endif
 {
   mchunkptr victim;                  /* inspected/selected chunk */
@@ -1290,11 +1432,6 @@ Void_t* mALLOc(bytes) size_t bytes;
 
   INTERNAL_SIZE_T nb;
 
-#if CONFIG_VAL(SYS_MALLOC_F_LEN)
-	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
-		return malloc_simple(bytes);
-#endif
-
   /* check if mem_malloc_init() was run */
   if ((mem_malloc_start == 0) && (mem_malloc_end == 0)) {
     /* not initialized yet */
@@ -1305,6 +1442,12 @@ Void_t* mALLOc(bytes) size_t bytes;
 
   nb = request2size(bytes);  /* padded request size; */
 
+  /* Check for a chunk of exactly this size in a size class */
+
+  victim = size_class_get(nb);
+  if (victim)
+    return chunk2mem(victim);
+
   /* Check for exact match in a bin */
 
   if (is_small_request(nb))  /* Faster version for small requests */
@@ -1504,7 +1647,12 @@ Void_t* mALLOc(bytes) size_t bytes;
     /* Try to extend */
     malloc_extend_top(nb);
     if ( (remainder_size = chunksize(top) - nb) < (long)MINSIZE)
+    {
+      /* Coalesce the size classes and try again */
+      if (size_class_release())
+	return malloc_core(bytes);
       return NULL; /* propagate failure */
+    }
   }
 
   victim = top;
@@ -1542,9 +1690,9 @@ Void_t* mALLOc(bytes) size_t bytes;
 
 
 #if __STD_C
-void fREe(Void_t* mem)
+static void free_core(Void_t* mem)
 #else
-void fREe(mem) Void_t* mem;
+static void free_core(mem) Void_t* mem;
 #endif
 {
   mchunkptr p;         /* chunk corresponding to mem */
@@ -1558,12 +1706,6 @@ void fREe(mem) Void_t* mem;
   mchunkptr fwd;       /* misc temp for linking */
   int       islr;      /* track whether merging with last_remainder */
 
-#if CONFIG_VAL(SYS_MALLOC_F_LEN)
-	/* free() is a no-op - all the memory will be freed on relocation */
-	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
-		return;
-#endif
-
   if (mem == NULL)                              /* free(0) has no effect */
     return;
 
@@ -1680,9 +1822,9 @@ void fREe(mem) Void_t* mem;
 
 
 #if __STD_C
-Void_t* rEALLOc(Void_t* oldmem, size_t bytes)
+static Void_t* realloc_core(Void_t* oldmem, size_t bytes)
 #else
-Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
+static Void_t* realloc_core(oldmem, bytes) Void_t* oldmem; size_t bytes;
 #endif
 {
   INTERNAL_SIZE_T    nb;      /* padded request size */
@@ -1708,7 +1850,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
 #ifdef REALLOC_ZERO_BYTES_FREES
   if (!bytes) {
-	fREe(oldmem);
+	free_core(oldmem);
 	return NULL;
   }
 #endif
@@ -1716,14 +1858,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
   if ((long)bytes < 0) return NULL;
 
   /* realloc of null is supposed to be same as malloc */
-  if (oldmem == NULL) return mALLOc(bytes);
-
-#if CONFIG_VAL(SYS_MALLOC_F_LEN)
-	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
-		/* This is harder to support and should not be needed */
-		panic("pre-reloc realloc() is not supported");
-	}
-#endif
+  if (oldmem == NULL) return malloc_core(bytes);
 
   newp    = oldp    = mem2chunk(oldmem);
   newsize = oldsize = chunksize(oldp);
@@ -1741,7 +1876,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
     /* Note the extra SIZE_SZ overhead. */
     if(oldsize - SIZE_SZ >= nb) return oldmem; /* do nothing */
     /* Must alloc, copy, free. */
-    newmem = mALLOc(bytes);
+    newmem = malloc_core(bytes);
     if (!newmem)
 	return NULL; /* propagate failure */
     MALLOC_COPY(newmem, oldmem, oldsize - 2*SIZE_SZ);
@@ -1844,7 +1979,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
     /* Must allocate */
 
-    newmem = mALLOc (bytes);
+    newmem = malloc_core(bytes);
 
     if (newmem == NULL)  /* propagate failure */
       return NULL;
@@ -1861,7 +1996,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
     /* Otherwise copy, free, and exit */
     MALLOC_COPY(newmem, oldmem, oldsize - SIZE_SZ);
-    fREe(oldmem);
+    free_core(oldmem);
     return newmem;
   }
 
@@ -1875,7 +2010,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
     set_head_size(newp, nb);
     set_head(remainder, remainder_size | PREV_INUSE);
     set_inuse_bit_at_offset(remainder, remainder_size);
-    fREe(chunk2mem(remainder)); /* let free() deal with it */
+    free_core(chunk2mem(remainder)); /* let free() deal with it */
   }
   else
   {
@@ -1910,9 +2045,9 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
 
 #if __STD_C
-Void_t* mEMALIGn(size_t alignment, size_t bytes)
+static Void_t* memalign_core(size_t alignment, size_t bytes)
 #else
-Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
+static Void_t* memalign_core(alignment, bytes) size_t alignment; size_t bytes;
 #endif
 {
   INTERNAL_SIZE_T    nb;      /* padded  request size */
@@ -1927,15 +2062,9 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
 
   if ((long)bytes < 0) return NULL;
 
-#if CONFIG_VAL(SYS_MALLOC_F_LEN)
-	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
-		return memalign_simple(alignment, bytes);
-	}
-#endif
-
   /* If need less alignment than we give anyway, just relay to malloc */
 
-  if (alignment <= MALLOC_ALIGNMENT) return mALLOc(bytes);
+  if (alignment <= MALLOC_ALIGNMENT) return malloc_core(bytes);
 
   /* Otherwise, ensure that it is at least a minimum chunk size */
 
@@ -1944,7 +2073,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
   /* Call malloc with worst case padding to hit alignment. */
 
   nb = request2size(bytes);
-  m  = (char*)(mALLOc(nb + alignment + MINSIZE));
+  m  = (char*)(malloc_core(nb + alignment + MINSIZE));
 
   /*
   * The attempt to over-allocate (with a size large enough to guarantee the
@@ -1960,7 +2089,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
      * Use bytes not nb, since mALLOc internally calls request2size too, and
      * each call increases the size to allocate, to account for the header.
      */
-    m  = (char*)(mALLOc(bytes));
+    m  = (char*)(malloc_core(bytes));
     /* Aligned -> return it */
     if ((((unsigned long)(m)) % alignment) == 0)
       return m;
@@ -1968,10 +2097,10 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
      * Otherwise, try again, requesting enough extra space to be able to
      * acquire alignment.
      */
-    fREe(m);
+    free_core(m);
     /* Add in extra bytes to match misalignment of unexpanded allocation */
     extra = alignment - (((unsigned long)(m)) % alignment);
-    m  = (char*)(mALLOc(bytes + extra));
+    m  = (char*)(malloc_core(bytes + extra));
     /*
      * m might not be the same as before. Validate that the previous value of
      * extra still works for the current value of m.
@@ -1980,7 +2109,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     if (m) {
       extra2 = alignment - (((unsigned long)(m)) % alignment);
       if (extra2 > extra) {
-        fREe(m);
+        free_core(m);
         m = NULL;
       }
     }
@@ -2030,7 +2159,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     set_head(newp, newsize | PREV_INUSE);
     set_inuse_bit_at_offset(newp, newsize);
     set_head_size(p, leadsize);
-    fREe(chunk2mem(p));
+    free_core(chunk2mem(p));
     p = newp;
 
     assert (newsize >= nb && (((unsigned long)(chunk2mem(p))) % alignment) == 0);
@@ -2045,7 +2174,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     remainder = chunk_at_offset(p, nb);
     set_head(remainder, remainder_size | PREV_INUSE);
     set_head_size(p, nb);
-    fREe(chunk2mem(remainder));
+    free_core(chunk2mem(remainder));
   }
 
   check_inuse_chunk(p);
@@ -2056,6 +2185,126 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
 
 
 
+/*
+  Public entry points
+
+    These deal with the simple allocator used before relocation, then
+    call the routines above. Freed small chunks go to the size classes.
+    The caller is passed down so that allocations can be tracked by the
+    code which made them, rather than by calloc() and the like.
+*/
+
+static Void_t *malloc_caller(size_t bytes, void *caller)
+{
+	Void_t *mem;
+
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		mem = malloc_simple(bytes);
+		malloc_track_alloc(mem, bytes, caller);
+		return mem;
+	}
+#endif
+	mem = malloc_core(bytes);
+	if (mem) {
+		malloc_count(mallocs);
+		malloc_account(chunksize(mem2chunk(mem)), 1);
+	} else {
+		malloc_count(failures);
+	}
+	malloc_track_alloc(mem, bytes, caller);
+
+	return mem;
+}
+
+static Void_t *memalign_caller(size_t alignment, size_t bytes, void *caller)
+{
+	Void_t *mem;
+
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		mem = memalign_simple(alignment, bytes);
+		malloc_track_alloc(mem, bytes, caller);
+		return mem;
+	}
+#endif
+	mem = memalign_core(alignment, bytes);
+	if (mem) {
+		malloc_count(mallocs);
+		malloc_account(chunksize(mem2chunk(mem)), 1);
+	} else {
+		malloc_count(failures);
+	}
+	malloc_track_alloc(mem, bytes, caller);
+
+	return mem;
+}
+
+Void_t *mALLOc(size_t bytes)
+{
+	return malloc_caller(bytes, __builtin_return_address(0));
+}
+
+void fREe(Void_t *mem)
+{
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	/* At most the last block can be freed - the rest go on relocation */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		ulong ptr = gd->malloc_ptr;
+
+		if (CONFIG_IS_ENABLED(SYS_MALLOC_F_FREE_LAST))
+			free_simple(mem);
+		if (gd->malloc_ptr != ptr)
+			malloc_track_free(mem);
+		return;
+	}
+#endif
+	malloc_track_free(mem);
+	if (!mem)
+		return;
+	check_inuse_chunk(mem2chunk(mem));
+	malloc_count(frees);
+	malloc_account(chunksize(mem2chunk(mem)), 0);
+	if (!size_class_put(mem2chunk(mem)))
+		free_core(mem);
+}
+
+Void_t *rEALLOc(Void_t *oldmem, size_t bytes)
+{
+	INTERNAL_SIZE_T oldsize;
+	Void_t *mem;
+
+	if (!oldmem)
+		return malloc_caller(bytes, __builtin_return_address(0));
+#if CONFIG_VAL(SYS_MALLOC_F_LEN)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		/* This is harder to support and should not be needed */
+		panic("pre-reloc realloc() is not supported");
+	}
+#endif
+	oldsize = chunksize(mem2chunk(oldmem));
+	mem = realloc_core(oldmem, bytes);
+	if (mem) {
+		malloc_count(reallocs);
+		malloc_account(oldsize, 0);
+		malloc_account(chunksize(mem2chunk(mem)), 1);
+		malloc_track_free(oldmem);
+		malloc_track_alloc(mem, bytes, __builtin_return_address(0));
+	} else {
+		malloc_count(failures);
+	}
+
+	return mem;
+}
+
+Void_t *mEMALIGn(size_t alignment, size_t bytes)
+{
+	return memalign_caller(alignment, bytes, __builtin_return_address(0));
+}
+
+
+
+
 /*
     valloc just invokes memalign with alignment argument equal
     to the page size of the system (or as near to this as can
@@ -2068,7 +2317,8 @@ Void_t* vALLOc(size_t bytes)
 Void_t* vALLOc(bytes) size_t bytes;
 #endif
 {
-  return mEMALIGn (malloc_getpagesize, bytes);
+  return memalign_caller(malloc_getpagesize, bytes,
+			 __builtin_return_address(0));
 }
 
 /*
@@ -2084,7 +2334,8 @@ Void_t* pvALLOc(bytes) size_t bytes;
 #endif
 {
   size_t pagesize = malloc_getpagesize;
-  return mEMALIGn (pagesize, (bytes + pagesize - 1) & ~(pagesize - 1));
+  return memalign_caller(pagesize, (bytes + pagesize - 1) & ~(pagesize - 1),
+			 __builtin_return_address(0));
 }
 
 /*
@@ -2112,7 +2363,7 @@ Void_t* cALLOc(n, elem_size) size_t n; size_t elem_size;
   INTERNAL_SIZE_T oldtopsize = chunksize(top);
 #endif
 #endif
-  Void_t* mem = mALLOc (sz);
+  Void_t* mem = malloc_caller(sz, __builtin_return_address(0));
 
   if ((long)n < 0) return NULL;
 
@@ -2351,6 +2602,7 @@ static void malloc_update_mallinfo()
 #ifdef DEBUG
 void malloc_stats()
 {
+  size_class_release();
   malloc_update_mallinfo();
   printf("max system bytes = %10u\n",
 	  (unsigned int)(max_total_mem));
@@ -2372,6 +2624,7 @@ void malloc_stats()
 #ifdef DEBUG
 struct mallinfo mALLINFo()
 {
+  size_class_release();
   malloc_update_mallinfo();
   return current_mallinfo;
 }
@@ -17,6 +17,7 @@
 #include <asm/global_data.h>
 #include <linux/libfdt.h>
 #include <fdt_support.h>
+#include <fdt_txn.h>
 #include <exports.h>
 #include <fdtdec.h>
 
@@ -511,36 +512,46 @@ int fdt_fixup_memory(void *blob, u64 start, u64 size)
 	return fdt_fixup_memory_banks(blob, &start, &size, 1);
 }
 
+static void fdt_fixup_ethernet_err(const char *path, const char *prop,
+				   int err)
+{
+	printf("Unable to update property %s:%s, err=%s\n", path, prop,
+	       fdt_strerror(err));
+}
+
+/*
+ * All the MAC address properties are written by one transaction, so the
+ * offsets in /aliases stay valid while it is walked. A board with only a
+ * few interfaces makes no more edits than the transaction applies in
+ * place, which is no faster than editing the tree directly and, like
+ * direct edits, leaves the earlier properties written if a later one
+ * fails. Only boards with many interfaces get the single rebuild.
+ */
 void fdt_fixup_ethernet(void *fdt)
 {
-	int i = 0, j, prop;
+	int i = 0, j, ret;
 	char *tmp, *end;
 	char mac[16];
 	const char *path;
 	unsigned char mac_addr[ARP_HLEN];
-	int offset;
+	int aliases, offset, nodeoff;
+	struct fdt_txn txn;
 #ifdef FDT_SEQ_MACADDR_FROM_ENV
-	int nodeoff;
 	const struct fdt_property *fdt_prop;
 #endif
 
-	if (fdt_path_offset(fdt, "/aliases") < 0)
+	aliases = fdt_path_offset(fdt, "/aliases");
+	if (aliases < 0)
 		return;
 
-	/* Cycle through all aliases */
-	for (prop = 0; ; prop++) {
+	/*
+	 * The edits are only made when the transaction is committed, so the
+	 * offsets stay valid while cycling through all aliases
+	 */
+	fdt_txn_init(&txn, fdt);
+	fdt_for_each_property_offset(offset, fdt, aliases) {
 		const char *name;
 
-		/* FDT might have been edited, recompute the offset */
-		offset = fdt_first_property_offset(fdt,
-			fdt_path_offset(fdt, "/aliases"));
-		/* Select property number 'prop' */
-		for (j = 0; j < prop; j++)
-			offset = fdt_next_property_offset(fdt, offset);
-
-		if (offset < 0)
-			break;
-
 		path = fdt_getprop_by_offset(fdt, offset, &name, NULL);
 		if (!strncmp(name, "ethernet", 8)) {
 			/* Treat plain "ethernet" same as "ethernet0". */
@@ -562,8 +573,8 @@ void fdt_fixup_ethernet(void *fdt)
 			} else {
 				continue;
 			}
-#ifdef FDT_SEQ_MACADDR_FROM_ENV
 			nodeoff = fdt_path_offset(fdt, path);
+#ifdef FDT_SEQ_MACADDR_FROM_ENV
 			fdt_prop = fdt_get_property(fdt, nodeoff, "status",
 						    NULL);
 			if (fdt_prop && !strcmp(fdt_prop->data, "disabled"))
@@ -581,12 +592,31 @@ void fdt_fixup_ethernet(void *fdt)
 					tmp = (*end) ? end + 1 : end;
 			}
 
-			do_fixup_by_path(fdt, path, "mac-address",
-					 &mac_addr, 6, 0);
-			do_fixup_by_path(fdt, path, "local-mac-address",
-					 &mac_addr, 6, 1);
+			if (nodeoff < 0) {
+				fdt_fixup_ethernet_err(path, "local-mac-address",
+						       nodeoff);
+				continue;
+			}
+			ret = 0;
+			if (fdt_getprop(fdt, nodeoff, "mac-address", NULL))
+				ret = fdt_txn_setprop(&txn, nodeoff,
+						      "mac-address",
+						      &mac_addr, 6);
+			if (ret)
+				fdt_fixup_ethernet_err(path, "mac-address", ret);
+			ret = fdt_txn_setprop(&txn, nodeoff,
+					      "local-mac-address",
+					      &mac_addr, 6);
+			if (ret)
+				fdt_fixup_ethernet_err(path, "local-mac-address",
+						       ret);
 		}
 	}
+
+	ret = fdt_txn_commit(&txn);
+	if (ret)
+		printf("Unable to update property mac-address, err=%s\n",
+		       fdt_strerror(ret));
 }
 
 int fdt_record_loadable(void *blob, u32 index, const char *name,
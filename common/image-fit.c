@@ -1878,10 +1878,12 @@ static const char *fit_get_image_type_property(int type)
 	return "unknown";
 }
 
-int fit_image_load(bootm_headers_t *images, ulong addr,
-		   const char **fit_unamep, const char **fit_uname_configp,
-		   int arch, int image_type, int bootstage_id,
-		   enum fit_load_op load_op, ulong *datap, ulong *lenp)
+static int fit_image_do_load(bootm_headers_t *images, ulong addr,
+			     const char **fit_unamep,
+			     const char **fit_uname_configp, int arch,
+			     int image_type, int bootstage_id,
+			     enum fit_load_op load_op, ulong *datap,
+			     ulong *lenp)
 {
 	int cfg_noffset, noffset;
 	const char *fit_uname;
@@ -2133,6 +2135,23 @@ int fit_image_load(bootm_headers_t *images, ulong addr,
 	return noffset;
 }
 
+int fit_image_load(bootm_headers_t *images, ulong addr,
+		   const char **fit_unamep, const char **fit_uname_configp,
+		   int arch, int image_type, int bootstage_id,
+		   enum fit_load_op load_op, ulong *datap, ulong *lenp)
+{
+	int span, ret;
+
+	/* Covers checking hashes and signatures, and decompression */
+	span = bootstage_span_start("fit load", 0);
+	ret = fit_image_do_load(images, addr, fit_unamep, fit_uname_configp,
+				arch, image_type, bootstage_id, load_op, datap,
+				lenp);
+	bootstage_span_end(span, ret < 0 ? 0 : *lenp);
+
+	return ret;
+}
+
 int boot_get_setup_fit(bootm_headers_t *images, uint8_t arch,
 			ulong *setup_start, ulong *setup_len)
 {
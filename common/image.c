@@ -1630,11 +1630,15 @@ int boot_get_cmdline(struct lmb *lmb, ulong *cmd_start, ulong *cmd_end)
 	char *cmdline;
 	char *s;
 
-	cmdline = (char *)(ulong)lmb_alloc_base(lmb, CONFIG_SYS_BARGSIZE, 0xf,
-				env_get_bootm_mapsize() + env_get_bootm_low());
+	/* Keep the large free ranges for the ramdisk and device tree */
+	cmdline = (char *)(ulong)lmb_alloc_policy(lmb, CONFIG_SYS_BARGSIZE, 0x10,
+				env_get_bootm_mapsize() + env_get_bootm_low(),
+				LMB_ALLOC_BEST_FIT);
 
-	if (cmdline == NULL)
+	if (cmdline == NULL) {
+		puts("ERROR: Failed to allocate kernel command line\n");
 		return -1;
+	}
 
 	s = env_get("bootargs");
 	if (!s)
@@ -1667,12 +1671,14 @@ int boot_get_cmdline(struct lmb *lmb, ulong *cmd_start, ulong *cmd_end)
  */
 int boot_get_kbd(struct lmb *lmb, struct bd_info **kbd)
 {
-	*kbd = (struct bd_info *)(ulong)lmb_alloc_base(lmb,
-						       sizeof(struct bd_info),
-						       0xf,
-						       env_get_bootm_mapsize() + env_get_bootm_low());
-	if (*kbd == NULL)
+	*kbd = (struct bd_info *)(ulong)lmb_alloc_policy(lmb,
+					sizeof(struct bd_info), 0x10,
+					env_get_bootm_mapsize() + env_get_bootm_low(),
+					LMB_ALLOC_BEST_FIT);
+	if (*kbd == NULL) {
+		puts("ERROR: Failed to allocate kernel board info\n");
 		return -1;
+	}
 
 	**kbd = *(gd->bd);
 
@@ -183,18 +183,28 @@ static bool log_passes_filters(struct log_device *ldev, struct log_rec *rec)
  * log_dispatch() - Send a log record to all log devices for processing
  *
  * The log record is sent to each log device in turn, skipping those which have
- * filters which block the record
+ * filters which block the record. The message is only formatted if a device
+ * accepts the record.
  *
  * @rec: Log record to dispatch
+ * @fmt: printf() format string for the message
+ * @args: Arguments for @fmt
  * @return 0 (meaning success)
  */
-static int log_dispatch(struct log_rec *rec)
+static int log_dispatch(struct log_rec *rec, const char *fmt, va_list args)
 {
+	char buf[CONFIG_SYS_CBSIZE];
 	struct log_device *ldev;
 
+	rec->msg = NULL;
 	list_for_each_entry(ldev, &gd->log_head, sibling_node) {
-		if (log_passes_filters(ldev, rec))
-			ldev->drv->emit(ldev, rec);
+		if (!log_passes_filters(ldev, rec))
+			continue;
+		if (!rec->msg) {
+			vsnprintf(buf, sizeof(buf), fmt, args);
+			rec->msg = buf;
+		}
+		ldev->drv->emit(ldev, rec);
 	}
 
 	return 0;
@@ -203,25 +213,27 @@ static int log_dispatch(struct log_rec *rec)
 int _log(enum log_category_t cat, enum log_level_t level, const char *file,
 	 int line, const char *func, const char *fmt, ...)
 {
-	char buf[CONFIG_SYS_CBSIZE];
 	struct log_rec rec;
 	va_list args;
 
+	if (!gd || !(gd->flags & GD_FLG_LOG_READY)) {
+		if (gd)
+			gd->log_drop_count++;
+		return -ENOSYS;
+	}
 	rec.cat = cat;
 	rec.level = level;
 	rec.file = file;
 	rec.line = line;
 	rec.func = func;
+	if (CONFIG_IS_ENABLED(LOG_RING) && gd->log_ring) {
+		va_start(args, fmt);
+		log_ring_add(&rec, fmt, args);
+		va_end(args);
+	}
 	va_start(args, fmt);
-	vsnprintf(buf, sizeof(buf), fmt, args);
+	log_dispatch(&rec, fmt, args);
 	va_end(args);
-	rec.msg = buf;
-	if (!gd || !(gd->flags & GD_FLG_LOG_READY)) {
-		if (gd)
-			gd->log_drop_count++;
-		return -ENOSYS;
-	}
-	log_dispatch(&rec);
 
 	return 0;
 }
@@ -318,6 +330,16 @@ int log_init(void)
 			      (struct list_head *)&gd->log_head);
 		drv++;
 	}
+#if CONFIG_IS_ENABLED(LOG_RING)
+	/* Keep records once relocated, since they point into the code */
+	if ((gd->flags & GD_FLG_RELOC) && !gd->log_ring) {
+		int ret = log_ring_init(CONFIG_LOG_RING_SIZE);
+
+		if (ret)
+			debug("%s: Cannot set up log ring (err=%d)\n", __func__,
+			      ret);
+	}
+#endif
 	gd->flags |= GD_FLG_LOG_READY;
 	if (!gd->default_log_level)
 		gd->default_log_level = CONFIG_LOG_DEFAULT_LEVEL;
@@ -0,0 +1,637 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Log ring, holding log records in binary form
+ *
+ * Formatting a log record is slow compared to most of the code which logs
+ * things, so this keeps the format string and a copy of the arguments
+ * instead, along with the time, category and level. The text is only
+ * produced when the records are shown or passed on to the OS.
+ *
+ * Records are stored one after another in a ring buffer. When a record does
+ * not fit before the end of the buffer, a record with a size of 0 marks the
+ * end and the record goes at the start. The oldest records are dropped to
+ * make space as needed.
+ */
+
+#include <common.h>
+#include <bloblist.h>
+#include <div64.h>
+#include <log.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/ctype.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+enum {
+	/* Largest record, including its header */
+	LOG_RING_MAX_REC	= 256,
+	/* Longest conversion specification, e.g. "%-08lx" */
+	LOG_RING_MAX_SPEC	= 12,
+	/* Its length with each '*' replaced by a value, e.g. "-2147483648" */
+	LOG_RING_MAX_SPEC_STR	= LOG_RING_MAX_SPEC + 2 * 11 + 1,
+};
+
+/* Flags for struct log_ring_rec */
+enum log_ring_rec_flags {
+	LOGRF_TEXT	= 1 << 0,	/* text follows, not arguments */
+};
+
+/**
+ * struct log_ring_rec - a record in the log ring
+ *
+ * This is followed by the arguments for @fmt, packed together, or by the
+ * message text if LOGRF_TEXT is set. Strings are copied into the arguments,
+ * with their terminator.
+ *
+ * @size: Size of the record including what follows, or 0 to mark the end of
+ *	the records before the ring wraps
+ * @level: Log level (enum log_level_t)
+ * @flags: Flags (enum log_ring_rec_flags)
+ * @cat: Log category (enum log_category_t)
+ * @line: Line number where the record was generated
+ * @time_us: Time when the record was generated, in microseconds
+ * @fmt: printf() format string, not used if LOGRF_TEXT is set
+ * @file: File where the record was generated
+ * @func: Function where the record was generated
+ */
+struct log_ring_rec {
+	u16 size;
+	u8 level;
+	u8 flags;
+	u16 cat;
+	u16 line;
+	u64 time_us;
+	const char *fmt;
+	const char *file;
+	const char *func;
+};
+
+/**
+ * struct log_ring - the log ring
+ *
+ * @buf: Buffer holding the records
+ * @size: Size of @buf in bytes
+ * @head: Offset of the oldest record
+ * @tail: Offset at which to add the next record
+ * @stats: Statistics for the ring
+ */
+struct log_ring {
+	char *buf;
+	int size;
+	int head;
+	int tail;
+	struct log_ring_stats stats;
+};
+
+/**
+ * struct log_ring_spec - a conversion specification in a format string
+ *
+ * @start: Start of the specification, i.e. the '%'
+ * @len: Length of the specification
+ * @conv: Conversion character, e.g. 'd'
+ * @qualifier: Conversion qualifier ('h', 'l', 'L', 'z', 'Z', 't') or 0
+ * @width_star: true if the field width is an argument
+ * @prec_star: true if the precision is an argument
+ * @precision: Precision if given as a number, else -1
+ */
+struct log_ring_spec {
+	const char *start;
+	int len;
+	char conv;
+	char qualifier;
+	bool width_star;
+	bool prec_star;
+	int precision;
+};
+
+/**
+ * log_ring_next_spec() - find the next conversion specification
+ *
+ * This follows the parsing in vsnprintf() so that the same arguments are
+ * used
+ *
+ * @fmt: Format string to search
+ * @spec: Returns information about the specification found
+ * @return pointer to the specification, or NULL if there are no more
+ */
+static const char *log_ring_next_spec(const char *fmt,
+				      struct log_ring_spec *spec)
+{
+	const char *p;
+
+	fmt = strchr(fmt, '%');
+	if (!fmt)
+		return NULL;
+	p = fmt + 1;
+	while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+		p++;
+
+	spec->width_star = *p == '*';
+	if (spec->width_star)
+		p++;
+	while (isdigit(*p))
+		p++;
+	spec->prec_star = false;
+	spec->precision = -1;
+	if (*p == '.') {
+		p++;
+		if (*p == '*') {
+			spec->prec_star = true;
+			p++;
+		} else {
+			spec->precision = simple_strtoul(p, NULL, 10);
+			while (isdigit(*p))
+				p++;
+		}
+	}
+
+	spec->qualifier = 0;
+	if (*p == 'h' || *p == 'l' || *p == 'L' || *p == 'Z' || *p == 'z' ||
+	    *p == 't') {
+		spec->qualifier = *p++;
+		if (spec->qualifier == 'l' && *p == 'l') {
+			spec->qualifier = 'L';
+			p++;
+		}
+	}
+	spec->conv = *p;
+	if (*p)
+		p++;
+	spec->start = fmt;
+	spec->len = p - fmt;
+
+	return fmt;
+}
+
+/* Add a value to the packed arguments */
+static int log_ring_put(char **ptrp, char *end, const void *val, int size)
+{
+	if (*ptrp + size > end)
+		return -E2BIG;
+	memcpy(*ptrp, val, size);
+	*ptrp += size;
+
+	return 0;
+}
+
+/* Get a value from the packed arguments */
+static void log_ring_get(const char **ptrp, void *val, int size)
+{
+	memcpy(val, *ptrp, size);
+	*ptrp += size;
+}
+
+/**
+ * log_ring_pack() - pack the arguments for a format string
+ *
+ * @buf: Buffer for the arguments
+ * @size: Size of @buf
+ * @fmt: Format string
+ * @args: Arguments for @fmt
+ * @return number of bytes used, -E2BIG if @buf is too small, -ENOTSUPP if the
+ *	format string cannot be handled, e.g. uses a %p extension which needs
+ *	the data that the pointer refers to
+ */
+static int log_ring_pack(char *buf, int size, const char *fmt, va_list args)
+{
+	struct log_ring_spec spec;
+	char *ptr = buf, *end = buf + size;
+	int ret;
+
+	for (; (fmt = log_ring_next_spec(fmt, &spec)); fmt += spec.len) {
+		if (spec.len > LOG_RING_MAX_SPEC)
+			return -ENOTSUPP;
+		if (spec.width_star) {
+			int val = va_arg(args, int);
+
+			ret = log_ring_put(&ptr, end, &val, sizeof(val));
+			if (ret)
+				return ret;
+		}
+		if (spec.prec_star) {
+			int val = va_arg(args, int);
+
+			ret = log_ring_put(&ptr, end, &val, sizeof(val));
+			if (ret)
+				return ret;
+			spec.precision = max(val, 0);
+		}
+
+		switch (spec.conv) {
+		case '%':
+			continue;
+		case 's': {
+			const char *str;
+			int len;
+
+			if (spec.qualifier == 'l')
+				return -ENOTSUPP;
+			str = va_arg(args, const char *);
+			if (!str)
+				str = "<NULL>";
+			len = strnlen(str, spec.precision >= 0 ?
+				      spec.precision : end - ptr);
+			if (ptr + len + 1 > end)
+				return -E2BIG;
+			memcpy(ptr, str, len);
+			ptr[len] = '\0';
+			ptr += len + 1;
+			continue;
+		}
+		case 'p': {
+			void *val;
+
+			if (isalnum(fmt[spec.len]))
+				return -ENOTSUPP;
+			val = va_arg(args, void *);
+			ret = log_ring_put(&ptr, end, &val, sizeof(val));
+			break;
+		}
+		case 'c':
+		case 'd':
+		case 'i':
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			switch (spec.qualifier) {
+			case 'L': {
+				long long val = va_arg(args, long long);
+
+				ret = log_ring_put(&ptr, end, &val, sizeof(val));
+				break;
+			}
+			case 'l': {
+				long val = va_arg(args, long);
+
+				ret = log_ring_put(&ptr, end, &val, sizeof(val));
+				break;
+			}
+			case 'z':
+			case 'Z': {
+				size_t val = va_arg(args, size_t);
+
+				ret = log_ring_put(&ptr, end, &val, sizeof(val));
+				break;
+			}
+			case 't': {
+				ptrdiff_t val = va_arg(args, ptrdiff_t);
+
+				ret = log_ring_put(&ptr, end, &val, sizeof(val));
+				break;
+			}
+			default: {
+				int val = va_arg(args, int);
+
+				ret = log_ring_put(&ptr, end, &val, sizeof(val));
+				break;
+			}
+			}
+			break;
+		default:
+			return -ENOTSUPP;
+		}
+		if (ret)
+			return ret;
+	}
+
+	return ptr - buf;
+}
+
+/* Add formatted text to a buffer, returning the new position */
+static int log_ring_printf(char *buf, int size, int pos, const char *fmt, ...)
+{
+	va_list args;
+	int len;
+
+	va_start(args, fmt);
+	if (pos < size)
+		len = vsnprintf(buf + pos, size - pos, fmt, args);
+	else
+		len = vsnprintf(NULL, 0, fmt, args);
+	va_end(args);
+
+	return pos + len;
+}
+
+/**
+ * log_ring_format_rec() - format a record as text
+ *
+ * @rec: Record to format
+ * @buf: Buffer for the text
+ * @size: Size of @buf
+ * @pos: Position in @buf at which to add the text
+ * @return new position in @buf, which may be past the end if the text was
+ *	truncated
+ */
+static int log_ring_format_rec(struct log_ring_rec *rec, char *buf, int size,
+			       int pos)
+{
+	const char *args = (const char *)(rec + 1);
+	const char *fmt = rec->fmt;
+	struct log_ring_spec spec;
+	u64 secs = rec->time_us;
+	uint usecs;
+
+	usecs = do_div(secs, 1000000);
+	pos = log_ring_printf(buf, size, pos, "<%d>[%5lu.%06u] %s() ",
+			      rec->level, (ulong)secs, usecs, rec->func);
+	if (rec->flags & LOGRF_TEXT)
+		return log_ring_printf(buf, size, pos, "%s", args);
+
+	for (; log_ring_next_spec(fmt, &spec); fmt = spec.start + spec.len) {
+		char spec_str[LOG_RING_MAX_SPEC_STR];
+		const char *p, *end = spec.start + spec.len;
+		char *out = spec_str;
+
+		pos = log_ring_printf(buf, size, pos, "%.*s",
+				      (int)(spec.start - fmt), fmt);
+
+		/* Put the values of any '*' into the specification */
+		for (p = spec.start; p < end; p++) {
+			if (*p == '*') {
+				int val;
+
+				log_ring_get(&args, &val, sizeof(val));
+				if (p[-1] == '.')
+					val = max(val, 0);
+				out += sprintf(out, "%d", val);
+			} else {
+				*out++ = *p;
+			}
+		}
+		*out = '\0';
+
+		switch (spec.conv) {
+		case '%':
+			pos = log_ring_printf(buf, size, pos, "%%");
+			break;
+		case 's':
+			pos = log_ring_printf(buf, size, pos, spec_str, args);
+			args += strlen(args) + 1;
+			break;
+		case 'p': {
+			void *val;
+
+			log_ring_get(&args, &val, sizeof(val));
+			pos = log_ring_printf(buf, size, pos, spec_str, val);
+			break;
+		}
+		default:
+			switch (spec.qualifier) {
+			case 'L': {
+				long long val;
+
+				log_ring_get(&args, &val, sizeof(val));
+				pos = log_ring_printf(buf, size, pos, spec_str,
+						      val);
+				break;
+			}
+			case 'l': {
+				long val;
+
+				log_ring_get(&args, &val, sizeof(val));
+				pos = log_ring_printf(buf, size, pos, spec_str,
+						      val);
+				break;
+			}
+			case 'z':
+			case 'Z': {
+				size_t val;
+
+				log_ring_get(&args, &val, sizeof(val));
+				pos = log_ring_printf(buf, size, pos, spec_str,
+						      val);
+				break;
+			}
+			case 't': {
+				ptrdiff_t val;
+
+				log_ring_get(&args, &val, sizeof(val));
+				pos = log_ring_printf(buf, size, pos, spec_str,
+						      val);
+				break;
+			}
+			default: {
+				int val;
+
+				log_ring_get(&args, &val, sizeof(val));
+				pos = log_ring_printf(buf, size, pos, spec_str,
+						      val);
+				break;
+			}
+			}
+			break;
+		}
+	}
+
+	return log_ring_printf(buf, size, pos, "%s", fmt);
+}
+
+/* Get the record which follows another, or the first if @rec is NULL */
+static struct log_ring_rec *log_ring_next(struct log_ring *ring,
+					  struct log_ring_rec *rec)
+{
+	int offset;
+
+	if (rec) {
+		offset = (char *)rec - ring->buf + rec->size;
+		if (offset == ring->tail)
+			return NULL;
+	} else {
+		if (!ring->stats.count)
+			return NULL;
+		offset = ring->head;
+	}
+	/* Go back to the start at the end of the buffer or an end marker */
+	if (offset + sizeof(rec->size) > ring->size ||
+	    !((struct log_ring_rec *)(ring->buf + offset))->size)
+		offset = 0;
+
+	return (struct log_ring_rec *)(ring->buf + offset);
+}
+
+/* Drop the oldest record in the ring */
+static void log_ring_drop(struct log_ring *ring)
+{
+	struct log_ring_rec *rec = log_ring_next(ring, NULL);
+
+	ring->head = (char *)rec - ring->buf + rec->size;
+	ring->stats.used -= rec->size;
+	ring->stats.count--;
+	ring->stats.dropped++;
+}
+
+/**
+ * log_ring_make_room() - make space for a new record
+ *
+ * Records are dropped until there is space at the tail. If the record does
+ * not fit before the end of the buffer, the end of the records is marked and
+ * the record goes at the start.
+ *
+ * @ring: Ring to update
+ * @size: Size of the new record
+ */
+static void log_ring_make_room(struct log_ring *ring, int size)
+{
+	struct log_ring_rec *end;
+
+	for (;;) {
+		if (!ring->stats.count) {
+			ring->head = 0;
+			ring->tail = 0;
+		}
+		if (!ring->stats.count || ring->head < ring->tail) {
+			if (ring->tail + size <= ring->size)
+				return;
+			if (size <= ring->head) {
+				end = (struct log_ring_rec *)(ring->buf +
+							      ring->tail);
+				if (ring->tail + sizeof(end->size) <=
+				    ring->size)
+					end->size = 0;
+				ring->tail = 0;
+				return;
+			}
+		} else if (ring->tail + size <= ring->head) {
+			return;
+		}
+		log_ring_drop(ring);
+	}
+}
+
+void log_ring_add(struct log_rec *rec, const char *fmt, va_list args)
+{
+	char data[LOG_RING_MAX_REC - sizeof(struct log_ring_rec)];
+	struct log_ring *ring = gd->log_ring;
+	struct log_ring_rec *out;
+	va_list args_copy;
+	int len, size;
+	uint flags = 0;
+
+	if (!ring || rec->level > CONFIG_LOG_RING_LEVEL)
+		return;
+	va_copy(args_copy, args);
+	len = log_ring_pack(data, sizeof(data), fmt, args_copy);
+	va_end(args_copy);
+	if (len < 0) {
+		/* Fall back to formatting the message now */
+		len = vscnprintf(data, sizeof(data), fmt, args) + 1;
+		flags |= LOGRF_TEXT;
+		ring->stats.text++;
+	}
+
+	size = ALIGN(sizeof(*out) + len, sizeof(u64));
+	log_ring_make_room(ring, size);
+	out = (struct log_ring_rec *)(ring->buf + ring->tail);
+	out->size = size;
+	out->level = rec->level;
+	out->flags = flags;
+	out->cat = rec->cat;
+	out->line = rec->line;
+	out->time_us = timer_get_us();
+	out->fmt = fmt;
+	out->file = rec->file;
+	out->func = rec->func;
+	memcpy(out + 1, data, len);
+	ring->tail += size;
+	ring->stats.used += size;
+	ring->stats.count++;
+	ring->stats.added++;
+}
+
+int log_ring_format(char *buf, int size)
+{
+	struct log_ring *ring = gd->log_ring;
+	struct log_ring_rec *rec;
+	int pos = 0;
+
+	if (size)
+		*buf = '\0';
+	if (!ring)
+		return 0;
+	for (rec = log_ring_next(ring, NULL); rec; rec = log_ring_next(ring, rec))
+		pos = log_ring_format_rec(rec, buf, size, pos);
+
+	return pos;
+}
+
+void log_ring_show(void)
+{
+	struct log_ring *ring = gd->log_ring;
+	struct log_ring_rec *rec;
+	char line[CONFIG_SYS_CBSIZE];
+
+	if (!ring)
+		return;
+	for (rec = log_ring_next(ring, NULL); rec;
+	     rec = log_ring_next(ring, rec)) {
+		log_ring_format_rec(rec, line, sizeof(line), 0);
+		puts(line);
+	}
+}
+
+void log_ring_clear(void)
+{
+	struct log_ring *ring = gd->log_ring;
+
+	if (!ring)
+		return;
+	ring->head = 0;
+	ring->tail = 0;
+	ring->stats.used = 0;
+	ring->stats.count = 0;
+}
+
+int log_ring_get_stats(struct log_ring_stats *stats)
+{
+	struct log_ring *ring = gd->log_ring;
+
+	if (!ring)
+		return -ENOENT;
+	*stats = ring->stats;
+
+	return 0;
+}
+
+int log_ring_export(void)
+{
+	void *blob;
+	int size;
+	int ret;
+
+	if (!IS_ENABLED(CONFIG_BLOBLIST))
+		return -ENOSYS;
+	if (!gd->log_ring)
+		return -ENOENT;
+	size = log_ring_format(NULL, 0) + 1;
+	ret = bloblist_ensure_size(BLOBLISTT_LOG_TEXT, size, &blob);
+	if (ret)
+		return log_msg_ret("blob", ret);
+	log_ring_format(blob, size);
+
+	return bloblist_finish();
+}
+
+int log_ring_init(int size)
+{
+	struct log_ring *ring;
+
+	size = ALIGN_DOWN(size, sizeof(u64));
+	if (size < LOG_RING_MAX_REC)
+		return -EINVAL;
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return -ENOMEM;
+	ring->buf = malloc(size);
+	if (!ring->buf) {
+		free(ring);
+		return -ENOMEM;
+	}
+	ring->size = size;
+	ring->stats.size = size;
+	gd->log_ring = ring;
+
+	return 0;
+}
@@ -30,6 +30,7 @@ static void *alloc_simple(size_t bytes, int align)
 	}
 
 	ptr = map_sysmem(addr, bytes);
+	gd->malloc_last = addr - gd->malloc_base;
 	gd->malloc_ptr = ALIGN(new_ptr, sizeof(new_ptr));
 
 	return ptr;
@@ -60,6 +61,24 @@ void *memalign_simple(size_t align, size_t bytes)
 	return ptr;
 }
 
+void free_simple(void *ptr)
+{
+	ulong offset;
+
+	if (!ptr)
+		return;
+	offset = map_to_sysmem(ptr) - gd->malloc_base;
+	log_debug("free %lx: ", (ulong)ptr);
+
+	/* Drop the last allocation, so that a temporary buffer costs nothing */
+	if (offset == gd->malloc_last && offset < gd->malloc_ptr) {
+		gd->malloc_ptr = offset;
+		log_debug("ptr=%lx\n", gd->malloc_ptr);
+	} else {
+		log_debug("not the last allocation\n");
+	}
+}
+
 #if CONFIG_IS_ENABLED(SYS_MALLOC_SIMPLE)
 void *calloc(size_t nmemb, size_t elem_size)
 {
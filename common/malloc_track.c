@@ -0,0 +1,428 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tracking of heap allocations by caller
+ *
+ * Each live allocation is recorded in a hash table keyed by its address,
+ * along with the address of the caller, the size requested and when it was
+ * made. Totals are kept for each caller and for each boot phase, so that
+ * leaks and the heaviest users of the heap can be found.
+ *
+ * Before relocation a small tracker in the data section covers the simple
+ * heap. It is left alone afterwards so that it can still be shown. The tables
+ * for the full heap are allocated once that heap is set up.
+ *
+ * Lifetimes are counted in allocations rather than timer ticks, since
+ * reading the timer may itself need to allocate memory.
+ *
+ * The simple heap can only reclaim the last block, so a block freed before
+ * relocation still counts as live unless it was actually given back.
+ *
+ * The peak for each phase is also recorded in bootstage as an empty span
+ * carrying the number of bytes, when the phase ends and just before the OS
+ * is started.
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <log.h>
+#include <malloc.h>
+#include <sort.h>
+#include <linux/build_bug.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+enum {
+	EARLY_CALLERS	= 64,
+	EARLY_RECS	= 128,
+	TRACK_CALLERS	= CONFIG_SYS_MALLOC_TRACK_CALLERS,
+	TRACK_RECS	= CONFIG_SYS_MALLOC_TRACK_SIZE,
+};
+
+/**
+ * struct track_rec - a live allocation
+ *
+ * @ptr: Address returned to the caller, NULL if this slot is empty
+ * @seq: Value of track_seq when the allocation was made
+ * @size: Number of bytes requested
+ * @caller: Index of the caller in the tracker's caller table
+ * @phase: Boot phase in which the allocation was made
+ */
+struct track_rec {
+	void *ptr;
+	ulong seq;
+	u32 size;
+	u16 caller;
+	u8 phase;
+};
+
+/**
+ * struct track_caller - totals for one caller
+ *
+ * @caller: Return address of the call to malloc(), NULL for the overflow entry
+ * @allocs: Number of tracked allocations made
+ * @frees: Number of those which have been freed
+ * @live_bytes: Bytes requested by allocations which are still live
+ * @lifetime: Total lifetime of the freed allocations, in allocations
+ */
+struct track_caller {
+	void *caller;
+	uint allocs;
+	uint frees;
+	ulong live_bytes;
+	ulong lifetime;
+};
+
+/**
+ * struct tracker - allocations from one heap
+ *
+ * Both tables are hashed with linear probing and are never filled beyond
+ * three quarters. When the caller table is full, new callers share an
+ * overflow entry at the end.
+ *
+ * @callers: Table of callers, @caller_size + 1 entries
+ * @recs: Table of live allocations, @rec_size entries
+ * @caller_size: Number of hashed entries in @callers, a power of two
+ * @rec_size: Number of entries in @recs, a power of two
+ * @ncallers: Number of entries in use in @callers
+ * @nrecs: Number of entries in use in @recs
+ * @live_bytes: Bytes requested by the live allocations in @recs
+ * @peak_bytes: Highest value seen for @live_bytes
+ * @dropped: Number of allocations not tracked as @recs was full
+ * @unknown: Number of frees of blocks which were not tracked
+ */
+struct tracker {
+	struct track_caller *callers;
+	struct track_rec *recs;
+	uint caller_size;
+	uint rec_size;
+	uint ncallers;
+	uint nrecs;
+	ulong live_bytes;
+	ulong peak_bytes;
+	ulong dropped;
+	ulong unknown;
+};
+
+/**
+ * struct track_phase - heap use in one boot phase
+ *
+ * @entered: true if the phase has been entered
+ * @start_bytes: Tracked live bytes when the phase was last entered
+ * @peak_bytes: Highest number of tracked live bytes during the phase
+ * @allocs: Number of allocations made during the phase
+ * @frees: Number of blocks freed during the phase
+ */
+struct track_phase {
+	bool entered;
+	ulong start_bytes;
+	ulong peak_bytes;
+	ulong allocs;
+	ulong frees;
+};
+
+static const char *const phase_name[MALLOC_PHASE_COUNT] = {
+	"board_f",
+	"board_r",
+	"bootm",
+};
+
+/* Names of the bootstage spans, which must stay valid */
+static const char *const phase_stage[MALLOC_PHASE_COUNT] = {
+	"heap board_f",
+	"heap board_r",
+	"heap bootm",
+};
+
+/* All of this is used before relocation, when BSS is not available */
+static struct track_caller early_callers[EARLY_CALLERS + 1] __section(".data");
+static struct track_rec early_recs[EARLY_RECS] __section(".data");
+static struct tracker early_trk __section(".data") = {
+	.callers	= early_callers,
+	.recs		= early_recs,
+	.caller_size	= EARLY_CALLERS,
+	.rec_size	= EARLY_RECS,
+};
+static struct track_phase phases[MALLOC_PHASE_COUNT] __section(".data") = {
+	[MALLOC_PHASE_BOARD_F]	= { .entered = true },
+};
+static enum malloc_phase cur_phase __section(".data") = MALLOC_PHASE_BOARD_F;
+static ulong track_seq __section(".data");
+
+static struct tracker full_trk;
+
+static struct tracker *track_get(void)
+{
+	if (gd->flags & GD_FLG_FULL_MALLOC_INIT)
+		return &full_trk;
+
+	return &early_trk;
+}
+
+static uint track_hash(const void *ptr, uint size)
+{
+	u32 hash = (ulong)ptr >> 2;
+
+	hash *= 0x9e3779b9;
+
+	return (hash ^ hash >> 16) & (size - 1);
+}
+
+static struct track_rec *track_find(struct tracker *trk, const void *ptr)
+{
+	uint mask = trk->rec_size - 1;
+	uint i;
+
+	for (i = track_hash(ptr, trk->rec_size); trk->recs[i].ptr;
+	     i = (i + 1) & mask) {
+		if (trk->recs[i].ptr == ptr)
+			return &trk->recs[i];
+	}
+
+	return NULL;
+}
+
+/* Close the gap left by a record, so that lookups need no tombstones */
+static void track_remove(struct tracker *trk, struct track_rec *rec)
+{
+	uint mask = trk->rec_size - 1;
+	uint hole = rec - trk->recs;
+	uint i, home;
+
+	for (i = (hole + 1) & mask; trk->recs[i].ptr; i = (i + 1) & mask) {
+		home = track_hash(trk->recs[i].ptr, trk->rec_size);
+
+		/* Move the record back if the hole is between home and i */
+		if (((i - home) & mask) >= ((i - hole) & mask)) {
+			trk->recs[hole] = trk->recs[i];
+			hole = i;
+		}
+	}
+	trk->recs[hole].ptr = NULL;
+	trk->nrecs--;
+}
+
+static uint track_caller_idx(struct tracker *trk, void *caller)
+{
+	uint mask = trk->caller_size - 1;
+	uint i;
+
+	for (i = track_hash(caller, trk->caller_size); trk->callers[i].caller;
+	     i = (i + 1) & mask) {
+		if (trk->callers[i].caller == caller)
+			return i;
+	}
+	if (trk->ncallers >= trk->caller_size / 4 * 3)
+		return trk->caller_size;
+	trk->callers[i].caller = caller;
+	trk->ncallers++;
+
+	return i;
+}
+
+void malloc_track_alloc(void *ptr, size_t size, void *caller)
+{
+	struct tracker *trk = track_get();
+	struct track_phase *phase = &phases[cur_phase];
+	struct track_caller *tc;
+	struct track_rec *rec;
+	uint mask, i;
+
+	if (!ptr || !trk->recs)
+		return;
+	track_seq++;
+	phase->allocs++;
+	if (trk->nrecs >= trk->rec_size / 4 * 3) {
+		trk->dropped++;
+		return;
+	}
+
+	mask = trk->rec_size - 1;
+	for (i = track_hash(ptr, trk->rec_size); trk->recs[i].ptr;
+	     i = (i + 1) & mask)
+		;
+	rec = &trk->recs[i];
+	rec->ptr = ptr;
+	rec->seq = track_seq;
+	rec->size = min_t(size_t, size, U32_MAX);
+	rec->caller = track_caller_idx(trk, caller);
+	rec->phase = cur_phase;
+	trk->nrecs++;
+
+	tc = &trk->callers[rec->caller];
+	tc->allocs++;
+	tc->live_bytes += rec->size;
+	trk->live_bytes += rec->size;
+	trk->peak_bytes = max(trk->peak_bytes, trk->live_bytes);
+	phase->peak_bytes = max(phase->peak_bytes, trk->live_bytes);
+}
+
+void malloc_track_free(void *ptr)
+{
+	struct tracker *trk = track_get();
+	struct track_caller *tc;
+	struct track_rec *rec;
+
+	if (!ptr || !trk->recs)
+		return;
+	phases[cur_phase].frees++;
+	rec = track_find(trk, ptr);
+	if (!rec) {
+		trk->unknown++;
+		return;
+	}
+	tc = &trk->callers[rec->caller];
+	tc->frees++;
+	tc->live_bytes -= rec->size;
+	tc->lifetime += track_seq - rec->seq;
+	trk->live_bytes -= rec->size;
+	track_remove(trk, rec);
+}
+
+void malloc_track_init(void)
+{
+	struct track_caller *callers;
+	struct track_rec *recs;
+
+	BUILD_BUG_ON_NOT_POWER_OF_2(TRACK_RECS);
+	BUILD_BUG_ON_NOT_POWER_OF_2(TRACK_CALLERS);
+
+	/* These are not tracked, since full_trk has no tables yet */
+	callers = calloc(TRACK_CALLERS + 1, sizeof(*callers));
+	recs = calloc(TRACK_RECS, sizeof(*recs));
+	if (!callers || !recs) {
+		log_warning("Cannot allocate malloc tracker\n");
+		free(callers);
+		free(recs);
+		return;
+	}
+	full_trk.caller_size = TRACK_CALLERS;
+	full_trk.rec_size = TRACK_RECS;
+	full_trk.callers = callers;
+	full_trk.recs = recs;
+	malloc_track_phase(MALLOC_PHASE_BOARD_R);
+}
+
+void malloc_track_phase(enum malloc_phase phase)
+{
+	struct tracker *trk = track_get();
+	struct track_phase *tp = &phases[phase];
+
+	malloc_track_bootstage();
+	cur_phase = phase;
+	tp->entered = true;
+	tp->start_bytes = trk->live_bytes;
+	tp->peak_bytes = max(tp->peak_bytes, trk->live_bytes);
+}
+
+void malloc_track_bootstage(void)
+{
+	ulong peak = phases[cur_phase].peak_bytes;
+	int span;
+
+	span = bootstage_span_start(phase_stage[cur_phase], 0);
+	bootstage_span_end(span, peak);
+}
+
+int malloc_track_find(const void *ptr, struct malloc_track_info *info)
+{
+	struct tracker *trk = track_get();
+	struct track_rec *rec;
+
+	if (!trk->recs)
+		return -ENOENT;
+	rec = track_find(trk, ptr);
+	if (!rec)
+		return -ENOENT;
+	info->caller = trk->callers[rec->caller].caller;
+	info->size = rec->size;
+	info->age = track_seq - rec->seq;
+	info->phase = rec->phase;
+
+	return 0;
+}
+
+static int h_cmp_live_bytes(const void *v1, const void *v2)
+{
+	const struct track_caller *tc1 = v1, *tc2 = v2;
+
+	if (tc1->live_bytes != tc2->live_bytes)
+		return tc1->live_bytes < tc2->live_bytes ? 1 : -1;
+
+	return 0;
+}
+
+void malloc_track_show_callers(bool early)
+{
+	struct tracker *trk = early ? &early_trk : &full_trk;
+	struct track_caller *list;
+	struct track_rec *recs;
+	ulong offset;
+	uint count, i;
+
+	if (!trk->recs) {
+		printf("No allocations tracked\n");
+		return;
+	}
+	printf("%u blocks, %lu bytes live (peak %lu)", trk->nrecs,
+	       trk->live_bytes, trk->peak_bytes);
+	if (trk->dropped || trk->unknown)
+		printf("; %lu not tracked, %lu unknown frees", trk->dropped,
+		       trk->unknown);
+	printf("\n");
+
+	/* Keep the list itself out of the tables */
+	recs = full_trk.recs;
+	full_trk.recs = NULL;
+	list = malloc((trk->caller_size + 1) * sizeof(*list));
+	full_trk.recs = recs;
+	if (!list) {
+		printf("Out of memory\n");
+		return;
+	}
+	for (i = 0, count = 0; i <= trk->caller_size; i++) {
+		struct track_caller *tc = &trk->callers[i];
+
+		if (tc->allocs != tc->frees)
+			list[count++] = *tc;
+	}
+	qsort(list, count, sizeof(*list), h_cmp_live_bytes);
+
+	/* Show link addresses, so they can be looked up in System.map */
+	offset = early ? 0 : gd->reloc_off;
+	printf("\n%-18s %8s %10s %8s %10s\n", "Caller", "Live", "Bytes",
+	       "Allocs", "Avg life");
+	for (i = 0; i < count; i++) {
+		struct track_caller *tc = &list[i];
+
+		if (tc->caller)
+			printf("%-18lx ", (ulong)tc->caller - offset);
+		else
+			printf("%-18s ", "(others)");
+		printf("%8u %10lu %8u ", tc->allocs - tc->frees,
+		       tc->live_bytes, tc->allocs);
+		if (tc->frees)
+			printf("%10lu\n", tc->lifetime / tc->frees);
+		else
+			printf("%10s\n", "-");
+	}
+	full_trk.recs = NULL;
+	free(list);
+	full_trk.recs = recs;
+}
+
+void malloc_track_show_phases(void)
+{
+	int i;
+
+	printf("%-8s %10s %10s %10s %10s\n", "Phase", "Start", "Peak",
+	       "Allocs", "Frees");
+	for (i = 0; i < MALLOC_PHASE_COUNT; i++) {
+		struct track_phase *tp = &phases[i];
+
+		if (!tp->entered)
+			continue;
+		printf("%-8s %10lu %10lu %10lu %10lu%s\n", phase_name[i],
+		       tp->start_bytes, tp->peak_bytes, tp->allocs, tp->frees,
+		       i == cur_phase ? " *" : "");
+	}
+}
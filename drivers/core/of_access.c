@@ -46,6 +46,11 @@ static struct device_node *of_stdout;
 /* pointer to options given after the alias (separated by :) or NULL if none */
 static const char *of_stdout_options;
 
+/* table of nodes indexed by phandle, for the tree at of_phandle_root */
+static struct device_node *of_phandle_root;
+static struct device_node **of_phandle_cache;
+static uint of_phandle_count;
+
 /**
  * struct alias_prop - Alias property in 'aliases' node
  *
@@ -445,6 +450,10 @@ struct device_node *of_find_node_by_phandle(phandle handle)
 	if (!handle)
 		return NULL;
 
+	if (of_phandle_cache && of_phandle_root == gd->of_root &&
+	    handle < of_phandle_count)
+		return of_phandle_cache[handle];
+
 	for_each_of_allnodes(np)
 		if (np->phandle == handle)
 			break;
@@ -453,6 +462,14 @@ struct device_node *of_find_node_by_phandle(phandle handle)
 	return np;
 }
 
+void of_set_phandle_cache(struct device_node *root,
+			  struct device_node **cache, uint count)
+{
+	of_phandle_root = cache ? root : NULL;
+	of_phandle_cache = cache;
+	of_phandle_count = cache ? count : 0;
+}
+
 /**
  * of_find_property_value_of_size() - find property of given size
  *
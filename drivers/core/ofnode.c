@@ -7,6 +7,7 @@
 #include <common.h>
 #include <dm.h>
 #include <fdtdec.h>
+#include <fdt_index.h>
 #include <fdt_support.h>
 #include <log.h>
 #include <malloc.h>
@@ -17,6 +18,36 @@
 #include <linux/err.h>
 #include <linux/ioport.h>
 
+#if CONFIG_IS_ENABLED(OF_PROP_INDEX)
+static struct fdt_index ofnode_prop_index;
+
+/*
+ * Look up a property in the flat control tree. After relocation this goes
+ * through an index of the tree, which is (re)built when first needed.
+ */
+static const void *ofnode_fdt_getprop(int offset, const char *propname,
+				      int *lenp)
+{
+	struct fdt_index *idx = &ofnode_prop_index;
+
+	if (!(gd->flags & GD_FLG_RELOC))
+		return fdt_getprop(gd->fdt_blob, offset, propname, lenp);
+
+	if (!fdt_index_matches(idx, gd->fdt_blob)) {
+		fdt_index_uninit(idx);
+		fdt_index_init(idx, gd->fdt_blob);
+	}
+
+	return fdt_index_getprop(idx, offset, propname, lenp);
+}
+#else
+static const void *ofnode_fdt_getprop(int offset, const char *propname,
+				      int *lenp)
+{
+	return fdt_getprop(gd->fdt_blob, offset, propname, lenp);
+}
+#endif
+
 int ofnode_read_u32(ofnode node, const char *propname, u32 *outp)
 {
 	return ofnode_read_u32_index(node, propname, 0, outp);
@@ -43,8 +74,7 @@ int ofnode_read_u32_index(ofnode node, const char *propname, int index,
 		return of_read_u32_index(ofnode_to_np(node), propname, index,
 					 outp);
 
-	cell = fdt_getprop(gd->fdt_blob, ofnode_to_offset(node), propname,
-			   &len);
+	cell = ofnode_fdt_getprop(ofnode_to_offset(node), propname, &len);
 	if (!cell) {
 		debug("(not found)\n");
 		return -EINVAL;
@@ -89,8 +119,7 @@ int ofnode_read_u64(ofnode node, const char *propname, u64 *outp)
 	if (ofnode_is_np(node))
 		return of_read_u64(ofnode_to_np(node), propname, outp);
 
-	cell = fdt_getprop(gd->fdt_blob, ofnode_to_offset(node), propname,
-			   &len);
+	cell = ofnode_fdt_getprop(ofnode_to_offset(node), propname, &len);
 	if (!cell || len < sizeof(*cell)) {
 		debug("(not found)\n");
 		return -EINVAL;
@@ -141,8 +170,8 @@ const void *ofnode_read_prop(ofnode node, const char *propname, int *sizep)
 			len = prop->length;
 		}
 	} else {
-		val = fdt_getprop(gd->fdt_blob, ofnode_to_offset(node),
-				  propname, &len);
+		val = ofnode_fdt_getprop(ofnode_to_offset(node), propname,
+					 &len);
 	}
 	if (!val) {
 		debug("<not found>\n");
@@ -579,8 +608,8 @@ const void *ofnode_get_property(ofnode node, const char *propname, int *lenp)
 	if (ofnode_is_np(node))
 		return of_get_property(ofnode_to_np(node), propname, lenp);
 	else
-		return fdt_getprop(gd->fdt_blob, ofnode_to_offset(node),
-				   propname, lenp);
+		return ofnode_fdt_getprop(ofnode_to_offset(node), propname,
+					  lenp);
 }
 
 int ofnode_get_first_property(ofnode node, struct ofprop *prop)
@@ -17,6 +17,7 @@
 #include <hash.h>
 #include <linux/list.h>
 #include <linux/compiler.h>
+#include <linux/sizes.h>
 
 static LIST_HEAD(dfu_list);
 static int dfu_alt_num;
@@ -165,15 +166,46 @@ done:
 	return ret;
 }
 
-static unsigned char *dfu_buf;
+/*
+ * Data is collected in a ring of buffers on its way to the medium. The first
+ * is also used for reads and is the one returned by dfu_get_buf(). When
+ * writing behind, a full buffer is queued for dfu_write_pending() to write
+ * out, while the next one is filled.
+ */
+static unsigned char *dfu_buf[CONFIG_DFU_WRITE_BUFFERS];
 static unsigned long dfu_buf_size;
 static enum dfu_device_type dfu_buf_device_type;
 
+/* Largest write to the medium made by dfu_write_pending() at one time */
+#define DFU_WRITE_SLICE		SZ_256K
+
+static bool dfu_write_behind;
+/* Entity whose data is queued */
+static struct dfu_entity *dfu_queue_dfu;
+/* Number of full buffers queued, and the index of the oldest one */
+static int dfu_queue_count;
+static int dfu_queue_tail;
+/* Bytes of the oldest queued buffer which have been written */
+static long dfu_queue_done;
+/* Error from writing out the queue, reported by the next dfu_write() */
+static int dfu_queue_err;
+/* Index of the buffer being filled, and the amount of data in each */
+static int dfu_buf_fill;
+static long dfu_buf_len[CONFIG_DFU_WRITE_BUFFERS];
+
 unsigned char *dfu_free_buf(void)
 {
-	free(dfu_buf);
-	dfu_buf = NULL;
-	return dfu_buf;
+	int i;
+
+	for (i = 0; i < CONFIG_DFU_WRITE_BUFFERS; i++) {
+		free(dfu_buf[i]);
+		dfu_buf[i] = NULL;
+	}
+	dfu_queue_count = 0;
+	dfu_queue_done = 0;
+	dfu_buf_fill = 0;
+
+	return NULL;
 }
 
 unsigned long dfu_get_buf_size(void)
@@ -186,11 +218,11 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	char *s;
 
 	/* manage several entity with several contraint */
-	if (dfu_buf && dfu->dev_type != dfu_buf_device_type)
+	if (dfu_buf[0] && dfu->dev_type != dfu_buf_device_type)
 		dfu_free_buf();
 
-	if (dfu_buf != NULL)
-		return dfu_buf;
+	if (dfu_buf[0])
+		return dfu_buf[0];
 
 	s = env_get("dfu_bufsiz");
 	if (s)
@@ -202,13 +234,13 @@ unsigned char *dfu_get_buf(struct dfu_entity *dfu)
 	if (dfu->max_buf_size && dfu_buf_size > dfu->max_buf_size)
 		dfu_buf_size = dfu->max_buf_size;
 
-	dfu_buf = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
-	if (dfu_buf == NULL)
+	dfu_buf[0] = memalign(CONFIG_SYS_CACHELINE_SIZE, dfu_buf_size);
+	if (!dfu_buf[0])
 		printf("%s: Could not memalign 0x%lx bytes\n",
 		       __func__, dfu_buf_size);
 
 	dfu_buf_device_type = dfu->dev_type;
-	return dfu_buf;
+	return dfu_buf[0];
 }
 
 static char *dfu_get_hash_algo(void)
@@ -228,37 +260,186 @@ static char *dfu_get_hash_algo(void)
 	return NULL;
 }
 
+static int dfu_write_data(struct dfu_entity *dfu, void *buf, long *len)
+{
+	ulong start = get_timer(0);
+	int ret;
+
+	if (dfu_hash_algo)
+		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc, buf,
+					   *len, 0);
+
+	ret = dfu->write_medium(dfu, dfu->offset, buf, len);
+	if (ret)
+		debug("%s: Write error!\n", __func__);
+
+	/* update offset */
+	dfu->offset += *len;
+	dfu->write_time += get_timer(start);
+
+	return ret;
+}
+
+/* Write out up to @max bytes from the oldest queued buffer */
+static int dfu_queue_write(long max)
+{
+	int i = dfu_queue_tail;
+	long w_size = min(dfu_buf_len[i] - dfu_queue_done, max);
+	int ret;
+
+	ret = dfu_write_data(dfu_queue_dfu, dfu_buf[i] + dfu_queue_done,
+			     &w_size);
+	dfu_queue_done += w_size;
+	if (ret || !w_size || dfu_queue_done >= dfu_buf_len[i]) {
+		dfu_queue_tail = (i + 1) % CONFIG_DFU_WRITE_BUFFERS;
+		dfu_queue_count--;
+		dfu_queue_done = 0;
+		puts("#");
+	}
+
+	return ret;
+}
+
+static int dfu_queue_write_all(void)
+{
+	int ret;
+
+	while (dfu_queue_count) {
+		ret = dfu_queue_write(LONG_MAX);
+		if (ret) {
+			dfu_queue_count = 0;
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+int dfu_write_pending(void)
+{
+	struct dfu_entity *dfu = dfu_queue_dfu;
+	long max = LONG_MAX;
+	int ret;
+
+	if (!dfu_queue_count)
+		return 0;
+
+	/* Write in slices, if the medium allows it, so USB is not held up */
+	if (dfu->write_unit)
+		max = roundup(DFU_WRITE_SLICE, dfu->write_unit);
+	ret = dfu_queue_write(max);
+	if (ret) {
+		dfu_queue_count = 0;
+		dfu_queue_err = ret;
+	}
+
+	return ret;
+}
+
+void dfu_set_write_behind(bool enable)
+{
+	if (!enable && dfu_queue_write_all())
+		pr_err("DFU write failed!\n");
+	dfu_write_behind = enable;
+}
+
 static int dfu_write_buffer_drain(struct dfu_entity *dfu)
 {
 	long w_size;
 	int ret;
 
+	/* anything queued must go first */
+	ret = dfu_queue_write_all();
+	if (ret)
+		return ret;
+
 	/* flush size? */
 	w_size = dfu->i_buf - dfu->i_buf_start;
 	if (w_size == 0)
 		return 0;
 
-	if (dfu_hash_algo)
-		dfu_hash_algo->hash_update(dfu_hash_algo, &dfu->crc,
-					   dfu->i_buf_start, w_size, 0);
-
-	ret = dfu->write_medium(dfu, dfu->offset, dfu->i_buf_start, &w_size);
-	if (ret)
-		debug("%s: Write error!\n", __func__);
+	ret = dfu_write_data(dfu, dfu->i_buf_start, &w_size);
 
 	/* point back */
 	dfu->i_buf = dfu->i_buf_start;
 
-	/* update offset */
-	dfu->offset += w_size;
-
 	puts("#");
 
 	return ret;
 }
 
+/*
+ * Hand on a full buffer. When writing behind, it is queued and filling moves
+ * to the next buffer in the ring, so that the host does not have to wait for
+ * the medium. It only waits when all the buffers are full.
+ */
+static int dfu_write_buffer_queue(struct dfu_entity *dfu)
+{
+	int next = (dfu_buf_fill + 1) % CONFIG_DFU_WRITE_BUFFERS;
+	ulong start = get_timer(0);
+	int ret = 0;
+
+	if (!dfu_write_behind || next == dfu_buf_fill ||
+	    (dfu_queue_count && dfu_queue_dfu != dfu)) {
+		ret = dfu_write_buffer_drain(dfu);
+		goto done;
+	}
+
+	if (!dfu_buf[next]) {
+		dfu_buf[next] = memalign(CONFIG_SYS_CACHELINE_SIZE,
+					 dfu_buf_size);
+		if (!dfu_buf[next]) {
+			ret = dfu_write_buffer_drain(dfu);
+			goto done;
+		}
+	}
+
+	dfu_buf_len[dfu_buf_fill] = dfu->i_buf - dfu->i_buf_start;
+	dfu_queue_dfu = dfu;
+	if (!dfu_queue_count)
+		dfu_queue_tail = dfu_buf_fill;
+	dfu_queue_count++;
+
+	/* the next buffer may still be waiting to be written */
+	while (dfu_queue_count == CONFIG_DFU_WRITE_BUFFERS) {
+		ret = dfu_queue_write(LONG_MAX);
+		if (ret) {
+			dfu_queue_count = 0;
+			goto done;
+		}
+	}
+
+	dfu_buf_fill = next;
+	dfu->i_buf_start = dfu_buf[next];
+	dfu->i_buf_end = dfu->i_buf_start + dfu_buf_size;
+	dfu->i_buf = dfu->i_buf_start;
+done:
+	dfu->wait_time += get_timer(start);
+
+	return ret;
+}
+
+static void dfu_show_stats(struct dfu_entity *dfu)
+{
+	ulong total = max(get_timer(dfu->start_time), 1UL);
+
+	printf("DFU alt %d (%s): %llu bytes in %lu ms, %llu KiB/s\n",
+	       dfu->alt, dfu->name, dfu->offset, total,
+	       lldiv(dfu->offset * 1000, total) / 1024);
+	printf("  writing %lu ms, host waiting for the medium %lu ms\n",
+	       dfu->write_time, dfu->wait_time);
+}
+
 void dfu_transaction_cleanup(struct dfu_entity *dfu)
 {
+	/* anything still queued for another entity is written out first */
+	if (dfu_queue_count && dfu_queue_dfu != dfu)
+		dfu_queue_write_all();
+	dfu_queue_count = 0;
+	dfu_queue_done = 0;
+	dfu_queue_err = 0;
+	dfu_buf_fill = 0;
+
 	/* clear everything */
 	dfu->crc = 0;
 	dfu->offset = 0;
@@ -269,6 +450,8 @@ void dfu_transaction_cleanup(struct dfu_entity *dfu)
 	dfu->r_left = 0;
 	dfu->b_left = 0;
 	dfu->bad_skip = 0;
+	dfu->write_time = 0;
+	dfu->wait_time = 0;
 
 	dfu->inited = 0;
 }
@@ -286,6 +469,7 @@ int dfu_transaction_initiate(struct dfu_entity *dfu, bool read)
 		return -ENOMEM;
 
 	dfu->i_buf_end = dfu->i_buf_start + dfu_get_buf_size();
+	dfu->start_time = get_timer(0);
 
 	if (read) {
 		ret = dfu->get_medium_size(dfu, &dfu->r_left);
@@ -302,9 +486,11 @@ int dfu_transaction_initiate(struct dfu_entity *dfu, bool read)
 
 int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 {
-	int ret = 0;
+	int ret;
 
-	ret = dfu_write_buffer_drain(dfu);
+	ret = dfu_queue_err;
+	if (!ret)
+		ret = dfu_write_buffer_drain(dfu);
 	if (ret)
 		return ret;
 
@@ -314,6 +500,8 @@ int dfu_flush(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 	if (dfu_hash_algo)
 		printf("\nDFU complete %s: 0x%08x\n", dfu_hash_algo->name,
 		       dfu->crc);
+	if (dfu->offset)
+		dfu_show_stats(dfu);
 
 	dfu_flush_callback(dfu);
 
@@ -341,6 +529,13 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 		return -1;
 	}
 
+	/* a queued buffer could not be written */
+	if (dfu_queue_err) {
+		ret = dfu_queue_err;
+		dfu_transaction_cleanup(dfu);
+		return ret;
+	}
+
 	/* DFU 1.1 standard says:
 	 * The wBlockNum field is a block sequence number. It increments each
 	 * time a block is transferred, wrapping to zero from 65,535. It is used
@@ -359,7 +554,7 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	/* flush buffer if overflow */
 	if ((dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = dfu_write_buffer_queue(dfu);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			return ret;
@@ -379,7 +574,8 @@ int dfu_write(struct dfu_entity *dfu, void *buf, int size, int blk_seq_num)
 
 	/* if end or if buffer full flush */
 	if (size == 0 || (dfu->i_buf + size) > dfu->i_buf_end) {
-		ret = dfu_write_buffer_drain(dfu);
+		ret = size ? dfu_write_buffer_queue(dfu) :
+			     dfu_write_buffer_drain(dfu);
 		if (ret) {
 			dfu_transaction_cleanup(dfu);
 			return ret;
@@ -491,6 +687,7 @@ static int dfu_fill_entity(struct dfu_entity *dfu, char *s, int alt,
 
 	dfu->alt = alt;
 	dfu->max_buf_size = 0;
+	dfu->write_unit = 0;
 	dfu->free_entity = NULL;
 
 	/* Specific for mmc device */
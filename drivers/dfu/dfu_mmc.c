@@ -417,6 +417,8 @@ int dfu_fill_entity_mmc(struct dfu_entity *dfu, char *devstr, char *s)
 	dfu->flush_medium = dfu_flush_medium_mmc;
 	dfu->inited = 0;
 	dfu->free_entity = dfu_free_entity_mmc;
+	if (dfu->layout == DFU_RAW_ADDR)
+		dfu->write_unit = dfu->data.mmc.lba_blk_size;
 
 	/* Check if file buffer is ready */
 	if (!dfu_file_buf) {
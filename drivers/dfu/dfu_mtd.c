@@ -251,6 +251,8 @@ int dfu_fill_entity_mtd(struct dfu_entity *dfu, char *devstr, char *s)
 
 	has_pages = mtd->type == MTD_NANDFLASH || mtd->type == MTD_MLCNANDFLASH;
 	dfu->max_buf_size = has_pages ? mtd->erasesize : 0;
+	/* each write erases the blocks it covers */
+	dfu->write_unit = mtd->erasesize;
 
 	st = strsep(&s, " ");
 	if (!strcmp(st, "raw")) {
@@ -196,6 +196,7 @@ unsigned int dfu_polltimeout_nand(struct dfu_entity *dfu)
 
 int dfu_fill_entity_nand(struct dfu_entity *dfu, char *devstr, char *s)
 {
+	struct mtd_info *mtd;
 	char *st;
 	int ret, dev, part;
 
@@ -245,6 +246,11 @@ int dfu_fill_entity_nand(struct dfu_entity *dfu, char *devstr, char *s)
 	dfu->flush_medium = dfu_flush_medium_nand;
 	dfu->poll_timeout = dfu_polltimeout_nand;
 
+	/* each write erases the blocks it covers */
+	mtd = get_nand_dev_by_index(nand_curr_device);
+	if (mtd)
+		dfu->write_unit = mtd->erasesize;
+
 	/* initial state */
 	dfu->inited = 0;
 
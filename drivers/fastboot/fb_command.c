@@ -13,6 +13,7 @@
 #include <flash.h>
 #include <part.h>
 #include <stdlib.h>
+#include <linux/sizes.h>
 
 /**
  * image_size - final fastboot image size
@@ -29,6 +30,35 @@ static u32 fastboot_bytes_received;
  */
 static u32 fastboot_bytes_expected;
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * struct fb_stream - state of a download which is flashed as it arrives
+ *
+ * Data is collected at the start of the download buffer and written to the
+ * partition each time @chunk bytes have arrived, so the image can be larger
+ * than the buffer. The host waits while each piece is written.
+ *
+ * @part: Partition named by 'oem stream' for the next download, or ""
+ * @done: Partition the last download was written to, or "" if none
+ * @active: true if the current download is being flashed
+ * @failed: true if writing failed, so the rest of the download is dropped
+ * @chunk: Number of bytes to collect before writing them
+ * @fill: Number of bytes collected so far
+ * @response: Response to send when the download completes
+ */
+static struct fb_stream {
+	char part[PART_NAME_LEN];
+	char done[PART_NAME_LEN];
+	bool active;
+	bool failed;
+	u32 chunk;
+	u32 fill;
+	char response[FASTBOOT_RESPONSE_LEN];
+} stream;
+
+static void stream_abort(void);
+#endif
+
 static void okay(char *, char *);
 static void getvar(char *, char *);
 static void download(char *, char *);
@@ -40,6 +70,9 @@ static void reboot_bootloader(char *, char *);
 #if CONFIG_IS_ENABLED(FASTBOOT_CMD_OEM_FORMAT)
 static void oem_format(char *, char *);
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+static void oem_stream(char *, char *);
+#endif
 
 static const struct {
 	const char *command;
@@ -89,6 +122,12 @@ static const struct {
 		.dispatch = oem_format,
 	},
 #endif
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	[FASTBOOT_COMMAND_OEM_STREAM] = {
+		.command = "oem stream",
+		.dispatch = oem_stream,
+	},
+#endif
 };
 
 /**
@@ -107,6 +146,11 @@ int fastboot_handle_command(char *cmd_string, char *response)
 	cmd_parameter = cmd_string;
 	strsep(&cmd_parameter, ":");
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* The host has given up on a download which was being flashed */
+	stream_abort();
+#endif
+
 	for (i = 0; i < FASTBOOT_COMMAND_COUNT; i++) {
 		if (!strcmp(commands[i].command, cmd_string)) {
 			if (commands[i].dispatch) {
@@ -170,6 +214,24 @@ static void download(char *cmd_parameter, char *response)
 		fastboot_fail("Expected nonzero image size", response);
 		return;
 	}
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	stream.done[0] = '\0';
+	if (*stream.part) {
+		if (fastboot_mmc_stream_start(stream.part,
+					      fastboot_bytes_expected,
+					      response)) {
+			stream.part[0] = '\0';
+			return;
+		}
+		stream.active = true;
+		stream.failed = false;
+		stream.fill = 0;
+		printf("Starting download of %d bytes to '%s'\n",
+		       fastboot_bytes_expected, stream.part);
+		fastboot_response("DATA", response, "%s", cmd_parameter);
+		return;
+	}
+#endif
 	/*
 	 * Nothing to download yet. Response is of the form:
 	 * [DATA|FAIL]$cmd_parameter
@@ -195,6 +257,78 @@ u32 fastboot_data_remaining(void)
 	return fastboot_bytes_expected - fastboot_bytes_received;
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/* Write out the data collected so far */
+static void stream_write(void)
+{
+	void (*progress)(const char *msg) = fastboot_progress_callback;
+	u32 len = stream.fill;
+
+	stream.fill = 0;
+	if (!len || stream.failed)
+		return;
+
+	/* The host is still sending data, so cannot take INFO messages */
+	fastboot_progress_callback = NULL;
+	if (fastboot_mmc_stream_write(fastboot_buf_addr, len, stream.response))
+		stream.failed = true;
+	fastboot_progress_callback = progress;
+}
+
+static void stream_copy(const void *data, u32 len)
+{
+	u32 n;
+
+	while (len) {
+		n = min(len, stream.chunk - stream.fill);
+		memcpy(fastboot_buf_addr + stream.fill, data, n);
+		stream.fill += n;
+		data += n;
+		len -= n;
+		if (stream.fill == stream.chunk)
+			stream_write();
+	}
+}
+
+static void stream_complete(char *response)
+{
+	/* Write out the rest, then check the image was all there */
+	stream_write();
+	stream.active = false;
+	if (fastboot_mmc_stream_finish(!stream.failed, stream.response))
+		stream.failed = true;
+	strlcpy(response, stream.response, FASTBOOT_RESPONSE_LEN);
+	strlcpy(stream.done, stream.part, sizeof(stream.done));
+	stream.part[0] = '\0';
+}
+
+/*
+ * Stop flashing a download which did not complete. The partition is left
+ * part-written and the next download goes to the buffer as usual.
+ */
+static void stream_abort(void)
+{
+	if (!stream.active)
+		return;
+	stream.active = false;
+	stream.fill = 0;
+	fastboot_mmc_stream_finish(false, stream.response);
+	printf("\ndownload to '%s' abandoned\n", stream.part);
+	stream.part[0] = '\0';
+}
+#endif
+
+u32 fastboot_data_max_size(void)
+{
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* The partition size is checked when the download starts */
+	if (*stream.part)
+		return rounddown(U32_MAX, stream.chunk);
+#endif
+
+	return fastboot_buf_size;
+}
+
 /**
  * fastboot_data_download() - Copy image data to fastboot_buf_addr.
  *
@@ -221,11 +355,19 @@ void fastboot_data_download(const void *fastboot_data,
 	    fastboot_bytes_expected) {
 		fastboot_fail("Received invalid data length",
 			      response);
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+		stream_abort();
+#endif
 		return;
 	}
 	/* Download data to fastboot_buf_addr */
-	memcpy(fastboot_buf_addr + fastboot_bytes_received,
-	       fastboot_data, fastboot_data_len);
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	if (stream.active)
+		stream_copy(fastboot_data, fastboot_data_len);
+	else
+#endif
+		memcpy(fastboot_buf_addr + fastboot_bytes_received,
+		       fastboot_data, fastboot_data_len);
 
 	pre_dot_num = fastboot_bytes_received / BYTES_PER_DOT;
 	fastboot_bytes_received += fastboot_data_len;
@@ -252,6 +394,13 @@ void fastboot_data_complete(char *response)
 	fastboot_okay(NULL, response);
 	printf("\ndownloading of %d bytes finished\n", fastboot_bytes_received);
 	image_size = fastboot_bytes_received;
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* The image is on the partition now, not in the buffer */
+	if (stream.active) {
+		stream_complete(response);
+		image_size = 0;
+	}
+#endif
 	env_set_hex("filesize", image_size);
 	fastboot_bytes_expected = 0;
 	fastboot_bytes_received = 0;
@@ -269,6 +418,20 @@ void fastboot_data_complete(char *response)
  */
 static void flash(char *cmd_parameter, char *response)
 {
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+	/* A streamed image has already been written */
+	if (*stream.done) {
+		if (!cmd_parameter || strcmp(cmd_parameter, stream.done))
+			fastboot_fail("image was written to another partition",
+				      response);
+		else if (stream.failed)
+			fastboot_fail("failed writing to partition", response);
+		else
+			fastboot_okay(NULL, response);
+		stream.done[0] = '\0';
+		return;
+	}
+#endif
 #if CONFIG_IS_ENABLED(FASTBOOT_FLASH_MMC)
 	fastboot_mmc_flash_write(cmd_parameter, fastboot_buf_addr, image_size,
 				 response);
@@ -336,3 +499,33 @@ static void oem_format(char *cmd_parameter, char *response)
 	}
 }
 #endif
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * oem_stream() - Flash the next download to a partition as it arrives
+ *
+ * @cmd_parameter: Pointer to partition name, or NULL to cancel
+ * @response: Pointer to fastboot response buffer
+ */
+static void oem_stream(char *cmd_parameter, char *response)
+{
+	u32 chunk;
+
+	if (!cmd_parameter || !*cmd_parameter) {
+		stream.part[0] = '\0';
+		fastboot_okay(NULL, response);
+		return;
+	}
+
+	chunk = min_t(u32, CONFIG_FASTBOOT_STREAM_CHUNK_SIZE,
+		      fastboot_buf_size);
+	chunk = rounddown(chunk, SZ_4K);
+	if (!chunk) {
+		fastboot_fail("download buffer too small", response);
+		return;
+	}
+	stream.chunk = chunk;
+	strlcpy(stream.part, cmd_parameter, sizeof(stream.part));
+	fastboot_okay(NULL, response);
+}
+#endif
@@ -94,12 +94,27 @@ static lbaint_t fb_mmc_sparse_write(struct sparse_storage *info,
 	return fb_mmc_blk_write(dev_desc, blk, blkcnt, buffer);
 }
 
+/*
+ * DONT_CARE blocks are left alone. A large image is sent as several sparse
+ * images, each of which covers the others' data with DONT_CARE chunks.
+ */
 static lbaint_t fb_mmc_sparse_reserve(struct sparse_storage *info,
 		lbaint_t blk, lbaint_t blkcnt)
 {
 	return blkcnt;
 }
 
+static lbaint_t fb_mmc_sparse_write_zeroes(struct sparse_storage *info,
+		lbaint_t blk, lbaint_t blkcnt)
+{
+	struct fb_mmc_sparse *sparse = info->priv;
+	lbaint_t blks;
+
+	blks = blk_dwrite_zeroes(sparse->dev_desc, blk, blkcnt);
+
+	return IS_ERR_VALUE(blks) ? 0 : blks;
+}
+
 static void write_raw_image(struct blk_desc *dev_desc,
 			    struct disk_partition *info, const char *part_name,
 			    void *buffer, u32 download_bytes, char *response)
@@ -410,6 +425,7 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 {
 	struct blk_desc *dev_desc;
 	struct disk_partition info;
+	struct mmc *mmc;
 
 	dev_desc = blk_get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
 	if (!dev_desc || dev_desc->type == DEV_TYPE_UNKNOWN) {
@@ -488,6 +504,11 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 		return;
 	}
 
+	/* Let the card cache the image, then write it back before replying */
+	mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (mmc)
+		mmc_set_write_cache(mmc, true);
+
 	if (is_sparse_image(download_buffer)) {
 		struct fb_mmc_sparse sparse_priv;
 		struct sparse_storage sparse;
@@ -500,6 +521,7 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 		sparse.size = info.size;
 		sparse.write = fb_mmc_sparse_write;
 		sparse.reserve = fb_mmc_sparse_reserve;
+		sparse.write_zeroes = fb_mmc_sparse_write_zeroes;
 		sparse.mssg = fastboot_fail;
 
 		printf("Flashing sparse image at offset " LBAFU "\n",
@@ -514,8 +536,155 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
 		write_raw_image(dev_desc, &info, cmd, download_buffer,
 				download_bytes, response);
 	}
+
+	if (mmc && mmc_set_write_cache(mmc, false))
+		fastboot_fail("failed to flush cache", response);
 }
 
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/**
+ * struct fb_mmc_stream - a partition being written as its image arrives
+ *
+ * @dev_desc: Device being written
+ * @info: Partition being written
+ * @name: Name of the partition
+ * @size: Size of the image in bytes
+ * @started: true once the first piece has been seen
+ * @sparse: true if the image is sparse
+ * @blk: Next block to write, for a raw image
+ * @sparse_priv: Private data for the sparse writer
+ * @storage: Sparse storage for the partition
+ * @ss: State of the sparse writer
+ */
+static struct fb_mmc_stream {
+	struct blk_desc *dev_desc;
+	struct disk_partition info;
+	char name[PART_NAME_LEN];
+	u32 size;
+	bool started;
+	bool sparse;
+	lbaint_t blk;
+	struct fb_mmc_sparse sparse_priv;
+	struct sparse_storage storage;
+	struct sparse_stream ss;
+} fb_stream;
+
+int fastboot_mmc_stream_start(const char *cmd, u32 size, char *response)
+{
+	struct fb_mmc_stream *st = &fb_stream;
+	struct mmc *mmc;
+
+	memset(st, '\0', sizeof(*st));
+	st->dev_desc = blk_get_dev("mmc", CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (!st->dev_desc || st->dev_desc->type == DEV_TYPE_UNKNOWN) {
+		pr_err("invalid mmc device\n");
+		fastboot_fail("invalid mmc device", response);
+		return -ENODEV;
+	}
+	if (part_get_info_by_name_or_alias(st->dev_desc, cmd, &st->info) < 0) {
+		pr_err("cannot find partition: '%s'\n", cmd);
+		fastboot_fail("cannot find partition", response);
+		return -ENOENT;
+	}
+	strlcpy(st->name, cmd, sizeof(st->name));
+	st->size = size;
+	st->blk = st->info.start;
+
+	mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (mmc)
+		mmc_set_write_cache(mmc, true);
+
+	return 0;
+}
+
+int fastboot_mmc_stream_write(const void *buf, u32 len, char *response)
+{
+	struct fb_mmc_stream *st = &fb_stream;
+	struct disk_partition *info = &st->info;
+	lbaint_t blkcnt, blks;
+
+	/* The first piece says what sort of image this is */
+	if (!st->started) {
+		st->started = true;
+		st->sparse = len >= sizeof(sparse_header_t) &&
+			is_sparse_image((void *)buf);
+		if (st->sparse) {
+			st->sparse_priv.dev_desc = st->dev_desc;
+			st->storage.blksz = info->blksz;
+			st->storage.start = info->start;
+			st->storage.size = info->size;
+			st->storage.priv = &st->sparse_priv;
+			st->storage.write = fb_mmc_sparse_write;
+			st->storage.reserve = fb_mmc_sparse_reserve;
+			st->storage.write_zeroes = fb_mmc_sparse_write_zeroes;
+			st->storage.mssg = fastboot_fail;
+			printf("Flashing sparse image at offset " LBAFU "\n",
+			       st->storage.start);
+			if (sparse_stream_start(&st->ss, &st->storage,
+						st->name)) {
+				st->sparse = false;
+				fastboot_fail("Malloc failed for sparse image",
+					      response);
+				return -ENOMEM;
+			}
+		} else {
+			if (lldiv(st->size + info->blksz - 1, info->blksz) >
+			    info->size) {
+				pr_err("too large for partition: '%s'\n",
+				       st->name);
+				fastboot_fail("too large for partition",
+					      response);
+				return -EFBIG;
+			}
+			puts("Flashing Raw Image\n");
+		}
+	}
+
+	if (st->sparse)
+		return sparse_stream_write(&st->ss, buf, len, response) ?
+			-EIO : 0;
+
+	/* Only the last piece can end part-way through a block */
+	blkcnt = lldiv(len + info->blksz - 1, info->blksz);
+	blks = fb_mmc_blk_write(st->dev_desc, st->blk, blkcnt, buf);
+	if (blks != blkcnt) {
+		pr_err("failed writing to device %d\n", st->dev_desc->devnum);
+		fastboot_fail("failed writing to device", response);
+		return -EIO;
+	}
+	st->blk += blks;
+
+	return 0;
+}
+
+int fastboot_mmc_stream_finish(bool ok, char *response)
+{
+	struct fb_mmc_stream *st = &fb_stream;
+	struct mmc *mmc;
+	int ret = 0;
+
+	if (st->sparse) {
+		if (sparse_stream_finish(&st->ss, response))
+			ret = -EIO;
+	} else if (ok) {
+		printf("........ wrote " LBAFU " bytes to '%s'\n",
+		       (st->blk - st->info.start) * st->info.blksz, st->name);
+	}
+	if (!ok)
+		ret = -EIO;
+	if (!ret)
+		fastboot_okay(NULL, response);
+
+	mmc = find_mmc_device(CONFIG_FASTBOOT_FLASH_MMC_DEV);
+	if (mmc && mmc_set_write_cache(mmc, false)) {
+		fastboot_fail("failed to flush cache", response);
+		ret = -EIO;
+	}
+
+	return ret;
+}
+#endif
+
 /**
  * fastboot_mmc_flash_erase() - Erase eMMC for fastboot
  *
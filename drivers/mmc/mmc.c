@@ -10,6 +10,7 @@
 #include <config.h>
 #include <common.h>
 #include <blk.h>
+#include <bootstage.h>
 #include <command.h>
 #include <dm.h>
 #include <log.h>
@@ -415,7 +416,7 @@ static int mmc_read_blocks(struct mmc *mmc, void *dst, lbaint_t start,
 }
 
 #if !CONFIG_IS_ENABLED(DM_MMC)
-static int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt)
+int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt)
 {
 	if (mmc->cfg->ops->get_b_max)
 		return mmc->cfg->ops->get_b_max(mmc, dst, blkcnt);
@@ -435,7 +436,7 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
 #endif
 	int dev_num = block_dev->devnum;
-	int err;
+	int err, span;
 	lbaint_t cur, blocks_todo = blkcnt;
 	uint b_max;
 
@@ -469,16 +470,19 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 
 	b_max = mmc_get_b_max(mmc, dst, blkcnt);
 
+	span = bootstage_span_start("mmc read", BOOTSTAGEF_MERGE);
 	do {
 		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_read_blocks(mmc, dst, start, cur) != cur) {
 			pr_debug("%s: Failed to read blocks\n", __func__);
+			bootstage_span_end(span, 0);
 			return 0;
 		}
 		blocks_todo -= cur;
 		start += cur;
 		dst += cur * mmc->read_bl_len;
 	} while (blocks_todo > 0);
+	bootstage_span_end(span, blkcnt * mmc->read_bl_len);
 
 	return blkcnt;
 }
@@ -764,21 +768,22 @@ int mmc_send_ext_csd(struct mmc *mmc, u8 *ext_csd)
 }
 
 static int __mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value,
-			bool send_status)
+			uint timeout_ms, bool send_status)
 {
 	unsigned int status, start;
 	struct mmc_cmd cmd;
-	int timeout_ms = DEFAULT_CMD6_TIMEOUT_MS;
 	bool is_part_switch = (set == EXT_CSD_CMD_SET_NORMAL) &&
 			      (index == EXT_CSD_PART_CONF);
 	int retries = 3;
 	int ret;
 
-	if (mmc->gen_cmd6_time)
-		timeout_ms = mmc->gen_cmd6_time * 10;
-
-	if (is_part_switch  && mmc->part_switch_time)
-		timeout_ms = mmc->part_switch_time * 10;
+	if (!timeout_ms) {
+		timeout_ms = DEFAULT_CMD6_TIMEOUT_MS;
+		if (mmc->gen_cmd6_time)
+			timeout_ms = mmc->gen_cmd6_time * 10;
+		if (is_part_switch && mmc->part_switch_time)
+			timeout_ms = mmc->part_switch_time * 10;
+	}
 
 	cmd.cmdidx = MMC_CMD_SWITCH;
 	cmd.resp_type = MMC_RSP_R1b;
@@ -831,7 +836,13 @@ static int __mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value,
 
 int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value)
 {
-	return __mmc_switch(mmc, set, index, value, true);
+	return __mmc_switch(mmc, set, index, value, 0, true);
+}
+
+int mmc_switch_timeout(struct mmc *mmc, u8 set, u8 index, u8 value,
+		       uint timeout_ms)
+{
+	return __mmc_switch(mmc, set, index, value, timeout_ms, true);
 }
 
 int mmc_boot_wp(struct mmc *mmc)
@@ -877,7 +888,7 @@ static int mmc_set_card_speed(struct mmc *mmc, enum bus_mode mode,
 	}
 
 	err = __mmc_switch(mmc, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_HS_TIMING,
-			   speed_bits, !hsdowngrade);
+			   speed_bits, 0, !hsdowngrade);
 	if (err)
 		return err;
 
@@ -2408,6 +2419,31 @@ error:
 	return err;
 }
 
+#if CONFIG_IS_ENABLED(MMC_FAST_WRITE)
+static void mmc_get_write_caps(struct mmc *mmc)
+{
+	u8 *ext_csd = mmc->ext_csd;
+
+	/* CMD23 is optional for SD cards but part of MMC since v3.1 */
+	if (IS_SD(mmc))
+		mmc->cmd23 = mmc->scr[0] & SD_SCR_CMD23_SUPPORT;
+	else
+		mmc->cmd23 = mmc->version >= MMC_VERSION_3;
+	if (mmc_host_is_spi(mmc))
+		mmc->cmd23 = false;
+
+	mmc->cache_size = 0;
+	mmc->cache_on = false;
+	if (!IS_SD(mmc) && ext_csd && mmc->version >= MMC_VERSION_4_5) {
+		mmc->cache_size = ext_csd[EXT_CSD_CACHE_SIZE] << 0
+				| ext_csd[EXT_CSD_CACHE_SIZE + 1] << 8
+				| ext_csd[EXT_CSD_CACHE_SIZE + 2] << 16
+				| ext_csd[EXT_CSD_CACHE_SIZE + 3] << 24;
+		mmc->cache_on = ext_csd[EXT_CSD_CACHE_CTRL] & EXT_CSD_CACHE_EN;
+	}
+}
+#endif
+
 static int mmc_startup(struct mmc *mmc)
 {
 	int err, i;
@@ -2612,6 +2648,9 @@ static int mmc_startup(struct mmc *mmc)
 		return err;
 
 	mmc->best_mode = mmc->selected_mode;
+#if CONFIG_IS_ENABLED(MMC_FAST_WRITE)
+	mmc_get_write_caps(mmc);
+#endif
 
 	/* Fix the block length for DDR mode */
 	if (mmc->ddr_mode) {
@@ -32,6 +32,8 @@ ulong mmc_bread(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 ulong mmc_bwrite(struct udevice *dev, lbaint_t start, lbaint_t blkcnt,
 		 const void *src);
 ulong mmc_berase(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
+ulong mmc_bdiscard(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
+ulong mmc_bwrite_zeroes(struct udevice *dev, lbaint_t start, lbaint_t blkcnt);
 #else
 ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 		 const void *src);
@@ -133,4 +135,32 @@ int mmc_switch_part(struct mmc *mmc, unsigned int part_num);
  */
 int mmc_switch(struct mmc *mmc, u8 set, u8 index, u8 value);
 
+/**
+ * mmc_switch_timeout() - Issue an MMC switch mode command with a timeout
+ *
+ * This is for switches which can take much longer than the card's usual
+ * CMD6 time, such as flushing its cache.
+ *
+ * @mmc:	MMC device
+ * @set:	Unused
+ * @index:	Cmdarg index
+ * @value:	Cmdarg value
+ * @timeout_ms:	Time to wait for the card to finish, in milliseconds
+ * @return 0 if OK, -ve on error
+ */
+int mmc_switch_timeout(struct mmc *mmc, u8 set, u8 index, u8 value,
+		       uint timeout_ms);
+
+#if !CONFIG_IS_ENABLED(DM_MMC)
+/**
+ * mmc_get_b_max() - Get the largest number of blocks in one transfer
+ *
+ * @mmc:	MMC device
+ * @dst:	Buffer for the transfer
+ * @blkcnt:	Total number of blocks to transfer
+ * @return maximum number of blocks for one transfer
+ */
+int mmc_get_b_max(struct mmc *mmc, void *dst, lbaint_t blkcnt);
+#endif
+
 #endif /* _MMC_PRIVATE_H_ */
@@ -15,7 +15,8 @@
 #include <linux/math64.h>
 #include "mmc_private.h"
 
-static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
+static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt,
+			 u32 arg)
 {
 	struct mmc_cmd cmd;
 	ulong end;
@@ -52,7 +53,7 @@ static ulong mmc_erase_t(struct mmc *mmc, ulong start, lbaint_t blkcnt)
 		goto err_out;
 
 	cmd.cmdidx = MMC_CMD_ERASE;
-	cmd.cmdarg = MMC_ERASE_ARG;
+	cmd.cmdarg = arg;
 	cmd.resp_type = MMC_RSP_R1b;
 
 	err = mmc_send_cmd(mmc, &cmd, NULL);
@@ -113,7 +114,7 @@ ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt)
 			blk_r = ((blkcnt - blk) > mmc->erase_grp_size) ?
 				mmc->erase_grp_size : (blkcnt - blk);
 		}
-		err = mmc_erase_t(mmc, start + blk, blk_r);
+		err = mmc_erase_t(mmc, start + blk, blk_r, MMC_ERASE_ARG);
 		if (err)
 			break;
 
@@ -127,12 +128,131 @@ ulong mmc_berase(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt)
 	return blk;
 }
 
+#if CONFIG_IS_ENABLED(BLK)
+/*
+ * Trim and discard work on write blocks rather than erase groups, so large
+ * ranges can go in a few commands. Limit each one so that the busy timeout
+ * stays sensible.
+ */
+#define MMC_DISCARD_MAX_BLOCKS	0x10000
+
+/* SD cards do not give a trim timeout, so allow plenty */
+#define MMC_SD_DISCARD_TIMEOUT_MS	30000
+
+/**
+ * mmc_discard_arg() - Work out how to drop blocks without touching others
+ *
+ * @mmc:	MMC device
+ * @zero:	true if the blocks must read back as zero afterwards
+ * @return erase argument to use, or -EOPNOTSUPP if the card cannot do it
+ */
+static int mmc_discard_arg(struct mmc *mmc, bool zero)
+{
+	u8 *ext_csd = mmc->ext_csd;
+
+	/* SD cards erase write blocks, with the result given in the SCR */
+	if (IS_SD(mmc)) {
+		if (zero && (!mmc->scr[0] ||
+			     (mmc->scr[0] & SD_SCR_DATA_STAT_AFTER_ERASE)))
+			return -EOPNOTSUPP;
+		return MMC_ERASE_ARG;
+	}
+	if (!ext_csd)
+		return -EOPNOTSUPP;
+
+	/* Discarded blocks may keep their old contents */
+	if (!zero && mmc->version >= MMC_VERSION_4_5)
+		return MMC_DISCARD_ARG;
+	if (!(ext_csd[EXT_CSD_SEC_FEATURE_SUPPORT] & EXT_CSD_SEC_GB_CL_EN))
+		return -EOPNOTSUPP;
+	if (zero && ext_csd[EXT_CSD_ERASED_MEM_CONT])
+		return -EOPNOTSUPP;
+
+	return MMC_TRIM_ARG;
+}
+
+static ulong mmc_discard_blocks(struct udevice *dev, lbaint_t start,
+				lbaint_t blkcnt, bool zero)
+{
+	struct blk_desc *block_dev = dev_get_uclass_platdata(dev);
+	struct mmc *mmc = find_mmc_device(block_dev->devnum);
+	lbaint_t blk = 0, blk_r;
+	int arg, err, timeout_ms;
+
+	if (!mmc)
+		return -ENODEV;
+
+	err = blk_select_hwpart_devnum(IF_TYPE_MMC, block_dev->devnum,
+				       block_dev->hwpart);
+	if (err < 0)
+		return err;
+
+	if (start + blkcnt > block_dev->lba)
+		return -EINVAL;
+
+	arg = mmc_discard_arg(mmc, zero);
+	if (arg < 0)
+		return arg;
+
+	while (blk < blkcnt) {
+		blk_r = min_t(lbaint_t, blkcnt - blk, MMC_DISCARD_MAX_BLOCKS);
+		err = mmc_erase_t(mmc, start + blk, blk_r, arg);
+		if (err)
+			break;
+
+		/* The trim timeout is given per erase group */
+		if (IS_SD(mmc)) {
+			timeout_ms = MMC_SD_DISCARD_TIMEOUT_MS;
+		} else {
+			timeout_ms = 300 * mmc->ext_csd[EXT_CSD_TRIM_MULT] *
+				DIV_ROUND_UP(blk_r, mmc->erase_grp_size);
+			timeout_ms = max(timeout_ms, 1000);
+		}
+		if (mmc_poll_for_busy(mmc, timeout_ms))
+			break;
+
+		blk += blk_r;
+	}
+
+	return blk;
+}
+
+ulong mmc_bdiscard(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+	return mmc_discard_blocks(dev, start, blkcnt, false);
+}
+
+ulong mmc_bwrite_zeroes(struct udevice *dev, lbaint_t start, lbaint_t blkcnt)
+{
+	return mmc_discard_blocks(dev, start, blkcnt, true);
+}
+#endif
+
+/* CMD23 holds the block count in its lower 16 bits */
+#define MMC_CMD23_MAX_BLOCKS	0xffff
+
+/*
+ * Flushing waits for everything in the cache to be programmed, which can
+ * take far longer than an ordinary switch
+ */
+#define MMC_CACHE_FLUSH_TIMEOUT_MS	30000
+
+static bool mmc_use_cmd23(struct mmc *mmc)
+{
+#if CONFIG_IS_ENABLED(MMC_FAST_WRITE)
+	return mmc->cmd23;
+#else
+	return false;
+#endif
+}
+
 static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 		lbaint_t blkcnt, const void *src)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
 	int timeout_ms = 1000;
+	bool predefined = false;
 
 	if ((start + blkcnt) > mmc_get_blk_desc(mmc)->lba) {
 		printf("MMC: block number 0x" LBAF " exceeds max(0x" LBAF ")\n",
@@ -142,7 +262,20 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 
 	if (blkcnt == 0)
 		return 0;
-	else if (blkcnt == 1)
+
+	/* Tell the card how much is coming, so no stop command is needed */
+	if (blkcnt > 1 && mmc_use_cmd23(mmc)) {
+		cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+		cmd.cmdarg = blkcnt;
+		cmd.resp_type = MMC_RSP_R1;
+		if (mmc_send_cmd(mmc, &cmd, NULL)) {
+			printf("mmc fail to set block count\n");
+			return 0;
+		}
+		predefined = true;
+	}
+
+	if (blkcnt == 1)
 		cmd.cmdidx = MMC_CMD_WRITE_SINGLE_BLOCK;
 	else
 		cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
@@ -167,7 +300,7 @@ static ulong mmc_write_blocks(struct mmc *mmc, lbaint_t start,
 	/* SPI multiblock writes terminate using a special
 	 * token, not a STOP_TRANSMISSION request.
 	 */
-	if (!mmc_host_is_spi(mmc) && blkcnt > 1) {
+	if (!mmc_host_is_spi(mmc) && blkcnt > 1 && !predefined) {
 		cmd.cmdidx = MMC_CMD_STOP_TRANSMISSION;
 		cmd.cmdarg = 0;
 		cmd.resp_type = MMC_RSP_R1b;
@@ -197,6 +330,7 @@ ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 #endif
 	int dev_num = block_dev->devnum;
 	lbaint_t cur, blocks_todo = blkcnt;
+	uint b_max;
 	int err;
 
 	struct mmc *mmc = find_mmc_device(dev_num);
@@ -210,9 +344,15 @@ ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 	if (mmc_set_blocklen(mmc, mmc->write_bl_len))
 		return 0;
 
+	b_max = mmc->cfg->b_max;
+	if (CONFIG_IS_ENABLED(MMC_FAST_WRITE)) {
+		b_max = mmc_get_b_max(mmc, (void *)src, blkcnt);
+		if (mmc_use_cmd23(mmc))
+			b_max = min_t(uint, b_max, MMC_CMD23_MAX_BLOCKS);
+	}
+
 	do {
-		cur = (blocks_todo > mmc->cfg->b_max) ?
-			mmc->cfg->b_max : blocks_todo;
+		cur = (blocks_todo > b_max) ? b_max : blocks_todo;
 		if (mmc_write_blocks(mmc, start, cur, src) != cur)
 			return 0;
 		blocks_todo -= cur;
@@ -222,3 +362,43 @@ ulong mmc_bwrite(struct blk_desc *block_dev, lbaint_t start, lbaint_t blkcnt,
 
 	return blkcnt;
 }
+
+#if CONFIG_IS_ENABLED(MMC_FAST_WRITE)
+int mmc_set_write_cache(struct mmc *mmc, bool enable)
+{
+	int ret;
+
+	if (!mmc->cache_size || mmc->cache_on == enable)
+		return 0;
+
+	/* Turning the cache off makes the card write it back first */
+	ret = mmc_switch_timeout(mmc, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_CACHE_CTRL,
+				 enable ? EXT_CSD_CACHE_EN : 0,
+				 enable ? 0 : MMC_CACHE_FLUSH_TIMEOUT_MS);
+	if (ret) {
+		printf("mmc fail to %s cache (err=%d)\n",
+		       enable ? "enable" : "disable", ret);
+		return ret;
+	}
+	mmc->cache_on = enable;
+
+	return 0;
+}
+
+int mmc_flush_cache(struct mmc *mmc)
+{
+	int ret;
+
+	if (!mmc->cache_on)
+		return 0;
+
+	ret = mmc_switch_timeout(mmc, EXT_CSD_CMD_SET_NORMAL,
+				 EXT_CSD_FLUSH_CACHE, 1,
+				 MMC_CACHE_FLUSH_TIMEOUT_MS);
+	if (ret)
+		printf("mmc fail to flush cache (err=%d)\n", ret);
+
+	return ret;
+}
+#endif
@@ -12,20 +12,48 @@
 #include <mmc.h>
 #include <asm/test.h>
 
+/* Number of command indexes which are counted */
+#define SANDBOX_MMC_CMDS	64
+
 struct sandbox_mmc_plat {
 	struct mmc_config cfg;
 	struct mmc mmc;
 };
 
+/**
+ * struct sandbox_mmc_priv - state of the emulated card
+ *
+ * @cmd_count: Number of times each command has been sent
+ * @block_count: Block count set by CMD23 for the next transfer, or 0
+ * @predefined: true if the last transfer had its length set by CMD23, so
+ *	must not be followed by CMD12
+ * @erase_start: First block to erase, plus one (0 if not set)
+ * @erase_end: Last block to erase, plus one (0 if not set)
+ */
+struct sandbox_mmc_priv {
+	uint cmd_count[SANDBOX_MMC_CMDS];
+	uint block_count;
+	bool predefined;
+	uint erase_start;
+	uint erase_end;
+};
+
 /**
  * sandbox_mmc_send_cmd() - Emulate SD commands
  *
  * This emulate an SD card version 2. Single-block reads result in zero data.
- * Multiple-block reads return a test string.
+ * Multiple-block reads return a test string. Writes are checked against any
+ * block count given by CMD23, then discarded. Erases are checked to have a
+ * valid range but otherwise do nothing.
  */
 static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 				struct mmc_data *data)
 {
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	if (cmd->cmdidx < SANDBOX_MMC_CMDS)
+		priv->cmd_count[cmd->cmdidx]++;
+
 	switch (cmd->cmdidx) {
 	case MMC_CMD_ALL_SEND_CID:
 		memset(cmd->response, '\0', sizeof(cmd->response));
@@ -60,11 +88,38 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	}
 	case MMC_CMD_READ_SINGLE_BLOCK:
 		memset(data->dest, '\0', data->blocksize);
+		priv->predefined = false;
 		break;
 	case MMC_CMD_READ_MULTIPLE_BLOCK:
 		strcpy(data->dest, "this is a test");
+		priv->predefined = false;
+		break;
+	case MMC_CMD_SET_BLOCK_COUNT:
+		priv->block_count = cmd->cmdarg & 0xffff;
+		break;
+	case MMC_CMD_WRITE_SINGLE_BLOCK:
+	case MMC_CMD_WRITE_MULTIPLE_BLOCK:
+		if (priv->block_count && data->blocks != priv->block_count)
+			return -EILSEQ;
+		priv->predefined = priv->block_count != 0;
+		priv->block_count = 0;
 		break;
 	case MMC_CMD_STOP_TRANSMISSION:
+		/* The card has already stopped, so this is not allowed */
+		if (priv->predefined)
+			return -EILSEQ;
+		break;
+	case SD_CMD_ERASE_WR_BLK_START:
+		priv->erase_start = cmd->cmdarg + 1;
+		break;
+	case SD_CMD_ERASE_WR_BLK_END:
+		priv->erase_end = cmd->cmdarg + 1;
+		break;
+	case MMC_CMD_ERASE:
+		if (!priv->erase_start || priv->erase_end < priv->erase_start)
+			return -EILSEQ;
+		priv->erase_start = 0;
+		priv->erase_end = 0;
 		break;
 	case SD_CMD_APP_SEND_OP_COND:
 		cmd->response[0] = OCR_BUSY | OCR_HCS;
@@ -79,7 +134,8 @@ static int sandbox_mmc_send_cmd(struct udevice *dev, struct mmc_cmd *cmd,
 	case SD_CMD_APP_SEND_SCR: {
 		u32 *scr = (u32 *)data->dest;
 
-		scr[0] = cpu_to_be32(2 << 24 | 1 << 15);  /* SD version 3 */
+		/* SD version 3, supporting CMD23 */
+		scr[0] = cpu_to_be32(2 << 24 | 1 << 15 | SD_SCR_CMD23_SUPPORT);
 		break;
 	}
 	default:
@@ -106,6 +162,20 @@ static const struct dm_mmc_ops sandbox_mmc_ops = {
 	.get_cd = sandbox_mmc_get_cd,
 };
 
+uint sandbox_mmc_get_cmd_count(struct udevice *dev, uint cmdidx)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	return cmdidx < SANDBOX_MMC_CMDS ? priv->cmd_count[cmdidx] : 0;
+}
+
+void sandbox_mmc_reset_cmd_counts(struct udevice *dev)
+{
+	struct sandbox_mmc_priv *priv = dev_get_priv(dev);
+
+	memset(priv->cmd_count, '\0', sizeof(priv->cmd_count));
+}
+
 int sandbox_mmc_probe(struct udevice *dev)
 {
 	struct sandbox_mmc_plat *plat = dev_get_platdata(dev);
@@ -148,5 +218,6 @@ U_BOOT_DRIVER(mmc_sandbox) = {
 	.bind		= sandbox_mmc_bind,
 	.unbind		= sandbox_mmc_unbind,
 	.probe		= sandbox_mmc_probe,
+	.priv_auto_alloc_size = sizeof(struct sandbox_mmc_priv),
 	.platdata_auto_alloc_size = sizeof(struct sandbox_mmc_plat),
 };
@@ -84,6 +84,8 @@ struct sandbox_spi_flash {
 	uint cmd;
 	/* Erase size of current erase command */
 	uint erase_size;
+	/* Number of erase commands carried out, for each size */
+	uint erase_4k, erase_64k, erase_chip;
 	/* Current position in the flash; used when reading/writing/etc... */
 	uint off;
 	/* How many address bytes we've consumed */
@@ -111,6 +113,22 @@ void sandbox_sf_set_block_protect(struct udevice *dev, int bp_mask)
 	sbsf->status |= bp_mask << STAT_BP_SHIFT;
 }
 
+uint sandbox_sf_get_erase_count(struct udevice *dev, uint opcode)
+{
+	struct sandbox_spi_flash *sbsf = dev_get_priv(dev);
+
+	switch (opcode) {
+	case SPINOR_OP_BE_4K:
+		return sbsf->erase_4k;
+	case SPINOR_OP_SE:
+		return sbsf->erase_64k;
+	case SPINOR_OP_CHIP_ERASE:
+		return sbsf->erase_chip;
+	default:
+		return 0;
+	}
+}
+
 /**
  * This is a very strange probe function. If it has platform data (which may
  * have come from the device tree) then this function gets the filename and
@@ -230,6 +248,8 @@ static void sandbox_spi_tristate(u8 *buf, uint len)
 	memset(buf, 0xff, len);
 }
 
+int sandbox_erase_part(struct sandbox_spi_flash *sbsf, int size);
+
 /* Figure out what command this stream is telling us to do */
 static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 				  u8 *tx)
@@ -269,16 +289,29 @@ static int sandbox_sf_process_cmd(struct sandbox_spi_flash *sbsf, const u8 *rx,
 	case SPINOR_OP_WRSR:
 		sbsf->state = SF_WRITE_STATUS;
 		break;
+	case SPINOR_OP_CHIP_ERASE:
+		/* There is no address, so erase everything now */
+		if (!(sbsf->status & STAT_WEL)) {
+			puts("sandbox_sf: write enable not set before erase\n");
+			break;
+		}
+		log_content(" chip erase\n");
+		if (os_lseek(sbsf->fd, 0, OS_SEEK_SET) < 0 ||
+		    sandbox_erase_part(sbsf, sbsf->data->sector_size *
+				       sbsf->data->n_sectors)) {
+			log_content("sandbox_sf: Erase failed\n");
+			return -EIO;
+		}
+		sbsf->erase_chip++;
+		sbsf->status &= ~STAT_WEL;
+		break;
 	default: {
 		int flags = sbsf->data->flags;
 
 		/* we only support erase here */
-		if (sbsf->cmd == SPINOR_OP_CHIP_ERASE) {
-			sbsf->erase_size = sbsf->data->sector_size *
-				sbsf->data->n_sectors;
-		} else if (sbsf->cmd == SPINOR_OP_BE_4K && (flags & SECT_4K)) {
+		if (sbsf->cmd == SPINOR_OP_BE_4K && (flags & SECT_4K)) {
 			sbsf->erase_size = 4 << 10;
-		} else if (sbsf->cmd == SPINOR_OP_SE && !(flags & SECT_4K)) {
+		} else if (sbsf->cmd == SPINOR_OP_SE) {
 			sbsf->erase_size = 64 << 10;
 		} else {
 			debug(" cmd unknown: %#x\n", sbsf->cmd);
@@ -484,6 +517,10 @@ static int sandbox_sf_xfer(struct udevice *dev, unsigned int bitlen,
 				log_content("sandbox_sf: Erase failed\n");
 				goto done;
 			}
+			if (sbsf->erase_size == 4 << 10)
+				sbsf->erase_4k++;
+			else
+				sbsf->erase_64k++;
 			goto done;
 		}
 		default:
@@ -14,9 +14,56 @@
 #include <malloc.h>
 #include <spi.h>
 #include <spi_flash.h>
+#include <spi-mem.h>
+#include <linux/err.h>
 
 #include "sf_internal.h"
 
+/*
+ * Set up the read operation chosen by spi_nor_scan() as a direct mapping of
+ * the whole flash, so that reads can go through the controller's memory-mapped
+ * window if it has one. Without a mapping, reads go on as before.
+ */
+static void spi_flash_create_read_dirmap(struct spi_flash *flash)
+{
+	struct spi_mem_dirmap_info info = {
+		.op_tmpl = SPI_MEM_OP(SPI_MEM_OP_CMD(flash->read_opcode, 1),
+				      SPI_MEM_OP_ADDR(flash->addr_width, 0, 1),
+				      SPI_MEM_OP_DUMMY(flash->read_dummy, 1),
+				      SPI_MEM_OP_DATA_IN(0, NULL, 1)),
+		.offset = 0,
+		.length = flash->size,
+	};
+	struct spi_mem_op *op = &info.op_tmpl;
+	struct spi_mem_dirmap_desc *desc;
+
+	/* With a bank address register, only 16MiB can be reached at once */
+	if (IS_ENABLED(CONFIG_SPI_FLASH_BAR))
+		return;
+
+	op->cmd.buswidth = spi_nor_get_protocol_inst_nbits(flash->read_proto);
+	op->addr.buswidth = spi_nor_get_protocol_addr_nbits(flash->read_proto);
+	op->dummy.buswidth = op->addr.buswidth;
+	op->data.buswidth = spi_nor_get_protocol_data_nbits(flash->read_proto);
+	op->dummy.nbytes = (flash->read_dummy * op->dummy.buswidth) / 8;
+
+	desc = spi_mem_dirmap_create(flash->spi, &info);
+	if (IS_ERR(desc)) {
+		debug("SF: No direct mapping for reads (err=%ld)\n",
+		      PTR_ERR(desc));
+		return;
+	}
+	flash->dirmap_rdesc = desc;
+}
+
+static void spi_flash_destroy_read_dirmap(struct spi_flash *flash)
+{
+	if (!flash->dirmap_rdesc)
+		return;
+	spi_mem_dirmap_destroy(flash->dirmap_rdesc);
+	flash->dirmap_rdesc = NULL;
+}
+
 /**
  * spi_flash_probe_slave() - Probe for a SPI flash device on a bus
  *
@@ -45,8 +92,14 @@ static int spi_flash_probe_slave(struct spi_flash *flash)
 	if (ret)
 		goto err_read_id;
 
-	if (CONFIG_IS_ENABLED(SPI_FLASH_MTD))
+	if (IS_ENABLED(CONFIG_SPI_DIRMAP))
+		spi_flash_create_read_dirmap(flash);
+
+	if (CONFIG_IS_ENABLED(SPI_FLASH_MTD)) {
 		ret = spi_flash_mtd_register(flash);
+		if (ret)
+			spi_flash_destroy_read_dirmap(flash);
+	}
 
 err_read_id:
 	spi_release_bus(spi);
@@ -86,6 +139,7 @@ void spi_flash_free(struct spi_flash *flash)
 	if (CONFIG_IS_ENABLED(SPI_FLASH_MTD))
 		spi_flash_mtd_unregister();
 
+	spi_flash_destroy_read_dirmap(flash);
 	spi_free_slave(flash->spi);
 	free(flash);
 }
@@ -143,9 +197,13 @@ int spi_flash_std_probe(struct udevice *dev)
 
 static int spi_flash_std_remove(struct udevice *dev)
 {
+	struct spi_flash *flash = dev_get_uclass_priv(dev);
+
 	if (CONFIG_IS_ENABLED(SPI_FLASH_MTD))
 		spi_flash_mtd_unregister();
 
+	spi_flash_destroy_read_dirmap(flash);
+
 	return 0;
 }
 
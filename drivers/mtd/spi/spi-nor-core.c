@@ -38,6 +38,12 @@
 
 #define DEFAULT_READY_WAIT_JIFFIES		(40UL * HZ)
 
+/*
+ * For full-chip erase, calibrated to a 2MB flash (M25P16); should be scaled up
+ * for larger flash
+ */
+#define CHIP_ERASE_2MB_READY_WAIT_JIFFIES	(40UL * HZ)
+
 static int spi_nor_read_write_reg(struct spi_nor *nor, struct spi_mem_op
 		*op, void *buf)
 {
@@ -84,6 +90,10 @@ static ssize_t spi_nor_read_data(struct spi_nor *nor, loff_t from, size_t len,
 	size_t remaining = len;
 	int ret;
 
+	/* The direct mapping may return less than asked for */
+	if (nor->dirmap_rdesc)
+		return spi_mem_dirmap_read(nor->dirmap_rdesc, from, len, buf);
+
 	/* get transfer protocols. */
 	op.cmd.buswidth = spi_nor_get_protocol_inst_nbits(nor->read_proto);
 	op.addr.buswidth = spi_nor_get_protocol_addr_nbits(nor->read_proto);
@@ -295,12 +305,16 @@ static u8 spi_nor_convert_3to4_erase(u8 opcode)
 static void spi_nor_set_4byte_opcodes(struct spi_nor *nor,
 				      const struct flash_info *info)
 {
+	struct spi_nor_erase_type *type;
+	int i, n;
+
 	/* Do some manufacturer fixups first */
 	switch (JEDEC_MFR(info)) {
 	case SNOR_MFR_SPANSION:
 		/* No small sector erase for 4-byte command set */
 		nor->erase_opcode = SPINOR_OP_SE;
 		nor->mtd.erasesize = info->sector_size;
+		nor->num_erase_types = 0;
 		break;
 
 	default:
@@ -310,6 +324,17 @@ static void spi_nor_set_4byte_opcodes(struct spi_nor *nor,
 	nor->read_opcode = spi_nor_convert_3to4_read(nor->read_opcode);
 	nor->program_opcode = spi_nor_convert_3to4_program(nor->program_opcode);
 	nor->erase_opcode = spi_nor_convert_3to4_erase(nor->erase_opcode);
+
+	/* Drop the extra erase commands which have no 4-byte form */
+	for (i = 0, n = 0; i < nor->num_erase_types; i++) {
+		type = &nor->erase_types[i];
+		if (spi_nor_convert_3to4_erase(type->opcode) == type->opcode)
+			continue;
+		nor->erase_types[n] = *type;
+		nor->erase_types[n++].opcode =
+			spi_nor_convert_3to4_erase(type->opcode);
+	}
+	nor->num_erase_types = n;
 }
 #endif /* !CONFIG_SPI_FLASH_BAR */
 
@@ -523,10 +548,10 @@ static int read_bar(struct spi_nor *nor, const struct flash_info *info)
 /*
  * Initiate the erasure of a single sector
  */
-static int spi_nor_erase_sector(struct spi_nor *nor, u32 addr)
+static int spi_nor_erase_sector(struct spi_nor *nor, u8 opcode, u32 addr)
 {
 	struct spi_mem_op op =
-		SPI_MEM_OP(SPI_MEM_OP_CMD(nor->erase_opcode, 1),
+		SPI_MEM_OP(SPI_MEM_OP_CMD(opcode, 1),
 			   SPI_MEM_OP_ADDR(nor->addr_width, addr, 1),
 			   SPI_MEM_OP_NO_DUMMY,
 			   SPI_MEM_OP_NO_DATA);
@@ -541,13 +566,98 @@ static int spi_nor_erase_sector(struct spi_nor *nor, u32 addr)
 	return spi_mem_exec_op(nor->spi, &op);
 }
 
+/*
+ * Initiate the erasure of the whole chip
+ */
+static int spi_nor_erase_chip(struct spi_nor *nor)
+{
+	struct spi_mem_op op =
+		SPI_MEM_OP(SPI_MEM_OP_CMD(SPINOR_OP_CHIP_ERASE, 1),
+			   SPI_MEM_OP_NO_ADDR,
+			   SPI_MEM_OP_NO_DUMMY,
+			   SPI_MEM_OP_NO_DATA);
+
+	return spi_mem_exec_op(nor->spi, &op);
+}
+
+/*
+ * Chip erase is only used when nothing is write protected, since flashes
+ * ignore it if any block is locked. Block protection covers a range at the
+ * top or the bottom of the flash, so it is enough to ask the locking code
+ * about the first and last bytes. That way the top/bottom bit and any other
+ * bits it knows about are taken into account.
+ */
+static bool spi_nor_can_erase_chip(struct spi_nor *nor)
+{
+	u64 last = nor->mtd.size - 1;
+
+	if (nor->erase || (nor->flags & SNOR_F_NO_OP_CHIP_ERASE))
+		return false;
+	if (!nor->flash_is_locked)
+		return true;
+	if (nor->info->flags & SPI_NOR_HAS_SST26LOCK)
+		return false;
+
+	return !nor->flash_is_locked(nor, 0, 1) &&
+	       !nor->flash_is_locked(nor, last, 1);
+}
+
+/*
+ * Note an erase command the flash supports, keeping the first one seen for
+ * each size. spi_nor_select_erase_types() sorts out the final list.
+ */
+static void spi_nor_add_erase_type(struct spi_nor *nor, u32 size, u8 opcode,
+				   u32 time_ms)
+{
+	struct spi_nor_erase_type *type;
+	int i;
+
+	for (i = 0; i < nor->num_erase_types; i++) {
+		if (nor->erase_types[i].size == size)
+			return;
+	}
+	if (nor->num_erase_types == SNOR_ERASE_TYPE_MAX)
+		return;
+
+	type = &nor->erase_types[nor->num_erase_types++];
+	type->size = size;
+	type->time_ms = time_ms;
+	type->opcode = opcode;
+}
+
+/*
+ * Pick the largest erase command which starts at @addr and does not go
+ * past @len. The smallest one always fits, since the range is a multiple of
+ * mtd->erasesize.
+ */
+static const struct spi_nor_erase_type *
+spi_nor_find_erase_type(struct spi_nor *nor, u32 addr, u32 len)
+{
+	const struct spi_nor_erase_type *type;
+	int i;
+
+	for (i = nor->num_erase_types - 1; i > 0; i--) {
+		type = &nor->erase_types[i];
+		if (!(addr & (type->size - 1)) && len >= type->size)
+			return type;
+	}
+
+	return &nor->erase_types[0];
+}
+
 /*
  * Erase an address range on the nor chip.  The address range may extend
  * one or more erase sectors.  Return an error is there is a problem erasing.
+ *
+ * Each step uses the largest erase command that fits, so the aligned middle
+ * of a range goes in large blocks and only the ends use small sectors. A
+ * range covering the whole chip uses chip erase.
  */
 static int spi_nor_erase(struct mtd_info *mtd, struct erase_info *instr)
 {
 	struct spi_nor *nor = mtd_to_spi_nor(mtd);
+	const struct spi_nor_erase_type *type;
+	unsigned long timeout;
 	u32 addr, len, rem;
 	int ret;
 
@@ -564,7 +674,21 @@ static int spi_nor_erase(struct mtd_info *mtd, struct erase_info *instr)
 	addr = instr->addr;
 	len = instr->len;
 
+	if (!addr && len == mtd->size && spi_nor_can_erase_chip(nor)) {
+		timeout = max(CHIP_ERASE_2MB_READY_WAIT_JIFFIES *
+			      (unsigned long)(mtd->size / SZ_2M),
+			      DEFAULT_READY_WAIT_JIFFIES);
+
+		write_enable(nor);
+		ret = spi_nor_erase_chip(nor);
+		if (!ret)
+			ret = spi_nor_wait_till_ready_with_timeout(nor,
+								   timeout);
+		goto erase_err;
+	}
+
 	while (len) {
+		type = spi_nor_find_erase_type(nor, addr, len);
 #ifdef CONFIG_SPI_FLASH_BAR
 		ret = write_bar(nor, addr);
 		if (ret < 0)
@@ -572,12 +696,12 @@ static int spi_nor_erase(struct mtd_info *mtd, struct erase_info *instr)
 #endif
 		write_enable(nor);
 
-		ret = spi_nor_erase_sector(nor, addr);
+		ret = spi_nor_erase_sector(nor, type->opcode, addr);
 		if (ret)
 			goto erase_err;
 
-		addr += mtd->erasesize;
-		len -= mtd->erasesize;
+		addr += type->size;
+		len -= type->size;
 
 		ret = spi_nor_wait_till_ready(nor);
 		if (ret)
@@ -1653,6 +1777,9 @@ struct sfdp_header {
 #define BFPT_DWORD5_FAST_READ_4_4_4		BIT(4)
 
 /* 11th DWORD. */
+#define BFPT_DWORD10_ERASE_TIME_SHIFT		4
+#define BFPT_DWORD10_ERASE_TIME_COUNT_MASK	GENMASK(4, 0)
+
 #define BFPT_DWORD11_PAGE_SIZE_SHIFT		4
 #define BFPT_DWORD11_PAGE_SIZE_MASK		GENMASK(7, 4)
 
@@ -1812,6 +1939,19 @@ static const struct sfdp_bfpt_erase sfdp_bfpt_erases[] = {
 
 static int spi_nor_hwcaps_read2cmd(u32 hwcaps);
 
+/*
+ * Typical time of Erase Type @i from BFPT DWORD10: a 5-bit count plus one, in
+ * units of 1 ms, 16 ms, 128 ms or 1 s.
+ */
+static u32 spi_nor_bfpt_erase_time(u32 dword, int i)
+{
+	static const u16 units[] = { 1, 16, 128, 1000 };
+	u32 val = dword >> (BFPT_DWORD10_ERASE_TIME_SHIFT + 7 * i);
+
+	return ((val & BFPT_DWORD10_ERASE_TIME_COUNT_MASK) + 1) *
+		units[(val >> 5) & 0x3];
+}
+
 /**
  * spi_nor_parse_bfpt() - read and parse the Basic Flash Parameter Table.
  * @nor:		pointer to a 'struct spi_nor'
@@ -1920,6 +2060,23 @@ static int spi_nor_parse_bfpt(struct spi_nor *nor,
 		spi_nor_set_read_settings_from_bfpt(read, half, rd->proto);
 	}
 
+	/* All Erase Types, for spi_nor_erase() to choose from. */
+	for (i = 0; i < ARRAY_SIZE(sfdp_bfpt_erases); i++) {
+		const struct sfdp_bfpt_erase *er = &sfdp_bfpt_erases[i];
+		u32 time_ms = 0;
+
+		half = bfpt.dwords[er->dword] >> er->shift;
+		if (!(half & 0xff))
+			continue;
+
+		/* Typical erase times are only there since JESD216 rev A. */
+		if (bfpt_header->length >= BFPT_DWORD_MAX)
+			time_ms = spi_nor_bfpt_erase_time(bfpt.dwords[BFPT_DWORD(10)],
+							  i);
+		spi_nor_add_erase_type(nor, 1U << (half & 0xff),
+				       (half >> 8) & 0xff, time_ms);
+	}
+
 	/* Sector Erase settings. */
 	for (i = 0; i < ARRAY_SIZE(sfdp_bfpt_erases); i++) {
 		const struct sfdp_bfpt_erase *er = &sfdp_bfpt_erases[i];
@@ -2228,6 +2385,7 @@ static int spi_nor_init_params(struct spi_nor *nor,
 	/* Override the parameters with data read from SFDP tables. */
 	nor->addr_width = 0;
 	nor->mtd.erasesize = 0;
+	nor->num_erase_types = 0;
 	if ((info->flags & (SPI_NOR_DUAL_READ | SPI_NOR_QUAD_READ)) &&
 	    !(info->flags & SPI_NOR_SKIP_SFDP)) {
 		struct spi_nor_flash_parameter sfdp_params;
@@ -2236,6 +2394,7 @@ static int spi_nor_init_params(struct spi_nor *nor,
 		if (spi_nor_parse_sfdp(nor, &sfdp_params)) {
 			nor->addr_width = 0;
 			nor->mtd.erasesize = 0;
+			nor->num_erase_types = 0;
 		} else {
 			memcpy(params, &sfdp_params, sizeof(*params));
 		}
@@ -2370,9 +2529,57 @@ static int spi_nor_select_erase(struct spi_nor *nor,
 		nor->erase_opcode = SPINOR_OP_SE;
 		mtd->erasesize = info->sector_size;
 	}
+
+	/* Whole sectors can still go with a single erase */
+	spi_nor_add_erase_type(nor, info->sector_size, SPINOR_OP_SE, 0);
+
 	return 0;
 }
 
+/*
+ * Settle the erase commands spi_nor_erase() may use: the one chosen for
+ * mtd->erasesize, then larger ones in order of size. A larger command is
+ * dropped if SFDP says it is no quicker than the commands it stands in for.
+ */
+static void spi_nor_select_erase_types(struct spi_nor *nor)
+{
+	struct spi_nor_erase_type types[SNOR_ERASE_TYPE_MAX];
+	const struct spi_nor_erase_type *next, *prev;
+	struct mtd_info *mtd = &nor->mtd;
+	u32 floor;
+	int i, n;
+
+	types[0].size = mtd->erasesize;
+	types[0].time_ms = 0;
+	types[0].opcode = nor->erase_opcode;
+	for (i = 0; i < nor->num_erase_types; i++) {
+		if (nor->erase_types[i].size == mtd->erasesize)
+			types[0].time_ms = nor->erase_types[i].time_ms;
+	}
+
+	/* A driver's own erase hook only knows about erase_opcode */
+	floor = mtd->erasesize;
+	for (n = 1; !nor->erase && n < SNOR_ERASE_TYPE_MAX; floor = next->size) {
+		prev = &types[n - 1];
+		next = NULL;
+		for (i = 0; i < nor->num_erase_types; i++) {
+			if (nor->erase_types[i].size > floor &&
+			    (!next || nor->erase_types[i].size < next->size))
+				next = &nor->erase_types[i];
+		}
+		if (!next)
+			break;
+
+		if (next->time_ms && prev->time_ms &&
+		    next->time_ms >= prev->time_ms * (next->size / prev->size))
+			continue;
+		types[n++] = *next;
+	}
+
+	memcpy(nor->erase_types, types, n * sizeof(types[0]));
+	nor->num_erase_types = n;
+}
+
 static int spi_nor_setup(struct spi_nor *nor, const struct flash_info *info,
 			 const struct spi_nor_flash_parameter *params,
 			 const struct spi_nor_hwcaps *hwcaps)
@@ -2621,6 +2828,8 @@ int spi_nor_scan(struct spi_nor *nor)
 		return -EINVAL;
 	}
 
+	spi_nor_select_erase_types(nor);
+
 	/* Send all the required SPI flash commands to initialize device */
 	nor->info = info;
 	ret = spi_nor_init(nor);
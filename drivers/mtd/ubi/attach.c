@@ -832,7 +832,11 @@ static int scan_peb(struct ubi_device *ubi, struct ubi_attach_info *ai,
 		return 0;
 	}
 
+	ubi_io_prefetch_hdrs(ubi, pnum);
 	err = ubi_io_read_ec_hdr(ubi, pnum, ech, 0);
+	/* The prefetched VID header is only used along with a valid EC one */
+	if (err != 0 && err != UBI_IO_BITFLIPS)
+		ubi_io_drop_hdrs(ubi);
 	if (err < 0)
 		return err;
 	switch (err) {
@@ -1433,6 +1437,8 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 #else
 	err = scan_all(ubi, ai, 0);
 #endif
+	/* A scan which stopped early may leave headers behind */
+	ubi_io_drop_hdrs(ubi);
 	if (err)
 		goto out_ai;
 
@@ -1466,6 +1472,7 @@ int ubi_attach(struct ubi_device *ubi, int force_scan)
 		}
 
 		err = scan_all(ubi, scan_ai, 0);
+		ubi_io_drop_hdrs(ubi);
 		if (err) {
 			destroy_ai(scan_ai);
 			goto out_wl;
@@ -998,6 +998,12 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 	if (!ubi->peb_buf)
 		goto out_free;
 
+	ubi->hdrs_pnum = -1;
+	ubi->hdrs_buf = kmalloc(ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize,
+				GFP_KERNEL);
+	if (!ubi->hdrs_buf)
+		goto out_free;
+
 #ifdef CONFIG_MTD_UBI_FASTMAP
 	ubi->fm_size = ubi_calc_fm_size(ubi);
 	ubi->fm_buf = vzalloc(ubi->fm_size);
@@ -1017,6 +1023,19 @@ int ubi_attach_mtd_dev(struct mtd_info *mtd, int ubi_num,
 			goto out_detach;
 	}
 
+#ifdef CONFIG_MTD_UBI_FASTMAP
+	/*
+	 * The device had to be scanned. Write a fastmap now rather than at
+	 * detach time, which may never come before the OS takes over, so that
+	 * the next attach is fast.
+	 */
+	if (!ubi->fm && !ubi->fm_disabled && !ubi->ro_mode) {
+		err = ubi_update_fastmap(ubi);
+		if (err)
+			ubi_warn(ubi, "unable to write a fastmap: %d", err);
+	}
+#endif
+
 	err = uif_init(ubi, &ref);
 	if (err)
 		goto out_detach;
@@ -1082,6 +1101,7 @@ out_detach:
 	vfree(ubi->vtbl);
 out_free:
 	vfree(ubi->peb_buf);
+	kfree(ubi->hdrs_buf);
 	vfree(ubi->fm_buf);
 	if (ref)
 		put_device(&ubi->dev);
@@ -1161,6 +1181,7 @@ int ubi_detach_mtd_dev(int ubi_num, int anyway)
 	vfree(ubi->vtbl);
 	put_mtd_device(ubi->mtd);
 	vfree(ubi->peb_buf);
+	kfree(ubi->hdrs_buf);
 	vfree(ubi->fm_buf);
 	ubi_msg(ubi, "mtd%d is detached", ubi->mtd->index);
 	put_device(&ubi->dev);
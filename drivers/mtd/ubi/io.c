@@ -251,6 +251,9 @@ int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 	if (err)
 		return err;
 
+	if (ubi->hdrs_pnum == pnum)
+		ubi->hdrs_pnum = -1;
+
 	/* The area we are writing to has to contain all 0xFF bytes */
 	err = ubi_self_check_all_ff(ubi, pnum, offset, len);
 	if (err)
@@ -339,6 +342,9 @@ static int do_sync_erase(struct ubi_device *ubi, int pnum)
 		return -EROFS;
 	}
 
+	if (ubi->hdrs_pnum == pnum)
+		ubi->hdrs_pnum = -1;
+
 retry:
 	init_waitqueue_head(&wq);
 	memset(&ei, 0, sizeof(struct erase_info));
@@ -703,6 +709,63 @@ bad:
 	return 1;
 }
 
+/**
+ * ubi_io_prefetch_hdrs - read the EC and VID headers of a PEB at once.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock to read from
+ *
+ * This function reads the EC and VID headers of physical eraseblock @pnum with
+ * a single MTD read, so that the flash driver can fetch all the header pages
+ * in one go instead of one call per header. The next 'ubi_io_read_ec_hdr()'
+ * and 'ubi_io_read_vid_hdr()' for @pnum take their data from this read.
+ *
+ * Only a clean read is kept. On bit-flips or ECC errors the headers are read
+ * one by one as usual, so that the error is put down to the right header.
+ * The caller must drop the data with 'ubi_io_drop_hdrs()' if the VID header
+ * is not going to be read, e.g. because the EC header is not valid.
+ */
+void ubi_io_prefetch_hdrs(struct ubi_device *ubi, int pnum)
+{
+	int len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+	size_t read;
+	int err;
+
+	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
+
+	ubi->hdrs_pnum = -1;
+	/* Emulated bit-flips are left to the normal read path */
+	if (!ubi->hdrs_buf || ubi_dbg_is_bitflip(ubi))
+		return;
+
+	err = mtd_read(ubi->mtd, (loff_t)pnum * ubi->peb_size, len, &read,
+		       ubi->hdrs_buf);
+	if (!err && read == len)
+		ubi->hdrs_pnum = pnum;
+}
+
+/**
+ * ubi_io_drop_hdrs - drop the headers read by 'ubi_io_prefetch_hdrs()'.
+ * @ubi: UBI device description object
+ */
+void ubi_io_drop_hdrs(struct ubi_device *ubi)
+{
+	ubi->hdrs_pnum = -1;
+}
+
+/*
+ * Read a header from PEB @pnum, using the data read by ubi_io_prefetch_hdrs()
+ * if there is any for this PEB.
+ */
+static int read_hdr(struct ubi_device *ubi, void *buf, int pnum, int offset,
+		    int len)
+{
+	if (ubi->hdrs_pnum != pnum)
+		return ubi_io_read(ubi, buf, pnum, offset, len);
+
+	memcpy(buf, ubi->hdrs_buf + offset, len);
+	return 0;
+}
+
 /**
  * ubi_io_read_ec_hdr - read and check an erase counter header.
  * @ubi: UBI device description object
@@ -734,7 +797,7 @@ int ubi_io_read_ec_hdr(struct ubi_device *ubi, int pnum,
 	dbg_io("read EC header from PEB %d", pnum);
 	ubi_assert(pnum >= 0 && pnum < ubi->peb_count);
 
-	read_err = ubi_io_read(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
+	read_err = read_hdr(ubi, ec_hdr, pnum, 0, UBI_EC_HDR_SIZE);
 	if (read_err) {
 		if (read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 			return read_err;
@@ -1009,8 +1072,10 @@ int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 	ubi_assert(pnum >= 0 &&  pnum < ubi->peb_count);
 
 	p = (char *)vid_hdr - ubi->vid_hdr_shift;
-	read_err = ubi_io_read(ubi, p, pnum, ubi->vid_hdr_aloffset,
-			  ubi->vid_hdr_alsize);
+	read_err = read_hdr(ubi, p, pnum, ubi->vid_hdr_aloffset,
+			    ubi->vid_hdr_alsize);
+	/* The VID header is the last one needed from a prefetch */
+	ubi->hdrs_pnum = -1;
 	if (read_err && read_err != UBI_IO_BITFLIPS && !mtd_is_eccerr(read_err))
 		return read_err;
 
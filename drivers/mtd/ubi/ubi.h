@@ -526,6 +526,8 @@ struct ubi_debug_info {
  *
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
+ * @hdrs_buf: holds the EC and VID headers read by ubi_io_prefetch_hdrs()
+ * @hdrs_pnum: PEB whose headers are in @hdrs_buf, or %-1 if there are none
  * @ckvol_mutex: serializes static volume checking when opening
  *
  * @dbg: debugging information for this UBI device
@@ -626,6 +628,8 @@ struct ubi_device {
 	void *peb_buf;
 	struct mutex buf_mutex;
 	struct mutex ckvol_mutex;
+	void *hdrs_buf;
+	int hdrs_pnum;
 
 	struct ubi_debug_info dbg;
 };
@@ -896,6 +900,8 @@ int ubi_io_write_ec_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_ec_hdr *ec_hdr);
 int ubi_io_read_vid_hdr(struct ubi_device *ubi, int pnum,
 			struct ubi_vid_hdr *vid_hdr, int verbose);
+void ubi_io_prefetch_hdrs(struct ubi_device *ubi, int pnum);
+void ubi_io_drop_hdrs(struct ubi_device *ubi);
 int ubi_io_write_vid_hdr(struct ubi_device *ubi, int pnum,
 			 struct ubi_vid_hdr *vid_hdr);
 
@@ -107,6 +107,34 @@ static int sandbox_serial_putc(struct udevice *dev, const char ch)
 	return 0;
 }
 
+static ssize_t sandbox_serial_puts(struct udevice *dev, const char *s,
+				   size_t len)
+{
+	struct sandbox_serial_priv *priv = dev_get_priv(dev);
+	struct sandbox_serial_platdata *plat = dev->platdata;
+	const char *end, *top = s + len;
+
+	/* Write a line at a time, so that each one can start with colour */
+	while (s < top) {
+		if (!CONFIG_IS_ENABLED(OF_PLATDATA) && priv->start_of_line &&
+		    plat->colour != -1) {
+			priv->start_of_line = false;
+			output_ansi_colour(plat->colour);
+		}
+		end = memchr(s, '\n', top - s);
+		if (end) {
+			end++;
+			priv->start_of_line = true;
+		} else {
+			end = top;
+		}
+		os_write(1, s, end - s);
+		s = end;
+	}
+
+	return len;
+}
+
 static unsigned int increment_buffer_index(unsigned int index)
 {
 	return (index + 1) % ARRAY_SIZE(serial_buf);
@@ -242,6 +270,7 @@ static int sandbox_serial_ofdata_to_platdata(struct udevice *dev)
 
 static const struct dm_serial_ops sandbox_serial_ops = {
 	.putc = sandbox_serial_putc,
+	.puts = sandbox_serial_puts,
 	.pending = sandbox_serial_pending,
 	.getc = sandbox_serial_getc,
 	.getconfig = sandbox_serial_getconfig,
@@ -11,10 +11,12 @@
 #include <os.h>
 #include <serial.h>
 #include <stdio_dev.h>
+#include <time.h>
 #include <watchdog.h>
 #include <dm/lists.h>
 #include <dm/device-internal.h>
 #include <dm/of_access.h>
+#include <linux/compiler.h>
 #include <linux/delay.h>
 
 DECLARE_GLOBAL_DATA_PTR;
@@ -175,11 +177,156 @@ int serial_initialize(void)
 	return serial_init();
 }
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+#define TX_MASK		(CONFIG_SERIAL_TX_BUFFER_SIZE - 1)
+
+/*
+ * There is no TX interrupt, so the TX buffer is drained whenever the console
+ * is used, while waiting for input and from udelay(). Only the writer moves
+ * tx_head and only the drain moves tx_tail, so a drain which interrupts the
+ * writer (e.g. from a watchdog or timer handler) sees a consistent buffer.
+ */
+static void serial_tx_drain(struct udevice *dev)
+{
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+	uint head, tail, len;
+	ssize_t ret;
+
+	if (upriv->tx_busy)
+		return;
+	upriv->tx_busy = true;
+	barrier();
+	tail = upriv->tx_tail;
+	head = READ_ONCE(upriv->tx_head);
+	while (tail != head) {
+		/* Send as much as possible, up to the end of the buffer */
+		len = min_t(uint, head - tail,
+			    CONFIG_SERIAL_TX_BUFFER_SIZE - (tail & TX_MASK));
+		if (ops->puts) {
+			ret = ops->puts(dev, upriv->tx_buf + (tail & TX_MASK),
+					len);
+		} else {
+			ret = ops->putc(dev, upriv->tx_buf[tail & TX_MASK]);
+			if (!ret)
+				ret = 1;
+		}
+		if (ret == -EAGAIN)
+			break;
+		/* Drop the output if the UART cannot send it */
+		if (ret < 0)
+			ret = head - tail;
+		tail += ret;
+		barrier();
+		WRITE_ONCE(upriv->tx_tail, tail);
+	}
+	barrier();
+	upriv->tx_busy = false;
+}
+
+static void serial_tx_add(struct udevice *dev, char ch)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+	uint head = upriv->tx_head;
+
+	/* Wait for space, unless this interrupted a drain of this device */
+	while (head - READ_ONCE(upriv->tx_tail) >=
+	       CONFIG_SERIAL_TX_BUFFER_SIZE) {
+		if (upriv->tx_busy)
+			return;
+		serial_tx_drain(dev);
+		WATCHDOG_RESET();
+	}
+	upriv->tx_buf[head & TX_MASK] = ch;
+	barrier();
+	WRITE_ONCE(upriv->tx_head, head + 1);
+}
+
+/* Check if output to a device is buffered; it is not once it is removed */
+static bool serial_tx_buffered(struct udevice *dev)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	return upriv && upriv->tx_buf;
+}
+
+static bool serial_tx_put(struct udevice *dev, const char *str, size_t len)
+{
+	if (!serial_tx_buffered(dev))
+		return false;
+	while (len--) {
+		if (*str == '\n')
+			serial_tx_add(dev, '\r');
+		serial_tx_add(dev, *str++);
+	}
+	serial_tx_drain(dev);
+
+	return true;
+}
+
+static void serial_tx_poll(struct udevice *dev)
+{
+	if (serial_tx_buffered(dev))
+		serial_tx_drain(dev);
+}
+
+static void _serial_flush(struct udevice *dev)
+{
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+	ulong start;
+
+	while (upriv->tx_tail != upriv->tx_head && !upriv->tx_busy) {
+		serial_tx_drain(dev);
+		WATCHDOG_RESET();
+	}
+
+	/* Give the UART a little time to empty its FIFO */
+	if (ops->pending) {
+		start = get_timer(0);
+		while (ops->pending(dev, false) > 0 && get_timer(start) < 100)
+			;
+	}
+}
+
+void serial_poll(void)
+{
+	/* Only the console is polled, to keep this cheap */
+	if (gd->cur_serial_dev && (gd->flags & GD_FLG_RELOC))
+		serial_tx_poll(gd->cur_serial_dev);
+}
+
+void serial_flush(void)
+{
+	struct udevice *dev;
+	struct uclass *uc;
+
+	if (!gd->dm_root || uclass_get(UCLASS_SERIAL, &uc))
+		return;
+	uclass_foreach_dev(dev, uc) {
+		if (device_active(dev))
+			_serial_flush(dev);
+	}
+}
+#else
+static bool serial_tx_put(struct udevice *dev, const char *str, size_t len)
+{
+	return false;
+}
+
+static void serial_tx_poll(struct udevice *dev)
+{
+}
+#endif /* CONFIG_IS_ENABLED(SERIAL_TX_BUFFER) */
+
 static void _serial_putc(struct udevice *dev, char ch)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 	int err;
 
+	if (serial_tx_put(dev, &ch, 1))
+		return;
+
 	if (ch == '\n')
 		_serial_putc(dev, '\r');
 
@@ -188,10 +335,46 @@ static void _serial_putc(struct udevice *dev, char ch)
 	} while (err == -EAGAIN);
 }
 
+/* Send characters, waiting until the UART has accepted all of them */
+static void serial_send(struct udevice *dev, const char *str, size_t len)
+{
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	ssize_t ret;
+
+	while (len) {
+		ret = ops->puts(dev, str, len);
+		if (ret == -EAGAIN)
+			continue;
+		if (ret < 0)
+			return;
+		str += ret;
+		len -= ret;
+	}
+}
+
 static void _serial_puts(struct udevice *dev, const char *str)
 {
-	while (*str)
-		_serial_putc(dev, *str++);
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	size_t len;
+
+	if (serial_tx_put(dev, str, strlen(str)))
+		return;
+
+	if (!ops->puts) {
+		while (*str)
+			_serial_putc(dev, *str++);
+		return;
+	}
+
+	/* Send each line in one go, so that the FIFO is kept full */
+	while (*str) {
+		len = strchrnul(str, '\n') - str;
+		serial_send(dev, str, len);
+		if (!str[len])
+			break;
+		serial_send(dev, "\r\n", 2);
+		str += len + 1;
+	}
 }
 
 static int __serial_getc(struct udevice *dev)
@@ -201,8 +384,10 @@ static int __serial_getc(struct udevice *dev)
 
 	do {
 		err = ops->getc(dev);
-		if (err == -EAGAIN)
+		if (err == -EAGAIN) {
+			serial_tx_poll(dev);
 			WATCHDOG_RESET();
+		}
 	} while (err == -EAGAIN);
 
 	return err >= 0 ? err : 0;
@@ -212,6 +397,7 @@ static int __serial_tstc(struct udevice *dev)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 
+	serial_tx_poll(dev);
 	if (ops->pending)
 		return ops->pending(dev, true);
 
@@ -444,6 +630,8 @@ static int serial_post_probe(struct udevice *dev)
 		ops->getc += gd->reloc_off;
 	if (ops->putc)
 		ops->putc += gd->reloc_off;
+	if (ops->puts)
+		ops->puts += gd->reloc_off;
 	if (ops->pending)
 		ops->pending += gd->reloc_off;
 	if (ops->clear)
@@ -483,6 +671,10 @@ static int serial_post_probe(struct udevice *dev)
 	/* Allocate the RX buffer */
 	upriv->buf = malloc(CONFIG_SERIAL_RX_BUFFER_SIZE);
 #endif
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+	/* Allocate the TX buffer, leaving output unbuffered if this fails */
+	upriv->tx_buf = malloc(CONFIG_SERIAL_TX_BUFFER_SIZE);
+#endif
 
 	stdio_register_dev(&sdev, &upriv->sdev);
 #endif
@@ -497,6 +689,9 @@ static int serial_pre_remove(struct udevice *dev)
 	if (stdio_deregister_dev(upriv->sdev, true))
 		return -EPERM;
 #endif
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+	_serial_flush(dev);
+#endif
 
 	return 0;
 }
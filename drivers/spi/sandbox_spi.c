@@ -15,6 +15,7 @@
 #include <log.h>
 #include <malloc.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
 #include <os.h>
 
@@ -134,12 +135,49 @@ static int sandbox_spi_get_mmap(struct udevice *dev, ulong *map_basep,
 	return 0;
 }
 
+static int sandbox_spi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	return 0;
+}
+
+/*
+ * Act like a controller with a memory-mapped window: each read is a single
+ * operation of any length, with no max_read_size chunking. Like ti_qspi, the
+ * window does not reach the end of a larger flash.
+ */
+static ssize_t sandbox_spi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				       u64 offs, size_t len, void *buf)
+{
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int ret;
+
+	offs += desc->info.offset;
+	if (offs >= SANDBOX_SPI_DIRMAP_SIZE)
+		return -ENOTSUPP;
+	len = min_t(u64, len, SANDBOX_SPI_DIRMAP_SIZE - offs);
+
+	op.addr.val = offs;
+	op.data.buf.in = buf;
+	op.data.nbytes = len;
+	ret = spi_mem_exec_op(desc->slave, &op);
+	if (ret)
+		return ret;
+
+	return len;
+}
+
+static const struct spi_controller_mem_ops sandbox_spi_mem_ops = {
+	.dirmap_create	= sandbox_spi_dirmap_create,
+	.dirmap_read	= sandbox_spi_dirmap_read,
+};
+
 static const struct dm_spi_ops sandbox_spi_ops = {
 	.xfer		= sandbox_spi_xfer,
 	.set_speed	= sandbox_spi_set_speed,
 	.set_mode	= sandbox_spi_set_mode,
 	.cs_info	= sandbox_cs_info,
 	.get_mmap	= sandbox_spi_get_mmap,
+	.mem_ops	= &sandbox_spi_mem_ops,
 };
 
 static const struct udevice_id sandbox_spi_ids[] = {
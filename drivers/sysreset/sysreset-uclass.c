@@ -11,6 +11,7 @@
 #include <cpu_func.h>
 #include <hang.h>
 #include <log.h>
+#include <serial.h>
 #include <sysreset.h>
 #include <dm.h>
 #include <errno.h>
@@ -94,6 +95,7 @@ void sysreset_walk_halt(enum sysreset_t type)
 {
 	int ret;
 
+	serial_flush();
 	ret = sysreset_walk(type);
 
 	/* Wait for the reset to take effect */
@@ -991,6 +991,13 @@ static int do_write(struct fsg_common *common)
 
 static int do_synchronize_cache(struct fsg_common *common)
 {
+	struct fsg_lun	*curlun = &common->luns[common->lun];
+	struct ums	*ums_dev = &ums[common->lun];
+
+	/* We ignore the requested LBA and write out all cached data */
+	if (ums_dev->sync && ums_dev->sync(ums_dev))
+		curlun->sense_data = SS_WRITE_ERROR;
+
 	return 0;
 }
 
@@ -146,6 +146,7 @@ int env_import_redund(const char *buf1, int buf1_read_fail,
 		      int flags)
 {
 	int crc1_ok, crc2_ok;
+	enum env_valid newer;
 	env_t *ep, *tmp_env1, *tmp_env2;
 
 	tmp_env1 = (env_t *)buf1;
@@ -169,30 +170,41 @@ int env_import_redund(const char *buf1, int buf1_read_fail,
 		return env_import((char *)tmp_env2, 1, flags);
 	}
 
-	crc1_ok = crc32(0, tmp_env1->data, ENV_SIZE) ==
-			tmp_env1->crc;
-	crc2_ok = crc32(0, tmp_env2->data, ENV_SIZE) ==
-			tmp_env2->crc;
+	/*
+	 * Check the serial first: if the newer copy has a good CRC it is
+	 * used regardless of the older one, so there is no need to run the
+	 * CRC over the second copy as well.
+	 */
+	if (tmp_env1->flags == 255 && tmp_env2->flags == 0)
+		newer = ENV_REDUND;
+	else if (tmp_env2->flags == 255 && tmp_env1->flags == 0)
+		newer = ENV_VALID;
+	else if (tmp_env1->flags > tmp_env2->flags)
+		newer = ENV_VALID;
+	else if (tmp_env2->flags > tmp_env1->flags)
+		newer = ENV_REDUND;
+	else /* flags are equal - almost impossible */
+		newer = ENV_VALID;
+
+	if (newer == ENV_VALID) {
+		crc1_ok = crc32(0, tmp_env1->data, ENV_SIZE) ==
+				tmp_env1->crc;
+		crc2_ok = !crc1_ok && crc32(0, tmp_env2->data, ENV_SIZE) ==
+				tmp_env2->crc;
+	} else {
+		crc2_ok = crc32(0, tmp_env2->data, ENV_SIZE) ==
+				tmp_env2->crc;
+		crc1_ok = !crc2_ok && crc32(0, tmp_env1->data, ENV_SIZE) ==
+				tmp_env1->crc;
+	}
 
 	if (!crc1_ok && !crc2_ok) {
 		env_set_default("bad CRC", 0);
 		return -ENOMSG; /* needed for env_load() */
 	} else if (crc1_ok && !crc2_ok) {
 		gd->env_valid = ENV_VALID;
-	} else if (!crc1_ok && crc2_ok) {
-		gd->env_valid = ENV_REDUND;
 	} else {
-		/* both ok - check serial */
-		if (tmp_env1->flags == 255 && tmp_env2->flags == 0)
-			gd->env_valid = ENV_REDUND;
-		else if (tmp_env2->flags == 255 && tmp_env1->flags == 0)
-			gd->env_valid = ENV_VALID;
-		else if (tmp_env1->flags > tmp_env2->flags)
-			gd->env_valid = ENV_VALID;
-		else if (tmp_env2->flags > tmp_env1->flags)
-			gd->env_valid = ENV_REDUND;
-		else /* flags are equal - almost impossible */
-			gd->env_valid = ENV_VALID;
+		gd->env_valid = ENV_REDUND;
 	}
 
 	if (gd->env_valid == ENV_VALID)
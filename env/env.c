@@ -13,6 +13,27 @@
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/*
+ * Value of env_htab.changes when the environment was last loaded from or
+ * saved to gd->env_load_prio, zero if it was never in sync with storage
+ */
+static unsigned int env_synced_changes;
+
+static void env_set_synced(void)
+{
+	env_synced_changes = env_htab.changes;
+}
+
+static void env_clear_synced(void)
+{
+	env_synced_changes = 0;
+}
+
+static bool env_is_synced(void)
+{
+	return env_synced_changes && env_synced_changes == env_htab.changes;
+}
+
 #if defined(CONFIG_NEEDS_MANUAL_RELOC)
 void env_fix_drivers(void)
 {
@@ -202,6 +223,7 @@ int env_load(void)
 			gd->env_load_prio = prio;
 
 #if !CONFIG_IS_ENABLED(ENV_APPEND)
+			env_set_synced();
 			return 0;
 #endif
 		} else if (ret == -ENOMSG) {
@@ -228,6 +250,7 @@ int env_load(void)
 		best_prio = 0;
 
 	gd->env_load_prio = best_prio;
+	env_clear_synced();
 
 	return -ENODEV;
 }
@@ -253,8 +276,10 @@ int env_reload(void)
 		else
 			printf("OK\n");
 
-		if (!ret)
+		if (!ret) {
+			env_set_synced();
 			return 0;
+		}
 	}
 
 	return -ENODEV;
@@ -279,14 +304,22 @@ int env_save(void)
 			return -ENODEV;
 		}
 
+		if (IS_ENABLED(CONFIG_ENV_SAVE_SKIP_UNCHANGED) &&
+		    env_is_synced()) {
+			printf("unchanged, skipped\n");
+			return 0;
+		}
+
 		ret = drv->save();
 		if (ret)
 			printf("Failed (%d)\n", ret);
 		else
 			printf("OK\n");
 
-		if (!ret)
+		if (!ret) {
+			env_set_synced();
 			return 0;
+		}
 	}
 
 	return -ENODEV;
@@ -313,8 +346,10 @@ int env_erase(void)
 		else
 			printf("OK\n");
 
-		if (!ret)
+		if (!ret) {
+			env_clear_synced();
 			return 0;
+		}
 	}
 
 	return -ENODEV;
@@ -379,6 +414,7 @@ int env_select(const char *name)
 				gd->env_load_prio = prio;
 				gd->env_valid = ENV_INVALID;
 				gd->flags &= ~GD_FLG_ENV_DEFAULT;
+				env_clear_synced();
 			}
 			printf("OK\n");
 			return 0;
@@ -306,6 +306,15 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/*
+ * Position reached in the cluster chain of a file, so that a following read
+ * does not need to follow the chain from the first cluster again
+ */
+typedef struct {
+	loff_t pos;		/* offset in the file of the start of clust */
+	__u32 clust;		/* cluster, 0 if not known */
+} fat_cursor;
+
 /**
  * get_contents() - read from file
  *
@@ -315,14 +324,17 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
  *
  * @mydata:	file system description
  * @dentprt:	directory entry pointer
+ * @cursor:	if not NULL, cluster to start looking for 'pos' from if it is
+ *		not past 'pos', updated to the cluster holding 'pos'
  * @pos:	position from where to read
  * @buffer:	buffer into which to read
  * @maxsize:	maximum number of bytes to read
  * @gotsize:	number of bytes actually read
  * Return:	-1 on error, otherwise 0
  */
-static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
-			__u8 *buffer, loff_t maxsize, loff_t *gotsize)
+static int get_contents(fsdata *mydata, dir_entry *dentptr, fat_cursor *cursor,
+			loff_t pos, __u8 *buffer, loff_t maxsize,
+			loff_t *gotsize)
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
@@ -344,6 +356,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 	debug("%llu bytes\n", filesize);
 
 	actsize = bytesperclust;
+	if (cursor && cursor->clust && cursor->pos <= pos) {
+		curclust = cursor->clust;
+		actsize += cursor->pos;
+	}
 
 	/* go to cluster at pos */
 	while (actsize <= pos) {
@@ -358,6 +374,10 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	/* actsize > pos */
 	actsize -= bytesperclust;
+	if (cursor) {
+		cursor->pos = actsize;
+		cursor->clust = curclust;
+	}
 	filesize -= actsize;
 	pos -= actsize;
 
@@ -1218,7 +1238,8 @@ int file_fat_read_at(const char *filename, loff_t pos, void *buffer,
 	/* For saving default max clustersize memory allocated to malloc pool */
 	dir_entry *dentptr = itr->dent;
 
-	ret = get_contents(&fsdata, dentptr, pos, buffer, maxsize, actread);
+	ret = get_contents(&fsdata, dentptr, NULL, pos, buffer, maxsize,
+			   actread);
 
 out_free_both:
 	free(fsdata.fatbuf);
@@ -1316,6 +1337,72 @@ void fat_closedir(struct fs_dir_stream *dirs)
 	free(dir);
 }
 
+typedef struct {
+	struct fs_file parent;
+	fsdata fsdata;
+	dir_entry dent;
+	fat_cursor cursor;
+} fat_file;
+
+int fat_file_open(const char *filename, struct fs_file **filep)
+{
+	fat_file *file;
+	fat_itr *itr;
+	int ret;
+
+	file = calloc(1, sizeof(*file));
+	itr = malloc_cache_aligned(sizeof(fat_itr));
+	if (!file || !itr) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	ret = fat_itr_root(itr, &file->fsdata);
+	if (ret)
+		goto out;
+
+	ret = fat_itr_resolve(itr, filename, TYPE_FILE);
+	if (ret) {
+		free(file->fsdata.fatbuf);
+		goto out;
+	}
+
+	file->dent = *itr->dent;
+	file->parent.size = FAT2CPU32(file->dent.size);
+	*filep = &file->parent;
+	file = NULL;
+out:
+	free(itr);
+	free(file);
+	return ret;
+}
+
+int fat_file_read(struct fs_file *fsfile, void *buf, loff_t offset,
+		  loff_t len, loff_t *actread)
+{
+	fat_file *file = (fat_file *)fsfile;
+	int ret;
+
+	/* The FAT may have been written since the last read */
+	file->fsdata.fatbufnum = -1;
+
+	debug("reading %s at pos %llu\n", fsfile->name, offset);
+	ret = get_contents(&file->fsdata, &file->dent, &file->cursor, offset,
+			   buf, len, actread);
+	if (ret)
+		printf("** Unable to read file %s **\n", fsfile->name);
+
+	return ret;
+}
+
+void fat_file_close(struct fs_file *fsfile)
+{
+	fat_file *file = (fat_file *)fsfile;
+
+	free(file->fsdata.fatbuf);
+	free(file);
+}
+
 void fat_close(void)
 {
 }
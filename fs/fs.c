@@ -7,9 +7,11 @@
 #include <config.h>
 #include <errno.h>
 #include <common.h>
+#include <bootstage.h>
 #include <env.h>
 #include <lmb.h>
 #include <log.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <part.h>
 #include <ext4fs.h>
@@ -169,8 +171,23 @@ struct fstype_info {
 	int (*unlink)(const char *filename);
 	int (*mkdir)(const char *dirname);
 	int (*ln)(const char *filename, const char *target);
+	/*
+	 * Open a file for reading. On success return 0 and the file via
+	 * 'filep', with its size set. On error return -errno. Optional: if
+	 * not set, fs_file_open() and fs_file_read() use size() and read()
+	 * with the path of the file.
+	 */
+	int (*file_open)(const char *filename, struct fs_file **filep);
+	/* see fs_file_read(), called with the filesystem set up */
+	int (*file_read)(struct fs_file *file, void *buf, loff_t offset,
+			 loff_t len, loff_t *actread);
+	/* free a file returned by file_open() */
+	void (*file_close)(struct fs_file *file);
 };
 
+/* changed whenever a file or directory is written, so open files go stale */
+static ulong fs_write_gen;
+
 static struct fstype_info fstypes[] = {
 #ifdef CONFIG_FS_FAT
 	{
@@ -197,6 +214,9 @@ static struct fstype_info fstypes[] = {
 		.readdir = fat_readdir,
 		.closedir = fat_closedir,
 		.ln = fs_ln_unsupported,
+		.file_open = fat_file_open,
+		.file_read = fat_file_read,
+		.file_close = fat_file_close,
 	},
 #endif
 
@@ -505,11 +525,13 @@ static int fs_read_lmb_check(const char *filename, ulong addr, loff_t offset,
 	lmb_init_and_reserve(&lmb, gd->bd, (void *)gd->fdt_blob);
 	lmb_dump_all(&lmb);
 
-	if (lmb_alloc_addr(&lmb, addr, read_len) == addr)
+	ret = lmb_alloc_addr(&lmb, addr, read_len) == addr ? 0 : -ENOSPC;
+	lmb_uninit(&lmb);
+	if (!ret)
 		return 0;
 
 	printf("** Reading file would overwrite reserved memory **\n");
-	return -ENOSPC;
+	return ret;
 }
 #endif
 
@@ -518,6 +540,7 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 {
 	struct fstype_info *info = fs_get_info(fs_type);
 	void *buf;
+	int span;
 	int ret;
 
 #ifdef CONFIG_LMB
@@ -532,9 +555,11 @@ static int _fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 	 * We don't actually know how many bytes are being read, since len==0
 	 * means read the whole file.
 	 */
+	span = bootstage_span_start("fs read", 0);
 	buf = map_sysmem(addr, len);
 	ret = info->read(filename, buf, offset, len, actread);
 	unmap_sysmem(buf);
+	bootstage_span_end(span, ret ? 0 : *actread);
 
 	/* If we requested a specific number of bytes, check we got it */
 	if (ret == 0 && len && *actread != len)
@@ -557,6 +582,7 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	void *buf;
 	int ret;
 
+	fs_write_gen++;
 	buf = map_sysmem(addr, len);
 	ret = info->write(filename, buf, offset, len, actwrite);
 	unmap_sysmem(buf);
@@ -570,6 +596,99 @@ int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	return ret;
 }
 
+struct fs_file *fs_file_open(const char *filename)
+{
+	struct fstype_info *info = fs_get_info(fs_type);
+	struct fs_file *file = NULL;
+	int fstype = fs_type;
+	loff_t size;
+	int ret;
+
+	if (info->file_open) {
+		ret = info->file_open(filename, &file);
+	} else {
+		ret = info->size(filename, &size);
+		if (!ret) {
+			file = calloc(1, sizeof(*file));
+			if (file)
+				file->size = size;
+			else
+				ret = -ENOMEM;
+		}
+	}
+	fs_close();
+	if (ret) {
+		errno = ret < 0 ? -ret : EIO;
+		return NULL;
+	}
+
+	file->desc = fs_dev_desc;
+	file->part = fs_dev_part;
+	file->partition = fs_partition;
+	file->fstype = fstype;
+	file->write_gen = fs_write_gen;
+	file->name = strdup(filename);
+	if (!file->name) {
+		fs_file_close(file);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	return file;
+}
+
+int fs_file_read(struct fs_file *file, ulong addr, loff_t offset, loff_t len,
+		 loff_t *actread)
+{
+	struct fstype_info *info = fs_get_info(file->fstype);
+	void *buf;
+	int ret;
+
+	if (fs_file_changed(file))
+		return -ESTALE;
+
+	/*
+	 * Only the filesystem found when opening the file needs probing, and
+	 * the partition table does not need reading again
+	 */
+	fs_dev_desc = file->desc;
+	fs_dev_part = file->part;
+	fs_partition = file->partition;
+	if (info->probe(fs_dev_desc, &fs_partition))
+		return -EIO;
+	fs_type = file->fstype;
+
+	buf = map_sysmem(addr, len);
+	if (info->file_read)
+		ret = info->file_read(file, buf, offset, len, actread);
+	else
+		ret = info->read(file->name, buf, offset, len, actread);
+	unmap_sysmem(buf);
+	fs_close();
+
+	return ret;
+}
+
+bool fs_file_changed(struct fs_file *file)
+{
+	return file->write_gen != fs_write_gen;
+}
+
+void fs_file_close(struct fs_file *file)
+{
+	struct fstype_info *info;
+
+	if (!file)
+		return;
+
+	free(file->name);
+	info = fs_get_info(file->fstype);
+	if (info->file_close)
+		info->file_close(file);
+	else
+		free(file);
+}
+
 struct fs_dir_stream *fs_opendir(const char *filename)
 {
 	struct fstype_info *info = fs_get_info(fs_type);
@@ -628,6 +747,7 @@ int fs_unlink(const char *filename)
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	fs_write_gen++;
 	ret = info->unlink(filename);
 
 	fs_close();
@@ -641,6 +761,7 @@ int fs_mkdir(const char *dirname)
 
 	struct fstype_info *info = fs_get_info(fs_type);
 
+	fs_write_gen++;
 	ret = info->mkdir(dirname);
 
 	fs_close();
@@ -653,6 +774,7 @@ int fs_ln(const char *fname, const char *target)
 	struct fstype_info *info = fs_get_info(fs_type);
 	int ret;
 
+	fs_write_gen++;
 	ret = info->ln(fname, target);
 
 	if (ret < 0) {
@@ -2874,6 +2874,37 @@ void ubifs_tnc_close(struct ubifs_info *c)
 	destroy_old_idx(c);
 }
 
+#ifdef __UBOOT__
+/**
+ * ubifs_tnc_trim - drop the cached index if it has grown too big.
+ * @c: UBIFS file-system description object
+ * @max_znodes: maximum number of clean znodes to keep
+ *
+ * There is no memory shrinker in U-Boot, so the znodes read while looking up
+ * files stay in memory for as long as the volume is mounted. This lets later
+ * loads from the same volume skip reading the index again, but the TNC has to
+ * be kept bounded. This function frees the whole TNC if it holds more than
+ * @max_znodes clean znodes; it is then read from the flash again on demand.
+ * Nothing is freed while there are dirty znodes, as they only exist in memory.
+ */
+void ubifs_tnc_trim(struct ubifs_info *c, long max_znodes)
+{
+	long n;
+
+	mutex_lock(&c->tnc_mutex);
+	n = atomic_long_read(&c->clean_zn_cnt);
+	if (c->zroot.znode && n > max_znodes &&
+	    !atomic_long_read(&c->dirty_zn_cnt)) {
+		dbg_tnc("dropping %ld clean znodes", n);
+		ubifs_destroy_tnc_subtree(c->zroot.znode);
+		c->zroot.znode = NULL;
+		atomic_long_sub(n, &c->clean_zn_cnt);
+		atomic_long_sub(n, &ubifs_clean_zn_cnt);
+	}
+	mutex_unlock(&c->tnc_mutex);
+}
+#endif
+
 /**
  * left_znode - get the znode to the left.
  * @c: UBIFS file-system description object
@@ -671,23 +671,14 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
-static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+/* Decompress data node @dn of block @block into @addr */
+static int decompress_block(struct ubifs_info *c, struct inode *inode,
+			    void *addr, unsigned int block,
+			    struct ubifs_data_node *dn)
 {
-	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
-	union ubifs_key key;
 	unsigned int dlen;
 
-	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
-	if (err) {
-		if (err == -ENOENT)
-			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
-		return err;
-	}
-
 	ubifs_assert(le64_to_cpu(dn->ch.sqnum) > ubifs_inode(inode)->creat_sqnum);
 
 	len = le32_to_cpu(dn->size);
@@ -718,6 +709,74 @@ dump:
 	return -EINVAL;
 }
 
+static int read_block(struct inode *inode, void *addr, unsigned int block,
+		      struct ubifs_data_node *dn)
+{
+	struct ubifs_info *c = inode->i_sb->s_fs_info;
+	union ubifs_key key;
+	int err;
+
+	data_key_init(c, &key, inode->i_ino, block);
+	err = ubifs_tnc_lookup(c, &key, dn);
+	if (err) {
+		if (err == -ENOENT)
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+		return err;
+	}
+
+	return decompress_block(c, inode, addr, block, dn);
+}
+
+/*
+ * Read up to @max_blocks whole blocks starting at @block with one LEB read of
+ * the data nodes which follow each other on the flash, then decompress them
+ * into @addr. Returns the number of blocks filled in. On errors this is 0, and
+ * the blocks are read one by one instead, like Linux does.
+ */
+static int do_bulk_read(struct ubifs_info *c, struct inode *inode, void *addr,
+			unsigned int block, int max_blocks)
+{
+	struct bu_info *bu = &c->bu;
+	int err, i, nn = 0, offs = 0;
+
+	data_key_init(c, &bu->key, inode->i_ino, block);
+	bu->buf_len = c->max_bu_buf_len;
+	err = ubifs_tnc_get_bu_keys(c, bu);
+	if (err)
+		goto out_warn;
+	if (!bu->cnt)
+		return 0;
+
+	err = ubifs_tnc_bulk_read(c, bu);
+	if (err)
+		goto out_warn;
+
+	max_blocks = min(max_blocks, bu->blk_cnt);
+	for (i = 0; i < max_blocks; i++, addr += UBIFS_BLOCK_SIZE) {
+		struct ubifs_data_node *dn = bu->buf + offs;
+
+		if (nn >= bu->cnt ||
+		    key_block(c, &bu->zbranch[nn].key) != block + i) {
+			/* Not found, so it must be a hole */
+			memset(addr, 0, UBIFS_BLOCK_SIZE);
+			continue;
+		}
+
+		err = decompress_block(c, inode, addr, block + i, dn);
+		if (err)
+			goto out_warn;
+		offs += ALIGN(bu->zbranch[nn].len, 8);
+		nn++;
+	}
+
+	return max_blocks;
+
+out_warn:
+	ubifs_warn(c, "ignoring error %d and skipping bulk-read", err);
+	return 0;
+}
+
 static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		       struct page *page, int last_block_size)
 {
@@ -894,6 +953,19 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 		if (((i + 1) == count) && (size < inode->i_size))
 			last_block_size = size - (i * PAGE_SIZE);
 
+		/* The last block always goes through do_readpage() */
+		if (c->bulk_read && i + 1 < count) {
+			int n = do_bulk_read(c, inode, page.addr,
+					     page.index, count - 1 - i);
+
+			if (n > 0) {
+				i += n - 1;
+				page.addr += n * PAGE_SIZE;
+				page.index += n;
+				continue;
+			}
+		}
+
 		err = do_readpage(c, inode, &page, last_block_size);
 		if (err)
 			break;
@@ -912,6 +984,10 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 put_inode:
 	ubifs_iput(inode);
 
+	/* Keep the index nodes for the next load, up to a limit */
+	if (CONFIG_UBIFS_TNC_CACHE_MAX)
+		ubifs_tnc_trim(c, CONFIG_UBIFS_TNC_CACHE_MAX);
+
 out:
 	ubi_close_volume(c->ubi);
 	return err;
@@ -246,6 +246,38 @@ struct blk_ops {
 	unsigned long (*erase)(struct udevice *dev, lbaint_t start,
 			       lbaint_t blkcnt);
 
+	/**
+	 * discard() - tell the device that a section is no longer in use
+	 *
+	 * This is normally much faster than writing or erasing. The contents
+	 * of the blocks are undefined afterwards.
+	 *
+	 * @dev:	Device to update
+	 * @start:	Start block number to discard (0=first)
+	 * @blkcnt:	Number of blocks to discard
+	 * @return number of blocks discarded, or -ve error number (see the
+	 * IS_ERR_VALUE() macro
+	 */
+	unsigned long (*discard)(struct udevice *dev, lbaint_t start,
+				 lbaint_t blkcnt);
+
+	/**
+	 * write_zeroes() - make a section of a block device read as zero
+	 *
+	 * This should only be provided where it is faster than writing a
+	 * buffer of zeroes. It may fail (e.g. with -EOPNOTSUPP) when the
+	 * device cannot guarantee the result, in which case the caller should
+	 * write the zeroes itself.
+	 *
+	 * @dev:	Device to update
+	 * @start:	Start block number to zero (0=first)
+	 * @blkcnt:	Number of blocks to zero
+	 * @return number of blocks zeroed, or -ve error number (see the
+	 * IS_ERR_VALUE() macro
+	 */
+	unsigned long (*write_zeroes)(struct udevice *dev, lbaint_t start,
+				      lbaint_t blkcnt);
+
 	/**
 	 * select_hwpart() - select a particular hardware partition
 	 *
@@ -280,6 +312,10 @@ unsigned long blk_dwrite(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt, const void *buffer);
 unsigned long blk_derase(struct blk_desc *block_dev, lbaint_t start,
 			 lbaint_t blkcnt);
+unsigned long blk_ddiscard(struct blk_desc *block_dev, lbaint_t start,
+			   lbaint_t blkcnt);
+unsigned long blk_dwrite_zeroes(struct blk_desc *block_dev, lbaint_t start,
+				lbaint_t blkcnt);
 
 /**
  * blk_find_device() - Find a block device
@@ -466,6 +502,19 @@ static inline ulong blk_derase(struct blk_desc *block_dev, lbaint_t start,
 	return block_dev->block_erase(block_dev, start, blkcnt);
 }
 
+/* Legacy block devices do not support these, so callers must fall back */
+static inline ulong blk_ddiscard(struct blk_desc *block_dev, lbaint_t start,
+				 lbaint_t blkcnt)
+{
+	return -ENOSYS;
+}
+
+static inline ulong blk_dwrite_zeroes(struct blk_desc *block_dev,
+				      lbaint_t start, lbaint_t blkcnt)
+{
+	return -ENOSYS;
+}
+
 /**
  * struct blk_driver - Driver for block interface types
  *
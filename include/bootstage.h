@@ -15,6 +15,7 @@
 enum bootstage_flags {
 	BOOTSTAGEF_ERROR	= 1 << 0,	/* Error record */
 	BOOTSTAGEF_ALLOC	= 1 << 1,	/* Allocate an id */
+	BOOTSTAGEF_MERGE	= 1 << 2,	/* Merge with previous span */
 };
 
 /* bootstate sub-IDs used for kernel and ramdisk ranges */
@@ -313,6 +314,50 @@ uint32_t bootstage_accum(enum bootstage_id id);
 /* Print a report about boot time */
 void bootstage_report(void);
 
+/**
+ * bootstage_span_start() - Start a timed span of boot activity
+ *
+ * Spans are timed in timer ticks (see get_ticks()) and can be nested: a span
+ * started while another is open becomes its child, for example "mmc read"
+ * inside "fs read". Each span must be ended with bootstage_span_end().
+ *
+ * With BOOTSTAGEF_MERGE, a span which directly follows a span with the same
+ * name and parent is merged into it, to avoid filling the table with small
+ * repeated operations such as block reads.
+ *
+ * @name: Name of the span, which must remain valid until relocation
+ * @flags: Flags (BOOTSTAGEF_MERGE or 0)
+ * @return span number to pass to bootstage_span_end(), -ENOSPC if the span
+ *	table is full, -ENOMEM if it cannot be allocated, -EAGAIN before
+ *	relocation in U-Boot proper (where spans are not recorded), -ENOENT if
+ *	bootstage is not set up
+ */
+int bootstage_span_start(const char *name, int flags);
+
+/**
+ * bootstage_span_end() - End a timed span
+ *
+ * @span: Span number returned by bootstage_span_start(), ignored if -ve
+ * @bytes: Number of bytes processed during the span, or 0
+ */
+void bootstage_span_end(int span, ulong bytes);
+
+/**
+ * bootstage_export_trace() - Write the boot timeline as a Chrome trace
+ *
+ * This produces the trace-event JSON format used by chrome://tracing and
+ * Perfetto. Marks become instant events, spans become complete events with
+ * their byte counts, and accumulated times are listed in 'otherData'.
+ *
+ * Like snprintf(), this returns the length the trace would have, so it can
+ * be called with @size 0 to find the size of the buffer needed.
+ *
+ * @buf: Buffer to write to (may be NULL if @size is 0)
+ * @size: Size of buffer in bytes
+ * @return length of the trace in bytes, excluding the terminating nul
+ */
+int bootstage_export_trace(char *buf, int size);
+
 /**
  * Add bootstage information to the device tree
  *
@@ -358,6 +403,14 @@ int bootstage_get_size(void);
  */
 int bootstage_init(bool first);
 
+/**
+ * bootstage_uninit() - Free the bootstage data set up by bootstage_init()
+ *
+ * This must not be used once bootstage has been relocated. It is for tests
+ * which set up their own bootstage data.
+ */
+void bootstage_uninit(void);
+
 #else
 static inline ulong bootstage_add_record(enum bootstage_id id,
 		const char *name, int flags, ulong mark)
@@ -409,6 +462,15 @@ static inline uint32_t bootstage_accum(enum bootstage_id id)
 	return 0;
 }
 
+static inline int bootstage_span_start(const char *name, int flags)
+{
+	return 0;
+}
+
+static inline void bootstage_span_end(int span, ulong bytes)
+{
+}
+
 static inline int bootstage_stash(void *base, int size)
 {
 	return 0;	/* Pretend to succeed */
@@ -429,6 +491,10 @@ static inline int bootstage_init(bool first)
 	return 0;
 }
 
+static inline void bootstage_uninit(void)
+{
+}
+
 #endif /* ENABLE_BOOTSTAGE */
 
 /* Helper macro for adding a bootstage to a line of code */
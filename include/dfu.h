@@ -118,6 +118,8 @@ struct dfu_entity {
 	enum dfu_device_type    dev_type;
 	enum dfu_layout         layout;
 	unsigned long           max_buf_size;
+	/* writes may be split at multiples of this size, or 0 if not at all */
+	u32			write_unit;
 
 	union {
 		struct mmc_internal_data mmc;
@@ -155,6 +157,11 @@ struct dfu_entity {
 
 	u32 bad_skip;	/* for nand use */
 
+	/* statistics, in milliseconds */
+	ulong start_time;
+	ulong write_time;	/* writing to the medium */
+	ulong wait_time;	/* with the host waiting for the medium */
+
 	unsigned int inited:1;
 };
 
@@ -295,6 +302,29 @@ int dfu_init_env_entities(char *interface, char *devstr);
 unsigned char *dfu_get_buf(struct dfu_entity *dfu);
 unsigned char *dfu_free_buf(void);
 unsigned long dfu_get_buf_size(void);
+
+/**
+ * dfu_set_write_behind() - select whether full buffers are queued
+ *
+ * When enabled, dfu_write() queues each buffer as it fills up and goes on to
+ * fill the next one, up to CONFIG_DFU_WRITE_BUFFERS. The caller must then
+ * call dfu_write_pending() regularly. When disabled, anything queued is
+ * written out and each buffer is written as soon as it is full.
+ *
+ * @enable:	true to queue full buffers
+ */
+void dfu_set_write_behind(bool enable);
+
+/**
+ * dfu_write_pending() - write out some of the queued data
+ *
+ * This writes part of the oldest queued buffer to the medium, small enough
+ * that USB requests can be handled in between. Any error is also returned by
+ * the next call to dfu_write() or dfu_flush().
+ *
+ * Return:	0 if OK or nothing is queued, -ve on error
+ */
+int dfu_write_pending(void);
 bool dfu_usb_get_reset(void);
 
 #ifdef CONFIG_DFU_TIMEOUT
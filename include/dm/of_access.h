@@ -258,6 +258,23 @@ struct device_node *of_find_node_by_prop_value(struct device_node *from,
  */
 struct device_node *of_find_node_by_phandle(phandle handle);
 
+/**
+ * of_set_phandle_cache() - Set up a table for finding nodes by phandle
+ *
+ * Once this is set up, of_find_node_by_phandle() looks up phandles in the
+ * table while @root is the live tree in use, instead of searching the
+ * whole tree.
+ *
+ * The table must be dropped, by passing NULL for @cache, before the tree is
+ * freed or rebuilt, since a new tree may be put at the same address.
+ *
+ * @root:	Root node of the tree which the table belongs to
+ * @cache:	Table of nodes indexed by phandle, NULL for unused phandles
+ * @count:	Number of entries in @cache
+ */
+void of_set_phandle_cache(struct device_node *root,
+			  struct device_node **cache, uint count);
+
 /**
  * of_read_u32() - Find and read a 32-bit integer from a property
  *
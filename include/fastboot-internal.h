@@ -33,4 +33,14 @@ extern void (*fastboot_progress_callback)(const char *msg);
  */
 void fastboot_getvar(char *cmd_parameter, char *response);
 
+/**
+ * fastboot_data_max_size() - Get the largest download which can be accepted
+ *
+ * This is the size of the download buffer, unless downloads are being
+ * flashed as they arrive.
+ *
+ * Return: Number of bytes
+ */
+u32 fastboot_data_max_size(void);
+
 #endif
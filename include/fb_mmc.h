@@ -39,4 +39,37 @@ void fastboot_mmc_flash_write(const char *cmd, void *download_buffer,
  * @response: Pointer to fastboot response buffer
  */
 void fastboot_mmc_erase(const char *cmd, char *response);
+
+/**
+ * fastboot_mmc_stream_start() - Prepare to write an image as it arrives
+ *
+ * @cmd: Named partition to write image to
+ * @size: Size of the image in bytes
+ * @response: Pointer to fastboot response buffer, updated on error
+ * @return 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_start(const char *cmd, u32 size, char *response);
+
+/**
+ * fastboot_mmc_stream_write() - Write the next piece of a streamed image
+ *
+ * The image may be raw or sparse. Each piece except the last must be a
+ * whole number of blocks.
+ *
+ * @buf: Next piece of the image
+ * @len: Length of the piece in bytes
+ * @response: Pointer to fastboot response buffer, updated on error
+ * @return 0 if OK, -ve on error
+ */
+int fastboot_mmc_stream_write(const void *buf, u32 len, char *response);
+
+/**
+ * fastboot_mmc_stream_finish() - Finish writing a streamed image
+ *
+ * @ok: false if an earlier piece failed, so @response already holds the
+ *	reason
+ * @response: Pointer to fastboot response buffer
+ * @return 0 if the whole image was written, -ve on error
+ */
+int fastboot_mmc_stream_finish(bool ok, char *response);
 #endif
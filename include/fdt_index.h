@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Index of the properties of a flattened device tree
+ *
+ * fdt_getprop() walks the properties of a node and compares each name
+ * through the strings block. A driver reading many properties repeats that
+ * walk for each one. The index maps each distinct property name to one
+ * string offset, and each (node, name) pair to the property offset, so a
+ * lookup is a string hash plus a table probe.
+ *
+ * Edits made with fdt_rw.c move properties, so the index must then be
+ * rebuilt; see fdt_index_matches(). Edits in place keep it valid.
+ */
+
+#ifndef __FDT_INDEX_H
+#define __FDT_INDEX_H
+
+#include <linux/libfdt.h>
+
+/**
+ * struct fdt_index - property index of a flattened device tree
+ *
+ * @fdt: Tree which was indexed
+ * @move_count: Value of fdt_move_count when the tree was indexed
+ * @names: Hash table of string offsets, one per distinct property name,
+ *	-1 for an empty slot; NULL if the index could not be built
+ * @name_mask: Number of slots in @names, minus 1
+ * @props: Hash table of properties, keyed by node and name offset
+ * @prop_mask: Number of slots in @props, minus 1
+ */
+struct fdt_index {
+	const void *fdt;
+	ulong move_count;
+	int *names;
+	uint name_mask;
+	struct fdt_index_prop *props;
+	uint prop_mask;
+};
+
+/**
+ * fdt_index_init() - Build the property index of a tree
+ *
+ * If this fails, the index is still set up for @fdt, but lookups fall back
+ * to fdt_getprop().
+ *
+ * @idx: Index to set up
+ * @fdt: Tree to index
+ * @return 0 if OK, -FDT_ERR_NOSPACE if out of memory, other -FDT_ERR_... if
+ *	the tree is not valid
+ */
+int fdt_index_init(struct fdt_index *idx, const void *fdt);
+
+/**
+ * fdt_index_uninit() - Free the tables of an index
+ *
+ * @idx: Index to free
+ */
+void fdt_index_uninit(struct fdt_index *idx);
+
+/**
+ * fdt_index_matches() - Check whether an index can be used for a tree
+ *
+ * This checks that @idx was built for @fdt and that no tree has been edited
+ * with fdt_rw.c since, which may have moved properties.
+ *
+ * @idx: Index to check
+ * @fdt: Tree to check against
+ * @return true if @idx can be used to look up properties in @fdt
+ */
+static inline bool fdt_index_matches(const struct fdt_index *idx,
+				     const void *fdt)
+{
+	return idx->fdt == fdt && idx->move_count == fdt_move_count;
+}
+
+/**
+ * fdt_index_getprop() - Look up a property using the index
+ *
+ * This behaves like fdt_getprop() on the indexed tree, except that an
+ * invalid @nodeoffset gives -FDT_ERR_NOTFOUND. A property which has since
+ * been replaced by FDT_NOP tags is not found.
+ *
+ * @idx: Index of the tree
+ * @nodeoffset: Offset of the node
+ * @name: Name of the property
+ * @lenp: Returns the length of the property value, or -FDT_ERR_... if
+ *	not found (may be NULL)
+ * @return pointer to the property value, or NULL if not found
+ */
+const void *fdt_index_getprop(const struct fdt_index *idx, int nodeoffset,
+			      const char *name, int *lenp);
+
+#endif
@@ -0,0 +1,150 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Batched edits of a flattened device tree
+ *
+ * Each fdt_setprop(), fdt_add_subnode() or fdt_del_node() call on a
+ * flattened tree moves everything that follows the edited node. When a
+ * large number of fixups is made before booting an OS this adds up to
+ * many passes over the whole blob. A transaction collects the edits
+ * instead and applies them all in one sequential rebuild of the blob.
+ *
+ * A transaction only pays off within a fixup which makes many edits, such
+ * as fdt_fixup_ethernet() on a board with many interfaces. Up to eight
+ * edits are applied in place, one libfdt call each, which is no faster
+ * than direct edits and is not atomic either.
+ *
+ * The steps of image_setup_libfdt() are not joined into one transaction:
+ * board and arch fixups edit the blob directly and later steps look at
+ * what earlier ones wrote, which pending edits would not show.
+ */
+
+#ifndef __FDT_TXN_H
+#define __FDT_TXN_H
+
+#include <linux/list.h>
+#include <linux/libfdt.h>
+
+/*
+ * Nodes added in a transaction do not have an offset yet, so
+ * fdt_txn_add_subnode() returns a handle instead. Handles start at this
+ * value, which is larger than any offset in a real tree, and can be used
+ * wherever a node offset is expected by the fdt_txn_...() functions.
+ */
+#define FDT_TXN_HANDLE_BASE	0x40000000
+
+/**
+ * struct fdt_txn - a set of pending edits to a flattened device tree
+ *
+ * @fdt: Tree being edited; it is not touched until fdt_txn_commit()
+ * @nodes: List of struct fdt_txn_node, one per edited or added node
+ * @next_handle: Handle to give to the next added node
+ * @edits: Number of edits recorded so far
+ */
+struct fdt_txn {
+	void *fdt;
+	struct list_head nodes;
+	int next_handle;
+	int edits;
+};
+
+/**
+ * fdt_txn_init() - Start a new transaction
+ *
+ * While the transaction is open the tree itself is left as it is, so
+ * node offsets obtained with the normal libfdt functions stay valid and
+ * reads see the tree as it was before the transaction started.
+ *
+ * @txn: Transaction to set up
+ * @fdt: Tree to edit, which must be writable (version 17)
+ */
+void fdt_txn_init(struct fdt_txn *txn, void *fdt);
+
+/**
+ * fdt_txn_setprop() - Record setting the value of a property
+ *
+ * @txn: Transaction
+ * @node: Offset of an existing node, or handle of an added node
+ * @name: Name of the property
+ * @val: Value of the property (copied)
+ * @len: Length of @val in bytes
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_txn_setprop(struct fdt_txn *txn, int node, const char *name,
+		    const void *val, int len);
+
+static inline int fdt_txn_setprop_u32(struct fdt_txn *txn, int node,
+				      const char *name, uint32_t val)
+{
+	fdt32_t tmp = cpu_to_fdt32(val);
+
+	return fdt_txn_setprop(txn, node, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_txn_setprop_u64(struct fdt_txn *txn, int node,
+				      const char *name, uint64_t val)
+{
+	fdt64_t tmp = cpu_to_fdt64(val);
+
+	return fdt_txn_setprop(txn, node, name, &tmp, sizeof(tmp));
+}
+
+static inline int fdt_txn_setprop_string(struct fdt_txn *txn, int node,
+					 const char *name, const char *str)
+{
+	return fdt_txn_setprop(txn, node, name, str, strlen(str) + 1);
+}
+
+/**
+ * fdt_txn_delprop() - Record deleting a property
+ *
+ * Deleting a property which does not exist is not an error.
+ *
+ * @txn: Transaction
+ * @node: Offset of an existing node, or handle of an added node
+ * @name: Name of the property
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_txn_delprop(struct fdt_txn *txn, int node, const char *name);
+
+/**
+ * fdt_txn_add_subnode() - Record adding a new node
+ *
+ * @txn: Transaction
+ * @parent: Offset of an existing node, or handle of an added node
+ * @name: Name of the new node
+ * @return handle of the new node (>= FDT_TXN_HANDLE_BASE) if OK,
+ *	-FDT_ERR_EXISTS if @parent already has a subnode called @name,
+ *	other -FDT_ERR_... on error
+ */
+int fdt_txn_add_subnode(struct fdt_txn *txn, int parent, const char *name);
+
+/**
+ * fdt_txn_del_node() - Record deleting a node and all its subnodes
+ *
+ * @txn: Transaction
+ * @node: Offset of an existing node, or handle of an added node
+ * @return 0 if OK, -FDT_ERR_... on error
+ */
+int fdt_txn_del_node(struct fdt_txn *txn, int node);
+
+/**
+ * fdt_txn_commit() - Apply all recorded edits to the tree
+ *
+ * The tree keeps its total size; the edits must fit in the free space it
+ * has. The transaction is released whether or not this succeeds, and all
+ * node offsets into the tree are invalid afterwards.
+ *
+ * @txn: Transaction
+ * @return 0 if OK, -FDT_ERR_NOSPACE if the tree is too small for the
+ *	edits, other -FDT_ERR_... on error
+ */
+int fdt_txn_commit(struct fdt_txn *txn);
+
+/**
+ * fdt_txn_abort() - Drop all recorded edits, leaving the tree as it is
+ *
+ * @txn: Transaction
+ */
+void fdt_txn_abort(struct fdt_txn *txn);
+
+#endif
@@ -6,6 +6,7 @@
 #define _FS_H
 
 #include <common.h>
+#include <part.h>
 
 struct cmd_tbl;
 
@@ -152,6 +153,76 @@ int fs_read(const char *filename, ulong addr, loff_t offset, loff_t len,
 int fs_write(const char *filename, ulong addr, loff_t offset, loff_t len,
 	     loff_t *actwrite);
 
+/*
+ * An open file, returned by fs_file_open(). Apart from @size, it should be
+ * treated as opaque to the user of fs layer.
+ */
+struct fs_file {
+	loff_t size;		/* size in bytes when opened */
+	/* private to fs. layer: */
+	struct blk_desc *desc;
+	int part;
+	struct disk_partition partition;
+	int fstype;
+	ulong write_gen;
+	char *name;
+};
+
+/**
+ * fs_file_open() - open a file for reading
+ *
+ * This opens a file on the partition previously set by fs_set_blk_dev(), so
+ * that it can be read repeatedly with fs_file_read() without setting up the
+ * device or looking up the path again. Filesystems which support this keep
+ * the state needed to find the file's data in the returned object, e.g. its
+ * first cluster and the last position read. Others fall back to fs_read()
+ * with the path.
+ *
+ * The open file goes stale when anything is written through the fs layer,
+ * since its size and the location of its data may change; see
+ * fs_file_changed().
+ *
+ * @filename:	full path of the file to open
+ * Return:	open file, or NULL on error with errno set appropriately
+ */
+struct fs_file *fs_file_open(const char *filename);
+
+/**
+ * fs_file_read() - read from an open file
+ *
+ * This does not depend on the device set by fs_set_blk_dev() and leaves
+ * no device set afterwards, like fs_read().
+ *
+ * @file:	file opened by fs_file_open()
+ * @addr:	address of the buffer to write to
+ * @offset:	offset in the file from where to start reading
+ * @len:	the number of bytes to read. Use 0 to read entire file.
+ * @actread:	returns the actual number of bytes read
+ * Return:	0 if OK with valid *actread, -ESTALE if the file has gone stale,
+ *		other -ve value on error
+ */
+int fs_file_read(struct fs_file *file, ulong addr, loff_t offset, loff_t len,
+		 loff_t *actread);
+
+/**
+ * fs_file_changed() - check whether an open file has gone stale
+ *
+ * Anything written with fs_write(), fs_unlink(), fs_mkdir() or fs_ln() since
+ * the file was opened makes it stale. It must then be closed and opened
+ * again to be read.
+ *
+ * @file:	file opened by fs_file_open()
+ * Return:	true if the file is stale
+ */
+bool fs_file_changed(struct fs_file *file);
+
+/**
+ * fs_file_close() - close an open file
+ *
+ * @file:	file opened by fs_file_open(), or NULL
+ */
+void fs_file_close(struct fs_file *file);
+
 /*
  * Directory entry types, matches the subset of DT_x in posix readdir()
  * which apply to u-boot.
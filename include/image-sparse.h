@@ -23,9 +23,74 @@ struct sparse_storage {
 				 lbaint_t blk,
 				 lbaint_t blkcnt);
 
+	/*
+	 * Optional: make blocks read as zero without sending any data.
+	 * Returns the number of blocks zeroed; any not done are written.
+	 */
+	lbaint_t	(*write_zeroes)(struct sparse_storage *info,
+					lbaint_t blk,
+					lbaint_t blkcnt);
+
 	void		(*mssg)(const char *str, char *response);
 };
 
+enum sparse_stream_state {
+	SPARSE_STREAM_HEADER,
+	SPARSE_STREAM_CHUNK,
+	SPARSE_STREAM_RAW,
+	SPARSE_STREAM_FILL,
+	SPARSE_STREAM_DONE,
+	SPARSE_STREAM_ERROR,
+};
+
+/**
+ * struct sparse_stream - state of a sparse image written as it arrives
+ *
+ * The image can be passed in pieces of any size; headers and blocks split
+ * between pieces are put back together.
+ *
+ * @info: Storage being written
+ * @part_name: Name of the partition, for messages
+ * @state: What the next bytes of the image hold
+ * @header: Image header
+ * @chunk: Header of the current chunk
+ * @got: Number of bytes of the current header collected so far
+ * @skip: Number of bytes to skip before the next item
+ * @chunks_left: Number of chunks not yet started, including this one
+ * @raw_left: Number of bytes of raw data left in the current chunk
+ * @blk: Next block to write
+ * @bytes_written: Number of bytes written so far
+ * @total_blocks: Number of image blocks done so far
+ * @carry: Buffer for a block of raw data split between pieces
+ * @carry_len: Number of bytes in @carry
+ * @fill_val: Value for the current FILL chunk
+ * @fill_buf: Buffer for FILL chunks, or NULL if not allocated yet
+ * @fill_buf_num_blks: Size of @fill_buf in blocks
+ * @fill_buf_val: Value @fill_buf holds
+ * @fill_buf_set: true if @fill_buf_val is valid
+ */
+struct sparse_stream {
+	struct sparse_storage *info;
+	const char *part_name;
+	enum sparse_stream_state state;
+	sparse_header_t header;
+	chunk_header_t chunk;
+	uint got;
+	uint32_t skip;
+	uint32_t chunks_left;
+	uint32_t raw_left;
+	lbaint_t blk;
+	uint32_t bytes_written;
+	uint32_t total_blocks;
+	char *carry;
+	uint carry_len;
+	uint32_t fill_val;
+	uint32_t *fill_buf;
+	int fill_buf_num_blks;
+	uint32_t fill_buf_val;
+	bool fill_buf_set;
+};
+
 static inline int is_sparse_image(void *buf)
 {
 	sparse_header_t *s_header = (sparse_header_t *)buf;
@@ -39,3 +104,38 @@ static inline int is_sparse_image(void *buf)
 
 int write_sparse_image(struct sparse_storage *info, const char *part_name,
 		       void *data, char *response);
+
+/**
+ * sparse_stream_start() - Start writing a sparse image in pieces
+ *
+ * @ss: Stream state to set up
+ * @info: Storage to write to
+ * @part_name: Name of the partition, for messages
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info,
+			const char *part_name);
+
+/**
+ * sparse_stream_write() - Write the next piece of a sparse image
+ *
+ * @ss: Stream state
+ * @buf: Next piece of the image
+ * @len: Length of the piece in bytes
+ * @response: Response buffer for info->mssg()
+ * @return 0 if OK, -1 on error (after which the rest is ignored)
+ */
+int sparse_stream_write(struct sparse_stream *ss, const void *buf, size_t len,
+			char *response);
+
+/**
+ * sparse_stream_finish() - Finish writing a sparse image
+ *
+ * This must be called after sparse_stream_start(), even after an error, to
+ * free the buffers.
+ *
+ * @ss: Stream state
+ * @response: Response buffer for info->mssg()
+ * @return 0 if the whole image was written, -1 otherwise
+ */
+int sparse_stream_finish(struct sparse_stream *ss, char *response);
@@ -9,5 +9,6 @@
 
 /* U-Boot local hacks */
 extern struct fdt_header *working_fdt;  /* Pointer to the working fdt */
+extern ulong fdt_move_count;	/* Number of edits which moved tree data */
 
 #endif /* _INCLUDE_LIBFDT_H_ */
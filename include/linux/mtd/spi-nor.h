@@ -231,6 +231,20 @@ static inline u8 spi_nor_get_protocol_width(enum spi_nor_protocol proto)
 }
 
 #define SPI_NOR_MAX_CMD_SIZE	8
+#define SNOR_ERASE_TYPE_MAX	4
+
+/**
+ * struct spi_nor_erase_type - an erase command supported by the flash
+ * @size:	number of bytes erased by the command, a power of two
+ * @time_ms:	typical time taken by the command, 0 if not known
+ * @opcode:	the erase opcode
+ */
+struct spi_nor_erase_type {
+	u32	size;
+	u32	time_ms;
+	u8	opcode;
+};
+
 enum spi_nor_ops {
 	SPI_NOR_OPS_READ = 0,
 	SPI_NOR_OPS_WRITE,
@@ -255,6 +269,8 @@ enum spi_nor_option_flags {
  */
 struct flash_info;
 
+struct spi_mem_dirmap_desc;
+
 /*
  * TODO: Remove, once all users of spi_flash interface are moved to MTD
  *
@@ -274,6 +290,9 @@ struct flash_info;
  * @page_size:		the page size of the SPI NOR
  * @addr_width:		number of address bytes
  * @erase_opcode:	the opcode for erasing a sector
+ * @erase_types:	the erase commands usable by spi_nor_erase(), smallest
+ *			first; the first matches @erase_opcode
+ * @num_erase_types:	number of entries in @erase_types
  * @read_opcode:	the read opcode
  * @read_dummy:		the dummy needed by the read operation
  * @program_opcode:	the program opcode
@@ -302,6 +321,7 @@ struct flash_info;
  * @flash_is_locked:	[FLASH-SPECIFIC] check if a region of the SPI NOR is
  * @quad_enable:	[FLASH-SPECIFIC] enables SPI NOR quad mode
  *			completely locked
+ * @dirmap_rdesc:	direct mapping used for reads, or NULL
  * @priv:		the private data
  */
 struct spi_nor {
@@ -313,6 +333,8 @@ struct spi_nor {
 	u32			page_size;
 	u8			addr_width;
 	u8			erase_opcode;
+	struct spi_nor_erase_type erase_types[SNOR_ERASE_TYPE_MAX];
+	u8			num_erase_types;
 	u8			read_opcode;
 	u8			read_dummy;
 	u8			program_opcode;
@@ -344,6 +366,7 @@ struct spi_nor {
 	int (*flash_is_locked)(struct spi_nor *nor, loff_t ofs, uint64_t len);
 	int (*quad_enable)(struct spi_nor *nor);
 
+	struct spi_mem_dirmap_desc *dirmap_rdesc;
 	void *priv;
 /* Compatibility for spi_flash, remove once sf layer is merged with mtd */
 	const char *name;
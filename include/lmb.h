@@ -12,17 +12,35 @@
  * Copyright (C) 2001 Peter Bergner, IBM Corp.
  */
 
-#define MAX_LMB_REGIONS 8
+/*
+ * Number of regions held in struct lmb_region itself. Further regions are
+ * allocated with malloc(), see lmb_uninit().
+ */
+#define LMB_INIT_REGIONS 8
+
+/* Value of max_addr to allocate anywhere in memory */
+#define LMB_ALLOC_ANYWHERE	0
 
 struct lmb_property {
 	phys_addr_t base;
 	phys_size_t size;
 };
 
+/**
+ * struct lmb_region - set of regions, sorted by address
+ *
+ * @cnt: Number of regions
+ * @max: Number of regions which fit in @region
+ * @size: Not maintained, always 0
+ * @region: Regions, either @init_region or an allocated array
+ * @init_region: Space for the first regions
+ */
 struct lmb_region {
 	unsigned long cnt;
+	unsigned long max;
 	phys_size_t size;
-	struct lmb_property region[MAX_LMB_REGIONS+1];
+	struct lmb_property *region;
+	struct lmb_property init_region[LMB_INIT_REGIONS];
 };
 
 struct lmb {
@@ -30,7 +48,29 @@ struct lmb {
 	struct lmb_region reserved;
 };
 
+/**
+ * enum lmb_alloc_policy - how to choose among the free ranges which fit
+ *
+ * @LMB_ALLOC_TOP_DOWN: Use the highest free address, like lmb_alloc()
+ * @LMB_ALLOC_BEST_FIT: Use the top of the smallest free range which fits,
+ *	which keeps large ranges for large allocations
+ */
+enum lmb_alloc_policy {
+	LMB_ALLOC_TOP_DOWN,
+	LMB_ALLOC_BEST_FIT,
+};
+
 extern void lmb_init(struct lmb *lmb);
+
+/**
+ * lmb_uninit() - free the memory allocated for the regions of an lmb
+ *
+ * This is only needed once more than LMB_INIT_REGIONS memory or reserved
+ * regions have been added. The lmb may be set up again with lmb_init().
+ *
+ * @lmb: lmb set up by lmb_init(), or zeroed
+ */
+void lmb_uninit(struct lmb *lmb);
 extern void lmb_init_and_reserve(struct lmb *lmb, struct bd_info *bd,
 				 void *fdt_blob);
 extern void lmb_init_and_reserve_range(struct lmb *lmb, phys_addr_t base,
@@ -42,6 +82,22 @@ extern phys_addr_t lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align
 			    phys_addr_t max_addr);
 extern phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align,
 			      phys_addr_t max_addr);
+
+/**
+ * lmb_alloc_policy() - allocate memory
+ *
+ * @lmb: lmb to allocate from
+ * @size: Number of bytes to allocate
+ * @align: Alignment of the allocation, a power of two
+ * @max_addr: End of the allocated memory must be at or below this address,
+ *	or LMB_ALLOC_ANYWHERE
+ * @policy: How to choose where to allocate
+ * @return start of the allocated memory, 0 if there is no free memory which
+ *	fits
+ */
+phys_addr_t lmb_alloc_policy(struct lmb *lmb, phys_size_t size, ulong align,
+			     phys_addr_t max_addr,
+			     enum lmb_alloc_policy policy);
 extern phys_addr_t lmb_alloc_addr(struct lmb *lmb, phys_addr_t base,
 				  phys_size_t size);
 extern phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr);
@@ -460,6 +460,94 @@ static inline int log_init(void)
 }
 #endif
 
+/**
+ * struct log_ring_stats - statistics for the log ring
+ *
+ * @size: Size of the ring in bytes
+ * @used: Number of bytes used by records
+ * @count: Number of records in the ring
+ * @added: Total number of records added to the ring
+ * @dropped: Number of records dropped to make space for newer ones
+ * @text: Number of records which had to be formatted when added, e.g.
+ *	because they use a %p extension
+ */
+struct log_ring_stats {
+	int size;
+	int used;
+	ulong count;
+	ulong added;
+	ulong dropped;
+	ulong text;
+};
+
+/**
+ * log_ring_init() - Set up the log ring
+ *
+ * The ring holds log records in binary form, so that they can be kept
+ * cheaply and formatted later. This is called by log_init() once U-Boot has
+ * relocated.
+ *
+ * @size: Size of the ring in bytes
+ * @return 0 if OK, -ENOMEM if out of memory
+ */
+int log_ring_init(int size);
+
+/**
+ * log_ring_add() - Add a log record to the log ring
+ *
+ * The arguments are copied according to the format string, including the
+ * contents of any strings, but are not formatted. If the ring is full, the
+ * oldest records are dropped to make space.
+ *
+ * @rec: Log record to add (the message is not used)
+ * @fmt: printf() format string for the message
+ * @args: Arguments for @fmt
+ */
+void log_ring_add(struct log_rec *rec, const char *fmt, va_list args);
+
+/**
+ * log_ring_format() - Format the records in the log ring as text
+ *
+ * Each record is written on its own line, oldest first, as:
+ *
+ *    <level>[seconds.microseconds] func() message
+ *
+ * @buf: Buffer for the text, or NULL to find the size needed
+ * @size: Size of @buf in bytes
+ * @return length of the text, not including the terminator. This is more
+ *	than @size - 1 if the text was truncated
+ */
+int log_ring_format(char *buf, int size);
+
+/**
+ * log_ring_show() - Print the records in the log ring on the console
+ */
+void log_ring_show(void);
+
+/**
+ * log_ring_clear() - Remove all records from the log ring
+ */
+void log_ring_clear(void);
+
+/**
+ * log_ring_get_stats() - Get statistics for the log ring
+ *
+ * @stats: Returns the statistics
+ * @return 0 if OK, -ENOENT if there is no log ring
+ */
+int log_ring_get_stats(struct log_ring_stats *stats);
+
+/**
+ * log_ring_export() - Add the log ring to the bloblist as text
+ *
+ * This formats the records and adds them to the bloblist with the tag
+ * BLOBLISTT_LOG_TEXT, so that they can be passed to the OS.
+ *
+ * @return 0 if OK, -ENOENT if there is no log ring, -ENOSYS if there is no
+ *	bloblist, other -ve value on error
+ */
+int log_ring_export(void);
+
 /**
  * log_get_default_format() - get default log format
  *
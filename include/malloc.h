@@ -935,6 +935,16 @@ int initf_malloc(void);
 void *malloc_simple(size_t size);
 void *memalign_simple(size_t alignment, size_t bytes);
 
+/**
+ * free_simple() - Free memory allocated by malloc_simple()
+ *
+ * Only the most recent allocation can actually be freed, which is enough for
+ * the common pattern of a temporary buffer. Other calls have no effect.
+ *
+ * @ptr: Pointer to free
+ */
+void free_simple(void *ptr);
+
 #pragma GCC visibility push(hidden)
 # if __STD_C
 
@@ -978,6 +988,168 @@ extern ulong mem_malloc_brk;
 
 void mem_malloc_init(ulong start, ulong size);
 
+/* Number of chunk-size buckets in struct malloc_info */
+#define MALLOC_HIST_BUCKETS	20
+
+/**
+ * struct malloc_info - statistics about the heap after relocation
+ *
+ * Sizes are of chunks, so they include the allocator's overhead. Bucket n of
+ * the histograms holds chunks of up to 16 << n bytes, except that the last
+ * bucket holds all larger chunks.
+ *
+ * @heap_size: Size of the heap in bytes
+ * @live_bytes: Total size of the blocks currently allocated
+ * @live_count: Number of blocks currently allocated
+ * @peak_bytes: Highest value seen for @live_bytes
+ * @mallocs: Number of successful malloc(), calloc() and memalign() calls
+ * @frees: Number of free() calls, not counting free(NULL)
+ * @reallocs: Number of successful realloc() calls
+ * @failures: Number of allocations which failed
+ * @class_hits: Number of allocations taken from a size class
+ * @class_bytes: Total size of the freed blocks held in size classes
+ * @allocs: Number of blocks allocated in each bucket
+ * @live: Number of blocks currently allocated in each bucket
+ */
+struct malloc_info {
+	ulong heap_size;
+	ulong live_bytes;
+	ulong live_count;
+	ulong peak_bytes;
+	ulong mallocs;
+	ulong frees;
+	ulong reallocs;
+	ulong failures;
+	ulong class_hits;
+	ulong class_bytes;
+	ulong allocs[MALLOC_HIST_BUCKETS];
+	ulong live[MALLOC_HIST_BUCKETS];
+};
+
+/**
+ * malloc_get_info() - Get statistics about the heap
+ *
+ * This requires CONFIG_SYS_MALLOC_STATS
+ *
+ * @info: Returns the statistics
+ */
+void malloc_get_info(struct malloc_info *info);
+
+/**
+ * enum malloc_phase - boot phases for which heap use is tracked
+ *
+ * @MALLOC_PHASE_BOARD_F: Before relocation
+ * @MALLOC_PHASE_BOARD_R: After relocation, once the full heap is set up
+ * @MALLOC_PHASE_BOOTM: From the start of the bootm command
+ * @MALLOC_PHASE_COUNT: Number of phases
+ */
+enum malloc_phase {
+	MALLOC_PHASE_BOARD_F,
+	MALLOC_PHASE_BOARD_R,
+	MALLOC_PHASE_BOOTM,
+
+	MALLOC_PHASE_COUNT,
+};
+
+/**
+ * struct malloc_track_info - information about a tracked allocation
+ *
+ * @caller: Return address of the call which made the allocation
+ * @size: Number of bytes requested
+ * @age: Number of allocations made since this one
+ * @phase: Boot phase in which the allocation was made
+ */
+struct malloc_track_info {
+	void *caller;
+	size_t size;
+	ulong age;
+	enum malloc_phase phase;
+};
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_TRACK)
+/**
+ * malloc_track_alloc() - Record an allocation
+ *
+ * @ptr: Address of the new block, or NULL if the allocation failed
+ * @size: Number of bytes requested
+ * @caller: Return address of the call to malloc(), etc.
+ */
+void malloc_track_alloc(void *ptr, size_t size, void *caller);
+
+/**
+ * malloc_track_free() - Record that a block has been freed
+ *
+ * @ptr: Address of the block, or NULL
+ */
+void malloc_track_free(void *ptr);
+
+/**
+ * malloc_track_init() - Set up tracking for the full heap
+ *
+ * This allocates the tracking tables and moves to MALLOC_PHASE_BOARD_R. It
+ * must be called once the full heap is ready. If there is not enough memory,
+ * allocations are not tracked after relocation.
+ */
+void malloc_track_init(void);
+
+/**
+ * malloc_track_phase() - Move to a new boot phase
+ *
+ * The tracked heap use is recorded against the phase until the next call.
+ *
+ * @phase: Phase which is starting
+ */
+void malloc_track_phase(enum malloc_phase phase);
+
+/**
+ * malloc_track_bootstage() - Record the peak heap use of the current phase
+ *
+ * This adds a bootstage span named after the phase, with the peak number of
+ * tracked live bytes as its byte count. It is called when a phase ends and
+ * should be called before starting the OS, which ends the last phase.
+ */
+void malloc_track_bootstage(void);
+
+/**
+ * malloc_track_find() - Look up a tracked allocation
+ *
+ * @ptr: Address of the block
+ * @info: Returns information about the allocation
+ * @return 0 if OK, -ENOENT if the block is not being tracked
+ */
+int malloc_track_find(const void *ptr, struct malloc_track_info *info);
+
+/**
+ * malloc_track_show_callers() - Show live allocations grouped by caller
+ *
+ * @early: true to show allocations from the heap used before relocation
+ */
+void malloc_track_show_callers(bool early);
+
+/** malloc_track_show_phases() - Show heap use in each boot phase */
+void malloc_track_show_phases(void);
+#else
+static inline void malloc_track_alloc(void *ptr, size_t size, void *caller)
+{
+}
+
+static inline void malloc_track_free(void *ptr)
+{
+}
+
+static inline void malloc_track_init(void)
+{
+}
+
+static inline void malloc_track_phase(enum malloc_phase phase)
+{
+}
+
+static inline void malloc_track_bootstage(void)
+{
+}
+#endif
+
 #ifdef __cplusplus
 };  /* end of extern "C" */
 #endif
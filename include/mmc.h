@@ -82,6 +82,8 @@ struct bd_info;
 
 
 #define SD_DATA_4BIT	0x00040000
+#define SD_SCR_CMD23_SUPPORT	BIT(1)
+#define SD_SCR_DATA_STAT_AFTER_ERASE	BIT(23)
 
 #define IS_SD(x)	((x)->version & SD_VERSION_SD)
 #define IS_MMC(x)	((x)->version & MMC_VERSION_MMC)
@@ -212,6 +214,8 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 /*
  * EXT_CSD fields
  */
+#define EXT_CSD_FLUSH_CACHE		32	/* W */
+#define EXT_CSD_CACHE_CTRL		33	/* R/W */
 #define EXT_CSD_ENH_START_ADDR		136	/* R/W */
 #define EXT_CSD_ENH_SIZE_MULT		140	/* R/W */
 #define EXT_CSD_GP_SIZE_MULT		143	/* R/W */
@@ -228,6 +232,7 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_BOOT_WP			173	/* R/W & R/W/C_P */
 #define EXT_CSD_BOOT_WP_STATUS		174	/* R */
 #define EXT_CSD_ERASE_GROUP_DEF		175	/* R/W */
+#define EXT_CSD_ERASED_MEM_CONT		181	/* RO */
 #define EXT_CSD_BOOT_BUS_WIDTH		177
 #define EXT_CSD_PART_CONF		179	/* R/W */
 #define EXT_CSD_BUS_WIDTH		183	/* R/W */
@@ -240,7 +245,10 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_HC_WP_GRP_SIZE		221	/* RO */
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
+#define EXT_CSD_SEC_FEATURE_SUPPORT	231	/* RO */
+#define EXT_CSD_TRIM_MULT		232	/* RO */
 #define EXT_CSD_GENERIC_CMD6_TIME       248     /* RO */
+#define EXT_CSD_CACHE_SIZE		249	/* RO, 4 bytes */
 #define EXT_CSD_BKOPS_SUPPORT		502	/* RO */
 
 /*
@@ -283,6 +291,10 @@ static inline bool mmc_is_tuning_cmd(uint cmdidx)
 #define EXT_CSD_TIMING_HS400	3	/* HS400 */
 #define EXT_CSD_DRV_STR_SHIFT	4	/* Driver Strength shift */
 
+#define EXT_CSD_CACHE_EN	BIT(0)	/* Volatile cache is enabled */
+
+#define EXT_CSD_SEC_GB_CL_EN	BIT(4)	/* TRIM is supported */
+
 #define EXT_CSD_BOOT_ACK_ENABLE			(1 << 6)
 #define EXT_CSD_BOOT_PARTITION_ENABLE		(1 << 3)
 #define EXT_CSD_PARTITION_ACCESS_ENABLE		(1 << 0)
@@ -697,6 +709,11 @@ struct mmc {
 				  * accessing the boot partitions
 				  */
 	u32 quirks;
+#if CONFIG_IS_ENABLED(MMC_FAST_WRITE)
+	bool cmd23;		/* card supports CMD23 SET_BLOCK_COUNT */
+	bool cache_on;		/* eMMC volatile cache is enabled */
+	u32 cache_size;		/* size of the eMMC volatile cache in KiB */
+#endif
 };
 
 struct mmc_hwpart_conf {
@@ -807,6 +824,39 @@ int mmc_getwp(struct mmc *mmc);
 int board_mmc_getwp(struct mmc *mmc);
 #endif
 
+#if CONFIG_IS_ENABLED(MMC_FAST_WRITE)
+/**
+ * mmc_set_write_cache() - Turn the eMMC volatile cache on or off
+ *
+ * With the cache on, the card can accept data faster than it can program
+ * it, but the data is not safe until the cache is flushed. Turning the cache
+ * off flushes it. This does nothing if the card has no cache.
+ *
+ * @mmc:	MMC device
+ * @enable:	true to turn the cache on, false to flush it and turn it off
+ * @return 0 if OK, -ve on error
+ */
+int mmc_set_write_cache(struct mmc *mmc, bool enable);
+
+/**
+ * mmc_flush_cache() - Write back the contents of the eMMC volatile cache
+ *
+ * @mmc:	MMC device
+ * @return 0 if OK (or the cache is off), -ve on error
+ */
+int mmc_flush_cache(struct mmc *mmc);
+#else
+static inline int mmc_set_write_cache(struct mmc *mmc, bool enable)
+{
+	return 0;
+}
+
+static inline int mmc_flush_cache(struct mmc *mmc)
+{
+	return 0;
+}
+#endif
+
 int mmc_set_dsr(struct mmc *mmc, u16 val);
 /* Function to change the size of boot partition and rpmb partitions */
 int mmc_boot_partition_size_change(struct mmc *mmc, unsigned long bootsize,
@@ -355,4 +355,27 @@ int os_read_file(const char *name, void **bufp, int *sizep);
  */
 void *os_find_text_base(void);
 
+/**
+ * os_profile_start() - Start a timer which interrupts sandbox periodically
+ *
+ * This sets up a SIGPROF timer, which counts the CPU time used by sandbox.
+ * On each tick, @func is called from the signal handler with the registers
+ * of the interrupted code, so it must be safe to call from a signal handler.
+ * This is supported on x86 and ARM64 hosts.
+ *
+ * @rate:	Number of ticks per second of CPU time
+ * @func:	Function to call on each tick, with the program counter,
+ *		frame pointer and stack pointer of the interrupted code and the
+ *		top of its stack
+ * @return 0 if OK, -1 on error
+ */
+int os_profile_start(unsigned int rate,
+		     void (*func)(unsigned long pc, unsigned long fp,
+				  unsigned long sp, unsigned long stack_top));
+
+/**
+ * os_profile_stop() - Stop the timer started by os_profile_start()
+ */
+void os_profile_stop(void);
+
 #endif
@@ -0,0 +1,82 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * Sampling profiler
+ *
+ * A periodic interrupt records where U-Boot is running, as the interrupted
+ * program counter and the return addresses found by following the frame
+ * pointers. The samples go in a ring buffer which can be dumped for
+ * proftool, which turns them into folded stacks for a flame graph.
+ *
+ * Unlike function tracing (see trace.h) this needs no instrumented build
+ * and adds little to the run time, at the cost of only giving statistics.
+ */
+
+#ifndef __PROFILE_H
+#define __PROFILE_H
+
+/**
+ * profile_start() - Start sampling
+ *
+ * This clears any samples taken before.
+ *
+ * @rate: Number of samples per second
+ * @return 0 if OK, -EALREADY if already running, -ENOMEM if there is no
+ *	memory for the samples, other -ve on error from the timer
+ */
+int profile_start(uint rate);
+
+/**
+ * profile_stop() - Stop sampling
+ *
+ * The samples are kept until the next profile_start()
+ */
+void profile_stop(void);
+
+/**
+ * profile_sample() - Record a sample
+ *
+ * This is called from the timer interrupt with the registers of the
+ * interrupted code. It follows the frame records, which must each hold the
+ * previous frame pointer followed by the return address, as on x86 and
+ * ARM64.
+ *
+ * @pc: Program counter
+ * @fp: Frame pointer
+ * @sp: Stack pointer
+ * @stack_top: Address just above the stack, or 0 to record only @pc
+ */
+void profile_sample(ulong pc, ulong fp, ulong sp, ulong stack_top);
+
+/**
+ * profile_list_samples() - Write the samples for proftool
+ *
+ * The samples are written oldest first as a struct trace_output_hdr of
+ * type TRACE_CHUNK_SAMPLES followed by a struct trace_sample and its code
+ * offsets for each sample.
+ *
+ * @buff: Buffer to write to, or NULL to count the size
+ * @buff_size: Size of buffer
+ * @needed: Returns the number of bytes used or needed
+ * @return 0 if OK, -ENOSPC if the buffer is too small
+ */
+int profile_list_samples(void *buff, size_t buff_size, size_t *needed);
+
+/* Print statistics about the samples */
+void profile_print_stats(void);
+
+/**
+ * arch_profile_start() - Start the timer interrupt used for sampling
+ *
+ * The interrupt handler must call profile_sample().
+ *
+ * @rate: Number of interrupts per second
+ * @return 0 if OK, -ve on error
+ */
+int arch_profile_start(uint rate);
+
+/**
+ * arch_profile_stop() - Stop the timer interrupt used for sampling
+ */
+void arch_profile_stop(void);
+
+#endif
@@ -47,6 +47,18 @@ struct hsearch_data {
 	struct env_entry_node *table;
 	unsigned int size;
 	unsigned int filled;
+	/*
+	 * Modification counter, incremented whenever an entry is created,
+	 * changed or deleted and whenever the table is (re)created. Callers
+	 * can compare snapshots of it to detect whether the table changed.
+	 */
+	unsigned int changes;
+	/*
+	 * Number of hsearch_r() and hdelete_r() calls in progress. These hold
+	 * an index into the table while calling callbacks, which may add
+	 * entries themselves, so the table is only resized when this is 0.
+	 */
+	unsigned int nest;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
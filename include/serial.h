@@ -194,6 +194,22 @@ struct dm_serial_ops {
 	 * @return 0 if OK, -ve on error
 	 */
 	int (*putc)(struct udevice *dev, const char ch);
+	/**
+	 * puts() - Write a number of characters
+	 *
+	 * This writes as many characters as the UART can accept without
+	 * waiting, e.g. enough to fill its transmit FIFO. No translation of
+	 * '\n' is done. If no characters can be accepted, this should return
+	 * -EAGAIN without waiting.
+	 *
+	 * This method is optional. If it is not provided, putc() is used.
+	 *
+	 * @dev: Device pointer
+	 * @s: Characters to write
+	 * @len: Number of characters to write
+	 * @return number of characters written (> 0), -ve on error
+	 */
+	ssize_t (*puts)(struct udevice *dev, const char *s, size_t len);
 	/**
 	 * pending() - Check if input/output characters are waiting
 	 *
@@ -273,6 +289,13 @@ struct dm_serial_ops {
  * @buf:	Pointer to the RX buffer
  * @rd_ptr:	Read pointer in the RX buffer
  * @wr_ptr:	Write pointer in the RX buffer
+ *
+ * @tx_buf:	Pointer to the TX buffer, NULL if output is not buffered
+ * @tx_head:	Number of characters ever added to the TX buffer
+ * @tx_tail:	Number of characters ever sent from the TX buffer
+ * @tx_busy:	true while the TX buffer is being drained, so that a
+ *		nested call (e.g. from a watchdog or log handler) does not
+ *		send characters out of order
  */
 struct serial_dev_priv {
 	struct stdio_dev *sdev;
@@ -280,6 +303,11 @@ struct serial_dev_priv {
 	char *buf;
 	int rd_ptr;
 	int wr_ptr;
+
+	char *tx_buf;
+	uint tx_head;
+	uint tx_tail;
+	bool tx_busy;
 };
 
 /* Access the serial operations for a device */
@@ -346,4 +374,25 @@ void serial_puts(const char *str);
 int serial_getc(void);
 int serial_tstc(void);
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+/**
+ * serial_poll() - Send buffered output which the UARTs can accept now
+ *
+ * This does not wait, so it can be called from delay loops to keep the
+ * UARTs busy while U-Boot is doing something else.
+ */
+void serial_poll(void);
+
+/**
+ * serial_flush() - Wait until all buffered output has been sent
+ *
+ * This must be called before anything which might lose the contents of the
+ * TX buffer, such as a reset or jumping to an OS.
+ */
+void serial_flush(void);
+#else
+static inline void serial_poll(void) {}
+static inline void serial_flush(void) {}
+#endif
+
 #endif
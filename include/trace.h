@@ -28,6 +28,7 @@ enum {
 enum trace_chunk_type {
 	TRACE_CHUNK_FUNCS,
 	TRACE_CHUNK_CALLS,
+	TRACE_CHUNK_SAMPLES,
 };
 
 /* A trace record for a function, as written to the profile output file */
@@ -42,6 +43,18 @@ struct trace_output_hdr {
 	size_t rec_count;		/* Number of records */
 };
 
+/*
+ * A call stack recorded by the sampling profiler, as written to the profile
+ * output file. It is followed by @depth code offsets, starting with the
+ * interrupted instruction and followed by the return addresses of its
+ * callers. An offset of TRACE_SAMPLE_UNKNOWN is outside U-Boot.
+ */
+struct trace_sample {
+	uint32_t depth;			/* Number of code offsets */
+};
+
+#define TRACE_SAMPLE_UNKNOWN	0xffffffffU
+
 /* Print statistics about traced function calls */
 void trace_print_stats(void);
 
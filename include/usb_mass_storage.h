@@ -19,6 +19,7 @@ struct ums {
 			   ulong start, lbaint_t blkcnt, void *buf);
 	int (*write_sector)(struct ums *ums_dev,
 			    ulong start, lbaint_t blkcnt, const void *buf);
+	int (*sync)(struct ums *ums_dev);	/* optional */
 	unsigned int start_sector;
 	unsigned int num_sectors;
 	const char *name;
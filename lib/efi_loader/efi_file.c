@@ -39,6 +39,9 @@ struct file_handle {
 	struct fs_dir_stream *dirs;
 	struct fs_dirent *dent;
 
+	/* for reading a file, opened on first use: */
+	struct fs_file *file;
+
 	char path[0];
 };
 #define to_fh(x) container_of(x, struct file_handle, base)
@@ -298,6 +301,7 @@ out:
 static efi_status_t file_close(struct file_handle *fh)
 {
 	fs_closedir(fh->dirs);
+	fs_file_close(fh->file);
 	free(fh);
 	return EFI_SUCCESS;
 }
@@ -323,6 +327,34 @@ static efi_status_t EFIAPI efi_file_delete(struct efi_file_handle *file)
 	return EFI_EXIT(ret);
 }
 
+/**
+ * file_open_read() - open the file of a handle for reading
+ *
+ * The open file is kept until anything is written or the handle closed, so
+ * that subsequent reads do not need to look up the path again. A write,
+ * delete or mkdir through any handle makes it stale, so that the size and
+ * directory entry are read again.
+ *
+ * @fh:		file handle
+ * Return:	0 on success, -ve on error
+ */
+static int file_open_read(struct file_handle *fh)
+{
+	if (fh->file) {
+		if (!fs_file_changed(fh->file))
+			return 0;
+		fs_file_close(fh->file);
+		fh->file = NULL;
+	}
+	if (set_blk_dev(fh))
+		return -ENODEV;
+	fh->file = fs_file_open(fh->path);
+	if (!fh->file)
+		return -errno;
+
+	return 0;
+}
+
 /**
  * efi_get_file_size() - determine the size of a file
  *
@@ -333,6 +365,11 @@ static efi_status_t EFIAPI efi_file_delete(struct efi_file_handle *file)
 static efi_status_t efi_get_file_size(struct file_handle *fh,
 				      loff_t *file_size)
 {
+	if (!fh->isdir && !file_open_read(fh)) {
+		*file_size = fh->file->size;
+		return EFI_SUCCESS;
+	}
+
 	if (set_blk_dev(fh))
 		return EFI_DEVICE_ERROR;
 
@@ -347,25 +384,21 @@ static efi_status_t file_read(struct file_handle *fh, u64 *buffer_size,
 {
 	loff_t actread;
 	efi_status_t ret;
-	loff_t file_size;
 
 	if (!buffer) {
 		ret = EFI_INVALID_PARAMETER;
 		return ret;
 	}
 
-	ret = efi_get_file_size(fh, &file_size);
-	if (ret != EFI_SUCCESS)
-		return ret;
-	if (file_size < fh->offset) {
+	if (file_open_read(fh))
+		return EFI_DEVICE_ERROR;
+	if (fh->file->size < fh->offset) {
 		ret = EFI_DEVICE_ERROR;
 		return ret;
 	}
 
-	if (set_blk_dev(fh))
-		return EFI_DEVICE_ERROR;
-	if (fs_read(fh->path, map_to_sysmem(buffer), fh->offset,
-		    *buffer_size, &actread))
+	if (fs_file_read(fh->file, map_to_sysmem(buffer), fh->offset,
+			 *buffer_size, &actread))
 		return EFI_DEVICE_ERROR;
 
 	*buffer_size = actread;
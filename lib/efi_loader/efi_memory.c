@@ -12,27 +12,40 @@
 #include <mapmem.h>
 #include <watchdog.h>
 #include <asm/cache.h>
-#include <linux/list_sort.h>
+#include <linux/bitops.h>
+#include <linux/rbtree_augmented.h>
 #include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
 /* Magic number identifying memory allocated from pool */
 #define EFI_ALLOC_POOL_MAGIC 0x1fe67ddf6491caa2
+/* Magic number identifying a slab of small pool allocations */
+#define EFI_ALLOC_SLAB_MAGIC 0x6b52e1d5a37c0f49
 
 efi_uintn_t efi_memory_map_key;
 
+/**
+ * struct efi_mem_list - memory map entry
+ *
+ * @node:	node in the tree of entries, sorted by address
+ * @desc:	memory descriptor
+ * @max_free:	largest number of pages of an EFI_CONVENTIONAL_MEMORY entry
+ *		in the subtree of @node, used to find free memory
+ */
 struct efi_mem_list {
-	struct list_head link;
+	struct rb_node node;
 	struct efi_mem_desc desc;
+	u64 max_free;
 };
 
-#define EFI_CARVE_NO_OVERLAP		-1
-#define EFI_CARVE_LOOP_AGAIN		-2
-#define EFI_CARVE_OVERLAPS_NONRAM	-3
-
-/* This list contains all memory map items */
-LIST_HEAD(efi_mem);
+/*
+ * This tree contains all memory map items. They do not overlap, and no two
+ * adjacent items have the same type and attributes.
+ */
+static struct rb_root efi_mem = RB_ROOT;
+/* Number of memory map items */
+static efi_uintn_t efi_mem_count;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 void *efi_bounce_buffer;
@@ -61,6 +74,49 @@ struct efi_pool_allocation {
 	char data[] __aligned(ARCH_DMA_MINALIGN);
 };
 
+/* Pool allocations up to this size are served from slabs */
+#define EFI_POOL_SLAB_MAX	1024
+/* Slab objects are from 2^6 to 2^10 bytes */
+#define EFI_POOL_SLAB_MIN_SHIFT	6
+#define EFI_POOL_SLAB_CLASSES	5
+
+/**
+ * struct efi_pool_slab - page holding small pool allocations of one size
+ *
+ * @num_pages:	always 0, to match struct efi_pool_allocation
+ * @checksum:	checksum, see slab_checksum()
+ * @link:	entry in efi_pool_slabs[] while the slab has a free object
+ * @pool_type:	memory type of the page
+ * @size:	size of an object
+ * @count:	number of objects
+ * @used:	bitmap of the allocated objects
+ * @data:	objects
+ *
+ * AllocatePool() is called very often for small buffers. Allocating pages
+ * for each of them adds an entry to the memory map every time, so small
+ * sizes are instead rounded up to a power of two and served from a page
+ * holding objects of that size.
+ */
+struct efi_pool_slab {
+	u64 num_pages;
+	u64 checksum;
+	struct list_head link;
+	int pool_type;
+	unsigned int size;
+	unsigned int count;
+	u64 used;
+	char data[] __aligned(ARCH_DMA_MINALIGN);
+};
+
+/* Slabs with free objects, by size class */
+static struct list_head efi_pool_slabs[EFI_POOL_SLAB_CLASSES] = {
+	LIST_HEAD_INIT(efi_pool_slabs[0]),
+	LIST_HEAD_INIT(efi_pool_slabs[1]),
+	LIST_HEAD_INIT(efi_pool_slabs[2]),
+	LIST_HEAD_INIT(efi_pool_slabs[3]),
+	LIST_HEAD_INIT(efi_pool_slabs[4]),
+};
+
 /**
  * checksum() - calculate checksum for memory allocated from pool
  *
@@ -77,24 +133,19 @@ static u64 checksum(struct efi_pool_allocation *alloc)
 	return ret;
 }
 
-/*
- * Sorts the memory list from highest address to lowest address
+/**
+ * slab_checksum() - calculate checksum for a slab of pool allocations
  *
- * When allocating memory we should always start from the highest
- * address chunk, so sort the memory list such that the first list
- * iterator gets the highest address and goes lower from there.
+ * @slab:	slab
+ * Return:	checksum, always non-zero and different from checksum()
  */
-static int efi_mem_cmp(void *priv, struct list_head *a, struct list_head *b)
+static u64 slab_checksum(struct efi_pool_slab *slab)
 {
-	struct efi_mem_list *mema = list_entry(a, struct efi_mem_list, link);
-	struct efi_mem_list *memb = list_entry(b, struct efi_mem_list, link);
-
-	if (mema->desc.physical_start == memb->desc.physical_start)
-		return 0;
-	else if (mema->desc.physical_start < memb->desc.physical_start)
-		return 1;
-	else
-		return -1;
+	u64 addr = (uintptr_t)slab;
+	u64 ret = (addr >> 32) ^ (addr << 32) ^ EFI_ALLOC_SLAB_MAGIC;
+	if (!ret)
+		++ret;
+	return ret;
 }
 
 static uint64_t desc_get_end(struct efi_mem_desc *desc)
@@ -102,131 +153,191 @@ static uint64_t desc_get_end(struct efi_mem_desc *desc)
 	return desc->physical_start + (desc->num_pages << EFI_PAGE_SHIFT);
 }
 
-static void efi_mem_sort(void)
+static u64 efi_mem_compute_max(struct efi_mem_list *item)
+{
+	u64 max = 0, child;
+
+	if (item->desc.type == EFI_CONVENTIONAL_MEMORY)
+		max = item->desc.num_pages;
+	if (item->node.rb_left) {
+		child = rb_entry(item->node.rb_left, struct efi_mem_list,
+				 node)->max_free;
+		max = max(max, child);
+	}
+	if (item->node.rb_right) {
+		child = rb_entry(item->node.rb_right, struct efi_mem_list,
+				 node)->max_free;
+		max = max(max, child);
+	}
+
+	return max;
+}
+
+RB_DECLARE_CALLBACKS(static, efi_mem_augment, struct efi_mem_list, node,
+		     u64, max_free, efi_mem_compute_max)
+
+/**
+ * efi_mem_update() - update the tree after changing an entry
+ *
+ * This must be called after changing the size or type of an entry.
+ *
+ * @item:	changed entry
+ */
+static void efi_mem_update(struct efi_mem_list *item)
+{
+	efi_mem_augment_propagate(&item->node, NULL);
+}
+
+/**
+ * efi_mem_insert() - add an entry to the tree
+ *
+ * @item:	entry, which must not overlap any entry in the tree
+ */
+static void efi_mem_insert(struct efi_mem_list *item)
+{
+	struct rb_node **link = &efi_mem.rb_node, *parent = NULL;
+	struct efi_mem_list *cur;
+
+	item->max_free = efi_mem_compute_max(item);
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct efi_mem_list, node);
+		if (cur->max_free < item->max_free)
+			cur->max_free = item->max_free;
+		if (item->desc.physical_start < cur->desc.physical_start)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&item->node, parent, link);
+	rb_insert_augmented(&item->node, &efi_mem, &efi_mem_augment);
+	efi_mem_count++;
+}
+
+/**
+ * efi_mem_remove() - remove an entry from the tree and free it
+ *
+ * @item:	entry
+ */
+static void efi_mem_remove(struct efi_mem_list *item)
+{
+	rb_erase_augmented(&item->node, &efi_mem, &efi_mem_augment);
+	free(item);
+	efi_mem_count--;
+}
+
+/**
+ * efi_mem_find() - find the entry holding an address
+ *
+ * @addr:	address
+ * Return:	entry holding @addr, else the first entry above @addr, or NULL
+ */
+static struct efi_mem_list *efi_mem_find(u64 addr)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *prevmem = NULL;
-	bool merge_again = true;
-
-	list_sort(NULL, &efi_mem, efi_mem_cmp);
-
-	/* Now merge entries that can be merged */
-	while (merge_again) {
-		merge_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			struct efi_mem_desc *prev = &prevmem->desc;
-			struct efi_mem_desc *cur;
-			uint64_t pages;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			if (!prevmem) {
-				prevmem = lmem;
-				continue;
-			}
-
-			cur = &lmem->desc;
-
-			if ((desc_get_end(cur) == prev->physical_start) &&
-			    (prev->type == cur->type) &&
-			    (prev->attribute == cur->attribute)) {
-				/* There is an existing map before, reuse it */
-				pages = cur->num_pages;
-				prev->num_pages += pages;
-				prev->physical_start -= pages << EFI_PAGE_SHIFT;
-				prev->virtual_start -= pages << EFI_PAGE_SHIFT;
-				list_del(&lmem->link);
-				free(lmem);
-
-				merge_again = true;
-				break;
-			}
-
-			prevmem = lmem;
+	struct rb_node *rb = efi_mem.rb_node;
+	struct efi_mem_list *item, *above = NULL;
+
+	while (rb) {
+		item = rb_entry(rb, struct efi_mem_list, node);
+		if (addr < item->desc.physical_start) {
+			above = item;
+			rb = rb->rb_left;
+		} else if (addr >= desc_get_end(&item->desc)) {
+			rb = rb->rb_right;
+		} else {
+			return item;
 		}
 	}
+
+	return above;
+}
+
+static struct efi_mem_list *efi_mem_next(struct efi_mem_list *item)
+{
+	return rb_entry_safe(rb_next(&item->node), struct efi_mem_list, node);
+}
+
+static struct efi_mem_list *efi_mem_prev(struct efi_mem_list *item)
+{
+	return rb_entry_safe(rb_prev(&item->node), struct efi_mem_list, node);
+}
+
+/**
+ * efi_mem_merge() - merge two adjacent entries if they are alike
+ *
+ * @low:	entry
+ * @high:	entry directly following @low, may be NULL
+ * Return:	true if @high has been merged into @low and freed
+ */
+static bool efi_mem_merge(struct efi_mem_list *low, struct efi_mem_list *high)
+{
+	if (!high || desc_get_end(&low->desc) != high->desc.physical_start ||
+	    low->desc.type != high->desc.type ||
+	    low->desc.attribute != high->desc.attribute)
+		return false;
+
+	low->desc.num_pages += high->desc.num_pages;
+	efi_mem_remove(high);
+	efi_mem_update(low);
+
+	return true;
 }
 
 /** efi_mem_carve_out - unmap memory region
  *
- * @map:		memory map
- * @carve_desc:		memory region to unmap
- * @overlap_only_ram:	the carved out region may only overlap RAM
- * Return Value:	the number of overlapping pages which have been
- *			removed from the map,
- *			EFI_CARVE_NO_OVERLAP, if the regions don't overlap,
- *			EFI_CARVE_OVERLAPS_NONRAM, if the carve and map overlap,
- *			and the map contains anything but free ram
- *			(only when overlap_only_ram is true),
- *			EFI_CARVE_LOOP_AGAIN, if the mapping list should be
- *			traversed again, as it has been altered.
- *
- * Unmaps all memory occupied by the carve_desc region from the list entry
- * pointed to by map.
- *
- * In case of EFI_CARVE_OVERLAPS_NONRAM it is the callers responsibility
- * to re-add the already carved out pages to the mapping.
+ * @map:		memory map entry
+ * @carve_start:	start of the memory region to unmap
+ * @carve_end:		end of the memory region to unmap
+ * Return:		status code
+ *
+ * Removes the part of the entry between carve_start and carve_end, which
+ * must overlap it. The entry may be shrunk, split in two or freed. The map
+ * is not changed if an error is returned.
  */
-static s64 efi_mem_carve_out(struct efi_mem_list *map,
-			     struct efi_mem_desc *carve_desc,
-			     bool overlap_only_ram)
+static efi_status_t efi_mem_carve_out(struct efi_mem_list *map,
+				      u64 carve_start, u64 carve_end)
 {
 	struct efi_mem_list *newmap;
 	struct efi_mem_desc *map_desc = &map->desc;
 	uint64_t map_start = map_desc->physical_start;
-	uint64_t map_end = map_start + (map_desc->num_pages << EFI_PAGE_SHIFT);
-	uint64_t carve_start = carve_desc->physical_start;
-	uint64_t carve_end = carve_start +
-			     (carve_desc->num_pages << EFI_PAGE_SHIFT);
-
-	/* check whether we're overlapping */
-	if ((carve_end <= map_start) || (carve_start >= map_end))
-		return EFI_CARVE_NO_OVERLAP;
-
-	/* We're overlapping with non-RAM, warn the caller if desired */
-	if (overlap_only_ram && (map_desc->type != EFI_CONVENTIONAL_MEMORY))
-		return EFI_CARVE_OVERLAPS_NONRAM;
-
-	/* Sanitize carve_start and carve_end to lie within our bounds */
-	carve_start = max(carve_start, map_start);
-	carve_end = min(carve_end, map_end);
-
-	/* Carving at the beginning of our map? Just move it! */
-	if (carve_start == map_start) {
-		if (map_end == carve_end) {
-			/* Full overlap, just remove map */
-			list_del(&map->link);
-			free(map);
-		} else {
-			map->desc.physical_start = carve_end;
-			map->desc.virtual_start = carve_end;
-			map->desc.num_pages = (map_end - carve_end)
-					      >> EFI_PAGE_SHIFT;
-		}
+	uint64_t map_end = desc_get_end(map_desc);
 
-		return (carve_end - carve_start) >> EFI_PAGE_SHIFT;
+	if (carve_start > map_start && carve_end < map_end) {
+		/*
+		 * Overlapping maps, split the map:
+		 *
+		 * [ map_desc |__carve__| newmap ]
+		 */
+		newmap = calloc(1, sizeof(*newmap));
+		if (!newmap)
+			return EFI_OUT_OF_RESOURCES;
+		newmap->desc = map->desc;
+		newmap->desc.physical_start = carve_end;
+		newmap->desc.virtual_start = carve_end;
+		newmap->desc.num_pages = (map_end - carve_end) >> EFI_PAGE_SHIFT;
+		efi_mem_insert(newmap);
 	}
 
-	/*
-	 * Overlapping maps, just split the list map at carve_start,
-	 * it will get moved or removed in the next iteration.
-	 *
-	 * [ map_desc |__carve_start__| newmap ]
-	 */
-
-	/* Create a new map from [ carve_start ... map_end ] */
-	newmap = calloc(1, sizeof(*newmap));
-	newmap->desc = map->desc;
-	newmap->desc.physical_start = carve_start;
-	newmap->desc.virtual_start = carve_start;
-	newmap->desc.num_pages = (map_end - carve_start) >> EFI_PAGE_SHIFT;
-	/* Insert before current entry (descending address order) */
-	list_add_tail(&newmap->link, &map->link);
-
-	/* Shrink the map to [ map_start ... carve_start ] */
-	map_desc->num_pages = (carve_start - map_start) >> EFI_PAGE_SHIFT;
+	if (carve_start > map_start) {
+		/* Shrink the map to [ map_start ... carve_start ] */
+		map_desc->num_pages = (carve_start - map_start)
+				      >> EFI_PAGE_SHIFT;
+		efi_mem_update(map);
+	} else if (carve_end < map_end) {
+		/*
+		 * Carving at the beginning of our map? Just move it! This keeps
+		 * the order of the tree, as the entries do not overlap.
+		 */
+		map_desc->physical_start = carve_end;
+		map_desc->virtual_start = carve_end;
+		map_desc->num_pages = (map_end - carve_end) >> EFI_PAGE_SHIFT;
+		efi_mem_update(map);
+	} else {
+		/* Full overlap, just remove map */
+		efi_mem_remove(map);
+	}
 
-	return EFI_CARVE_LOOP_AGAIN;
+	return EFI_SUCCESS;
 }
 
 /**
@@ -242,11 +353,10 @@ static efi_status_t efi_add_memory_map_pg(u64 start, u64 pages,
 					  int memory_type,
 					  bool overlap_only_ram)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *newlist;
-	bool carve_again;
-	uint64_t carved_pages = 0;
+	struct efi_mem_list *newlist, *item, *next;
+	u64 end = start + (pages << EFI_PAGE_SHIFT);
 	struct efi_event *evt;
+	efi_status_t ret;
 
 	EFI_PRINT("%s: 0x%llx 0x%llx %d %s\n", __func__,
 		  start, pages, memory_type, overlap_only_ram ? "yes" : "no");
@@ -257,8 +367,29 @@ static efi_status_t efi_add_memory_map_pg(u64 start, u64 pages,
 	if (!pages)
 		return EFI_SUCCESS;
 
-	++efi_memory_map_key;
+	if (overlap_only_ram) {
+		uint64_t ram_pages = 0;
+
+		/*
+		 * The payload wants to have RAM overlaps only. Check this
+		 * before changing anything.
+		 */
+		for (item = efi_mem_find(start);
+		     item && item->desc.physical_start < end;
+		     item = efi_mem_next(item)) {
+			if (item->desc.type != EFI_CONVENTIONAL_MEMORY)
+				return EFI_NO_MAPPING;
+			ram_pages += (min(end, desc_get_end(&item->desc)) -
+				      max(start, item->desc.physical_start))
+				     >> EFI_PAGE_SHIFT;
+		}
+		if (ram_pages != pages)
+			return EFI_NO_MAPPING;
+	}
+
 	newlist = calloc(1, sizeof(*newlist));
+	if (!newlist)
+		return EFI_OUT_OF_RESOURCES;
 	newlist->desc.type = memory_type;
 	newlist->desc.physical_start = start;
 	newlist->desc.virtual_start = start;
@@ -277,60 +408,25 @@ static efi_status_t efi_add_memory_map_pg(u64 start, u64 pages,
 		break;
 	}
 
-	/* Add our new map */
-	do {
-		carve_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			s64 r;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			r = efi_mem_carve_out(lmem, &newlist->desc,
-					      overlap_only_ram);
-			switch (r) {
-			case EFI_CARVE_OVERLAPS_NONRAM:
-				/*
-				 * The user requested to only have RAM overlaps,
-				 * but we hit a non-RAM region. Error out.
-				 */
-				return EFI_NO_MAPPING;
-			case EFI_CARVE_NO_OVERLAP:
-				/* Just ignore this list entry */
-				break;
-			case EFI_CARVE_LOOP_AGAIN:
-				/*
-				 * We split an entry, but need to loop through
-				 * the list again to actually carve it.
-				 */
-				carve_again = true;
-				break;
-			default:
-				/* We carved a number of pages */
-				carved_pages += r;
-				carve_again = true;
-				break;
-			}
-
-			if (carve_again) {
-				/* The list changed, we need to start over */
-				break;
-			}
+	/* Carve the new map out of the overlapping ones */
+	for (item = efi_mem_find(start);
+	     item && item->desc.physical_start < end; item = next) {
+		next = efi_mem_next(item);
+		ret = efi_mem_carve_out(item, start, end);
+		if (ret != EFI_SUCCESS) {
+			/* Only a split can fail, before anything is carved */
+			free(newlist);
+			return ret;
 		}
-	} while (carve_again);
-
-	if (overlap_only_ram && (carved_pages != pages)) {
-		/*
-		 * The payload wanted to have RAM overlaps, but we overlapped
-		 * with an unallocated region. Error out.
-		 */
-		return EFI_NO_MAPPING;
 	}
 
-	/* Add our new map */
-        list_add_tail(&newlist->link, &efi_mem);
-
-	/* And make sure memory is listed in descending order */
-	efi_mem_sort();
+	/* Add our new map and merge it with its neighbours */
+	++efi_memory_map_key;
+	efi_mem_insert(newlist);
+	item = efi_mem_prev(newlist);
+	if (item && efi_mem_merge(item, newlist))
+		newlist = item;
+	efi_mem_merge(newlist, efi_mem_next(newlist));
 
 	/* Notify that the memory map was changed */
 	list_for_each_entry(evt, &efi_events, link) {
@@ -383,65 +479,61 @@ efi_status_t efi_add_memory_map(u64 start, u64 size, int memory_type)
  * Return:		status code
  */
 static efi_status_t efi_check_allocated(u64 addr, bool must_be_allocated)
+{
+	struct efi_mem_list *item = efi_mem_find(addr);
+
+	if (!item || addr < item->desc.physical_start)
+		return EFI_NOT_FOUND;
+	if (must_be_allocated ^ (item->desc.type == EFI_CONVENTIONAL_MEMORY))
+		return EFI_SUCCESS;
+	else
+		return EFI_NOT_FOUND;
+}
+
+/**
+ * efi_find_free() - find free memory in a subtree of the memory map
+ *
+ * @rb:		subtree to search
+ * @len:	number of bytes needed, a multiple of EFI_PAGE_SIZE
+ * @max_addr:	end of the memory to search, a multiple of EFI_PAGE_SIZE
+ * Return:	highest start address of free memory of @len bytes ending at
+ *		or below @max_addr, or 0 if none
+ */
+static u64 efi_find_free(struct rb_node *rb, u64 len, u64 max_addr)
 {
 	struct efi_mem_list *item;
+	u64 ret, end;
+
+	if (!rb)
+		return 0;
+	item = rb_entry(rb, struct efi_mem_list, node);
+	if (item->max_free < len >> EFI_PAGE_SHIFT)
+		return 0;
 
-	list_for_each_entry(item, &efi_mem, link) {
-		u64 start = item->desc.physical_start;
-		u64 end = start + (item->desc.num_pages << EFI_PAGE_SHIFT);
+	if (item->desc.physical_start < max_addr) {
+		/* Take memory from the highest addresses first */
+		ret = efi_find_free(rb->rb_right, len, max_addr);
+		if (ret)
+			return ret;
 
-		if (addr >= start && addr < end) {
-			if (must_be_allocated ^
-			    (item->desc.type == EFI_CONVENTIONAL_MEMORY))
-				return EFI_SUCCESS;
-			else
-				return EFI_NOT_FOUND;
-		}
+		end = min(desc_get_end(&item->desc), max_addr);
+		if (item->desc.type == EFI_CONVENTIONAL_MEMORY &&
+		    end - item->desc.physical_start >= len)
+			return end - len;
 	}
 
-	return EFI_NOT_FOUND;
+	return efi_find_free(rb->rb_left, len, max_addr);
 }
 
 static uint64_t efi_find_free_memory(uint64_t len, uint64_t max_addr)
 {
-	struct list_head *lhandle;
-
 	/*
 	 * Prealign input max address, so we simplify our matching
 	 * logic below and can just reuse it as return pointer.
 	 */
 	max_addr &= ~EFI_PAGE_MASK;
 
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem = list_entry(lhandle,
-			struct efi_mem_list, link);
-		struct efi_mem_desc *desc = &lmem->desc;
-		uint64_t desc_len = desc->num_pages << EFI_PAGE_SHIFT;
-		uint64_t desc_end = desc->physical_start + desc_len;
-		uint64_t curmax = min(max_addr, desc_end);
-		uint64_t ret = curmax - len;
-
-		/* We only take memory from free RAM */
-		if (desc->type != EFI_CONVENTIONAL_MEMORY)
-			continue;
-
-		/* Out of bounds for max_addr */
-		if ((ret + len) > max_addr)
-			continue;
-
-		/* Out of bounds for upper map limit */
-		if ((ret + len) > desc_end)
-			continue;
-
-		/* Out of bounds for lower map limit */
-		if (ret < desc->physical_start)
-			continue;
-
-		/* Return the highest address in this map within bounds */
-		return ret;
-	}
-
-	return 0;
+	return efi_find_free(efi_mem.rb_node, len, max_addr);
 }
 
 /*
@@ -541,7 +633,6 @@ efi_status_t efi_free_pages(uint64_t memory, efi_uintn_t pages)
 
 	ret = efi_add_memory_map_pg(memory, pages, EFI_CONVENTIONAL_MEMORY,
 				    false);
-	/* Merging of adjacent free regions is missing */
 
 	if (ret != EFI_SUCCESS)
 		return EFI_NOT_FOUND;
@@ -557,6 +648,75 @@ efi_status_t efi_free_pages(uint64_t memory, efi_uintn_t pages)
  * @buffer:	allocated memory
  * Return:	status code
  */
+static efi_status_t efi_pool_slab_alloc(int pool_type, efi_uintn_t size,
+				       void **buffer)
+{
+	int class = max(fls(size - 1) - EFI_POOL_SLAB_MIN_SHIFT, 0);
+	struct list_head *slabs = &efi_pool_slabs[class];
+	struct efi_pool_slab *slab;
+	u64 full;
+	efi_status_t r;
+	u64 addr;
+	int i;
+
+	list_for_each_entry(slab, slabs, link) {
+		if (slab->pool_type == pool_type)
+			goto found;
+	}
+
+	r = efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES, pool_type, 1, &addr);
+	if (r != EFI_SUCCESS)
+		return r;
+	slab = (struct efi_pool_slab *)(uintptr_t)addr;
+	slab->num_pages = 0;
+	slab->checksum = slab_checksum(slab);
+	slab->pool_type = pool_type;
+	slab->size = max(1 << (class + EFI_POOL_SLAB_MIN_SHIFT),
+			 ARCH_DMA_MINALIGN);
+	slab->count = min_t(unsigned int,
+			    (EFI_PAGE_SIZE - sizeof(*slab)) / slab->size, 64);
+	slab->used = 0;
+	list_add(&slab->link, slabs);
+
+found:
+	i = __ffs64(~slab->used);
+	slab->used |= 1ULL << i;
+	full = slab->count == 64 ? ~0ULL : (1ULL << slab->count) - 1;
+	if (slab->used == full)
+		list_del(&slab->link);
+	*buffer = slab->data + i * slab->size;
+
+	return EFI_SUCCESS;
+}
+
+static efi_status_t efi_pool_slab_free(struct efi_pool_slab *slab,
+				       void *buffer)
+{
+	int class = max(fls(slab->size - 1) - EFI_POOL_SLAB_MIN_SHIFT, 0);
+	struct list_head *slabs = &efi_pool_slabs[class];
+	ptrdiff_t offset = (char *)buffer - slab->data;
+	int i = offset / slab->size;
+	u64 full;
+
+	if (offset < 0 || offset % slab->size || i >= slab->count ||
+	    !(slab->used & (1ULL << i)))
+		return EFI_INVALID_PARAMETER;
+
+	full = slab->count == 64 ? ~0ULL : (1ULL << slab->count) - 1;
+	if (slab->used == full)
+		list_add(&slab->link, slabs);
+	slab->used &= ~(1ULL << i);
+
+	/* Keep one empty slab, for programs allocating and freeing in turn */
+	if (!slab->used && !list_is_singular(slabs)) {
+		list_del(&slab->link);
+		slab->checksum = 0;
+		return efi_free_pages((uintptr_t)slab, 1);
+	}
+
+	return EFI_SUCCESS;
+}
+
 efi_status_t efi_allocate_pool(int pool_type, efi_uintn_t size, void **buffer)
 {
 	efi_status_t r;
@@ -573,6 +733,9 @@ efi_status_t efi_allocate_pool(int pool_type, efi_uintn_t size, void **buffer)
 		return EFI_SUCCESS;
 	}
 
+	if (size <= EFI_POOL_SLAB_MAX)
+		return efi_pool_slab_alloc(pool_type, size, buffer);
+
 	r = efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES, pool_type, num_pages,
 			       &addr);
 	if (r == EFI_SUCCESS) {
@@ -595,6 +758,7 @@ efi_status_t efi_free_pool(void *buffer)
 {
 	efi_status_t ret;
 	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab;
 
 	if (!buffer)
 		return EFI_INVALID_PARAMETER;
@@ -604,12 +768,18 @@ efi_status_t efi_free_pool(void *buffer)
 		return ret;
 
 	alloc = container_of(buffer, struct efi_pool_allocation, data);
+	slab = (struct efi_pool_slab *)((uintptr_t)buffer & ~EFI_PAGE_MASK);
 
 	/* Check that this memory was allocated by efi_allocate_pool() */
 	if (((uintptr_t)alloc & EFI_PAGE_MASK) ||
 	    alloc->checksum != checksum(alloc)) {
-		printf("%s: illegal free 0x%p\n", __func__, buffer);
-		return EFI_INVALID_PARAMETER;
+		if (slab->checksum == slab_checksum(slab))
+			ret = efi_pool_slab_free(slab, buffer);
+		else
+			ret = EFI_INVALID_PARAMETER;
+		if (ret == EFI_INVALID_PARAMETER)
+			printf("%s: illegal free 0x%p\n", __func__, buffer);
+		return ret;
 	}
 	/* Avoid double free */
 	alloc->checksum = 0;
@@ -637,8 +807,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 				uint32_t *descriptor_version)
 {
 	efi_uintn_t map_size = 0;
-	int map_entries = 0;
-	struct list_head *lhandle;
+	struct rb_node *rb;
 	efi_uintn_t provided_map_size;
 
 	if (!memory_map_size)
@@ -646,10 +815,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 
 	provided_map_size = *memory_map_size;
 
-	list_for_each(lhandle, &efi_mem)
-		map_entries++;
-
-	map_size = map_entries * sizeof(struct efi_mem_desc);
+	map_size = efi_mem_count * sizeof(struct efi_mem_desc);
 
 	*memory_map_size = map_size;
 
@@ -665,16 +831,9 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 	if (!memory_map)
 		return EFI_INVALID_PARAMETER;
 
-	/* Copy list into array */
-	/* Return the list in ascending order */
-	memory_map = &memory_map[map_entries - 1];
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem;
-
-		lmem = list_entry(lhandle, struct efi_mem_list, link);
-		*memory_map = lmem->desc;
-		memory_map--;
-	}
+	/* Copy tree into array, in ascending order */
+	for (rb = rb_first(&efi_mem); rb; rb = rb_next(rb))
+		*memory_map++ = rb_entry(rb, struct efi_mem_list, node)->desc;
 
 	if (map_key)
 		*map_key = efi_memory_map_key;
@@ -0,0 +1,262 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * efi_selftest_allocation
+ *
+ * This unit test checks the following boottime services:
+ * AllocatePool, FreePool, AllocatePages, FreePages, GetMemoryMap
+ *
+ * Many small pool allocations are mixed with page allocations, as done by
+ * boot loaders and shells. The memory map is checked for consistency and
+ * the throughput is reported.
+ */
+
+#include <efi_selftest.h>
+
+#define EFI_ST_ALLOCATIONS 4000
+/* Period of the clock in units of 100 ns */
+#define EFI_ST_CLOCK_PERIOD 10000
+
+static struct efi_boot_services *boottime;
+static struct efi_event *clock;
+static unsigned int ticks;
+static void **buffers;
+static u64 *pages;
+
+/**
+ * tick() - count the clock periods which have elapsed
+ */
+static void tick(void)
+{
+	while (boottime->check_event(clock) == EFI_SUCCESS)
+		++ticks;
+}
+
+/**
+ * setup() - setup unit test
+ *
+ * @handle:	handle of the loaded image
+ * @systable:	system table
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int setup(const efi_handle_t handle,
+		 const struct efi_system_table *systable)
+{
+	efi_status_t ret;
+
+	boottime = systable->boottime;
+
+	ret = boottime->create_event(EVT_TIMER, TPL_CALLBACK, NULL, NULL,
+				     &clock);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Could not create event\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = boottime->allocate_pool(EFI_LOADER_DATA,
+				      EFI_ST_ALLOCATIONS * sizeof(void *),
+				      (void **)&buffers);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("AllocatePool did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = boottime->allocate_pool(EFI_LOADER_DATA,
+				      EFI_ST_ALLOCATIONS * sizeof(u64),
+				      (void **)&pages);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("AllocatePool did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * teardown() - tear down unit test
+ *
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int teardown(void)
+{
+	int ret = EFI_ST_SUCCESS;
+
+	if (clock && boottime->close_event(clock) != EFI_SUCCESS) {
+		efi_st_error("Could not close event\n");
+		ret = EFI_ST_FAILURE;
+	}
+	if (buffers && boottime->free_pool(buffers) != EFI_SUCCESS) {
+		efi_st_error("FreePool did not return EFI_SUCCESS\n");
+		ret = EFI_ST_FAILURE;
+	}
+	if (pages && boottime->free_pool(pages) != EFI_SUCCESS) {
+		efi_st_error("FreePool did not return EFI_SUCCESS\n");
+		ret = EFI_ST_FAILURE;
+	}
+	return ret;
+}
+
+/**
+ * check_memory_map() - check that the memory map is sorted and consistent
+ *
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int check_memory_map(void)
+{
+	efi_uintn_t map_size = 0;
+	efi_uintn_t map_key;
+	efi_uintn_t desc_size;
+	u32 desc_version;
+	struct efi_mem_desc *memory_map, *prev, *entry;
+	efi_uintn_t i;
+	efi_status_t ret;
+
+	ret = boottime->get_memory_map(&map_size, NULL, &map_key, &desc_size,
+				       &desc_version);
+	if (ret != EFI_BUFFER_TOO_SMALL) {
+		efi_st_error
+			("GetMemoryMap did not return EFI_BUFFER_TOO_SMALL\n");
+		return EFI_ST_FAILURE;
+	}
+	/* Allocate extra space for newly allocated memory */
+	map_size += 2 * desc_size;
+	ret = boottime->allocate_pool(EFI_BOOT_SERVICES_DATA, map_size,
+				      (void **)&memory_map);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("AllocatePool did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = boottime->get_memory_map(&map_size, memory_map, &map_key,
+				       &desc_size, &desc_version);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("GetMemoryMap did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+
+	for (i = desc_size; i < map_size; i += desc_size) {
+		prev = (void *)memory_map + i - desc_size;
+		entry = (void *)memory_map + i;
+		if (prev->physical_start + (prev->num_pages << EFI_PAGE_SHIFT) >
+		    entry->physical_start) {
+			efi_st_error("Memory map not sorted or overlapping\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+
+	ret = boottime->free_pool(memory_map);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("FreePool did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * free_buffer() - check the contents of a buffer and free it
+ *
+ * @i:		index of the buffer
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int free_buffer(unsigned int i)
+{
+	efi_status_t ret;
+
+	if (*(u32 *)buffers[i] != i) {
+		efi_st_error("Pool memory overwritten\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = boottime->free_pool(buffers[i]);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("FreePool did not return EFI_SUCCESS\n");
+		return EFI_ST_FAILURE;
+	}
+	if (pages[i]) {
+		ret = boottime->free_pages(pages[i], 1 + i % 3);
+		if (ret != EFI_SUCCESS) {
+			efi_st_error("FreePages did not return EFI_SUCCESS\n");
+			return EFI_ST_FAILURE;
+		}
+	}
+	tick();
+	return EFI_ST_SUCCESS;
+}
+
+/**
+ * execute() - execute unit test
+ *
+ * Return:	EFI_ST_SUCCESS for success
+ */
+static int execute(void)
+{
+	unsigned int i, alloc_ticks;
+	efi_status_t ret;
+
+	ret = boottime->set_timer(clock, EFI_TIMER_PERIODIC,
+				  EFI_ST_CLOCK_PERIOD);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Could not set timer\n");
+		return EFI_ST_FAILURE;
+	}
+	ticks = 0;
+
+	for (i = 0; i < EFI_ST_ALLOCATIONS; ++i) {
+		/* Mostly small buffers of varying size and type */
+		ret = boottime->allocate_pool(i % 3 ? EFI_LOADER_DATA :
+					      EFI_BOOT_SERVICES_DATA,
+					      sizeof(u32) + i * 37 % 3000,
+					      &buffers[i]);
+		if (ret != EFI_SUCCESS) {
+			efi_st_error("AllocatePool did not return EFI_SUCCESS\n");
+			return EFI_ST_FAILURE;
+		}
+		*(u32 *)buffers[i] = i;
+
+		pages[i] = 0;
+		if (!(i % 4)) {
+			ret = boottime->allocate_pages(EFI_ALLOCATE_ANY_PAGES,
+						       EFI_LOADER_DATA,
+						       1 + i % 3, &pages[i]);
+			if (ret != EFI_SUCCESS) {
+				efi_st_error("AllocatePages did not return EFI_SUCCESS\n");
+				return EFI_ST_FAILURE;
+			}
+		}
+		tick();
+	}
+	alloc_ticks = ticks;
+
+	if (check_memory_map() != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+
+	/* Free every other buffer first, to leave holes */
+	for (i = 1; i < EFI_ST_ALLOCATIONS; i += 2) {
+		if (free_buffer(i) != EFI_ST_SUCCESS)
+			return EFI_ST_FAILURE;
+	}
+	if (boottime->free_pool(buffers[1]) == EFI_SUCCESS) {
+		efi_st_error("FreePool accepted a double free\n");
+		return EFI_ST_FAILURE;
+	}
+	if (check_memory_map() != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+	for (i = 0; i < EFI_ST_ALLOCATIONS; i += 2) {
+		if (free_buffer(i) != EFI_ST_SUCCESS)
+			return EFI_ST_FAILURE;
+	}
+	if (check_memory_map() != EFI_ST_SUCCESS)
+		return EFI_ST_FAILURE;
+
+	ret = boottime->set_timer(clock, EFI_TIMER_STOP, 0);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Could not stop timer\n");
+		return EFI_ST_FAILURE;
+	}
+	efi_st_printf("%u allocations in %u ms, freed in %u ms\n",
+		      EFI_ST_ALLOCATIONS, alloc_ticks, ticks - alloc_ticks);
+
+	return EFI_ST_SUCCESS;
+}
+
+EFI_UNIT_TEST(allocation) = {
+	.name = "memory allocation",
+	.phase = EFI_EXECUTE_BEFORE_BOOTTIME_EXIT,
+	.setup = setup,
+	.execute = execute,
+	.teardown = teardown,
+};
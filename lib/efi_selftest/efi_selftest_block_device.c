@@ -302,7 +302,7 @@ static int execute(void)
 	efi_handle_t handle_partition = NULL;
 	struct efi_device_path *dp_partition;
 	struct efi_simple_file_system_protocol *file_system;
-	struct efi_file_handle *root, *file;
+	struct efi_file_handle *root, *file, *file2;
 	struct {
 		struct efi_file_system_info info;
 		u16 label[12];
@@ -485,6 +485,47 @@ static int execute(void)
 		efi_st_error("Unexpected file content %s\n", buf);
 		return EFI_ST_FAILURE;
 	}
+
+	/* A write through another handle must be seen by this one */
+	ret = root->open(root, &file2, L"u-boot.txt", EFI_FILE_MODE_READ |
+			 EFI_FILE_MODE_WRITE, 0);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to open file\n");
+		return EFI_ST_FAILURE;
+	}
+	buf_size = 13;
+	boottime->copy_mem(buf, "U-Boot rules", buf_size);
+	ret = file2->write(file2, &buf_size, buf);
+	if (ret != EFI_SUCCESS || buf_size != 13) {
+		efi_st_error("Failed to write file\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = file2->close(file2);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to close file\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = file->setpos(file, 0);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("SetPosition failed\n");
+		return EFI_ST_FAILURE;
+	}
+	boottime->set_mem(buf, sizeof(buf), 0);
+	buf_size = sizeof(buf) - 1;
+	ret = file->read(file, &buf_size, buf);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to read file\n");
+		return EFI_ST_FAILURE;
+	}
+	if (buf_size != 13) {
+		efi_st_error("Wrong number of bytes read: %u\n",
+			     (unsigned int)buf_size);
+		return EFI_ST_FAILURE;
+	}
+	if (memcmp(buf, "U-Boot rules", 13)) {
+		efi_st_error("Unexpected file content %s\n", buf);
+		return EFI_ST_FAILURE;
+	}
 	ret = file->close(file);
 	if (ret != EFI_SUCCESS) {
 		efi_st_error("Failed to close file\n");
@@ -0,0 +1,192 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Index of the properties of a flattened device tree
+ *
+ * Property names are mapped to one canonical string offset each, since a
+ * tree may hold the same string more than once. Properties are then keyed
+ * by node offset and canonical name offset in an open-addressed hash
+ * table.
+ */
+
+#include <common.h>
+#include <fdt_index.h>
+#include <log.h>
+#include <malloc.h>
+#include <linux/log2.h>
+
+/**
+ * struct fdt_index_prop - a property in the index
+ *
+ * @node: Offset of the node, -1 for an empty slot
+ * @nameoff: Canonical string offset of the property name
+ * @offset: Offset of the property
+ */
+struct fdt_index_prop {
+	int node;
+	int nameoff;
+	int offset;
+};
+
+static uint fdt_index_hash_name(const char *name)
+{
+	uint hash = 2166136261U;
+
+	while (*name)
+		hash = (hash ^ (u8)*name++) * 16777619U;
+
+	return hash;
+}
+
+static uint fdt_index_hash_prop(int node, int nameoff)
+{
+	uint hash = node * 0x9e3779b1U + nameoff * 0x85ebca6bU;
+
+	return hash ^ (hash >> 16);
+}
+
+/*
+ * Find the slot of a name in the names table: either the slot holding it
+ * or the empty slot where it would go
+ */
+static int *fdt_index_find_name(const struct fdt_index *idx, const char *name)
+{
+	const char *strtab = idx->fdt + fdt_off_dt_strings(idx->fdt);
+	uint i = fdt_index_hash_name(name);
+	int *slot;
+
+	for (;; i++) {
+		slot = &idx->names[i & idx->name_mask];
+		if (*slot < 0 || !strcmp(strtab + *slot, name))
+			return slot;
+	}
+}
+
+static struct fdt_index_prop *fdt_index_find_prop(const struct fdt_index *idx,
+						  int node, int nameoff)
+{
+	struct fdt_index_prop *slot;
+	uint i = fdt_index_hash_prop(node, nameoff);
+
+	for (;; i++) {
+		slot = &idx->props[i & idx->prop_mask];
+		if (slot->node < 0 ||
+		    (slot->node == node && slot->nameoff == nameoff))
+			return slot;
+	}
+}
+
+/* Add all properties of the tree to the index */
+static int fdt_index_add_props(struct fdt_index *idx)
+{
+	const void *fdt = idx->fdt;
+	int node, prop;
+
+	for (node = 0; node >= 0; node = fdt_next_node(fdt, node, NULL)) {
+		fdt_for_each_property_offset(prop, fdt, node) {
+			struct fdt_index_prop *slot;
+			const char *name;
+			int *name_slot;
+
+			if (!fdt_getprop_by_offset(fdt, prop, &name, NULL))
+				return -FDT_ERR_BADSTRUCTURE;
+			name_slot = fdt_index_find_name(idx, name);
+			if (*name_slot < 0)
+				*name_slot = name - (const char *)fdt -
+					fdt_off_dt_strings(fdt);
+
+			/* the first of any duplicates wins, like fdt_getprop() */
+			slot = fdt_index_find_prop(idx, node, *name_slot);
+			if (slot->node < 0) {
+				slot->node = node;
+				slot->nameoff = *name_slot;
+				slot->offset = prop;
+			}
+		}
+		if (prop != -FDT_ERR_NOTFOUND)
+			return prop;
+	}
+	if (node != -FDT_ERR_NOTFOUND)
+		return node;
+
+	return 0;
+}
+
+int fdt_index_init(struct fdt_index *idx, const void *fdt)
+{
+	int node, prop, props = 0;
+	int ret, i;
+
+	memset(idx, '\0', sizeof(*idx));
+	idx->fdt = fdt;
+	idx->move_count = fdt_move_count;
+
+	for (node = 0; node >= 0; node = fdt_next_node(fdt, node, NULL)) {
+		fdt_for_each_property_offset(prop, fdt, node)
+			props++;
+	}
+
+	/*
+	 * Keep the tables at most half full. There cannot be more distinct
+	 * names than properties.
+	 */
+	idx->name_mask = roundup_pow_of_two(props * 2 + 1) - 1;
+	idx->prop_mask = idx->name_mask;
+	idx->names = malloc((idx->name_mask + 1) * sizeof(*idx->names));
+	idx->props = malloc((idx->prop_mask + 1) * sizeof(*idx->props));
+	if (!idx->names || !idx->props) {
+		ret = -FDT_ERR_NOSPACE;
+		goto err;
+	}
+	memset(idx->names, 0xff, (idx->name_mask + 1) * sizeof(*idx->names));
+	for (i = 0; i <= idx->prop_mask; i++)
+		idx->props[i].node = -1;
+
+	ret = fdt_index_add_props(idx);
+	if (ret)
+		goto err;
+	log_debug("indexed %d properties\n", props);
+
+	return 0;
+
+err:
+	log_debug("cannot index tree: %s\n", fdt_strerror(ret));
+	fdt_index_uninit(idx);
+
+	return ret;
+}
+
+void fdt_index_uninit(struct fdt_index *idx)
+{
+	free(idx->props);
+	free(idx->names);
+	idx->props = NULL;
+	idx->names = NULL;
+}
+
+const void *fdt_index_getprop(const struct fdt_index *idx, int nodeoffset,
+			      const char *name, int *lenp)
+{
+	struct fdt_index_prop *slot;
+	const void *val;
+	int nameoff;
+
+	if (!idx->props)
+		return fdt_getprop(idx->fdt, nodeoffset, name, lenp);
+
+	/* A name which is not in the tree at all is common, e.g. "status" */
+	nameoff = *fdt_index_find_name(idx, name);
+	if (nameoff >= 0) {
+		slot = fdt_index_find_prop(idx, nodeoffset, nameoff);
+		if (slot->node >= 0) {
+			/* fdt_nop_property() leaves the offsets as they are */
+			val = fdt_getprop_by_offset(idx->fdt, slot->offset,
+						    NULL, lenp);
+			if (val)
+				return val;
+		}
+	}
+	if (lenp)
+		*lenp = -FDT_ERR_NOTFOUND;
+
+	return NULL;
+}
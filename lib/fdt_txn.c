@@ -0,0 +1,725 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Batched edits of a flattened device tree
+ *
+ * Edits are recorded against the offsets of the unmodified tree. On
+ * commit the structure block is rebuilt in one sequential pass into a
+ * scratch buffer: the parts between edited nodes are copied as they are
+ * (keeping their string offsets, since the strings block is copied
+ * unchanged) and new property names are appended to the end of the
+ * strings block.
+ */
+
+#include <common.h>
+#include <fdt_txn.h>
+#include <log.h>
+#include <malloc.h>
+#include <sort.h>
+#include <linux/libfdt.h>
+
+/*
+ * With only a few edits, moving the tail of the tree for each one is
+ * cheaper than rebuilding the whole tree, so such transactions are
+ * applied in place
+ */
+#define FDT_TXN_INPLACE_MAX	8
+
+/**
+ * struct fdt_txn_prop - a pending property edit
+ *
+ * @list: Link in the props list of struct fdt_txn_node
+ * @name: Property name
+ * @val: New value, NULL to delete the property
+ * @len: Length of @val
+ * @nameoff: Offset of @name in the strings block of the rebuilt tree
+ * @done: true once the property has been written to the rebuilt tree
+ */
+struct fdt_txn_prop {
+	struct list_head list;
+	char *name;
+	void *val;
+	int len;
+	int nameoff;
+	bool done;
+};
+
+/**
+ * struct fdt_txn_node - pending edits of a node
+ *
+ * @list: Link in the nodes list of struct fdt_txn
+ * @node: Offset of the node in the tree, or handle of an added node
+ * @parent: Offset or handle of the parent, for added nodes only
+ * @deleted: true if the node is deleted
+ * @children: Number of subnodes added to the node
+ * @props: List of struct fdt_txn_prop
+ * @name: Name of the node, for added nodes only
+ */
+struct fdt_txn_node {
+	struct list_head list;
+	int node;
+	int parent;
+	bool deleted;
+	int children;
+	struct list_head props;
+	char name[];
+};
+
+/* Output state of a rebuild */
+struct fdt_txn_out {
+	char *buf;
+	int size;
+	int len;
+	int err;
+};
+
+static bool fdt_txn_is_added(int node)
+{
+	return node >= FDT_TXN_HANDLE_BASE;
+}
+
+static struct fdt_txn_node *fdt_txn_find(struct fdt_txn *txn, int node)
+{
+	struct fdt_txn_node *tnode;
+
+	list_for_each_entry(tnode, &txn->nodes, list) {
+		if (tnode->node == node)
+			return tnode;
+	}
+
+	return NULL;
+}
+
+static struct fdt_txn_prop *fdt_txn_find_prop(struct fdt_txn_node *tnode,
+					      const char *name)
+{
+	struct fdt_txn_prop *tprop;
+
+	list_for_each_entry(tprop, &tnode->props, list) {
+		if (!strcmp(tprop->name, name))
+			return tprop;
+	}
+
+	return NULL;
+}
+
+static struct fdt_txn_node *fdt_txn_get(struct fdt_txn *txn, int node)
+{
+	struct fdt_txn_node *tnode;
+
+	tnode = fdt_txn_find(txn, node);
+	if (tnode)
+		return tnode->deleted ? NULL : tnode;
+
+	/* added nodes always have a record, so this is an existing node */
+	if (fdt_txn_is_added(node) || !fdt_get_name(txn->fdt, node, NULL))
+		return NULL;
+
+	tnode = calloc(1, sizeof(*tnode));
+	if (!tnode)
+		return NULL;
+	tnode->node = node;
+	tnode->parent = -1;
+	INIT_LIST_HEAD(&tnode->props);
+	list_add_tail(&tnode->list, &txn->nodes);
+
+	return tnode;
+}
+
+void fdt_txn_init(struct fdt_txn *txn, void *fdt)
+{
+	txn->fdt = fdt;
+	INIT_LIST_HEAD(&txn->nodes);
+	txn->next_handle = FDT_TXN_HANDLE_BASE;
+	txn->edits = 0;
+}
+
+static int fdt_txn_set(struct fdt_txn *txn, int node, const char *name,
+		       const void *val, int len)
+{
+	struct fdt_txn_node *tnode;
+	struct fdt_txn_prop *tprop;
+	int name_len = strlen(name) + 1;
+
+	tnode = fdt_txn_get(txn, node);
+	if (!tnode)
+		return -FDT_ERR_BADOFFSET;
+
+	tprop = fdt_txn_find_prop(tnode, name);
+	if (tprop) {
+		list_del(&tprop->list);
+		free(tprop);
+	}
+
+	/* name and value go in the same allocation */
+	tprop = malloc(sizeof(*tprop) + name_len + (val ? len : 0));
+	if (!tprop)
+		return -FDT_ERR_NOSPACE;
+	tprop->name = (char *)(tprop + 1);
+	memcpy(tprop->name, name, name_len);
+	tprop->val = NULL;
+	tprop->len = 0;
+	if (val) {
+		tprop->val = tprop->name + name_len;
+		tprop->len = len;
+		memcpy(tprop->val, val, len);
+	}
+	tprop->done = false;
+	list_add_tail(&tprop->list, &tnode->props);
+	txn->edits++;
+
+	return 0;
+}
+
+int fdt_txn_setprop(struct fdt_txn *txn, int node, const char *name,
+		    const void *val, int len)
+{
+	if (len < 0 || (len && !val))
+		return -FDT_ERR_BADVALUE;
+
+	/* a NULL value marks a deletion, so use a dummy for empty ones */
+	return fdt_txn_set(txn, node, name, len ? val : "", len);
+}
+
+int fdt_txn_delprop(struct fdt_txn *txn, int node, const char *name)
+{
+	return fdt_txn_set(txn, node, name, NULL, 0);
+}
+
+int fdt_txn_add_subnode(struct fdt_txn *txn, int parent, const char *name)
+{
+	struct fdt_txn_node *tnode, *tparent;
+	int name_len = strlen(name) + 1;
+
+	tparent = fdt_txn_get(txn, parent);
+	if (!tparent)
+		return -FDT_ERR_BADOFFSET;
+
+	if (!fdt_txn_is_added(parent) &&
+	    fdt_subnode_offset(txn->fdt, parent, name) >= 0)
+		return -FDT_ERR_EXISTS;
+	list_for_each_entry(tnode, &txn->nodes, list) {
+		if (tnode->parent == parent && !tnode->deleted &&
+		    !strcmp(tnode->name, name))
+			return -FDT_ERR_EXISTS;
+	}
+
+	tnode = calloc(1, sizeof(*tnode) + name_len);
+	if (!tnode)
+		return -FDT_ERR_NOSPACE;
+	tnode->node = txn->next_handle++;
+	tnode->parent = parent;
+	INIT_LIST_HEAD(&tnode->props);
+	memcpy(tnode->name, name, name_len);
+	list_add_tail(&tnode->list, &txn->nodes);
+	tparent->children++;
+	txn->edits++;
+
+	return tnode->node;
+}
+
+int fdt_txn_del_node(struct fdt_txn *txn, int node)
+{
+	struct fdt_txn_node *tnode;
+
+	if (!node)
+		return -FDT_ERR_BADOFFSET;
+	tnode = fdt_txn_get(txn, node);
+	if (!tnode)
+		return -FDT_ERR_BADOFFSET;
+	tnode->deleted = true;
+	txn->edits++;
+
+	return 0;
+}
+
+void fdt_txn_abort(struct fdt_txn *txn)
+{
+	struct fdt_txn_node *tnode, *tnode_next;
+	struct fdt_txn_prop *tprop, *tprop_next;
+
+	list_for_each_entry_safe(tnode, tnode_next, &txn->nodes, list) {
+		list_for_each_entry_safe(tprop, tprop_next, &tnode->props,
+					 list)
+			free(tprop);
+		free(tnode);
+	}
+	INIT_LIST_HEAD(&txn->nodes);
+	txn->edits = 0;
+}
+
+/* Reserve @len bytes (rounded up to the tag alignment) in the output */
+static void *fdt_txn_grab(struct fdt_txn_out *out, int len)
+{
+	int alen = ALIGN(len, FDT_TAGSIZE);
+	char *ptr;
+
+	if (out->err)
+		return NULL;
+	if (out->len + alen > out->size) {
+		out->err = -FDT_ERR_NOSPACE;
+		return NULL;
+	}
+	ptr = out->buf + out->len;
+	memset(ptr + len, '\0', alen - len);
+	out->len += alen;
+
+	return ptr;
+}
+
+static void fdt_txn_put_tag(struct fdt_txn_out *out, uint32_t tag)
+{
+	fdt32_t *ptr = fdt_txn_grab(out, sizeof(*ptr));
+
+	if (ptr)
+		*ptr = cpu_to_fdt32(tag);
+}
+
+static void fdt_txn_put_begin(struct fdt_txn_out *out, const char *name,
+			      int len)
+{
+	char *ptr;
+
+	fdt_txn_put_tag(out, FDT_BEGIN_NODE);
+	ptr = fdt_txn_grab(out, len + 1);
+	if (ptr) {
+		memcpy(ptr, name, len);
+		ptr[len] = '\0';
+	}
+}
+
+static void fdt_txn_put_prop(struct fdt_txn_out *out, int nameoff,
+			     const void *val, int len)
+{
+	struct fdt_property *prop;
+
+	prop = fdt_txn_grab(out, sizeof(*prop) + len);
+	if (prop) {
+		prop->tag = cpu_to_fdt32(FDT_PROP);
+		prop->len = cpu_to_fdt32(len);
+		prop->nameoff = cpu_to_fdt32(nameoff);
+		memcpy(prop->data, val, len);
+	}
+}
+
+/* Write the pending properties which are not written yet */
+static void fdt_txn_put_new_props(struct fdt_txn_out *out,
+				  struct fdt_txn_node *tnode)
+{
+	struct fdt_txn_prop *tprop;
+
+	if (!tnode)
+		return;
+	list_for_each_entry(tprop, &tnode->props, list) {
+		if (!tprop->done && tprop->val)
+			fdt_txn_put_prop(out, tprop->nameoff, tprop->val,
+					 tprop->len);
+	}
+}
+
+/* Write the subnodes added to a node */
+static void fdt_txn_put_new_nodes(struct fdt_txn *txn,
+				  struct fdt_txn_out *out, int node)
+{
+	struct fdt_txn_node *child;
+
+	list_for_each_entry(child, &txn->nodes, list) {
+		if (child->parent != node || child->deleted)
+			continue;
+		fdt_txn_put_begin(out, child->name, strlen(child->name));
+		fdt_txn_put_new_props(out, child);
+		fdt_txn_put_new_nodes(txn, out, child->node);
+		fdt_txn_put_tag(out, FDT_END_NODE);
+	}
+}
+
+/* Copy a span of the original structure block as it is */
+static void fdt_txn_put_raw(struct fdt_txn_out *out, const void *fdt,
+			    int start, int end)
+{
+	char *ptr;
+
+	if (end <= start)
+		return;
+	ptr = fdt_txn_grab(out, end - start);
+	if (ptr)
+		memcpy(ptr, fdt_offset_ptr(fdt, start, 0), end - start);
+}
+
+/* Return the offset just past the FDT_END_NODE tag of a node */
+static int fdt_txn_node_end(const void *fdt, int node)
+{
+	int offset = node, depth = 0, next;
+	uint32_t tag;
+
+	do {
+		tag = fdt_next_tag(fdt, offset, &next);
+		if (next < 0)
+			return next;
+		if (tag == FDT_BEGIN_NODE)
+			depth++;
+		else if (tag == FDT_END_NODE)
+			depth--;
+		else if (tag == FDT_END)
+			return -FDT_ERR_BADSTRUCTURE;
+		offset = next;
+	} while (depth > 0);
+
+	return offset;
+}
+
+/*
+ * Write the begin tag and the properties of an edited node, returning the
+ * offset in the original tree where its subnodes start
+ */
+static int fdt_txn_put_props(struct fdt_txn_out *out, const void *fdt,
+			     struct fdt_txn_node *tnode)
+{
+	int offset, next, prop, len;
+	uint32_t tag;
+
+	fdt_next_tag(fdt, tnode->node, &offset);
+	fdt_txn_put_raw(out, fdt, tnode->node, offset);
+
+	fdt_for_each_property_offset(prop, fdt, tnode->node) {
+		const struct fdt_property *fprop;
+		struct fdt_txn_prop *tprop;
+		int nameoff;
+
+		fprop = fdt_get_property_by_offset(fdt, prop, &len);
+		if (!fprop) {
+			out->err = len;
+			return len;
+		}
+		nameoff = fdt32_to_cpu(fprop->nameoff);
+		tprop = fdt_txn_find_prop(tnode, fdt_string(fdt, nameoff));
+		if (!tprop) {
+			fdt_txn_put_prop(out, nameoff, fprop->data, len);
+		} else {
+			if (tprop->val)
+				fdt_txn_put_prop(out, tprop->nameoff,
+						 tprop->val, tprop->len);
+			tprop->done = true;
+		}
+	}
+
+	/* properties must come before any subnode */
+	fdt_txn_put_new_props(out, tnode);
+
+	/* skip the original properties, and any NOPs among them */
+	for (;;) {
+		tag = fdt_next_tag(fdt, offset, &next);
+		if (tag != FDT_PROP && tag != FDT_NOP)
+			break;
+		offset = next;
+	}
+
+	return offset;
+}
+
+/**
+ * struct fdt_txn_end - a pending end of an edited node
+ *
+ * @offset: Offset of the FDT_END_NODE tag of the node
+ * @tnode: Edited node
+ */
+struct fdt_txn_end {
+	int offset;
+	struct fdt_txn_node *tnode;
+};
+
+/*
+ * Write the structure block. Untouched parts of the tree are copied in
+ * spans between the edited nodes, which are visited by ascending offset.
+ * Subnodes added to a node go just before its FDT_END_NODE tag, i.e. after
+ * any edited nodes inside it, so these insertion points are kept on a
+ * stack until the copy reaches them.
+ */
+static void fdt_txn_put_struct(struct fdt_txn *txn, struct fdt_txn_out *out,
+			       struct fdt_txn_node **sorted, int count,
+			       struct fdt_txn_end *stack)
+{
+	const void *fdt = txn->fdt;
+	int struct_end = fdt_size_dt_struct(fdt);
+	int src = 0, depth = 0, i;
+
+	for (i = 0; i <= count && !out->err; i++) {
+		int next = i < count ? sorted[i]->node : struct_end;
+		struct fdt_txn_node *tnode;
+		int end;
+
+		while (depth && stack[depth - 1].offset <= next) {
+			depth--;
+			fdt_txn_put_raw(out, fdt, src, stack[depth].offset);
+			src = stack[depth].offset;
+			fdt_txn_put_new_nodes(txn, out, stack[depth].tnode->node);
+		}
+		if (i == count)
+			break;
+
+		/*
+		 * Added nodes are written along with their parent, and nodes
+		 * inside a deleted node are skipped with it
+		 */
+		tnode = sorted[i];
+		if (fdt_txn_is_added(tnode->node) || tnode->node < src)
+			continue;
+
+		fdt_txn_put_raw(out, fdt, src, tnode->node);
+		end = fdt_txn_node_end(fdt, tnode->node);
+		if (end < 0) {
+			out->err = end;
+			break;
+		}
+		if (tnode->deleted) {
+			src = end;
+			continue;
+		}
+		src = fdt_txn_put_props(out, fdt, tnode);
+		if (tnode->children) {
+			stack[depth].offset = end - FDT_TAGSIZE;
+			stack[depth++].tnode = tnode;
+		}
+	}
+	fdt_txn_put_raw(out, fdt, src, struct_end);
+}
+
+/* Sort node records by ascending offset, added nodes last */
+static int fdt_txn_cmp(const void *a, const void *b)
+{
+	const struct fdt_txn_node *na = *(const struct fdt_txn_node **)a;
+	const struct fdt_txn_node *nb = *(const struct fdt_txn_node **)b;
+
+	return na->node - nb->node;
+}
+
+static struct fdt_txn_node **fdt_txn_sort(struct fdt_txn *txn, int *countp)
+{
+	struct fdt_txn_node **sorted, *tnode;
+	int count = 0;
+
+	list_for_each_entry(tnode, &txn->nodes, list)
+		count++;
+	sorted = malloc(count * sizeof(*sorted) + 1);
+	if (!sorted)
+		return NULL;
+	count = 0;
+	list_for_each_entry(tnode, &txn->nodes, list)
+		sorted[count++] = tnode;
+	qsort(sorted, count, sizeof(*sorted), fdt_txn_cmp);
+	*countp = count;
+
+	return sorted;
+}
+
+/* Find a string in the strings block, returning its offset or -1 */
+static int fdt_txn_find_string(const char *strtab, int tabsize,
+			       const char *s)
+{
+	int len = strlen(s) + 1;
+	const char *last = strtab + tabsize - len;
+	const char *p;
+
+	for (p = strtab; p <= last; p++) {
+		if (!memcmp(p, s, len))
+			return p - strtab;
+	}
+
+	return -1;
+}
+
+/*
+ * Rebuild the tree with the edits applied, using @buf (of the same size
+ * as the tree) as scratch space
+ */
+static int fdt_txn_rebuild(struct fdt_txn *txn, char *buf)
+{
+	void *fdt = txn->fdt;
+	const char *strtab = fdt + fdt_off_dt_strings(fdt);
+	int strtab_size = fdt_size_dt_strings(fdt);
+	int rsv_size, struct_off, new_size = 0;
+	struct fdt_txn_node **sorted, *tnode;
+	struct fdt_txn_end *stack;
+	struct fdt_txn_prop *tprop;
+	struct fdt_txn_out out;
+	char *new_strings, *rsv;
+	int count = 0;
+
+	if (fdt_version(fdt) < 17)
+		return -FDT_ERR_BADVERSION;
+
+	/*
+	 * Work out where each property name ends up in the strings block,
+	 * collecting the names which are not there yet
+	 */
+	list_for_each_entry(tnode, &txn->nodes, list) {
+		list_for_each_entry(tprop, &tnode->props, list)
+			new_size += strlen(tprop->name) + 1;
+	}
+	new_strings = malloc(new_size + 1);
+	sorted = fdt_txn_sort(txn, &count);
+	stack = malloc(count * sizeof(*stack) + 1);
+	if (!new_strings || !sorted || !stack) {
+		out.err = -FDT_ERR_NOSPACE;
+		goto err;
+	}
+	new_size = 0;
+	list_for_each_entry(tnode, &txn->nodes, list) {
+		list_for_each_entry(tprop, &tnode->props, list) {
+			int off;
+
+			off = fdt_txn_find_string(strtab, strtab_size,
+						  tprop->name);
+			if (off < 0 && tprop->val) {
+				off = fdt_txn_find_string(new_strings,
+							  new_size,
+							  tprop->name);
+				if (off < 0) {
+					off = new_size;
+					strcpy(new_strings + off, tprop->name);
+					new_size += strlen(tprop->name) + 1;
+				}
+				off += strtab_size;
+			}
+			tprop->nameoff = off;
+		}
+	}
+
+	out.buf = buf;
+	out.size = fdt_totalsize(fdt);
+	out.err = 0;
+
+	/* Header, followed by the memory reservation map as it is */
+	rsv_size = (fdt_num_mem_rsv(fdt) + 1) *
+		sizeof(struct fdt_reserve_entry);
+	out.len = sizeof(struct fdt_header);
+	rsv = fdt_txn_grab(&out, rsv_size);
+	if (rsv)
+		memcpy(rsv, fdt + fdt_off_mem_rsvmap(fdt), rsv_size);
+
+	struct_off = out.len;
+	fdt_txn_put_struct(txn, &out, sorted, count, stack);
+	if (!out.err && out.len + strtab_size + new_size > out.size)
+		out.err = -FDT_ERR_NOSPACE;
+	if (out.err)
+		goto err;
+
+	memcpy(buf + out.len, strtab, strtab_size);
+	memcpy(buf + out.len + strtab_size, new_strings, new_size);
+
+	fdt_set_magic(buf, FDT_MAGIC);
+	fdt_set_totalsize(buf, out.size);
+	fdt_set_off_mem_rsvmap(buf, sizeof(struct fdt_header));
+	fdt_set_off_dt_struct(buf, struct_off);
+	fdt_set_size_dt_struct(buf, out.len - struct_off);
+	fdt_set_off_dt_strings(buf, out.len);
+	fdt_set_size_dt_strings(buf, strtab_size + new_size);
+	fdt_set_version(buf, 17);
+	fdt_set_last_comp_version(buf, 16);
+	fdt_set_boot_cpuid_phys(buf, fdt_boot_cpuid_phys(fdt));
+
+	memcpy(fdt, buf, out.len + strtab_size + new_size);
+err:
+	free(stack);
+	free(sorted);
+	free(new_strings);
+
+	return out.err;
+}
+
+static int fdt_txn_apply_props(struct fdt_txn_node *tnode, void *fdt,
+			       int offset)
+{
+	struct fdt_txn_prop *tprop;
+	int ret;
+
+	list_for_each_entry(tprop, &tnode->props, list) {
+		if (tprop->val) {
+			ret = fdt_setprop(fdt, offset, tprop->name,
+					  tprop->val, tprop->len);
+		} else {
+			ret = fdt_delprop(fdt, offset, tprop->name);
+			if (ret == -FDT_ERR_NOTFOUND)
+				ret = 0;
+		}
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int fdt_txn_apply_new(struct fdt_txn *txn, int node, int offset)
+{
+	struct fdt_txn_node *child;
+	int ret;
+
+	list_for_each_entry(child, &txn->nodes, list) {
+		int child_offset;
+
+		if (child->parent != node || child->deleted)
+			continue;
+		child_offset = fdt_add_subnode(txn->fdt, offset, child->name);
+		if (child_offset < 0)
+			return child_offset;
+		ret = fdt_txn_apply_props(child, txn->fdt, child_offset);
+		if (ret)
+			return ret;
+		ret = fdt_txn_apply_new(txn, child->node, child_offset);
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+/*
+ * Apply the edits with the normal libfdt functions. Editing a node only
+ * moves the nodes after it, so going through the nodes by descending
+ * offset keeps the offsets of the remaining ones valid.
+ */
+static int fdt_txn_apply(struct fdt_txn *txn)
+{
+	struct fdt_txn_node **sorted, *tnode;
+	int count, ret = 0, i;
+
+	sorted = fdt_txn_sort(txn, &count);
+	if (!sorted)
+		return -FDT_ERR_NOSPACE;
+
+	for (i = count - 1; i >= 0 && !ret; i--) {
+		tnode = sorted[i];
+		/* added nodes are handled along with their parent */
+		if (fdt_txn_is_added(tnode->node))
+			continue;
+		if (tnode->deleted) {
+			ret = fdt_del_node(txn->fdt, tnode->node);
+			continue;
+		}
+		ret = fdt_txn_apply_props(tnode, txn->fdt, tnode->node);
+		if (!ret)
+			ret = fdt_txn_apply_new(txn, tnode->node, tnode->node);
+	}
+	free(sorted);
+
+	return ret;
+}
+
+int fdt_txn_commit(struct fdt_txn *txn)
+{
+	char *buf = NULL;
+	int ret;
+
+	if (txn->edits > FDT_TXN_INPLACE_MAX)
+		buf = malloc(fdt_totalsize(txn->fdt));
+	if (buf) {
+		ret = fdt_txn_rebuild(txn, buf);
+		free(buf);
+	} else {
+		/* few edits, or no memory for a rebuild */
+		log_debug("applying %d edits in place\n", txn->edits);
+		ret = fdt_txn_apply(txn);
+	}
+	fdt_txn_abort(txn);
+
+	return ret;
+}
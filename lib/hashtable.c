@@ -92,6 +92,43 @@ static int isprime(unsigned int number)
 	return number % div != 0;
 }
 
+/* Return the first prime number not smaller than nel */
+static unsigned int hprime(unsigned int nel)
+{
+	nel |= 1;		/* make odd */
+	while (!isprime(nel))
+		nel += 2;
+
+	return nel;
+}
+
+/*
+ * Compute the first hash value for a key: the result is in the range
+ * 1..size, zero is reserved to mark an unused slot.
+ */
+static unsigned int hhash(const char *key, unsigned int size)
+{
+	unsigned int len = strlen(key);
+	unsigned int hval = len;
+	unsigned int count = len;
+
+	/* Compute an value for the given string. Perhaps use a better method. */
+	while (count-- > 0) {
+		hval <<= 4;
+		hval += key[count];
+	}
+
+	/*
+	 * First hash function:
+	 * simply take the modul but prevent zero.
+	 */
+	hval %= size;
+	if (hval == 0)
+		++hval;
+
+	return hval;
+}
+
 /*
  * Before using the hash table we must allocate memory for it.
  * Test for an existing table are done. We allocate one element
@@ -115,13 +152,9 @@ int hcreate_r(size_t nel, struct hsearch_data *htab)
 		return 0;
 	}
 
-	/* Change nel to the first prime number not smaller as nel. */
-	nel |= 1;		/* make odd */
-	while (!isprime(nel))
-		nel += 2;
-
-	htab->size = nel;
+	htab->size = hprime(nel);
 	htab->filled = 0;
+	++htab->changes;
 
 	/* allocate memory and zero out */
 	htab->table = (struct env_entry_node *)calloc(htab->size + 1,
@@ -168,6 +201,57 @@ void hdestroy_r(struct hsearch_data *htab)
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
+	++htab->changes;
+}
+
+/*
+ * hresize()
+ */
+
+/*
+ * Move all entries into a new table of (at least) nel elements. The
+ * entries themselves (key, data, callback and flags) are moved as they
+ * are; only their position is recomputed, so no callbacks are invoked.
+ * Since the table is empty of deleted markers afterwards this also
+ * shortens the probe sequences of subsequent searches.
+ */
+static int hresize_r(struct hsearch_data *htab, unsigned int nel)
+{
+	struct env_entry_node *old = htab->table;
+	struct env_entry_node *table;
+	unsigned int old_size = htab->size;
+	unsigned int size, i;
+
+	size = hprime(nel);
+	table = calloc(size + 1, sizeof(struct env_entry_node));
+	if (!table)
+		return -ENOMEM;
+
+	for (i = 1; i <= old_size; ++i) {
+		unsigned int hval, hval2, idx;
+
+		if (old[i].used <= 0)
+			continue;
+
+		hval = hhash(old[i].entry.key, size);
+		hval2 = 1 + hval % (size - 2);
+		for (idx = hval; table[idx].used; ) {
+			if (idx <= hval2)
+				idx = size + idx - hval2;
+			else
+				idx -= hval2;
+		}
+		table[idx].used = hval;
+		table[idx].entry = old[i].entry;
+	}
+
+	debug("hresize: table %p grown from %u to %u entries\n", htab,
+	      old_size, size);
+	free(old);
+	htab->table = table;
+	htab->size = size;
+
+	return 0;
 }
 
 /*
@@ -279,6 +363,7 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 				*retval = NULL;
 				return 0;
 			}
+			++htab->changes;
 		}
 		/* return found entry */
 		*retval = &htab->table[idx].entry;
@@ -288,31 +373,16 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 	return -1;
 }
 
-int hsearch_r(struct env_entry item, enum env_action action,
-	      struct env_entry **retval, struct hsearch_data *htab, int flag)
+static int _hsearch_r(struct env_entry item, enum env_action action,
+		      struct env_entry **retval, struct hsearch_data *htab,
+		      int flag)
 {
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
-	}
-
-	/*
-	 * First hash function:
-	 * simply take the modul but prevent zero.
-	 */
-	hval %= htab->size;
-	if (hval == 0)
-		++hval;
+	hval = hhash(item.key, htab->size);
 
 	/* The first index tried. */
 	idx = hval;
@@ -399,6 +469,7 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		}
 
 		++htab->filled;
+		++htab->changes;
 
 		/* This is a new entry, so look up a possible callback */
 		env_callback_init(&htab->table[idx].entry);
@@ -437,6 +508,28 @@ int hsearch_r(struct env_entry item, enum env_action action,
 	return 0;
 }
 
+int hsearch_r(struct env_entry item, enum env_action action,
+	      struct env_entry **retval, struct hsearch_data *htab, int flag)
+{
+	int ret;
+
+	/*
+	 * Keep the load factor below 3/4 so that probe sequences stay short,
+	 * growing the table as needed. If that fails we carry on with the
+	 * current table until it is completely full. A search made from a
+	 * callback must not move the entry the outer search is working on.
+	 */
+	if (action == ENV_ENTER && !htab->nest &&
+	    htab->filled * 4 >= htab->size * 3)
+		hresize_r(htab, htab->size * 2);
+
+	htab->nest++;
+	ret = _hsearch_r(item, action, retval, htab, flag);
+	htab->nest--;
+
+	return ret;
+}
+
 
 /*
  * hdelete()
@@ -459,9 +552,10 @@ static void _hdelete(const char *key, struct hsearch_data *htab,
 	htab->table[idx].used = USED_DELETED;
 
 	--htab->filled;
+	++htab->changes;
 }
 
-int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
+static int _hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 {
 	struct env_entry e, *ep;
 	int idx;
@@ -499,6 +593,17 @@ int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
 	return 1;
 }
 
+int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
+{
+	int ret;
+
+	htab->nest++;
+	ret = _hdelete_r(key, htab, flag);
+	htab->nest--;
+
+	return ret;
+}
+
 #if !(defined(CONFIG_SPL_BUILD) && !defined(CONFIG_SPL_SAVEENV))
 /*
  * hexport()
@@ -612,7 +717,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 char **resp, size_t size,
 		 int argc, char *const argv[])
 {
-	struct env_entry *list[htab->size];
+	struct env_entry **list;
 	char *res, *p;
 	size_t totlen;
 	int i, n;
@@ -625,6 +730,14 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, size = %lu\n",
 	      htab, htab->size, htab->filled, (ulong)size);
+
+	/* the table may grow, so don't keep the list on the stack */
+	list = malloc(sizeof(*list) * (htab->filled + 1));
+	if (!list) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+
 	/*
 	 * Pass 1:
 	 * search used entries,
@@ -680,6 +793,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		if (size < totlen + 1) {	/* provided buffer too small */
 			printf("Env export buffer too small: %lu, but need %lu\n",
 			       (ulong)size, (ulong)totlen + 1);
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -696,6 +810,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		/* no, allocate and clear one */
 		*resp = res = calloc(1, size);
 		if (res == NULL) {
+			free(list);
 			__set_errno(ENOMEM);
 			return (-1);
 		}
@@ -722,6 +837,7 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		*p++ = sep;
 	}
 	*p = '\0';		/* terminate result */
+	free(list);
 
 	return size;
 }
@@ -853,7 +969,8 @@ int himport_r(struct hsearch_data *htab,
 	 * environment size), so we clip it to a reasonable value.
 	 * On the other hand we need to add some more entries for free
 	 * space when importing very small buffers. Both boundaries can
-	 * be overwritten in the board config file if needed.
+	 * be overwritten in the board config file if needed. Since the
+	 * table grows on demand, this only sets its initial size.
 	 */
 
 	if (!htab->table) {
@@ -49,41 +49,68 @@
 
 static void default_log(const char *ignored, char *response) {}
 
-int write_sparse_image(struct sparse_storage *info,
-		       const char *part_name, void *data, char *response)
+/*
+ * The fill buffer is allocated once and kept for the whole image. A large
+ * one means fewer, larger writes; if the heap is short, settle for less.
+ */
+static uint32_t *alloc_fill_buf(struct sparse_storage *info, int *num_blksp)
 {
-	lbaint_t blk;
-	lbaint_t blkcnt;
-	lbaint_t blks;
-	uint32_t bytes_written = 0;
-	unsigned int chunk;
-	unsigned int offset;
-	unsigned int chunk_data_sz;
-	uint32_t *fill_buf = NULL;
-	uint32_t fill_val;
-	sparse_header_t *sparse_header;
-	chunk_header_t *chunk_header;
-	uint32_t total_blocks = 0;
-	int fill_buf_num_blks;
-	int i;
-	int j;
-
-	fill_buf_num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
-
-	/* Read and skip over sparse image header */
-	sparse_header = (sparse_header_t *)data;
-
-	data += sparse_header->file_hdr_sz;
-	if (sparse_header->file_hdr_sz > sizeof(sparse_header_t)) {
-		/*
-		 * Skip the remaining bytes in a header that is longer than
-		 * we expected.
-		 */
-		data += (sparse_header->file_hdr_sz - sizeof(sparse_header_t));
+	uint32_t *buf;
+	int num_blks;
+
+	for (num_blks = CONFIG_IMAGE_SPARSE_FILLBUF_SIZE / info->blksz;
+	     num_blks; num_blks /= 2) {
+		buf = memalign(ARCH_DMA_MINALIGN,
+			       ROUNDUP(info->blksz * num_blks,
+				       ARCH_DMA_MINALIGN));
+		if (buf) {
+			*num_blksp = num_blks;
+			return buf;
+		}
 	}
 
-	if (!info->mssg)
-		info->mssg = default_log;
+	return NULL;
+}
+
+static int sparse_fail(struct sparse_stream *ss, const char *msg,
+		       char *response)
+{
+	ss->state = SPARSE_STREAM_ERROR;
+	ss->info->mssg(msg, response);
+
+	return -1;
+}
+
+/*
+ * Collect a header which may be split across pieces. Returns true once it
+ * is complete.
+ */
+static bool sparse_gather(struct sparse_stream *ss, void *hdr, uint size,
+			  const char **datap, size_t *lenp)
+{
+	uint n = min_t(size_t, size - ss->got, *lenp);
+
+	memcpy(hdr + ss->got, *datap, n);
+	ss->got += n;
+	*datap += n;
+	*lenp -= n;
+	if (ss->got < size)
+		return false;
+	ss->got = 0;
+
+	return true;
+}
+
+static void sparse_next_chunk(struct sparse_stream *ss)
+{
+	ss->state = --ss->chunks_left ? SPARSE_STREAM_CHUNK :
+		SPARSE_STREAM_DONE;
+}
+
+static int sparse_check_header(struct sparse_stream *ss, char *response)
+{
+	sparse_header_t *sparse_header = &ss->header;
+	unsigned int offset;
 
 	debug("=== Sparse Image Header ===\n");
 	debug("magic: 0x%x\n", sparse_header->magic);
@@ -95,170 +122,327 @@ int write_sparse_image(struct sparse_storage *info,
 	debug("total_blks: %d\n", sparse_header->total_blks);
 	debug("total_chunks: %d\n", sparse_header->total_chunks);
 
+	if (!is_sparse_image(sparse_header) ||
+	    sparse_header->file_hdr_sz < sizeof(sparse_header_t) ||
+	    sparse_header->chunk_hdr_sz < sizeof(chunk_header_t))
+		return sparse_fail(ss, "not a sparse image", response);
+
 	/*
 	 * Verify that the sparse block size is a multiple of our
 	 * storage backend block size
 	 */
-	div_u64_rem(sparse_header->blk_sz, info->blksz, &offset);
-	if (offset) {
+	div_u64_rem(sparse_header->blk_sz, ss->info->blksz, &offset);
+	if (!sparse_header->blk_sz || offset) {
 		printf("%s: Sparse image block size issue [%u]\n",
 		       __func__, sparse_header->blk_sz);
-		info->mssg("sparse image block size issue", response);
-		return -1;
+		return sparse_fail(ss, "sparse image block size issue",
+				   response);
 	}
 
 	puts("Flashing Sparse Image\n");
 
-	/* Start processing chunks */
-	blk = info->start;
-	for (chunk = 0; chunk < sparse_header->total_chunks; chunk++) {
-		/* Read and skip over chunk header */
-		chunk_header = (chunk_header_t *)data;
-		data += sizeof(chunk_header_t);
-
-		if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
-			debug("=== Chunk Header ===\n");
-			debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
-			debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
-			debug("total_size: 0x%x\n", chunk_header->total_sz);
-		}
+	/* Skip the remaining bytes in a header that is longer than expected */
+	ss->skip = sparse_header->file_hdr_sz - sizeof(sparse_header_t);
+	ss->chunks_left = sparse_header->total_chunks;
+	ss->state = ss->chunks_left ? SPARSE_STREAM_CHUNK : SPARSE_STREAM_DONE;
+
+	return 0;
+}
 
-		if (sparse_header->chunk_hdr_sz > sizeof(chunk_header_t)) {
-			/*
-			 * Skip the remaining bytes in a header that is longer
-			 * than we expected.
-			 */
-			data += (sparse_header->chunk_hdr_sz -
-				 sizeof(chunk_header_t));
+static int sparse_start_chunk(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	sparse_header_t *sparse_header = &ss->header;
+	chunk_header_t *chunk_header = &ss->chunk;
+	unsigned int chunk_data_sz;
+	lbaint_t blkcnt;
+
+	if (chunk_header->chunk_type != CHUNK_TYPE_RAW) {
+		debug("=== Chunk Header ===\n");
+		debug("chunk_type: 0x%x\n", chunk_header->chunk_type);
+		debug("chunk_data_sz: 0x%x\n", chunk_header->chunk_sz);
+		debug("total_size: 0x%x\n", chunk_header->total_sz);
+	}
+
+	/* Skip the remaining bytes in a header that is longer than expected */
+	ss->skip = sparse_header->chunk_hdr_sz - sizeof(chunk_header_t);
+
+	chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
+	blkcnt = chunk_data_sz / info->blksz;
+	switch (chunk_header->chunk_type) {
+	case CHUNK_TYPE_RAW:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + chunk_data_sz))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type Raw",
+					   response);
+		if (ss->blk + blkcnt > info->start + info->size) {
+			printf("%s: Request would exceed partition size!\n",
+			       __func__);
+			return sparse_fail(ss,
+					   "Request would exceed partition size!",
+					   response);
 		}
+		ss->raw_left = chunk_data_sz;
+		if (ss->raw_left)
+			ss->state = SPARSE_STREAM_RAW;
+		else
+			sparse_next_chunk(ss);
+		break;
 
-		chunk_data_sz = sparse_header->blk_sz * chunk_header->chunk_sz;
-		blkcnt = chunk_data_sz / info->blksz;
-		switch (chunk_header->chunk_type) {
-		case CHUNK_TYPE_RAW:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + chunk_data_sz)) {
-				info->mssg("Bogus chunk size for chunk type Raw",
+	case CHUNK_TYPE_FILL:
+		if (chunk_header->total_sz !=
+		    (sparse_header->chunk_hdr_sz + sizeof(uint32_t)))
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type FILL",
 					   response);
-				return -1;
-			}
+		if (ss->blk + blkcnt > info->start + info->size) {
+			printf("%s: Request would exceed partition size!\n",
+			       __func__);
+			return sparse_fail(ss,
+					   "Request would exceed partition size!",
+					   response);
+		}
+		ss->state = SPARSE_STREAM_FILL;
+		break;
+
+	case CHUNK_TYPE_DONT_CARE:
+		ss->blk += info->reserve(info, ss->blk, blkcnt);
+		ss->total_blocks += chunk_header->chunk_sz;
+		sparse_next_chunk(ss);
+		break;
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
+	case CHUNK_TYPE_CRC32:
+		if (chunk_header->total_sz != sparse_header->chunk_hdr_sz)
+			return sparse_fail(ss,
+					   "Bogus chunk size for chunk type Dont Care",
 					   response);
-				return -1;
-			}
+		ss->total_blocks += chunk_header->chunk_sz;
+		ss->skip += chunk_data_sz;
+		sparse_next_chunk(ss);
+		break;
 
-			blks = info->write(info, blk, blkcnt, data);
-			/* blks might be > blkcnt (eg. NAND bad-blocks) */
-			if (blks < blkcnt) {
-				printf("%s: %s" LBAFU " [" LBAFU "]\n",
-				       __func__, "Write failed, block #",
-				       blk, blks);
-				info->mssg("flash write failure", response);
-				return -1;
-			}
-			blk += blks;
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
-			break;
+	default:
+		printf("%s: Unknown chunk type: %x\n", __func__,
+		       chunk_header->chunk_type);
+		return sparse_fail(ss, "Unknown chunk type", response);
+	}
 
-		case CHUNK_TYPE_FILL:
-			if (chunk_header->total_sz !=
-			    (sparse_header->chunk_hdr_sz + sizeof(uint32_t))) {
-				info->mssg("Bogus chunk size for chunk type FILL", response);
-				return -1;
-			}
+	return 0;
+}
 
-			fill_buf = (uint32_t *)
-				   memalign(ARCH_DMA_MINALIGN,
-					    ROUNDUP(
-						info->blksz * fill_buf_num_blks,
-						ARCH_DMA_MINALIGN));
-			if (!fill_buf) {
-				info->mssg("Malloc failed for: CHUNK_TYPE_FILL",
-					   response);
-				return -1;
-			}
+static int sparse_write_raw(struct sparse_stream *ss, const void *data,
+			    lbaint_t blkcnt, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	lbaint_t blks;
 
-			fill_val = *(uint32_t *)data;
-			data = (char *)data + sizeof(uint32_t);
+	blks = info->write(info, ss->blk, blkcnt, data);
+	/* blks might be > blkcnt (eg. NAND bad-blocks) */
+	if (blks < blkcnt) {
+		printf("%s: %s" LBAFU " [" LBAFU "]\n", __func__,
+		       "Write failed, block #", ss->blk, blks);
+		return sparse_fail(ss, "flash write failure", response);
+	}
+	ss->blk += blks;
+	ss->bytes_written += blkcnt * info->blksz;
+	ss->raw_left -= blkcnt * info->blksz;
+	if (!ss->raw_left) {
+		ss->total_blocks += ss->chunk.chunk_sz;
+		sparse_next_chunk(ss);
+	}
 
-			for (i = 0;
-			     i < (info->blksz * fill_buf_num_blks /
-				  sizeof(fill_val));
-			     i++)
-				fill_buf[i] = fill_val;
+	return 0;
+}
 
-			if (blk + blkcnt > info->start + info->size) {
-				printf(
-				    "%s: Request would exceed partition size!\n",
-				    __func__);
-				info->mssg("Request would exceed partition size!",
-					   response);
-				return -1;
-			}
+static int sparse_write_fill(struct sparse_stream *ss, char *response)
+{
+	struct sparse_storage *info = ss->info;
+	unsigned int chunk_data_sz;
+	lbaint_t blkcnt, blks;
+	int i, j;
 
-			for (i = 0; i < blkcnt;) {
-				j = blkcnt - i;
-				if (j > fill_buf_num_blks)
-					j = fill_buf_num_blks;
-				blks = info->write(info, blk, j, fill_buf);
-				/* blks might be > j (eg. NAND bad-blocks) */
-				if (blks < j) {
-					printf("%s: %s " LBAFU " [%d]\n",
-					       __func__,
-					       "Write failed, block #",
-					       blk, j);
-					info->mssg("flash write failure",
-						   response);
-					free(fill_buf);
-					return -1;
-				}
-				blk += blks;
-				i += j;
-			}
-			bytes_written += blkcnt * info->blksz;
-			total_blocks += chunk_data_sz / sparse_header->blk_sz;
-			free(fill_buf);
-			break;
+	chunk_data_sz = ss->header.blk_sz * ss->chunk.chunk_sz;
+	blkcnt = chunk_data_sz / info->blksz;
 
-		case CHUNK_TYPE_DONT_CARE:
-			blk += info->reserve(info, blk, blkcnt);
-			total_blocks += chunk_header->chunk_sz;
-			break;
+	/* Let the storage zero blocks itself if it can */
+	i = 0;
+	if (!ss->fill_val && info->write_zeroes) {
+		blks = info->write_zeroes(info, ss->blk, blkcnt);
+		if (blks <= blkcnt) {
+			ss->blk += blks;
+			i = blks;
+		}
+	}
 
-		case CHUNK_TYPE_CRC32:
-			if (chunk_header->total_sz !=
-			    sparse_header->chunk_hdr_sz) {
-				info->mssg("Bogus chunk size for chunk type Dont Care",
+	if (i < blkcnt && !ss->fill_buf) {
+		ss->fill_buf = alloc_fill_buf(info, &ss->fill_buf_num_blks);
+		if (!ss->fill_buf)
+			return sparse_fail(ss,
+					   "Malloc failed for: CHUNK_TYPE_FILL",
 					   response);
-				return -1;
+	}
+	if (i < blkcnt &&
+	    (!ss->fill_buf_set || ss->fill_buf_val != ss->fill_val)) {
+		for (j = 0;
+		     j < (info->blksz * ss->fill_buf_num_blks /
+			  sizeof(ss->fill_val));
+		     j++)
+			ss->fill_buf[j] = ss->fill_val;
+		ss->fill_buf_val = ss->fill_val;
+		ss->fill_buf_set = true;
+	}
+
+	while (i < blkcnt) {
+		j = blkcnt - i;
+		if (j > ss->fill_buf_num_blks)
+			j = ss->fill_buf_num_blks;
+		blks = info->write(info, ss->blk, j, ss->fill_buf);
+		/* blks might be > j (eg. NAND bad-blocks) */
+		if (blks < j) {
+			printf("%s: %s " LBAFU " [%d]\n", __func__,
+			       "Write failed, block #", ss->blk, j);
+			return sparse_fail(ss, "flash write failure", response);
+		}
+		ss->blk += blks;
+		i += j;
+	}
+	ss->bytes_written += blkcnt * info->blksz;
+	ss->total_blocks += chunk_data_sz / ss->header.blk_sz;
+	sparse_next_chunk(ss);
+
+	return 0;
+}
+
+int sparse_stream_start(struct sparse_stream *ss, struct sparse_storage *info,
+			const char *part_name)
+{
+	memset(ss, '\0', sizeof(*ss));
+	ss->info = info;
+	ss->part_name = part_name;
+	ss->blk = info->start;
+	if (!info->mssg)
+		info->mssg = default_log;
+
+	/* Raw data split between pieces is put back together here */
+	ss->carry = memalign(ARCH_DMA_MINALIGN,
+			     ROUNDUP(info->blksz, ARCH_DMA_MINALIGN));
+	if (!ss->carry)
+		return -ENOMEM;
+
+	return 0;
+}
+
+int sparse_stream_write(struct sparse_stream *ss, const void *buf, size_t len,
+			char *response)
+{
+	struct sparse_storage *info = ss->info;
+	const char *data = buf;
+	size_t n;
+	int ret;
+
+	while (len) {
+		if (ss->skip) {
+			n = min_t(size_t, ss->skip, len);
+			ss->skip -= n;
+			data += n;
+			len -= n;
+			continue;
+		}
+
+		ret = 0;
+		switch (ss->state) {
+		case SPARSE_STREAM_HEADER:
+			if (sparse_gather(ss, &ss->header, sizeof(ss->header),
+					  &data, &len))
+				ret = sparse_check_header(ss, response);
+			break;
+		case SPARSE_STREAM_CHUNK:
+			if (sparse_gather(ss, &ss->chunk, sizeof(ss->chunk),
+					  &data, &len))
+				ret = sparse_start_chunk(ss, response);
+			break;
+		case SPARSE_STREAM_RAW:
+			/* Write whole blocks in place where possible */
+			if (!ss->carry_len && len >= info->blksz) {
+				n = min_t(size_t, len, ss->raw_left);
+				n -= n % info->blksz;
+				ret = sparse_write_raw(ss, data, n / info->blksz,
+						       response);
+				data += n;
+				len -= n;
+				break;
+			}
+			n = min_t(size_t, len, info->blksz - ss->carry_len);
+			memcpy(ss->carry + ss->carry_len, data, n);
+			ss->carry_len += n;
+			data += n;
+			len -= n;
+			if (ss->carry_len == info->blksz) {
+				ss->carry_len = 0;
+				ret = sparse_write_raw(ss, ss->carry, 1,
+						       response);
 			}
-			total_blocks += chunk_header->chunk_sz;
-			data += chunk_data_sz;
 			break;
-
-		default:
-			printf("%s: Unknown chunk type: %x\n", __func__,
-			       chunk_header->chunk_type);
-			info->mssg("Unknown chunk type", response);
+		case SPARSE_STREAM_FILL:
+			if (sparse_gather(ss, &ss->fill_val,
+					  sizeof(ss->fill_val), &data, &len))
+				ret = sparse_write_fill(ss, response);
+			break;
+		case SPARSE_STREAM_DONE:
+			/* Anything after the last chunk is ignored */
+			return 0;
+		case SPARSE_STREAM_ERROR:
 			return -1;
 		}
+		if (ret)
+			return ret;
 	}
 
+	return 0;
+}
+
+int sparse_stream_finish(struct sparse_stream *ss, char *response)
+{
+	enum sparse_stream_state state = ss->state;
+	int ret = -1;
+
+	free(ss->fill_buf);
+	free(ss->carry);
+	ss->fill_buf = NULL;
+	ss->carry = NULL;
+	if (state == SPARSE_STREAM_ERROR)
+		return -1;
+
 	debug("Wrote %d blocks, expected to write %d blocks\n",
-	      total_blocks, sparse_header->total_blks);
-	printf("........ wrote %u bytes to '%s'\n", bytes_written, part_name);
+	      ss->total_blocks, ss->header.total_blks);
+	printf("........ wrote %u bytes to '%s'\n", ss->bytes_written,
+	       ss->part_name);
+
+	if (state != SPARSE_STREAM_DONE ||
+	    ss->total_blocks != ss->header.total_blks)
+		ss->info->mssg("sparse image write failure", response);
+	else
+		ret = 0;
+
+	return ret;
+}
+
+int write_sparse_image(struct sparse_storage *info,
+		       const char *part_name, void *data, char *response)
+{
+	struct sparse_stream ss;
 
-	if (total_blocks != sparse_header->total_blks) {
-		info->mssg("sparse image write failure", response);
+	if (sparse_stream_start(&ss, info, part_name)) {
+		info->mssg("Malloc failed for sparse image", response);
 		return -1;
 	}
 
-	return 0;
+	/*
+	 * The length of the image is not known here, but the headers say how
+	 * much there is, and nothing is read after the last chunk
+	 */
+	sparse_stream_write(&ss, data, SIZE_MAX, response);
+
+	return sparse_stream_finish(&ss, response);
 }
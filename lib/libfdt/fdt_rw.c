@@ -1,2 +1,19 @@
 #include <linux/libfdt_env.h>
+
+/*
+ * U-Boot: count the edits which move parts of a tree, so that an index of
+ * property offsets (see fdt_index.h) can tell that it is stale. Every such
+ * edit in fdt_rw.c goes through memmove().
+ */
+ulong fdt_move_count;
+
+static void *fdt_memmove_(void *dest, const void *src, size_t n)
+{
+	fdt_move_count++;
+
+	return memmove(dest, src, n);
+}
+
+#define memmove fdt_memmove_
+
 #include "../../scripts/dtc/libfdt/fdt_rw.c"
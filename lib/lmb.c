@@ -12,8 +12,6 @@
 #include <log.h>
 #include <malloc.h>
 
-#define LMB_ALLOC_ANYWHERE	0
-
 void lmb_dump_all_force(struct lmb *lmb)
 {
 	unsigned long i;
@@ -78,15 +76,62 @@ static long lmb_regions_adjacent(struct lmb_region *rgn, unsigned long r1,
 	return lmb_addrs_adjacent(base1, size1, base2, size2);
 }
 
+/*
+ * Find the first region which ends at or above an address. Since the
+ * regions are sorted and do not overlap, this is the region holding the
+ * address if there is one.
+ */
+static unsigned long lmb_find_region(struct lmb_region *rgn, phys_addr_t addr)
+{
+	unsigned long lo = 0, hi = rgn->cnt, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2;
+		if (rgn->region[mid].base + rgn->region[mid].size - 1 < addr)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return lo;
+}
+
 static void lmb_remove_region(struct lmb_region *rgn, unsigned long r)
 {
-	unsigned long i;
+	memmove(&rgn->region[r], &rgn->region[r + 1],
+		(rgn->cnt - r - 1) * sizeof(rgn->region[0]));
+	rgn->cnt--;
+}
 
-	for (i = r; i < rgn->cnt - 1; i++) {
-		rgn->region[i].base = rgn->region[i + 1].base;
-		rgn->region[i].size = rgn->region[i + 1].size;
+static long lmb_insert_region(struct lmb_region *rgn, unsigned long r,
+			      phys_addr_t base, phys_size_t size)
+{
+	struct lmb_property *region;
+	unsigned long max;
+
+	if (rgn->cnt == rgn->max) {
+		max = rgn->max * 2;
+		if (rgn->region == rgn->init_region) {
+			region = malloc(max * sizeof(*region));
+			if (region)
+				memcpy(region, rgn->region,
+				       rgn->cnt * sizeof(*region));
+		} else {
+			region = realloc(rgn->region, max * sizeof(*region));
+		}
+		if (!region)
+			return -1;
+		rgn->region = region;
+		rgn->max = max;
 	}
-	rgn->cnt--;
+
+	memmove(&rgn->region[r + 1], &rgn->region[r],
+		(rgn->cnt - r) * sizeof(rgn->region[0]));
+	rgn->region[r].base = base;
+	rgn->region[r].size = size;
+	rgn->cnt++;
+
+	return 0;
 }
 
 /* Assumption: base addr of region 1 < base addr of region 2 */
@@ -97,12 +142,31 @@ static void lmb_coalesce_regions(struct lmb_region *rgn, unsigned long r1,
 	lmb_remove_region(rgn, r2);
 }
 
+static void lmb_init_region(struct lmb_region *rgn)
+{
+	rgn->cnt = 0;
+	rgn->max = LMB_INIT_REGIONS;
+	rgn->size = 0;
+	rgn->region = rgn->init_region;
+}
+
 void lmb_init(struct lmb *lmb)
 {
-	lmb->memory.cnt = 0;
-	lmb->memory.size = 0;
-	lmb->reserved.cnt = 0;
-	lmb->reserved.size = 0;
+	lmb_init_region(&lmb->memory);
+	lmb_init_region(&lmb->reserved);
+}
+
+static void lmb_uninit_region(struct lmb_region *rgn)
+{
+	if (rgn->region != rgn->init_region)
+		free(rgn->region);
+	lmb_init_region(rgn);
+}
+
+void lmb_uninit(struct lmb *lmb)
+{
+	lmb_uninit_region(&lmb->memory);
+	lmb_uninit_region(&lmb->reserved);
 }
 
 static void lmb_reserve_common(struct lmb *lmb, void *fdt_blob)
@@ -148,18 +212,14 @@ void lmb_init_and_reserve_range(struct lmb *lmb, phys_addr_t base,
 /* This routine called with relocation disabled. */
 static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t size)
 {
-	unsigned long coalesced = 0;
-	long adjacent, i;
+	unsigned long i;
 
-	if (rgn->cnt == 0) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
-		rgn->cnt = 1;
+	if (!size)
 		return 0;
-	}
 
-	/* First try and coalesce this LMB with another. */
-	for (i = 0; i < rgn->cnt; i++) {
+	/* Find the first region which is not entirely below this one */
+	i = lmb_find_region(rgn, base);
+	if (i < rgn->cnt) {
 		phys_addr_t rgnbase = rgn->region[i].base;
 		phys_size_t rgnsize = rgn->region[i].size;
 
@@ -167,52 +227,30 @@ static long lmb_add_region(struct lmb_region *rgn, phys_addr_t base, phys_size_t
 			/* Already have this region, so we're done */
 			return 0;
 
-		adjacent = lmb_addrs_adjacent(base, size, rgnbase, rgnsize);
-		if (adjacent > 0) {
-			rgn->region[i].base -= size;
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (adjacent < 0) {
-			rgn->region[i].size += size;
-			coalesced++;
-			break;
-		} else if (lmb_addrs_overlap(base, size, rgnbase, rgnsize)) {
+		if (lmb_addrs_overlap(base, size, rgnbase, rgnsize))
 			/* regions overlap */
 			return -1;
-		}
-	}
-
-	if ((i < rgn->cnt - 1) && lmb_regions_adjacent(rgn, i, i + 1)) {
-		lmb_coalesce_regions(rgn, i, i + 1);
-		coalesced++;
 	}
 
-	if (coalesced)
-		return coalesced;
-	if (rgn->cnt >= MAX_LMB_REGIONS)
-		return -1;
-
-	/* Couldn't coalesce the LMB, so add it to the sorted table. */
-	for (i = rgn->cnt-1; i >= 0; i--) {
-		if (base < rgn->region[i].base) {
-			rgn->region[i + 1].base = rgn->region[i].base;
-			rgn->region[i + 1].size = rgn->region[i].size;
-		} else {
-			rgn->region[i + 1].base = base;
-			rgn->region[i + 1].size = size;
-			break;
+	/* Try and coalesce this LMB with the ones before and after it */
+	if (i > 0 && lmb_addrs_adjacent(base, size, rgn->region[i - 1].base,
+					rgn->region[i - 1].size) < 0) {
+		rgn->region[i - 1].size += size;
+		if (i < rgn->cnt && lmb_regions_adjacent(rgn, i - 1, i) > 0) {
+			lmb_coalesce_regions(rgn, i - 1, i);
+			return 2;
 		}
+		return 1;
 	}
-
-	if (base < rgn->region[0].base) {
-		rgn->region[0].base = base;
-		rgn->region[0].size = size;
+	if (i < rgn->cnt && lmb_addrs_adjacent(base, size, rgn->region[i].base,
+					       rgn->region[i].size) > 0) {
+		rgn->region[i].base -= size;
+		rgn->region[i].size += size;
+		return 1;
 	}
 
-	rgn->cnt++;
-
-	return 0;
+	/* Couldn't coalesce the LMB, so add it to the sorted table. */
+	return lmb_insert_region(rgn, i, base, size);
 }
 
 /* This routine may be called with relocation disabled. */
@@ -228,21 +266,17 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	struct lmb_region *rgn = &(lmb->reserved);
 	phys_addr_t rgnbegin, rgnend;
 	phys_addr_t end = base + size - 1;
-	int i;
-
-	rgnbegin = rgnend = 0; /* supress gcc warnings */
+	unsigned long i;
 
 	/* Find the region where (base, size) belongs to */
-	for (i = 0; i < rgn->cnt; i++) {
-		rgnbegin = rgn->region[i].base;
-		rgnend = rgnbegin + rgn->region[i].size - 1;
-
-		if ((rgnbegin <= base) && (end <= rgnend))
-			break;
-	}
+	i = lmb_find_region(rgn, base);
+	if (i == rgn->cnt)
+		return -1;
+	rgnbegin = rgn->region[i].base;
+	rgnend = rgnbegin + rgn->region[i].size - 1;
 
 	/* Didn't find the region */
-	if (i == rgn->cnt)
+	if ((rgnbegin > base) || (end > rgnend))
 		return -1;
 
 	/* Check to see if we are removing entire region */
@@ -268,8 +302,11 @@ long lmb_free(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 	 * We need to split the entry -  adjust the current one to the
 	 * beginging of the hole and add the region after hole.
 	 */
+	if (lmb_insert_region(rgn, i + 1, end + 1, rgnend - end) < 0)
+		return -1;
 	rgn->region[i].size = base - rgn->region[i].base;
-	return lmb_add_region(rgn, end + 1, rgnend - end);
+
+	return 0;
 }
 
 long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
@@ -282,16 +319,13 @@ long lmb_reserve(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 static long lmb_overlaps_region(struct lmb_region *rgn, phys_addr_t base,
 				phys_size_t size)
 {
-	unsigned long i;
+	unsigned long i = lmb_find_region(rgn, base);
 
-	for (i = 0; i < rgn->cnt; i++) {
-		phys_addr_t rgnbase = rgn->region[i].base;
-		phys_size_t rgnsize = rgn->region[i].size;
-		if (lmb_addrs_overlap(base, size, rgnbase, rgnsize))
-			break;
-	}
+	if (i < rgn->cnt && lmb_addrs_overlap(base, size, rgn->region[i].base,
+					      rgn->region[i].size))
+		return i;
 
-	return (i < rgn->cnt) ? i : -1;
+	return -1;
 }
 
 phys_addr_t lmb_alloc(struct lmb *lmb, phys_size_t size, ulong align)
@@ -317,45 +351,95 @@ static phys_addr_t lmb_align_down(phys_addr_t addr, phys_size_t size)
 	return addr & ~(size - 1);
 }
 
-phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
+/**
+ * lmb_alloc_fit() - check where an allocation fits in a free range
+ *
+ * @base: Start of the free range
+ * @last: Last address of the free range
+ * @size: Number of bytes to allocate
+ * @align: Alignment of the allocation
+ * Return: highest address in the range where the allocation fits, or 0
+ */
+static phys_addr_t lmb_alloc_fit(phys_addr_t base, phys_addr_t last,
+				 phys_size_t size, ulong align)
+{
+	phys_addr_t addr;
+
+	if (last < base || last - base < size - 1)
+		return 0;
+	addr = lmb_align_down(last - (size - 1), align);
+	if (addr < base)
+		return 0;
+
+	return addr;
+}
+
+phys_addr_t lmb_alloc_policy(struct lmb *lmb, phys_size_t size, ulong align,
+			     phys_addr_t max_addr, enum lmb_alloc_policy policy)
 {
-	long i, rgn;
-	phys_addr_t base = 0;
-	phys_addr_t res_base;
+	struct lmb_region *rsv = &lmb->reserved;
+	phys_addr_t best = 0, best_span = 0;
+	phys_addr_t mem_base, top, gap_base, addr;
+	long i, j;
+
+	if (!size)
+		return 0;
 
 	for (i = lmb->memory.cnt - 1; i >= 0; i--) {
-		phys_addr_t lmbbase = lmb->memory.region[i].base;
-		phys_size_t lmbsize = lmb->memory.region[i].size;
-
-		if (lmbsize < size)
-			continue;
-		if (max_addr == LMB_ALLOC_ANYWHERE)
-			base = lmb_align_down(lmbbase + lmbsize - size, align);
-		else if (lmbbase < max_addr) {
-			base = lmbbase + lmbsize;
-			if (base < lmbbase)
-				base = -1;
-			base = min(base, max_addr);
-			base = lmb_align_down(base - size, align);
-		} else
-			continue;
-
-		while (base && lmbbase <= base) {
-			rgn = lmb_overlaps_region(&lmb->reserved, base, size);
-			if (rgn < 0) {
-				/* This area isn't reserved, take it */
-				if (lmb_add_region(&lmb->reserved, base,
-						   size) < 0)
-					return 0;
-				return base;
+		mem_base = lmb->memory.region[i].base;
+		top = mem_base + lmb->memory.region[i].size - 1;
+		if (max_addr != LMB_ALLOC_ANYWHERE) {
+			if (mem_base >= max_addr)
+				continue;
+			top = min(top, max_addr - 1);
+		}
+
+		/*
+		 * Walk the free ranges from the top, between the reserved
+		 * regions which overlap this memory region
+		 */
+		j = lmb_find_region(rsv, top);
+		if (j < rsv->cnt && rsv->region[j].base <= top) {
+			if (rsv->region[j].base <= mem_base)
+				continue;
+			top = rsv->region[j].base - 1;
+		}
+		for (j--; ; j--) {
+			gap_base = mem_base;
+			if (j >= 0 && rsv->region[j].base +
+				      rsv->region[j].size - 1 >= mem_base)
+				gap_base = rsv->region[j].base +
+					   rsv->region[j].size;
+
+			addr = lmb_alloc_fit(gap_base, top, size, align);
+			if (addr && policy == LMB_ALLOC_TOP_DOWN) {
+				best = addr;
+				goto found;
+			}
+			if (addr && (!best || top - gap_base < best_span)) {
+				best = addr;
+				best_span = top - gap_base;
 			}
-			res_base = lmb->reserved.region[rgn].base;
-			if (res_base < size)
+
+			if (gap_base == mem_base ||
+			    rsv->region[j].base <= mem_base)
 				break;
-			base = lmb_align_down(res_base - size, align);
+			top = rsv->region[j].base - 1;
 		}
 	}
-	return 0;
+	if (!best)
+		return 0;
+
+found:
+	if (lmb_add_region(rsv, best, size) < 0)
+		return 0;
+
+	return best;
+}
+
+phys_addr_t __lmb_alloc_base(struct lmb *lmb, phys_size_t size, ulong align, phys_addr_t max_addr)
+{
+	return lmb_alloc_policy(lmb, size, align, max_addr, LMB_ALLOC_TOP_DOWN);
 }
 
 /*
@@ -387,22 +471,20 @@ phys_addr_t lmb_alloc_addr(struct lmb *lmb, phys_addr_t base, phys_size_t size)
 /* Return number of bytes from a given address that are free */
 phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
+	struct lmb_region *rsv = &lmb->reserved;
+	unsigned long i;
 	long rgn;
 
 	/* check if the requested address is in the memory regions */
 	rgn = lmb_overlaps_region(&lmb->memory, addr, 1);
 	if (rgn >= 0) {
-		for (i = 0; i < lmb->reserved.cnt; i++) {
-			if (addr < lmb->reserved.region[i].base) {
-				/* first reserved range > requested address */
-				return lmb->reserved.region[i].base - addr;
-			}
-			if (lmb->reserved.region[i].base +
-			    lmb->reserved.region[i].size > addr) {
-				/* requested addr is in this reserved range */
+		/* first reserved range which is not below requested address */
+		i = lmb_find_region(rsv, addr);
+		if (i < rsv->cnt) {
+			/* requested addr is in this reserved range */
+			if (rsv->region[i].base <= addr)
 				return 0;
-			}
+			return rsv->region[i].base - addr;
 		}
 		/* if we come here: no reserved ranges above requested addr */
 		return lmb->memory.region[lmb->memory.cnt - 1].base +
@@ -413,15 +495,7 @@ phys_size_t lmb_get_free_size(struct lmb *lmb, phys_addr_t addr)
 
 int lmb_is_reserved(struct lmb *lmb, phys_addr_t addr)
 {
-	int i;
-
-	for (i = 0; i < lmb->reserved.cnt; i++) {
-		phys_addr_t upper = lmb->reserved.region[i].base +
-			lmb->reserved.region[i].size - 1;
-		if ((addr >= lmb->reserved.region[i].base) && (addr <= upper))
-			return 1;
-	}
-	return 0;
+	return lmb_overlaps_region(&lmb->reserved, addr, 1) >= 0;
 }
 
 __weak void board_lmb_reserve(struct lmb *lmb)
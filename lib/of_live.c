@@ -16,6 +16,26 @@
 #include <dm/of_access.h>
 #include <linux/err.h>
 
+/*
+ * Only build a phandle table if phandles are reasonably dense, as they are
+ * when assigned by dtc. This is the largest ratio of the highest phandle
+ * to the number of nodes.
+ */
+#define OF_LIVE_PHANDLE_SPREAD	4
+
+/**
+ * struct unflatten_info - information collected while unflattening
+ *
+ * @nodes: Number of nodes in the tree
+ * @max_phandle: Highest phandle in the tree
+ * @phandles: Table of nodes indexed by phandle, or NULL if none
+ */
+struct unflatten_info {
+	int nodes;
+	phandle max_phandle;
+	struct device_node **phandles;
+};
+
 static void *unflatten_dt_alloc(void **mem, unsigned long size,
 				unsigned long align)
 {
@@ -38,11 +58,13 @@ static void *unflatten_dt_alloc(void **mem, unsigned long size,
  * @fpsize: Size of the node path up at t05he current depth.
  * @dryrun: If true, do not allocate device nodes but still calculate needed
  * memory size
+ * @info: Information about the tree, collected on the dry run
  */
 static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 			       struct device_node *dad,
 			       struct device_node **nodepp,
-			       unsigned long fpsize, bool dryrun)
+			       unsigned long fpsize, bool dryrun,
+			       struct unflatten_info *info)
 {
 	const __be32 *p;
 	struct device_node *np;
@@ -93,7 +115,9 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 
 	np = unflatten_dt_alloc(&mem, sizeof(struct device_node) + allocl,
 				__alignof__(struct device_node));
-	if (!dryrun) {
+	if (dryrun) {
+		info->nodes++;
+	} else {
 		char *fn;
 
 		fn = (char *)np + sizeof(*np);
@@ -143,7 +167,14 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 			has_name = 1;
 		pp = unflatten_dt_alloc(&mem, sizeof(struct property),
 					__alignof__(struct property));
-		if (!dryrun) {
+		if (dryrun) {
+			if (sz == sizeof(phandle) &&
+			    (!strcmp(pname, "phandle") ||
+			     !strcmp(pname, "linux,phandle") ||
+			     !strcmp(pname, "ibm,phandle")))
+				info->max_phandle = max(info->max_phandle,
+							be32_to_cpup(p));
+		} else {
 			/*
 			 * We accept flattened tree phandles either in
 			 * ePAPR-style "phandle" properties, or the
@@ -161,6 +192,14 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 			 * stuff */
 			if (strcmp(pname, "ibm,phandle") == 0)
 				np->phandle = be32_to_cpup(p);
+			/*
+			 * Pick up the name and type on the way, rather than
+			 * looking through the properties again afterwards
+			 */
+			if (!np->name && !strcmp(pname, "name"))
+				np->name = (const char *)p;
+			if (!np->type && !strcmp(pname, "device_type"))
+				np->type = (const char *)p;
 			pp->name = (char *)pname;
 			pp->length = sz;
 			pp->value = (__be32 *)p;
@@ -186,29 +225,43 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 		if (pa < ps)
 			pa = p1;
 		sz = (pa - ps) + 1;
-		pp = unflatten_dt_alloc(&mem, sizeof(struct property) + sz,
+
+		/*
+		 * Without a unit address the name is already terminated in the
+		 * blob, so point to it there instead of copying it
+		 */
+		pp = unflatten_dt_alloc(&mem, sizeof(struct property) +
+					(*pa ? sz : 0),
 					__alignof__(struct property));
 		if (!dryrun) {
 			pp->name = "name";
 			pp->length = sz;
-			pp->value = pp + 1;
 			*prev_pp = pp;
 			prev_pp = &pp->next;
-			memcpy(pp->value, ps, sz - 1);
-			((char *)pp->value)[sz - 1] = 0;
+			if (*pa) {
+				pp->value = pp + 1;
+				memcpy(pp->value, ps, sz - 1);
+				((char *)pp->value)[sz - 1] = 0;
+			} else {
+				pp->value = (char *)ps;
+			}
+			np->name = pp->value;
 			debug("fixed up name for %s -> %s\n", pathp,
 			      (char *)pp->value);
 		}
 	}
 	if (!dryrun) {
 		*prev_pp = NULL;
-		np->name = of_get_property(np, "name", NULL);
-		np->type = of_get_property(np, "device_type", NULL);
-
 		if (!np->name)
 			np->name = "<NULL>";
 		if (!np->type)
-			np->type = "<NULL>";	}
+			np->type = "<NULL>";
+		/* the first node wins, as with a search of the tree */
+		if (info->phandles && np->phandle &&
+		    np->phandle <= info->max_phandle &&
+		    !info->phandles[np->phandle])
+			info->phandles[np->phandle] = np;
+	}
 
 	old_depth = depth;
 	*poffset = fdt_next_node(blob, *poffset, &depth);
@@ -216,7 +269,7 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 		depth = 0;
 	while (*poffset > 0 && depth > old_depth) {
 		mem = unflatten_dt_node(blob, mem, poffset, np, NULL,
-					fpsize, dryrun);
+					fpsize, dryrun, info);
 		if (!mem)
 			return NULL;
 	}
@@ -254,7 +307,9 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
  * unflattens a device-tree, creating the
  * tree of struct device_node. It also fills the "name" and "type"
  * pointers of the nodes so the normal device-tree walking functions
- * can be used.
+ * can be used. Names and values of properties point into the blob, which
+ * must therefore stay where it is. If phandles are dense enough, a table
+ * for looking up nodes by phandle is set up as well.
  * @blob: The blob to expand
  * @mynodes: The device_node tree created by the call
  * @return 0 if OK, -ve on error
@@ -262,7 +317,8 @@ static void *unflatten_dt_node(const void *blob, void *mem, int *poffset,
 static int unflatten_device_tree(const void *blob,
 				 struct device_node **mynodes)
 {
-	unsigned long size;
+	struct unflatten_info info = {};
+	unsigned long size, table_size = 0;
 	int start;
 	void *mem;
 
@@ -283,32 +339,46 @@ static int unflatten_device_tree(const void *blob,
 		return -EINVAL;
 	}
 
+	/* The table for any previous tree does not cover this one */
+	of_set_phandle_cache(NULL, NULL, 0);
+
 	/* First pass, scan for size */
 	start = 0;
 	size = (unsigned long)unflatten_dt_node(blob, NULL, &start, NULL, NULL,
-						0, true);
+						0, true, &info);
 	if (!size)
 		return -EFAULT;
-	size = ALIGN(size, 4);
+	size = ALIGN(size, sizeof(void *));
+	if (info.max_phandle &&
+	    info.max_phandle <= info.nodes * OF_LIVE_PHANDLE_SPREAD)
+		table_size = (info.max_phandle + 1) * sizeof(*info.phandles);
 
-	debug("  size is %lx, allocating...\n", size);
+	debug("  size is %lx for %d nodes, phandle table %lx, allocating...\n",
+	      size, info.nodes, table_size);
 
-	/* Allocate memory for the expanded device tree */
-	mem = malloc(size + 4);
-	memset(mem, '\0', size);
+	/* Allocate memory for the expanded device tree and phandle table */
+	mem = malloc(size + table_size + 4);
+	if (!mem)
+		return -ENOMEM;
+	memset(mem, '\0', size + table_size);
+	if (table_size)
+		info.phandles = mem + size;
 
-	*(__be32 *)(mem + size) = cpu_to_be32(0xdeadbeef);
+	*(__be32 *)(mem + size + table_size) = cpu_to_be32(0xdeadbeef);
 
 	debug("  unflattening %p...\n", mem);
 
 	/* Second pass, do actual unflattening */
 	start = 0;
-	unflatten_dt_node(blob, mem, &start, NULL, mynodes, 0, false);
-	if (be32_to_cpup(mem + size) != 0xdeadbeef) {
+	unflatten_dt_node(blob, mem, &start, NULL, mynodes, 0, false, &info);
+	if (be32_to_cpup(mem + size + table_size) != 0xdeadbeef) {
 		debug("End of tree marker overwritten: %08x\n",
-		      be32_to_cpup(mem + size));
+		      be32_to_cpup(mem + size + table_size));
 		return -ENOSPC;
 	}
+	if (info.phandles)
+		of_set_phandle_cache(*mynodes, info.phandles,
+				     info.max_phandle + 1);
 
 	debug(" <- unflatten_device_tree()\n");
 
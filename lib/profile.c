@@ -0,0 +1,219 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Sampling profiler
+ *
+ * Samples are taken in interrupt context, so this code only writes to a ring
+ * buffer which is allocated when sampling starts. Each sample holds the code
+ * offsets of the call stack, innermost first, using the same offsets as
+ * function tracing so that proftool can look them up in System.map.
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <profile.h>
+#include <trace.h>
+#include <asm/sections.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+enum {
+	PROFILE_SAMPLES	= CONFIG_PROFILE_SAMPLES,
+	PROFILE_DEPTH	= CONFIG_PROFILE_DEPTH,
+};
+
+struct profile_sample {
+	uint32_t depth;
+	uint32_t offset[PROFILE_DEPTH];
+};
+
+/**
+ * struct profile_info - state of the profiler
+ *
+ * @samples: Ring buffer of samples, PROFILE_SAMPLES long
+ * @count: Total number of samples taken; the next is written at
+ *	@count % PROFILE_SAMPLES
+ * @unknown: Number of samples taken outside U-Boot
+ * @frames: Total number of code offsets recorded
+ * @rate: Sampling rate in samples per second
+ * @running: true if sampling is running
+ */
+struct profile_info {
+	struct profile_sample *samples;
+	ulong count;
+	ulong unknown;
+	ulong frames;
+	uint rate;
+	bool running;
+};
+
+static struct profile_info prof;
+
+/* Get the code offset of an address, as used by function tracing */
+static uint32_t profile_offset(ulong addr)
+{
+	ulong base;
+
+#ifdef CONFIG_SANDBOX
+	base = (ulong)&_init;
+#else
+	if (gd->flags & GD_FLG_RELOC)
+		base = gd->relocaddr;
+	else
+		base = CONFIG_SYS_TEXT_BASE;
+#endif
+	if (addr < base || addr - base >= gd->mon_len)
+		return TRACE_SAMPLE_UNKNOWN;
+
+	return addr - base;
+}
+
+void profile_sample(ulong pc, ulong fp, ulong sp, ulong stack_top)
+{
+	struct profile_sample *sample;
+	ulong *frame;
+	int depth;
+
+	if (!prof.running)
+		return;
+	sample = &prof.samples[prof.count++ % PROFILE_SAMPLES];
+	sample->offset[0] = profile_offset(pc);
+	if (sample->offset[0] == TRACE_SAMPLE_UNKNOWN)
+		prof.unknown++;
+
+	/*
+	 * Follow the frame records up the stack. Since a sample can arrive
+	 * anywhere, including in a function prologue or code built without
+	 * frame pointers, stop at anything which is not a frame record above
+	 * the last one.
+	 */
+	for (depth = 1; depth < PROFILE_DEPTH; depth++) {
+		if (fp < sp || fp % sizeof(ulong) ||
+		    fp + 2 * sizeof(ulong) > stack_top)
+			break;
+		frame = (ulong *)fp;
+		if (!frame[1])
+			break;
+		sample->offset[depth] = profile_offset(frame[1]);
+		sp = fp + 2 * sizeof(ulong);
+		fp = frame[0];
+	}
+	sample->depth = depth;
+	prof.frames += depth;
+}
+
+int profile_start(uint rate)
+{
+	int ret;
+
+	if (prof.running)
+		return -EALREADY;
+	if (!prof.samples) {
+		prof.samples = malloc(PROFILE_SAMPLES * sizeof(*prof.samples));
+		if (!prof.samples)
+			return -ENOMEM;
+	}
+	prof.count = 0;
+	prof.unknown = 0;
+	prof.frames = 0;
+	prof.rate = rate;
+	prof.running = true;
+	ret = arch_profile_start(rate);
+	if (ret)
+		prof.running = false;
+
+	return ret;
+}
+
+void profile_stop(void)
+{
+	if (!prof.running)
+		return;
+	arch_profile_stop();
+	prof.running = false;
+}
+
+int profile_list_samples(void *buff, size_t buff_size, size_t *needed)
+{
+	struct trace_output_hdr *output_hdr = NULL;
+	void *end, *ptr = buff;
+	ulong first, i, upto;
+	bool running;
+
+	/* Keep the ring still while it is copied */
+	running = prof.running;
+	prof.running = false;
+
+	end = buff ? buff + buff_size : NULL;
+
+	/* Place some header information */
+	if (ptr + sizeof(struct trace_output_hdr) <= end)
+		output_hdr = ptr;
+	ptr += sizeof(struct trace_output_hdr);
+
+	/* Add each sample, oldest first */
+	first = prof.count > PROFILE_SAMPLES ? prof.count - PROFILE_SAMPLES : 0;
+	for (i = first, upto = 0; i < prof.count; i++) {
+		struct profile_sample *sample;
+		size_t size;
+
+		sample = &prof.samples[i % PROFILE_SAMPLES];
+		size = sizeof(struct trace_sample) +
+			sample->depth * sizeof(uint32_t);
+		if (ptr + size <= end) {
+			struct trace_sample *out = ptr;
+
+			out->depth = sample->depth;
+			memcpy(out + 1, sample->offset,
+			       sample->depth * sizeof(uint32_t));
+			upto++;
+		}
+		ptr += size;
+	}
+	prof.running = running;
+
+	/* Update the header */
+	if (output_hdr) {
+		output_hdr->rec_count = upto;
+		output_hdr->type = TRACE_CHUNK_SAMPLES;
+	}
+
+	/* Work out how must of the buffer we used */
+	*needed = ptr - buff;
+	if (ptr > end)
+		return -ENOSPC;
+
+	return 0;
+}
+
+void profile_print_stats(void)
+{
+	ulong kept = min(prof.count, (ulong)PROFILE_SAMPLES);
+
+	if (!prof.samples) {
+		printf("No samples taken\n");
+		return;
+	}
+	printf("Sampling %s at %u Hz\n", prof.running ? "running" : "stopped",
+	       prof.rate);
+	print_grouped_ull(prof.count, 10);
+	puts(" samples taken\n");
+	print_grouped_ull(kept, 10);
+	puts(" samples kept");
+	if (prof.count > kept)
+		printf(" (%lu oldest overwritten)", prof.count - kept);
+	puts("\n");
+	print_grouped_ull(prof.unknown, 10);
+	puts(" samples outside U-Boot\n");
+	if (prof.count)
+		printf("%15lu average stack depth (limit %d)\n",
+		       prof.frames / prof.count, PROFILE_DEPTH);
+}
+
+__weak int arch_profile_start(uint rate)
+{
+	return -ENOSYS;
+}
+
+__weak void arch_profile_stop(void)
+{
+}
@@ -8,6 +8,7 @@
 #include <fastboot.h>
 #include <net.h>
 #include <net/fastboot.h>
+#include <asm/unaligned.h>
 
 /* Fastboot port # defined in spec */
 #define WELL_KNOWN_PORT 5554
@@ -25,13 +26,25 @@ struct __packed fastboot_header {
 	unsigned short seq;
 };
 
-#define PACKET_SIZE 1024
-#define DATA_SIZE (PACKET_SIZE - sizeof(struct fastboot_header))
+#define PACKET_SIZE CONFIG_FASTBOOT_UDP_PACKET_SIZE
+
+/*
+ * Version 2 adds a window size to the INIT packets. The host may then send
+ * that many download packets before waiting for an acknowledgement.
+ */
+#define UDP_VERSION_WINDOW	2
 
 /* Sequence number sent for every packet */
 static unsigned short sequence_number = 1;
 static const unsigned short packet_size = PACKET_SIZE;
-static const unsigned short udp_version = 1;
+static const unsigned short udp_version = UDP_VERSION_WINDOW;
+
+/* Download packets per acknowledgement, agreed with the host */
+static unsigned short window = 1;
+/* Download packets received since the last acknowledgement */
+static unsigned short unacked;
+/* true if the host has been told where to resend from after a loss */
+static bool resend_requested;
 
 /* Keep track of last packet for resubmission */
 static uchar last_packet[PACKET_SIZE];
@@ -109,6 +122,30 @@ static void fastboot_timed_send_info(const char *msg)
 }
 #endif
 
+/**
+ * fastboot_send_ack() - Acknowledge all packets up to a sequence number
+ *
+ * @seq: Sequence number of the last packet received in order
+ *
+ * This is used in windowed mode to tell the host where to resend from.
+ */
+static void fastboot_send_ack(unsigned short seq)
+{
+	struct fastboot_header header = {
+		.id = FASTBOOT_FASTBOOT,
+		.flags = 0,
+		.seq = htons(seq)
+	};
+	uchar *packet;
+
+	packet = net_tx_packet + net_eth_hdr_size() + IP_UDP_HDR_SIZE;
+	memcpy(packet, &header, sizeof(header));
+	net_send_udp_packet(net_server_ethaddr, fastboot_remote_ip,
+			    fastboot_remote_port, fastboot_our_port,
+			    sizeof(header));
+	unacked = 0;
+}
+
 /**
  * fastboot_send() - Sends a packet in response to received fastboot packet
  *
@@ -157,14 +194,34 @@ static void fastboot_send(struct fastboot_header header, char *fastboot_data,
 		memcpy(packet, &tmp, sizeof(tmp));
 		packet += sizeof(tmp);
 		break;
-	case FASTBOOT_INIT:
-		tmp = htons(udp_version);
+	case FASTBOOT_INIT: {
+		unsigned short version = 1, host_window = 1;
+
+		/* The host sends its version, packet size and maybe window */
+		if (fastboot_data_len >= 2)
+			version = get_unaligned_be16(fastboot_data);
+		if (fastboot_data_len >= 6)
+			host_window = get_unaligned_be16(fastboot_data + 4);
+		version = clamp_t(unsigned short, version, 1, udp_version);
+		window = 1;
+		if (version >= UDP_VERSION_WINDOW)
+			window = clamp_t(unsigned short, host_window, 1,
+					 CONFIG_FASTBOOT_UDP_WINDOW);
+		unacked = 0;
+
+		tmp = htons(version);
 		memcpy(packet, &tmp, sizeof(tmp));
 		packet += sizeof(tmp);
 		tmp = htons(packet_size);
 		memcpy(packet, &tmp, sizeof(tmp));
 		packet += sizeof(tmp);
+		if (version >= UDP_VERSION_WINDOW) {
+			tmp = htons(window);
+			memcpy(packet, &tmp, sizeof(tmp));
+			packet += sizeof(tmp);
+		}
 		break;
+	}
 	case FASTBOOT_ERROR:
 		memcpy(packet, error_msg, strlen(error_msg));
 		packet += strlen(error_msg);
@@ -177,11 +234,19 @@ static void fastboot_send(struct fastboot_header header, char *fastboot_data,
 				fastboot_data_download(fastboot_data,
 						       fastboot_data_len,
 						       response);
+				/*
+				 * Only the last packet of each window, and of
+				 * the download, needs an acknowledgement
+				 */
+				if (!*response && fastboot_data_remaining() &&
+				    ++unacked < window)
+					return;
 			}
 		} else if (!pending_command) {
-			strlcpy(command, fastboot_data,
-				min((size_t)fastboot_data_len + 1,
-				    sizeof(command)));
+			len = min((size_t)fastboot_data_len,
+				  sizeof(command) - 1);
+			memcpy(command, fastboot_data, len);
+			command[len] = '\0';
 			pending_command = true;
 		} else {
 			cmd = fastboot_handle_command(command, response);
@@ -213,6 +278,7 @@ static void fastboot_send(struct fastboot_header header, char *fastboot_data,
 
 	net_send_udp_packet(net_server_ethaddr, fastboot_remote_ip,
 			    fastboot_remote_port, fastboot_our_port, len);
+	unacked = 0;
 
 	/* Continue boot process after sending response */
 	if (!strncmp("OKAY", response, 4)) {
@@ -259,8 +325,6 @@ static void fastboot_handler(uchar *packet, unsigned int dport,
 			     unsigned int len)
 {
 	struct fastboot_header header;
-	char fastboot_data[DATA_SIZE] = {0};
-	unsigned int fastboot_data_len = 0;
 
 	if (dport != fastboot_our_port)
 		return;
@@ -276,29 +340,37 @@ static void fastboot_handler(uchar *packet, unsigned int dport,
 	packet += sizeof(header);
 	len -= sizeof(header);
 
+	/* The data is used in place, so as not to copy every packet */
 	switch (header.id) {
 	case FASTBOOT_QUERY:
-		fastboot_send(header, fastboot_data, 0, 0);
+		fastboot_send(header, (char *)packet, 0, 0);
 		break;
 	case FASTBOOT_INIT:
 	case FASTBOOT_FASTBOOT:
-		fastboot_data_len = len;
-		if (len > 0)
-			memcpy(fastboot_data, packet, len);
 		if (header.seq == sequence_number) {
-			fastboot_send(header, fastboot_data,
-				      fastboot_data_len, 0);
+			fastboot_send(header, (char *)packet, len, 0);
 			sequence_number++;
+			resend_requested = false;
+		} else if (header.seq == sequence_number - 1 && unacked) {
+			/* It was inside a window, so was not acknowledged */
+			fastboot_send_ack(header.seq);
 		} else if (header.seq == sequence_number - 1) {
 			/* Retransmit last sent packet */
-			fastboot_send(header, fastboot_data,
-				      fastboot_data_len, 1);
+			fastboot_send(header, (char *)packet, len, 1);
+		} else if (window > 1 &&
+			   (short)(header.seq - sequence_number) < 0) {
+			/* The host went back too far, so say where to resume */
+			fastboot_send_ack(sequence_number - 1);
+		} else if (window > 1 && !resend_requested) {
+			/* A packet was lost, so the host must go back to it */
+			fastboot_send_ack(sequence_number - 1);
+			resend_requested = true;
 		}
 		break;
 	default:
 		pr_err("ID %d not implemented.\n", header.id);
 		header.id = FASTBOOT_ERROR;
-		fastboot_send(header, fastboot_data, 0, 0);
+		fastboot_send(header, (char *)packet, 0, 0);
 		break;
 	}
 }
@@ -0,0 +1,435 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for fastboot over UDP
+ *
+ * A stand-in for the fastboot host talks to the device through the sandbox
+ * Ethernet driver, in the same way as 'fastboot -s udp:<addr>' would.
+ */
+
+#include <common.h>
+#include <dm.h>
+#include <env.h>
+#include <fastboot.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <net.h>
+#include <time.h>
+#include <asm/eth.h>
+#include <asm/unaligned.h>
+#include <dm/test.h>
+#include <linux/sizes.h>
+#include <net/fastboot.h>
+#include <test/ut.h>
+
+/* Port which the device listens on */
+#define FB_PORT		5554
+/* Port which the host sends from */
+#define HOST_PORT	45454
+
+/* Largest IP payload in one Ethernet frame, a multiple of 8 bytes */
+#define FRAG_SIZE	1480
+
+/* Size of the image to download */
+#define TEST_SIZE	SZ_2M
+
+enum {
+	ID_ERROR,
+	ID_QUERY,
+	ID_INIT,
+	ID_FASTBOOT,
+};
+
+struct __packed fb_header {
+	u8 id;
+	u8 flags;
+	u16 seq;
+};
+
+/* Number of download packets needed for the image */
+#define TEST_PACKETS	DIV_ROUND_UP(TEST_SIZE, CONFIG_FASTBOOT_UDP_PACKET_SIZE - \
+				     sizeof(struct fb_header))
+
+/**
+ * struct fb_host - State of the host end of a session
+ *
+ * @dev: Ethernet device in use
+ * @ip: IP address of the host
+ * @ip_id: IP identification field for the next packet
+ * @seq: Sequence number of the next packet to send
+ * @packet_size: Packet size agreed with the device
+ * @window: Packets to send for each acknowledgement
+ * @drop: Download packet to lose once, counting from 1, or 0 for none
+ * @replies: Number of packets received from the device
+ * @reply_seq: Sequence number of the last packet received
+ * @acked: Latest sequence number acknowledged by the device
+ * @reply_len: Length of the last packet's data
+ * @reply: Data of the last packet, nul-terminated
+ */
+struct fb_host {
+	struct udevice *dev;
+	struct in_addr ip;
+	ushort ip_id;
+	ushort seq;
+	uint packet_size;
+	uint window;
+	uint drop;
+	uint replies;
+	ushort reply_seq;
+	ushort acked;
+	uint reply_len;
+	char reply[FASTBOOT_RESPONSE_LEN];
+};
+
+/* Record packets from the device, answering its ARP requests */
+static int sb_fastboot_handler(struct udevice *dev, void *packet,
+			       unsigned int len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(dev);
+	struct fb_host *host = priv->priv;
+	struct ethernet_hdr *eth = packet;
+	struct ip_udp_hdr *ip = packet + ETHER_HDR_SIZE;
+	struct fb_header *hdr = packet + ETHER_HDR_SIZE + IP_UDP_HDR_SIZE;
+	uint size;
+
+	if (!sandbox_eth_arp_req_to_reply(dev, packet, len))
+		return 0;
+	if (ntohs(eth->et_protlen) != PROT_IP || ip->ip_p != IPPROTO_UDP ||
+	    ntohs(ip->udp_src) != FB_PORT)
+		return 0;
+
+	size = ntohs(ip->udp_len) - UDP_HDR_SIZE - sizeof(*hdr);
+	host->replies++;
+	host->reply_seq = get_unaligned_be16(&hdr->seq);
+	if ((short)(host->reply_seq - host->acked) > 0)
+		host->acked = host->reply_seq;
+	host->reply_len = min(size, (uint)sizeof(host->reply) - 1);
+	memcpy(host->reply, hdr + 1, host->reply_len);
+	host->reply[host->reply_len] = '\0';
+
+	return 0;
+}
+
+/* Let the device handle everything sent so far */
+static void host_flush(struct fb_host *host)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(host->dev);
+
+	while (priv->recv_packets)
+		eth_rx();
+}
+
+/* Send a packet to the device, in fragments if it is too large for a frame */
+static void host_send(struct fb_host *host, uint id, ushort seq,
+		      const void *data, uint len)
+{
+	struct eth_sandbox_priv *priv = dev_get_priv(host->dev);
+	static uchar buf[IP_UDP_HDR_SIZE + CONFIG_FASTBOOT_UDP_PACKET_SIZE];
+	struct ip_udp_hdr *ip = (struct ip_udp_hdr *)buf;
+	struct fb_header *hdr = (struct fb_header *)(ip + 1);
+	uchar *payload = (uchar *)&ip->udp_src;
+	uint total, offset;
+
+	total = UDP_HDR_SIZE + sizeof(*hdr) + len;
+	ip->udp_src = htons(HOST_PORT);
+	ip->udp_dst = htons(FB_PORT);
+	ip->udp_len = htons(total);
+	ip->udp_xsum = 0;
+	hdr->id = id;
+	hdr->flags = 0;
+	put_unaligned_be16(seq, &hdr->seq);
+	memcpy(hdr + 1, data, len);
+
+	for (offset = 0; offset < total; offset += FRAG_SIZE) {
+		uint size = min(total - offset, (uint)FRAG_SIZE);
+		struct ethernet_hdr *eth;
+		struct ip_udp_hdr *frag;
+		u16 off = offset / 8;
+
+		/* The device takes everything queued each time */
+		if (priv->recv_packets == PKTBUFSRX)
+			eth_rx();
+
+		eth = (void *)priv->recv_packet_buffer[priv->recv_packets];
+		memcpy(eth->et_dest, net_ethaddr, ARP_HLEN);
+		memcpy(eth->et_src, priv->fake_host_hwaddr, ARP_HLEN);
+		eth->et_protlen = htons(PROT_IP);
+
+		frag = (void *)eth + ETHER_HDR_SIZE;
+		frag->ip_hl_v = 0x45;
+		frag->ip_tos = 0;
+		frag->ip_len = htons(IP_HDR_SIZE + size);
+		frag->ip_id = htons(host->ip_id);
+		if (offset + size < total)
+			off |= IP_FLAGS_MFRAG;
+		frag->ip_off = htons(off);
+		frag->ip_ttl = 255;
+		frag->ip_p = IPPROTO_UDP;
+		frag->ip_sum = 0;
+		net_write_ip(&frag->ip_src, host->ip);
+		net_write_ip(&frag->ip_dst, net_ip);
+		frag->ip_sum = compute_ip_checksum(frag, IP_HDR_SIZE);
+		memcpy(&frag->udp_src, payload + offset, size);
+
+		priv->recv_packet_length[priv->recv_packets] =
+			ETHER_HDR_SIZE + IP_HDR_SIZE + size;
+		priv->recv_packets++;
+	}
+	host->ip_id++;
+}
+
+/* Send a packet and check that the device answers it */
+static int host_exchange(struct unit_test_state *uts, struct fb_host *host,
+			 uint id, const void *data, uint len)
+{
+	uint replies = host->replies;
+
+	host_send(host, id, host->seq, data, len);
+	host_flush(host);
+	ut_asserteq(replies + 1, host->replies);
+	ut_asserteq(host->seq, host->reply_seq);
+	host->seq++;
+
+	return 0;
+}
+
+/**
+ * host_start() - Start a session with the device
+ *
+ * @uts: Test state
+ * @host: Host state to set up
+ * @version: UDP protocol version to offer
+ * @window: Window size to offer (version 2 only)
+ * @return 0 if OK, non-zero on failure
+ */
+static int host_start(struct unit_test_state *uts, struct fb_host *host,
+		      uint version, uint window)
+{
+	uchar init[6];
+
+	memset(host, '\0', sizeof(*host));
+	host->ip = string_to_ip("1.2.3.5");
+	net_ip = string_to_ip("1.2.3.4");
+
+	env_set("ethact", "eth@10002000");
+	net_init();
+	eth_halt();
+	eth_set_current();
+	ut_assertok(eth_init());
+	host->dev = eth_get_dev();
+	ut_assertnonnull(host->dev);
+	sandbox_eth_set_tx_handler(0, sb_fastboot_handler);
+	sandbox_eth_set_priv(0, host);
+	fastboot_start_server();
+
+	/* The device tells us which sequence number to start from */
+	ut_assertok(host_exchange(uts, host, ID_QUERY, NULL, 0));
+	ut_asserteq(2, host->reply_len);
+	host->seq = get_unaligned_be16(host->reply);
+
+	put_unaligned_be16(version, init);
+	put_unaligned_be16(CONFIG_FASTBOOT_UDP_PACKET_SIZE, init + 2);
+	put_unaligned_be16(window, init + 4);
+	ut_assertok(host_exchange(uts, host, ID_INIT, init,
+				  version > 1 ? 6 : 4));
+	ut_asserteq(version, get_unaligned_be16(host->reply));
+	host->packet_size = get_unaligned_be16(host->reply + 2);
+	host->window = 1;
+	if (version > 1) {
+		ut_asserteq(6, host->reply_len);
+		host->window = get_unaligned_be16(host->reply + 4);
+	} else {
+		ut_asserteq(4, host->reply_len);
+	}
+
+	return 0;
+}
+
+static void host_stop(struct fb_host *host)
+{
+	eth_halt();
+	net_set_udp_handler(NULL);
+	sandbox_eth_set_tx_handler(0, NULL);
+	sandbox_eth_set_priv(0, NULL);
+}
+
+/**
+ * host_download() - Download an image to the device
+ *
+ * Download packets are sent a window at a time. After each window, sending
+ * starts again after the latest packet that the device acknowledged. Older
+ * acknowledgements may arrive as well, and are ignored.
+ *
+ * @uts: Test state
+ * @host: Host state
+ * @data: Image to download
+ * @size: Size of image in bytes
+ * @acksp: Returns the number of acknowledgements received for the data
+ * @return 0 if OK, non-zero on failure
+ */
+static int host_download(struct unit_test_state *uts, struct fb_host *host,
+			 const uchar *data, uint size, uint *acksp)
+{
+	uint chunk = host->packet_size - sizeof(struct fb_header);
+	uint count = DIV_ROUND_UP(size, chunk);
+	char cmd[FASTBOOT_COMMAND_LEN];
+	ulong start, us;
+	uint replies;
+	ushort first;
+
+	snprintf(cmd, sizeof(cmd), "download:%08x", size);
+	ut_assertok(host_exchange(uts, host, ID_FASTBOOT, cmd, strlen(cmd)));
+	ut_asserteq_str("", host->reply);
+	ut_assertok(host_exchange(uts, host, ID_FASTBOOT, NULL, 0));
+	snprintf(cmd, sizeof(cmd), "DATA%08x", size);
+	ut_asserteq_str(cmd, host->reply);
+
+	start = timer_get_us();
+	replies = host->replies;
+	first = host->seq;
+	host->acked = first - 1;
+	while ((ushort)(host->seq - first) < count) {
+		ushort base = host->seq;
+		uint i;
+
+		for (i = 0; i < host->window; i++) {
+			ushort seq = base + i;
+			uint index = (ushort)(seq - first);
+			uint offset = index * chunk;
+
+			if (offset >= size)
+				break;
+			if (index + 1 == host->drop) {
+				host->drop = 0;
+				continue;
+			}
+			host_send(host, ID_FASTBOOT, seq, data + offset,
+				  min(chunk, size - offset));
+		}
+		host_flush(host);
+		host->seq = host->acked + 1;
+	}
+	us = max(timer_get_us() - start, 1UL);
+	*acksp = host->replies - replies;
+	printf("%u bytes in %u-byte packets, window %u: %lu us, %lu.%lu MB/s, %u acks\n",
+	       size, host->packet_size, host->window, us, size / us,
+	       size * 10 / us % 10, *acksp);
+
+	ut_assertok(host_exchange(uts, host, ID_FASTBOOT, NULL, 0));
+	ut_asserteq_str("OKAY", host->reply);
+
+	return 0;
+}
+
+static int check_download(struct unit_test_state *uts, uint version,
+			  uint window, uint drop, uint *acksp)
+{
+	struct fb_host host;
+	uchar *data, *buf;
+	uint i;
+
+	data = malloc(TEST_SIZE);
+	ut_assertnonnull(data);
+	for (i = 0; i < TEST_SIZE; i++)
+		data[i] = i * 7 + (i >> 12);
+
+	/* download into the buffer set up by the board config */
+	ut_assert(TEST_SIZE <= CONFIG_FASTBOOT_BUF_SIZE);
+	buf = map_sysmem(CONFIG_FASTBOOT_BUF_ADDR, TEST_SIZE);
+	memset(buf, '\0', TEST_SIZE);
+	fastboot_init(NULL, 0);
+
+	ut_assertok(host_start(uts, &host, version, window));
+	host.drop = drop;
+	ut_assertok(host_download(uts, &host, data, TEST_SIZE, acksp));
+	host_stop(&host);
+	ut_asserteq_mem(data, buf, TEST_SIZE);
+
+	unmap_sysmem(buf);
+	free(data);
+
+	return 0;
+}
+
+/* Test downloading with and without a window */
+static int dm_test_fastboot_udp(struct unit_test_state *uts)
+{
+	uint windows = DIV_ROUND_UP(TEST_PACKETS, CONFIG_FASTBOOT_UDP_WINDOW);
+	uint acks;
+
+	/* Version 1 hosts get an acknowledgement for every packet */
+	ut_assertok(check_download(uts, 1, 0, 0, &acks));
+	ut_asserteq(TEST_PACKETS, acks);
+
+	/* Version 2 hosts get one for each window */
+	ut_assertok(check_download(uts, 2, CONFIG_FASTBOOT_UDP_WINDOW, 0,
+				   &acks));
+	ut_asserteq(windows, acks);
+
+	/* The device should not accept a larger window than it allows */
+	ut_assertok(check_download(uts, 2, 1000, 0, &acks));
+	ut_asserteq(windows, acks);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_udp, UT_TESTF_SCAN_FDT);
+
+/* Test that a lost packet is sent again */
+static int dm_test_fastboot_udp_loss(struct unit_test_state *uts)
+{
+	uint acks;
+
+	/* Lose a packet in the middle of the second window */
+	ut_assertok(check_download(uts, 2, 8, 12, &acks));
+
+	/* Lose the last packet of a window */
+	ut_assertok(check_download(uts, 2, 8, 16, &acks));
+
+	/* Lose the last packet of the download */
+	ut_assertok(check_download(uts, 2, 8, TEST_PACKETS, &acks));
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_udp_loss, UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(FASTBOOT_FLASH_STREAM)
+/* Send a command and check the reply, which comes after an empty one */
+static int host_command(struct unit_test_state *uts, struct fb_host *host,
+			const char *cmd, const char *reply)
+{
+	ut_assertok(host_exchange(uts, host, ID_FASTBOOT, cmd, strlen(cmd)));
+	ut_asserteq_str("", host->reply);
+	ut_assertok(host_exchange(uts, host, ID_FASTBOOT, NULL, 0));
+	ut_asserteq_str(reply, host->reply);
+
+	return 0;
+}
+
+/* Test that 'oem stream' only applies to the next download */
+static int dm_test_fastboot_udp_stream(struct unit_test_state *uts)
+{
+	char cmd[FASTBOOT_COMMAND_LEN], fail[FASTBOOT_RESPONSE_LEN];
+	struct fb_host host;
+	uint size;
+
+	fastboot_init(NULL, 0);
+	ut_assertok(host_start(uts, &host, 2, CONFIG_FASTBOOT_UDP_WINDOW));
+
+	/* Larger than the buffer, which is only allowed when streaming */
+	size = CONFIG_FASTBOOT_BUF_SIZE + SZ_1M;
+	snprintf(cmd, sizeof(cmd), "download:%08x", size);
+	snprintf(fail, sizeof(fail), "FAIL%08x", size);
+
+	ut_assertok(host_command(uts, &host, "oem stream:no-such-part",
+				 "OKAY"));
+	ut_assertok(host_command(uts, &host, cmd,
+				 "FAILcannot find partition"));
+
+	/* The failed download used up the stream, so the buffer is too small */
+	ut_assertok(host_command(uts, &host, cmd, fail));
+
+	host_stop(&host);
+
+	return 0;
+}
+DM_TEST(dm_test_fastboot_udp_stream, UT_TESTF_SCAN_FDT);
+#endif
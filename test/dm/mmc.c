@@ -4,9 +4,13 @@
  */
 
 #include <common.h>
+#include <command.h>
 #include <dm.h>
+#include <image-sparse.h>
+#include <malloc.h>
 #include <mmc.h>
 #include <part.h>
+#include <asm/test.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
@@ -43,3 +47,149 @@ static int dm_test_mmc_blk(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_mmc_blk, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(MMC_FAST_WRITE)
+/*
+ * Write the card in pieces, as fastboot or ums would, with and without CMD23.
+ * The sandbox card has no timing, so the cost is measured in commands.
+ */
+static int dm_test_mmc_write_cmds(struct unit_test_state *uts)
+{
+	const int count = 16, blocks = 64;
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	char *buf;
+	int pass, i;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	ut_assert(dev_desc->lba >= count * blocks);
+	dev = dev_get_parent(dev_desc->bdev);
+	mmc = mmc_get_mmc_dev(dev);
+	ut_assert(mmc->cmd23);
+	buf = calloc(blocks, dev_desc->blksz);
+	ut_assertnonnull(buf);
+
+	for (pass = 0; pass < 2; pass++) {
+		bool cmd23 = !pass;
+
+		mmc->cmd23 = cmd23;
+		sandbox_mmc_reset_cmd_counts(dev);
+		for (i = 0; i < count; i++)
+			ut_asserteq(blocks, blk_dwrite(dev_desc, i * blocks,
+						       blocks, buf));
+		ut_asserteq(count, sandbox_mmc_get_cmd_count(dev,
+					MMC_CMD_WRITE_MULTIPLE_BLOCK));
+		ut_asserteq(cmd23 ? count : 0, sandbox_mmc_get_cmd_count(dev,
+					MMC_CMD_SET_BLOCK_COUNT));
+		ut_asserteq(cmd23 ? 0 : count, sandbox_mmc_get_cmd_count(dev,
+					MMC_CMD_STOP_TRANSMISSION));
+	}
+	mmc->cmd23 = true;
+
+	/* A single write of the whole area needs one command with CMD23 */
+	sandbox_mmc_reset_cmd_counts(dev);
+	free(buf);
+	buf = calloc(count * blocks, dev_desc->blksz);
+	ut_assertnonnull(buf);
+	ut_asserteq(count * blocks, blk_dwrite(dev_desc, 0, count * blocks,
+					       buf));
+	ut_asserteq(1, sandbox_mmc_get_cmd_count(dev,
+						 MMC_CMD_WRITE_MULTIPLE_BLOCK));
+	ut_asserteq(1, sandbox_mmc_get_cmd_count(dev, MMC_CMD_SET_BLOCK_COUNT));
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_write_cmds, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
+
+/* Check that discard and zeroing use erase commands rather than writes */
+static int dm_test_mmc_discard(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	struct udevice *dev;
+	struct mmc *mmc;
+	uint scr;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	dev = dev_get_parent(dev_desc->bdev);
+	mmc = mmc_get_mmc_dev(dev);
+
+	sandbox_mmc_reset_cmd_counts(dev);
+	ut_asserteq(dev_desc->lba, blk_dwrite_zeroes(dev_desc, 0,
+						     dev_desc->lba));
+	ut_asserteq(20, blk_ddiscard(dev_desc, 10, 20));
+	ut_asserteq(2, sandbox_mmc_get_cmd_count(dev, MMC_CMD_ERASE));
+	ut_asserteq(0, sandbox_mmc_get_cmd_count(dev,
+						 MMC_CMD_WRITE_MULTIPLE_BLOCK));
+
+	/* A card which erases to ones cannot zero blocks this way */
+	scr = mmc->scr[0];
+	mmc->scr[0] |= SD_SCR_DATA_STAT_AFTER_ERASE;
+	ut_asserteq(-EOPNOTSUPP, blk_dwrite_zeroes(dev_desc, 0, 1));
+	ut_asserteq(1, blk_ddiscard(dev_desc, 0, 1));
+	mmc->scr[0] = scr;
+
+	ut_asserteq(-EINVAL, blk_ddiscard(dev_desc, dev_desc->lba, 1));
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_discard, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(CMD_MMC_SWRITE)
+/*
+ * Write a sparse image with 'mmc swrite'. The DONT_CARE chunk must be left
+ * alone, since it may belong to another part of a split image, so only the
+ * zero fill is erased.
+ */
+static int dm_test_mmc_sparse(struct unit_test_state *uts)
+{
+	struct blk_desc *dev_desc;
+	sparse_header_t *hdr;
+	chunk_header_t *chunk;
+	struct udevice *dev;
+	char cmd[40];
+	char *img;
+	u32 *fill;
+
+	ut_assertok(blk_get_device_by_str("mmc", "0", &dev_desc));
+	dev = dev_get_parent(dev_desc->bdev);
+	img = calloc(1, sizeof(*hdr) + 3 * sizeof(*chunk) + 512 + sizeof(u32));
+	ut_assertnonnull(img);
+
+	hdr = (sparse_header_t *)img;
+	hdr->magic = SPARSE_HEADER_MAGIC;
+	hdr->major_version = 1;
+	hdr->file_hdr_sz = sizeof(*hdr);
+	hdr->chunk_hdr_sz = sizeof(*chunk);
+	hdr->blk_sz = 512;
+	hdr->total_blks = 1 + 8 + 8;
+	hdr->total_chunks = 3;
+
+	chunk = (chunk_header_t *)(hdr + 1);
+	chunk->chunk_type = CHUNK_TYPE_RAW;
+	chunk->chunk_sz = 1;
+	chunk->total_sz = sizeof(*chunk) + 512;
+	chunk = (void *)chunk + chunk->total_sz;
+	chunk->chunk_type = CHUNK_TYPE_DONT_CARE;
+	chunk->chunk_sz = 8;
+	chunk->total_sz = sizeof(*chunk);
+	chunk++;
+	chunk->chunk_type = CHUNK_TYPE_FILL;
+	chunk->chunk_sz = 8;
+	chunk->total_sz = sizeof(*chunk) + sizeof(u32);
+	fill = (u32 *)(chunk + 1);
+	*fill = 0;
+
+	sandbox_mmc_reset_cmd_counts(dev);
+	snprintf(cmd, sizeof(cmd), "mmc swrite %lx 0", (ulong)img);
+	ut_assertok(run_command_list("mmc dev 0", -1, 0));
+	ut_assertok(run_command_list(cmd, -1, 0));
+	ut_asserteq(1, sandbox_mmc_get_cmd_count(dev, MMC_CMD_ERASE));
+	free(img);
+
+	return 0;
+}
+DM_TEST(dm_test_mmc_sparse, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
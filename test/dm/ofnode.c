@@ -3,6 +3,9 @@
 #include <common.h>
 #include <dm.h>
 #include <log.h>
+#include <malloc.h>
+#include <time.h>
+#include <dm/of_access.h>
 #include <dm/of_extra.h>
 #include <dm/test.h>
 #include <test/test.h>
@@ -136,3 +139,134 @@ static int dm_test_ofnode_get_child_count(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_ofnode_get_child_count,
 	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+static int dm_test_ofnode_phandle_cache(struct unit_test_state *uts)
+{
+	struct device_node *np;
+	ulong start, live_us, flat_us;
+	int count = 0;
+
+	/* Every node must be found by its phandle, via the table */
+	start = timer_get_us();
+	for_each_of_allnodes(np) {
+		if (!np->phandle)
+			continue;
+		ut_asserteq_ptr(np, of_find_node_by_phandle(np->phandle));
+		count++;
+	}
+	live_us = timer_get_us() - start;
+	ut_assert(count > 0);
+
+	start = timer_get_us();
+	for_each_of_allnodes(np) {
+		if (np->phandle)
+			ut_assert(fdt_node_offset_by_phandle(gd->fdt_blob,
+							     np->phandle) > 0);
+	}
+	flat_us = timer_get_us() - start;
+
+	printf("%d phandles: %lu us live tree, %lu us flat tree\n", count,
+	       live_us, flat_us);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_phandle_cache, UT_TESTF_SCAN_FDT | UT_TESTF_LIVE_TREE);
+
+static int dm_test_ofnode_prop_index(struct unit_test_state *uts)
+{
+	const void *blob = gd->fdt_blob;
+	ulong start, flat_us, read_us;
+	int node, prop, len, count = 0;
+	const char *name;
+	const void *val;
+
+	/* Every property must be found, with the same value as libfdt gives */
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		fdt_for_each_property_offset(prop, blob, node) {
+			val = fdt_getprop_by_offset(blob, prop, &name, NULL);
+			ut_asserteq_ptr(val,
+					ofnode_get_property(offset_to_ofnode(node),
+							    name, NULL));
+			count++;
+		}
+		ut_assertnull(ofnode_get_property(offset_to_ofnode(node),
+						  "no-such-property", &len));
+		ut_asserteq(-FDT_ERR_NOTFOUND, len);
+	}
+	ut_assert(count > 0);
+
+	start = timer_get_us();
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		fdt_getprop(blob, node, "compatible", NULL);
+		fdt_getprop(blob, node, "status", NULL);
+		fdt_getprop(blob, node, "reg", NULL);
+	}
+	flat_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	for (node = 0; node >= 0; node = fdt_next_node(blob, node, NULL)) {
+		ofnode_get_property(offset_to_ofnode(node), "compatible", NULL);
+		ofnode_get_property(offset_to_ofnode(node), "status", NULL);
+		ofnode_get_property(offset_to_ofnode(node), "reg", NULL);
+	}
+	read_us = timer_get_us() - start;
+
+	printf("%d properties: %lu us fdt_getprop(), %lu us ofnode\n", count,
+	       flat_us, read_us);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_prop_index, UT_TESTF_SCAN_FDT | UT_TESTF_FLAT_TREE);
+
+/* Edit a copy of the tree, then look up properties which have moved */
+static int ofnode_test_prop_index_edit(struct unit_test_state *uts)
+{
+	const void *blob = gd->fdt_blob;
+	ofnode node;
+	u32 val;
+	int len;
+
+	node = offset_to_ofnode(fdt_path_offset(blob, "/a-test"));
+	ut_assertok(ofnode_read_u32(node, "ping-add", &val));
+
+	/*
+	 * Move "ping-add" to the start of the node, where libfdt adds new
+	 * properties. This moves "reg" but keeps the size of the tree.
+	 */
+	ut_assertok(fdt_delprop((void *)blob, ofnode_to_offset(node),
+				"ping-add"));
+	ut_assertok(fdt_setprop_u32((void *)blob, ofnode_to_offset(node),
+				    "ping-add", val));
+	ut_asserteq_ptr(fdt_getprop(blob, ofnode_to_offset(node), "reg", NULL),
+			ofnode_get_property(node, "reg", NULL));
+	ut_asserteq_ptr(fdt_getprop(blob, ofnode_to_offset(node), "ping-add",
+				    NULL),
+			ofnode_get_property(node, "ping-add", NULL));
+
+	/* A property replaced by NOPs is gone */
+	ut_assertok(fdt_nop_property((void *)blob, ofnode_to_offset(node),
+				     "ping-expect"));
+	ut_assertnull(ofnode_get_property(node, "ping-expect", &len));
+	ut_asserteq(-FDT_ERR_NOTFOUND, len);
+
+	return 0;
+}
+
+static int dm_test_ofnode_prop_index_edit(struct unit_test_state *uts)
+{
+	const void *old_blob = gd->fdt_blob;
+	void *blob;
+	int ret;
+
+	blob = malloc(fdt_totalsize(old_blob));
+	ut_assertnonnull(blob);
+	memcpy(blob, old_blob, fdt_totalsize(old_blob));
+
+	gd->fdt_blob = blob;
+	ret = ofnode_test_prop_index_edit(uts);
+	gd->fdt_blob = old_blob;
+	free(blob);
+
+	return ret;
+}
+DM_TEST(dm_test_ofnode_prop_index_edit, UT_TESTF_SCAN_FDT | UT_TESTF_FLAT_TREE);
@@ -6,6 +6,7 @@
 #include <common.h>
 #include <log.h>
 #include <serial.h>
+#include <stdio_dev.h>
 #include <dm.h>
 #include <dm/test.h>
 #include <test/test.h>
@@ -70,3 +71,42 @@ static int dm_test_serial(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_serial, UT_TESTF_SCAN_FDT);
+
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+static int dm_test_serial_tx_buffer(struct unit_test_state *uts)
+{
+	static const char str[] = "serial TX buffer test\n";
+	struct serial_dev_priv *upriv;
+	struct udevice *dev_serial;
+	uint head;
+
+	ut_assertok(uclass_get_device_by_name(UCLASS_SERIAL, "serial",
+					      &dev_serial));
+	upriv = dev_get_uclass_priv(dev_serial);
+	ut_assertnonnull(upriv->tx_buf);
+	ut_assertnonnull(upriv->sdev);
+
+	/* The newline is sent as \r\n, and sandbox sends everything at once */
+	head = upriv->tx_head;
+	upriv->sdev->puts(upriv->sdev, str);
+	ut_asserteq(head + sizeof(str), upriv->tx_head);
+	ut_asserteq(upriv->tx_head, upriv->tx_tail);
+
+	upriv->sdev->putc(upriv->sdev, '\n');
+	ut_asserteq(head + sizeof(str) + 2, upriv->tx_head);
+	ut_asserteq(upriv->tx_head, upriv->tx_tail);
+
+	/* A drain which is already running is not re-entered */
+	upriv->tx_busy = true;
+	upriv->sdev->putc(upriv->sdev, '\n');
+	ut_asserteq(upriv->tx_head, upriv->tx_tail + 2);
+	serial_flush();
+	ut_asserteq(upriv->tx_head, upriv->tx_tail + 2);
+	upriv->tx_busy = false;
+	serial_flush();
+	ut_asserteq(upriv->tx_head, upriv->tx_tail);
+
+	return 0;
+}
+DM_TEST(dm_test_serial_tx_buffer, UT_TESTF_SCAN_FDT);
+#endif
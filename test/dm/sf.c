@@ -10,13 +10,17 @@
 #include <mapmem.h>
 #include <os.h>
 #include <spi.h>
+#include <spi-mem.h>
 #include <spi_flash.h>
+#include <asm/spi.h>
 #include <asm/state.h>
 #include <asm/test.h>
 #include <dm/test.h>
 #include <dm/util.h>
+#include <linux/mtd/spi-nor.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <u-boot/crc.h>
 
 /* Simple test of sandbox SPI flash */
 static int dm_test_spi_flash(struct unit_test_state *uts)
@@ -67,6 +71,97 @@ static int dm_test_spi_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_spi_flash, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/*
+ * Test erasing part of the flash and then all of it, checking the commands
+ * that the emulator sees. The m25p16 has no 4KiB erase, only 64KiB sectors.
+ */
+static int dm_test_spi_flash_erase(struct unit_test_state *uts)
+{
+	struct udevice *dev, *emul;
+	int full_size = 0x200000;
+	u8 *src, *dst;
+	int i;
+
+	src = map_sysmem(0x20000, full_size);
+	memset(src, 0x5a, full_size);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	ut_assertok(sandbox_spi_get_emul(state_get_current(), dev->parent, dev,
+					 &emul));
+	dst = map_sysmem(0x20000 + full_size, full_size);
+
+	/* Only the sectors in the range are erased, one command for each */
+	ut_assertok(spi_flash_erase_dm(dev, 0x10000, 0x30000));
+	ut_asserteq(0, sandbox_sf_get_erase_count(emul, SPINOR_OP_BE_4K));
+	ut_asserteq(3, sandbox_sf_get_erase_count(emul, SPINOR_OP_SE));
+	ut_asserteq(0, sandbox_sf_get_erase_count(emul, SPINOR_OP_CHIP_ERASE));
+	ut_assertok(spi_flash_read_dm(dev, 0, full_size, dst));
+	for (i = 0; i < full_size; i++) {
+		bool erased = i >= 0x10000 && i < 0x40000;
+
+		ut_asserteq(erased ? 0xff : 0x5a, dst[i]);
+	}
+
+	/* This uses a single chip erase */
+	ut_assertok(spi_flash_erase_dm(dev, 0, full_size));
+	ut_asserteq(0, sandbox_sf_get_erase_count(emul, SPINOR_OP_BE_4K));
+	ut_asserteq(3, sandbox_sf_get_erase_count(emul, SPINOR_OP_SE));
+	ut_asserteq(1, sandbox_sf_get_erase_count(emul, SPINOR_OP_CHIP_ERASE));
+	ut_assertok(spi_flash_read_dm(dev, 0, full_size, dst));
+	for (i = 0; i < full_size; i++)
+		ut_asserteq(0xff, dst[i]);
+
+	/* The flash would ignore chip erase with the top 32KiB locked */
+	sandbox_sf_set_block_protect(emul, 1);
+	ut_assertok(spi_flash_erase_dm(dev, 0, full_size));
+	ut_asserteq(3 + 32, sandbox_sf_get_erase_count(emul, SPINOR_OP_SE));
+	ut_asserteq(1, sandbox_sf_get_erase_count(emul, SPINOR_OP_CHIP_ERASE));
+
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_erase, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/*
+ * Test erasing a range which does not start or end on a 64KiB boundary, on
+ * a flash which has 4KiB erase as well. Only the ends use 4KiB erase.
+ */
+static int dm_test_spi_flash_erase_4k(struct unit_test_state *uts)
+{
+	struct udevice *dev, *emul;
+	int full_size = 0x200000;
+	u8 *src, *dst;
+	int i;
+
+	src = map_sysmem(0x20000, full_size);
+	memset(src, 0x5a, full_size);
+	ut_assertok(os_write_file("spi-4k.bin", src, full_size));
+	ut_assertok(uclass_get_device_by_ofnode(UCLASS_SPI_FLASH,
+						ofnode_path("/spi@1/flash@0"),
+						&dev));
+	ut_assertok(sandbox_spi_get_emul(state_get_current(), dev->parent, dev,
+					 &emul));
+	dst = map_sysmem(0x20000 + full_size, full_size);
+
+	/* From 8KiB before one 64KiB boundary to 12KiB after the next */
+	ut_assertok(spi_flash_erase_dm(dev, 0xe000, 0x15000));
+	ut_asserteq(2 + 3, sandbox_sf_get_erase_count(emul, SPINOR_OP_BE_4K));
+	ut_asserteq(1, sandbox_sf_get_erase_count(emul, SPINOR_OP_SE));
+	ut_asserteq(0, sandbox_sf_get_erase_count(emul, SPINOR_OP_CHIP_ERASE));
+	ut_assertok(spi_flash_read_dm(dev, 0, full_size, dst));
+	for (i = 0; i < full_size; i++) {
+		bool erased = i >= 0xe000 && i < 0x23000;
+
+		ut_asserteq(erased ? 0xff : 0x5a, dst[i]);
+	}
+
+	sandbox_sf_unbind_emul(state_get_current(), 1, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_erase_4k, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 /* Functional test that sandbox SPI flash works correctly */
 static int dm_test_spi_flash_func(struct unit_test_state *uts)
 {
@@ -94,3 +189,105 @@ static int dm_test_spi_flash_func(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash_func, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+#ifdef CONFIG_CMD_SF_CRCMAP
+/* Test that 'sf update -m' goes by the CRC map rather than the flash */
+static int dm_test_spi_flash_crcmap(struct unit_test_state *uts)
+{
+	struct udevice *dev;
+	int full_size = 0x200000;
+	int size = 0x40000;
+	u32 *map;
+	u8 *src, *dst;
+	int i;
+
+	src = map_sysmem(0x20000, full_size);
+	for (i = 0; i < full_size; i++)
+		src[i] = i;
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	ut_assertok(run_command_list(
+		"sf probe;"
+		"sf crcmap 10000 0 40000", -1, 0));
+
+	/* Header, then one CRC for each 64KB sector */
+	map = map_sysmem(0x10000, 0x20);
+	ut_asserteq(0x50414d43, map[0]);
+	ut_asserteq(0x10000, map[1]);
+	ut_asserteq(0, map[2]);
+	ut_asserteq(4, map[3]);
+	ut_asserteq(crc32(0, src + 0x10000, 0x10000), map[5]);
+
+	/*
+	 * Change the second and third sectors, but tell the map that the
+	 * third one is already up to date
+	 */
+	src[0x10000] ^= 0xff;
+	src[0x20000] ^= 0xff;
+	map[6] = crc32(0, src + 0x20000, 0x10000);
+	ut_assertok(run_command("sf update -m 10000 20000 0 40000", 0));
+	ut_asserteq(crc32(0, src + 0x10000, 0x10000), map[5]);
+
+	dst = map_sysmem(0x20000 + full_size, full_size);
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	ut_asserteq_mem(src, dst, 0x20000);
+	ut_asserteq(src[0x20000] ^ 0xff, dst[0x20000]);
+
+	/* A map made for another part of the flash is refused */
+	ut_asserteq(1, run_command("sf update -m 10000 20000 40000 10000", 0));
+
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_crcmap, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
+
+#ifdef CONFIG_SPI_DIRMAP
+/* Test that SPI flash reads go through a direct mapping */
+static int dm_test_spi_flash_dirmap(struct unit_test_state *uts)
+{
+	struct spi_flash *flash;
+	struct udevice *dev;
+	int full_size = 0x200000;
+	u8 *src, *dst;
+	int i;
+
+	src = map_sysmem(0x20000, full_size);
+	for (i = 0; i < full_size; i++)
+		src[i] = i * 7 + (i >> 16);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	flash = dev_get_uclass_priv(dev);
+
+	/* The sandbox SPI controller supports direct mapping */
+	ut_assertnonnull(flash->dirmap_rdesc);
+	ut_assert(!flash->dirmap_rdesc->nodirmap);
+	ut_asserteq(flash->read_opcode,
+		    flash->dirmap_rdesc->info.op_tmpl.cmd.opcode);
+	ut_asserteq(full_size, flash->dirmap_rdesc->info.length);
+
+	/* Read a range which is not aligned to anything */
+	dst = map_sysmem(0x20000 + full_size, full_size);
+	memset(dst, '\0', full_size);
+	ut_assertok(spi_flash_read_dm(dev, 0x1235, 0x54321, dst));
+	ut_asserteq_mem(src + 0x1235, dst, 0x54321);
+	ut_asserteq(0, dst[0x54321]);
+
+	/* Read across the end of the window, beyond which it is not used */
+	memset(dst, '\0', full_size);
+	ut_assertok(spi_flash_read_dm(dev, SANDBOX_SPI_DIRMAP_SIZE - 0x1235,
+				      0x54321, dst));
+	ut_asserteq_mem(src + SANDBOX_SPI_DIRMAP_SIZE - 0x1235, dst, 0x54321);
+	ut_asserteq(0, dst[0x54321]);
+
+	/* Reads past the end of the flash are still rejected */
+	ut_asserteq(-EINVAL, spi_flash_read_dm(dev, full_size - 0x10, 0x20,
+					       dst));
+
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_dirmap, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+#endif
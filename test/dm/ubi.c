@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for UBI on the sandbox SPI flash
+ */
+
+#include <common.h>
+#include <command.h>
+#include <console.h>
+#include <dm.h>
+#include <mapmem.h>
+#include <os.h>
+#include <spi_flash.h>
+#include <ubi_uboot.h>
+#include <asm/state.h>
+#include <asm/test.h>
+#include <dm/test.h>
+#include <linux/sizes.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/*
+ * Attach an erased flash, write a volume, then attach again, which scans the
+ * EC and VID headers of each PEB.
+ *
+ * The sandbox flash has 32 PEBs of 64KB, which is not more than
+ * UBI_FM_MAX_START, so UBI always disables fastmap on it. See
+ * dm_test_ubi_fastmap() for a larger flash.
+ */
+static int dm_test_ubi_attach(struct unit_test_state *uts)
+{
+	const int full_size = 0x200000;
+	const int size = 0x20000;
+	struct udevice *dev;
+	u8 *src, *dst;
+	int i;
+
+	src = map_sysmem(0x20000, full_size);
+	memset(src, 0xff, full_size);
+	ut_assertok(os_write_file("spi.bin", src, full_size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+
+	/* An empty flash is formatted when it is attached */
+	ut_assertok(ubi_part("nor0", NULL));
+	ut_assertok(run_command("ubi create test 20000", 0));
+	for (i = 0; i < size; i++)
+		src[i] = i / 0x1000 + i;
+	ut_assertok(ubi_volume_write("test", src, size));
+
+	/* No headers are left over from the scan */
+	ut_assertok(ubi_part("nor0", NULL));
+	ut_asserteq(-1, ubi_devices[0]->hdrs_pnum);
+
+	dst = map_sysmem(0x20000 + full_size, size);
+	memset(dst, '\0', size);
+	ut_assertok(ubi_volume_read("test", (char *)dst, size));
+	ut_asserteq_mem(src, dst, size);
+
+	ut_assertok(run_command("ubi detach", 0));
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_ubi_attach, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Check that a line of the console output since the last reset is @line */
+static int ubi_test_find_line(const char *line)
+{
+	char buf[CONFIG_SYS_CBSIZE];
+
+	while (console_record_readline(buf, sizeof(buf)) > 0) {
+		if (!strcmp(buf, line))
+			return 0;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Attach an erased flash with 256 PEBs, which is scanned, then attach it
+ * again. With fastmap autoconvert the first attach writes a fastmap as soon
+ * as the scan is done, so the second attach can use it.
+ *
+ * Detaching writes a fastmap as well, so the flash is put back to how it
+ * was just after the first attach, as if an OS had taken over from there.
+ */
+static int dm_test_ubi_fastmap(struct unit_test_state *uts)
+{
+	const int full_size = SZ_16M;
+	struct udevice *dev;
+	u8 *src, *snap;
+
+	src = map_sysmem(0x20000, full_size);
+	memset(src, 0xff, full_size);
+	ut_assertok(os_write_file("spi-16m.bin", src, full_size));
+	ut_assertok(uclass_get_device_by_ofnode(UCLASS_SPI_FLASH,
+						ofnode_path("/spi@2/flash@0"),
+						&dev));
+
+	ut_assertok(ubi_part("nor0", NULL));
+	ut_asserteq(256, ubi_devices[0]->peb_count);
+	ut_assertnonnull(ubi_devices[0]->fm);
+
+	snap = map_sysmem(0x20000 + full_size, full_size);
+	ut_assertok(spi_flash_read_dm(dev, 0, full_size, snap));
+	ut_assertok(run_command("ubi detach", 0));
+	ut_assertok(os_write_file("spi-16m.bin", snap, full_size));
+
+	console_record_reset();
+	ut_assertok(ubi_part("nor0", NULL));
+	ut_assertnonnull(ubi_devices[0]->fm);
+	ut_assertok(ubi_test_find_line("ubi0: attached by fastmap"));
+
+	ut_assertok(run_command("ubi detach", 0));
+
+	sandbox_sf_unbind_emul(state_get_current(), 2, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_ubi_fastmap, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
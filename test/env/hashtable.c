@@ -124,3 +124,99 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 }
 
 ENV_TEST(env_test_htab_deletes, 0);
+
+/* Insert many more entries than the table was created for */
+static int env_test_htab_grow(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	unsigned int changes;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, hcreate_r(SIZE, &htab));
+
+	ut_assertok(htab_fill(uts, &htab, SIZE * 16));
+	ut_assertok(htab_check_fill(uts, &htab, SIZE * 16));
+	ut_asserteq(SIZE * 16, htab.filled);
+	ut_assert(htab.size > SIZE * 16);
+
+	/* Deleting an entry is recorded as a change */
+	changes = htab.changes;
+	ut_asserteq(1, hdelete_r("0", &htab, 0));
+	ut_assert(htab.changes != changes);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+
+ENV_TEST(env_test_htab_grow, 0);
+
+static struct hsearch_data *nest_htab;
+
+/* Add entries to the table from within the search that creates "nest" */
+static int htab_nest_change_ok(const struct env_entry *item,
+			       const char *newval, enum env_op op, int flag)
+{
+	struct env_entry e, *ep;
+	char key[20];
+	int i;
+
+	if (op != env_op_create || strcmp(item->key, "nest"))
+		return 0;
+	for (i = 0; i < 4; i++) {
+		sprintf(key, "n%d", i);
+		e.callback = NULL;
+		e.flags = 0;
+		e.key = key;
+		e.data = key;
+		if (!hsearch_r(e, ENV_ENTER, &ep, nest_htab, 0))
+			return 1;
+	}
+
+	return 0;
+}
+
+/* Entries added by a callback must not move the entry being created */
+static int env_test_htab_nested(struct unit_test_state *uts)
+{
+	struct hsearch_data htab;
+	struct env_entry item, *ritem;
+	uint size;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, hcreate_r(SIZE * 2, &htab));
+	htab.change_ok = htab_nest_change_ok;
+	nest_htab = &htab;
+
+	/*
+	 * Fill the table to just below the point where it grows, so that the
+	 * entries added by the callback would make it grow
+	 */
+	size = htab.size;
+	ut_assertok(htab_fill(uts, &htab, size * 3 / 4 - 1));
+	item.callback = NULL;
+	item.flags = 0;
+	item.key = "nest";
+	item.data = "outer";
+	ut_asserteq(1, hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_assertnonnull(ritem);
+	ut_asserteq_str("nest", ritem->key);
+	ut_asserteq_str("outer", ritem->data);
+	ut_asserteq(size, htab.size);
+	ut_asserteq(0, htab.nest);
+
+	/* The next entry added at the top level grows the table */
+	item.key = "grow";
+	item.data = "grow";
+	ut_asserteq(1, hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_assert(htab.size > size);
+	ut_assertok(htab_check_fill(uts, &htab, size * 3 / 4 - 1));
+	item.key = "nest";
+	hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+	ut_assertnonnull(ritem);
+	ut_asserteq_str("outer", ritem->data);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+
+ENV_TEST(env_test_htab_nested, 0);
@@ -0,0 +1,132 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for bootstage spans and the Chrome trace export
+ */
+
+#include <common.h>
+#include <bootstage.h>
+#include <malloc.h>
+#include <asm/global_data.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define BOOTSTAGE_TEST_STASH_SIZE	0x4000
+
+/* Record a few nested spans, merging the repeated inner one */
+static int bootstage_test_record(struct unit_test_state *uts)
+{
+	int outer, span, i;
+
+	outer = bootstage_span_start("outer", 0);
+	ut_asserteq(0, outer);
+	for (i = 0; i < 3; i++) {
+		span = bootstage_span_start("inner", BOOTSTAGEF_MERGE);
+		ut_asserteq(1, span);
+		bootstage_span_end(span, 512);
+	}
+	span = bootstage_span_start("other \"quoted\"", BOOTSTAGEF_MERGE);
+	ut_asserteq(2, span);
+	bootstage_span_end(span, 0);
+	bootstage_span_end(outer, 1536);
+
+	/* This is not inside 'outer', so it is a new span */
+	span = bootstage_span_start("inner", BOOTSTAGEF_MERGE);
+	ut_asserteq(3, span);
+	bootstage_span_end(span, 0);
+
+	return 0;
+}
+
+/* Check the trace export and the stash, using the spans recorded above */
+static int bootstage_test_export(struct unit_test_state *uts)
+{
+	char *buf, *copy, *stash;
+	int len;
+
+	ut_assertok(bootstage_test_record(uts));
+
+	len = bootstage_export_trace(NULL, 0);
+	buf = malloc(len + 1);
+	ut_assertnonnull(buf);
+	ut_asserteq(len, bootstage_export_trace(buf, len + 1));
+	ut_asserteq(len, strlen(buf));
+	ut_assertnonnull(strstr(buf, "{\"traceEvents\":["));
+	ut_assertnonnull(strstr(buf,
+				"{\"name\":\"outer\",\"cat\":\"span\",\"ph\":\"X\""));
+	ut_assertnonnull(strstr(buf, "\"bytes\":1536,\"count\":3,"));
+	ut_assertnonnull(strstr(buf, "\"name\":\"other \\\"quoted\\\"\""));
+
+	/* A short buffer gets as much as fits */
+	copy = malloc(len + 1);
+	ut_assertnonnull(copy);
+	ut_asserteq(len, bootstage_export_trace(copy, 10));
+	ut_asserteq(9, strlen(copy));
+	ut_asserteq_mem(buf, copy, 9);
+
+	/* The spans survive a stash and unstash */
+	stash = malloc(BOOTSTAGE_TEST_STASH_SIZE);
+	ut_assertnonnull(stash);
+	ut_assertok(bootstage_stash(stash, BOOTSTAGE_TEST_STASH_SIZE));
+	bootstage_uninit();
+	ut_assertok(bootstage_init(false));
+	ut_assertok(bootstage_unstash(stash, BOOTSTAGE_TEST_STASH_SIZE));
+	ut_asserteq(len, bootstage_export_trace(copy, len + 1));
+	ut_asserteq_str(buf, copy);
+
+	free(stash);
+	free(copy);
+	free(buf);
+
+	return 0;
+}
+
+/* Fill the span table and check that the next span is dropped */
+static int bootstage_test_full(struct unit_test_state *uts)
+{
+	int span, i;
+
+	for (i = 0; i < CONFIG_BOOTSTAGE_SPAN_COUNT; i++) {
+		span = bootstage_span_start("span", 0);
+		ut_asserteq(i, span);
+		bootstage_span_end(span, 0);
+	}
+	ut_asserteq(-ENOSPC, bootstage_span_start("span", 0));
+
+	return 0;
+}
+
+/*
+ * Run a test with a separate bootstage table, to leave the one for this boot
+ * alone. The table for this boot is put back however the test ends.
+ */
+static int bootstage_test_run(struct unit_test_state *uts,
+			      int (*test)(struct unit_test_state *uts))
+{
+	struct bootstage_data *old = gd->bootstage;
+	int ret;
+
+	ret = bootstage_init(false);
+	if (!ret)
+		ret = test(uts);
+	bootstage_uninit();
+	gd->bootstage = old;
+
+	return ret;
+}
+
+static int lib_test_bootstage_spans(struct unit_test_state *uts)
+{
+	return bootstage_test_run(uts, bootstage_test_export);
+}
+
+LIB_TEST(lib_test_bootstage_spans, 0);
+
+static int lib_test_bootstage_span_full(struct unit_test_state *uts)
+{
+	return bootstage_test_run(uts, bootstage_test_full);
+}
+
+LIB_TEST(lib_test_bootstage_span_full, 0);
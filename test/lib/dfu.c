@@ -0,0 +1,82 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for writing behind with the DFU buffer ring
+ *
+ * An image is written to a RAM entity through dfu_write(), as the USB gadget
+ * would, with several buffers queued at once. The RAM must then hold the
+ * image unchanged.
+ */
+
+#include <common.h>
+#include <dfu.h>
+#include <env.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Size of each buffer in the ring and of each USB transfer */
+#define DFU_TEST_BUFSIZ		0x1000
+#define DFU_TEST_XFER		0x400
+
+/* Several buffers plus a partial one, so the ring wraps more than once */
+#define DFU_TEST_SIZE		(DFU_TEST_BUFSIZ * 7 + 0x300)
+
+static int dfu_test_write(struct unit_test_state *uts, u8 *src, u8 *dst)
+{
+	struct dfu_entity *dfu;
+	char alt_info[64];
+	int blk, ofs, len;
+
+	snprintf(alt_info, sizeof(alt_info), "img ram %lx %x", (ulong)dst,
+		 DFU_TEST_SIZE);
+	ut_assertok(env_set("dfu_alt_info", alt_info));
+	ut_assertok(env_set_ulong("dfu_bufsiz", DFU_TEST_BUFSIZ));
+	ut_assertok(dfu_init_env_entities("ram", "0"));
+	dfu = dfu_get_entity(0);
+	ut_assertnonnull(dfu);
+
+	dfu_set_write_behind(true);
+	for (blk = 0, ofs = 0; ofs < DFU_TEST_SIZE; blk++, ofs += len) {
+		len = min(DFU_TEST_SIZE - ofs, DFU_TEST_XFER);
+		ut_assertok(dfu_write(dfu, src + ofs, len, blk));
+
+		/*
+		 * Only write out now and then, as with a fast host, so that
+		 * the ring fills up and dfu_write() has to wait for it
+		 */
+		if (blk % 12 == 11)
+			ut_assertok(dfu_write_pending());
+	}
+	ut_assertok(dfu_flush(dfu, NULL, 0, blk));
+	dfu_set_write_behind(false);
+
+	ut_asserteq_mem(src, dst, DFU_TEST_SIZE);
+
+	return 0;
+}
+
+static int lib_test_dfu_write_behind(struct unit_test_state *uts)
+{
+	u8 *src, *dst;
+	int ret, i;
+
+	src = malloc(DFU_TEST_SIZE);
+	dst = calloc(1, DFU_TEST_SIZE);
+	ut_assertnonnull(src);
+	ut_assertnonnull(dst);
+	for (i = 0; i < DFU_TEST_SIZE; i++)
+		src[i] = i / DFU_TEST_XFER + i;
+
+	ret = dfu_test_write(uts, src, dst);
+
+	dfu_free_entities();
+	dfu_free_buf();
+	env_set("dfu_alt_info", NULL);
+	env_set("dfu_bufsiz", NULL);
+	free(dst);
+	free(src);
+
+	return ret;
+}
+LIB_TEST(lib_test_dfu_write_behind, 0);
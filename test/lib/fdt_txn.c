@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for batched device tree edits
+ */
+
+#include <common.h>
+#include <console.h>
+#include <env.h>
+#include <fdt_support.h>
+#include <fdt_txn.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/libfdt.h>
+#include <linux/sizes.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* A tree of about 100KB, similar to the one of a large SoC */
+#define FDT_TXN_TEST_NODES	500
+#define FDT_TXN_TEST_SIZE	SZ_256K
+
+static int fdt_txn_test_build(struct unit_test_state *uts, void *fdt)
+{
+	char name[20];
+	int i, j;
+
+	ut_assertok(fdt_create(fdt, FDT_TXN_TEST_SIZE));
+	ut_assertok(fdt_add_reservemap_entry(fdt, 0x1000, 0x2000));
+	ut_assertok(fdt_finish_reservemap(fdt));
+	ut_assertok(fdt_begin_node(fdt, ""));
+	ut_assertok(fdt_property_string(fdt, "model", "test"));
+	for (i = 0; i < FDT_TXN_TEST_NODES; i++) {
+		snprintf(name, sizeof(name), "node@%d", i);
+		ut_assertok(fdt_begin_node(fdt, name));
+		for (j = 0; j < 8; j++) {
+			snprintf(name, sizeof(name), "prop-%d", j);
+			ut_assertok(fdt_property_u32(fdt, name, i * 8 + j));
+		}
+		ut_assertok(fdt_begin_node(fdt, "child"));
+		ut_assertok(fdt_property_string(fdt, "status", "okay"));
+		ut_assertok(fdt_end_node(fdt));
+		ut_assertok(fdt_end_node(fdt));
+	}
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_finish(fdt));
+	ut_assertok(fdt_open_into(fdt, fdt, FDT_TXN_TEST_SIZE));
+
+	return 0;
+}
+
+/*
+ * Make a set of edits to one node, with the normal libfdt functions if
+ * @txn is NULL
+ */
+static int fdt_txn_test_edit(struct unit_test_state *uts, void *fdt,
+			     struct fdt_txn *txn, int i)
+{
+	char path[20];
+	int node, child;
+
+	snprintf(path, sizeof(path), "/node@%d", i * 37 % FDT_TXN_TEST_NODES);
+	node = fdt_path_offset(fdt, path);
+	ut_assert(node > 0);
+
+	if (!txn) {
+		ut_assertok(fdt_setprop_u32(fdt, node, "prop-3", i));
+		ut_assertok(fdt_setprop_string(fdt, node, "label", path));
+		if (i % 5 == 0)
+			ut_assertok(fdt_delprop(fdt, node, "prop-1"));
+		if (i % 7 == 0) {
+			child = fdt_add_subnode(fdt, node, "added");
+			ut_assert(child > 0);
+			ut_assertok(fdt_setprop_u32(fdt, child, "index", i));
+			child = fdt_add_subnode(fdt, child, "nested");
+			ut_assert(child > 0);
+			ut_assertok(fdt_setprop_empty(fdt, child, "empty"));
+		}
+		if (i % 11 == 0)
+			ut_assertok(fdt_del_node(fdt, fdt_subnode_offset(fdt,
+							node, "child")));
+	} else {
+		ut_assertok(fdt_txn_setprop_u32(txn, node, "prop-3", i));
+		ut_assertok(fdt_txn_setprop_string(txn, node, "label", path));
+		if (i % 5 == 0)
+			ut_assertok(fdt_txn_delprop(txn, node, "prop-1"));
+		if (i % 7 == 0) {
+			child = fdt_txn_add_subnode(txn, node, "added");
+			ut_assert(child >= FDT_TXN_HANDLE_BASE);
+			ut_assertok(fdt_txn_setprop_u32(txn, child, "index", i));
+			child = fdt_txn_add_subnode(txn, child, "nested");
+			ut_assert(child >= FDT_TXN_HANDLE_BASE);
+			ut_assertok(fdt_txn_setprop(txn, child, "empty", NULL,
+						    0));
+		}
+		if (i % 11 == 0)
+			ut_assertok(fdt_txn_del_node(txn, fdt_subnode_offset(fdt,
+							node, "child")));
+	}
+
+	return 0;
+}
+
+/* Check that two nodes have the same properties and subnodes */
+static int fdt_txn_test_same(struct unit_test_state *uts, const void *a,
+			     int anode, const void *b, int bnode)
+{
+	const void *aval, *bval;
+	const char *name;
+	int acount = 0, bcount = 0;
+	int prop, sub, alen, blen;
+
+	fdt_for_each_property_offset(prop, a, anode) {
+		aval = fdt_getprop_by_offset(a, prop, &name, &alen);
+		bval = fdt_getprop(b, bnode, name, &blen);
+		ut_assertnonnull(bval);
+		ut_asserteq(alen, blen);
+		ut_asserteq_mem(aval, bval, alen);
+		acount++;
+	}
+	fdt_for_each_property_offset(prop, b, bnode)
+		bcount++;
+	ut_asserteq(acount, bcount);
+
+	acount = 0;
+	bcount = 0;
+	fdt_for_each_subnode(sub, a, anode) {
+		int bsub;
+
+		bsub = fdt_subnode_offset(b, bnode, fdt_get_name(a, sub, NULL));
+		ut_assert(bsub > 0);
+		ut_assertok(fdt_txn_test_same(uts, a, sub, b, bsub));
+		acount++;
+	}
+	fdt_for_each_subnode(sub, b, bnode)
+		bcount++;
+	ut_asserteq(acount, bcount);
+
+	return 0;
+}
+
+static int fdt_txn_test_run(struct unit_test_state *uts, int count)
+{
+	struct fdt_txn txn;
+	ulong start, direct_us, txn_us;
+	void *direct, *batched;
+	int i;
+
+	direct = malloc(FDT_TXN_TEST_SIZE);
+	batched = malloc(FDT_TXN_TEST_SIZE);
+	ut_assertnonnull(direct);
+	ut_assertnonnull(batched);
+	ut_assertok(fdt_txn_test_build(uts, direct));
+	memcpy(batched, direct, FDT_TXN_TEST_SIZE);
+
+	start = timer_get_us();
+	for (i = 0; i < count; i++)
+		ut_assertok(fdt_txn_test_edit(uts, direct, NULL, i));
+	direct_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	fdt_txn_init(&txn, batched);
+	for (i = 0; i < count; i++)
+		ut_assertok(fdt_txn_test_edit(uts, batched, &txn, i));
+	ut_assertok(fdt_txn_commit(&txn));
+	txn_us = timer_get_us() - start;
+
+	printf("%d nodes edited: %lu us directly, %lu us batched\n", count,
+	       direct_us, txn_us);
+
+	ut_assertok(fdt_check_header(batched));
+	ut_asserteq(1, fdt_num_mem_rsv(batched));
+	ut_assertok(fdt_txn_test_same(uts, direct, 0, batched, 0));
+
+	free(batched);
+	free(direct);
+
+	return 0;
+}
+
+/* A few edits, which are applied in place */
+static int lib_test_fdt_txn_small(struct unit_test_state *uts)
+{
+	return fdt_txn_test_run(uts, 1);
+}
+
+LIB_TEST(lib_test_fdt_txn_small, 0);
+
+/* Many edits, which are applied by rebuilding the tree */
+static int lib_test_fdt_txn_batch(struct unit_test_state *uts)
+{
+	return fdt_txn_test_run(uts, 100);
+}
+
+LIB_TEST(lib_test_fdt_txn_batch, 0);
+
+static int lib_test_fdt_txn_abort(struct unit_test_state *uts)
+{
+	struct fdt_txn txn;
+	void *fdt, *copy;
+	int node;
+
+	fdt = malloc(FDT_TXN_TEST_SIZE);
+	copy = malloc(FDT_TXN_TEST_SIZE);
+	ut_assertnonnull(fdt);
+	ut_assertnonnull(copy);
+	ut_assertok(fdt_txn_test_build(uts, fdt));
+	memcpy(copy, fdt, FDT_TXN_TEST_SIZE);
+
+	fdt_txn_init(&txn, fdt);
+	node = fdt_path_offset(fdt, "/node@1");
+	ut_assertok(fdt_txn_setprop_u32(&txn, node, "prop-0", 0));
+	ut_asserteq(-FDT_ERR_EXISTS, fdt_txn_add_subnode(&txn, node, "child"));
+	ut_assertok(fdt_txn_del_node(&txn, node));
+	ut_asserteq(-FDT_ERR_BADOFFSET,
+		    fdt_txn_setprop_u32(&txn, node, "prop-0", 0));
+	fdt_txn_abort(&txn);
+
+	ut_asserteq_mem(copy, fdt, FDT_TXN_TEST_SIZE);
+
+	free(copy);
+	free(fdt);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_fdt_txn_abort, 0);
+
+/* Build a tree with two ethernet aliases, the second one dangling */
+static int fdt_txn_test_build_eth(struct unit_test_state *uts, void *fdt,
+				  int size)
+{
+	ut_assertok(fdt_create(fdt, size));
+	ut_assertok(fdt_finish_reservemap(fdt));
+	ut_assertok(fdt_begin_node(fdt, ""));
+	ut_assertok(fdt_begin_node(fdt, "aliases"));
+	ut_assertok(fdt_property_string(fdt, "ethernet8", "/eth@8"));
+	ut_assertok(fdt_property_string(fdt, "ethernet9", "/eth@9"));
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_begin_node(fdt, "eth@8"));
+	ut_assertok(fdt_property(fdt, "mac-address", "\0\0\0\0\0\0", 6));
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_finish(fdt));
+
+	return 0;
+}
+
+/* Check that fdt_fixup_ethernet() reports each edit it cannot make */
+static int lib_test_fdt_txn_ethernet(struct unit_test_state *uts)
+{
+	const u8 mac[] = { 0x02, 0x00, 0x11, 0x22, 0x33, 0x44 };
+	const void *val;
+	char fdt[512];
+	int node, len;
+
+	/* these are not used by sandbox, so can be set and cleared here */
+	ut_assertnull(env_get("eth8addr"));
+	ut_assertnull(env_get("eth9addr"));
+	ut_assertok(env_set("eth8addr", "02:00:11:22:33:44"));
+	ut_assertok(env_set("eth9addr", "02:00:11:22:33:55"));
+
+	/* there is room for the edits, but ethernet1 has no node */
+	ut_assertok(fdt_txn_test_build_eth(uts, fdt, sizeof(fdt)));
+	ut_assertok(fdt_open_into(fdt, fdt, sizeof(fdt)));
+	ut_assertok(console_record_reset_enable());
+	fdt_fixup_ethernet(fdt);
+	ut_assert_nextline("Unable to update property /eth@9:local-mac-address, err=FDT_ERR_NOTFOUND");
+	ut_assert_console_end();
+	node = fdt_path_offset(fdt, "/eth@8");
+	val = fdt_getprop(fdt, node, "mac-address", &len);
+	ut_asserteq(6, len);
+	ut_asserteq_mem(mac, val, 6);
+	val = fdt_getprop(fdt, node, "local-mac-address", &len);
+	ut_asserteq(6, len);
+	ut_asserteq_mem(mac, val, 6);
+
+	/* there is no room for the edits, so the commit fails */
+	ut_assertok(fdt_txn_test_build_eth(uts, fdt, sizeof(fdt)));
+	ut_assertok(fdt_pack(fdt));
+	ut_assertok(console_record_reset_enable());
+	fdt_fixup_ethernet(fdt);
+	ut_assert_nextline("Unable to update property /eth@9:local-mac-address, err=FDT_ERR_NOTFOUND");
+	ut_assert_nextline("Unable to update property mac-address, err=FDT_ERR_NOSPACE");
+	ut_assert_console_end();
+
+	/* MAC addresses can only be cleared with their protection removed */
+	ut_assertok(env_set(".flags", "eth8addr,eth9addr"));
+	ut_assertok(env_set("eth8addr", NULL));
+	ut_assertok(env_set("eth9addr", NULL));
+	ut_assertok(env_set(".flags", NULL));
+
+	return 0;
+}
+
+LIB_TEST(lib_test_fdt_txn_ethernet, UT_TESTF_CONSOLE_REC);
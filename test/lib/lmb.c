@@ -659,3 +659,104 @@ static int lib_test_lmb_get_free_size(struct unit_test_state *uts)
 
 DM_TEST(lib_test_lmb_get_free_size,
 	UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Reserve many more regions than fit in struct lmb_region itself */
+static int lib_test_lmb_many_regions(struct unit_test_state *uts)
+{
+	const phys_addr_t ram = 0x40000000;
+	const phys_size_t ram_size = 0x20000000;
+	const int count = LMB_INIT_REGIONS * 32;
+	struct lmb lmb;
+	phys_addr_t a;
+	long ret;
+	int i;
+
+	lmb_init(&lmb);
+
+	ret = lmb_add(&lmb, ram, ram_size);
+	ut_asserteq(ret, 0);
+
+	/* reserve 4 KiB every 64 KiB, in an order which is not sorted */
+	for (i = 0; i < count; i++) {
+		ret = lmb_reserve(&lmb, ram + (i * 37 % count) * 0x10000,
+				  0x1000);
+		ut_asserteq(ret, 0);
+	}
+	ut_asserteq(lmb.reserved.cnt, count);
+	for (i = 0; i < count; i++) {
+		ut_asserteq(lmb.reserved.region[i].base, ram + i * 0x10000);
+		ut_asserteq(lmb.reserved.region[i].size, 0x1000);
+	}
+	ut_asserteq(1, lmb_is_reserved(&lmb, ram + 0x10000 * (count - 1)));
+	ut_asserteq(0, lmb_is_reserved(&lmb, ram + 0x10000 * (count - 1) +
+				       0x1000));
+	ut_asserteq(0xf000, lmb_get_free_size(&lmb, ram + 0x1000));
+
+	/* fill the gaps from the top, below the last reserved region */
+	for (i = count - 2; i >= 0; i--) {
+		a = lmb_alloc_base(&lmb, 0xf000, 0x1000,
+				   ram + 0x10000 * (count - 1));
+		ut_asserteq(ram + i * 0x10000 + 0x1000, a);
+	}
+	ASSERT_LMB(&lmb, ram, ram_size, 1, ram, 0x10000 * (count - 1) + 0x1000,
+		   0, 0, 0, 0);
+
+	lmb_uninit(&lmb);
+	ut_asserteq(lmb.reserved.cnt, 0);
+
+	return 0;
+}
+
+DM_TEST(lib_test_lmb_many_regions, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Check that best fit uses the smallest free range and top down the highest */
+static int lib_test_lmb_best_fit(struct unit_test_state *uts)
+{
+	const phys_addr_t ram = 0x40000000;
+	const phys_size_t ram_size = 0x20000000;
+	const phys_addr_t ram_end = ram + ram_size;
+	struct lmb lmb;
+	phys_addr_t a, b;
+	long ret;
+
+	lmb_init(&lmb);
+
+	ret = lmb_add(&lmb, ram, ram_size);
+	ut_asserteq(ret, 0);
+
+	/* leave free ranges of 64 KiB, 8 KiB, 16 KiB and the rest at the top */
+	ret = lmb_reserve(&lmb, ram + 0x10000, 0x10000);
+	ut_asserteq(ret, 0);
+	ret = lmb_reserve(&lmb, ram + 0x22000, 0x10000);
+	ut_asserteq(ret, 0);
+	ret = lmb_reserve(&lmb, ram + 0x36000, ram_size / 2);
+	ut_asserteq(ret, 0);
+	ASSERT_LMB(&lmb, ram, ram_size, 3, ram + 0x10000, 0x10000,
+		   ram + 0x22000, 0x10000, ram + 0x36000, ram_size / 2);
+
+	a = lmb_alloc_policy(&lmb, 0x2000, 0x1000, LMB_ALLOC_ANYWHERE,
+			     LMB_ALLOC_BEST_FIT);
+	ut_asserteq(ram + 0x20000, a);
+	b = lmb_alloc_policy(&lmb, 0x2000, 0x1000, LMB_ALLOC_ANYWHERE,
+			     LMB_ALLOC_BEST_FIT);
+	ut_asserteq(ram + 0x34000, b);
+	a = lmb_alloc_policy(&lmb, 0x2000, 0x1000, LMB_ALLOC_ANYWHERE,
+			     LMB_ALLOC_TOP_DOWN);
+	ut_asserteq(ram_end - 0x2000, a);
+
+	/* the 64 KiB range is the only one which fits below the limit */
+	b = lmb_alloc_policy(&lmb, 0x4000, 0x1000, ram + 0x30000,
+			     LMB_ALLOC_BEST_FIT);
+	ut_asserteq(ram + 0xc000, b);
+
+	/* nothing fits */
+	b = lmb_alloc_policy(&lmb, 0x10000, 0x1000, ram + 0x30000,
+			     LMB_ALLOC_BEST_FIT);
+	ut_asserteq(0, b);
+
+	lmb_uninit(&lmb);
+
+	return 0;
+}
+
+DM_TEST(lib_test_lmb_best_fit, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -0,0 +1,165 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the malloc() statistics, size classes and tracking
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <asm/global_data.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static int lib_test_malloc_info(struct unit_test_state *uts)
+{
+	struct malloc_info before, info;
+	void *ptr;
+
+	malloc_get_info(&before);
+	ptr = malloc(100);
+	ut_assertnonnull(ptr);
+	malloc_get_info(&info);
+	ut_asserteq(before.mallocs + 1, info.mallocs);
+	ut_asserteq(before.live_count + 1, info.live_count);
+	ut_assert(info.live_bytes >= before.live_bytes + 100);
+	ut_assert(info.peak_bytes >= info.live_bytes);
+
+	/* A chunk of 100 bytes plus overhead is in the 128-byte bucket */
+	ut_asserteq(before.allocs[3] + 1, info.allocs[3]);
+	ut_asserteq(before.live[3] + 1, info.live[3]);
+
+	ptr = realloc(ptr, 1000);
+	ut_assertnonnull(ptr);
+	malloc_get_info(&info);
+	ut_asserteq(before.reallocs + 1, info.reallocs);
+	ut_asserteq(before.live_count + 1, info.live_count);
+	ut_assert(info.live_bytes >= before.live_bytes + 1000);
+	ut_asserteq(before.live[3], info.live[3]);
+
+	free(ptr);
+	malloc_get_info(&info);
+	ut_asserteq(before.frees + 1, info.frees);
+	ut_asserteq(before.live_count, info.live_count);
+	ut_asserteq(before.live_bytes, info.live_bytes);
+
+	return 0;
+}
+LIB_TEST(lib_test_malloc_info, 0);
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_SIZE_CLASSES)
+static int lib_test_malloc_size_class(struct unit_test_state *uts)
+{
+	struct malloc_info before, info;
+	void *ptr, *ptr2;
+
+	malloc_get_info(&before);
+	ptr = malloc(40);
+	ut_assertnonnull(ptr);
+	free(ptr);
+
+	/* The freed block is held and handed straight back */
+	ptr2 = malloc(40);
+	ut_asserteq_ptr(ptr, ptr2);
+	malloc_get_info(&info);
+	ut_asserteq(before.class_hits + 1, info.class_hits);
+
+	/* mallinfo() merges held blocks back into the heap */
+	free(ptr2);
+	mallinfo();
+	malloc_get_info(&info);
+	ut_asserteq(0, info.class_bytes);
+
+	return 0;
+}
+LIB_TEST(lib_test_malloc_size_class, 0);
+#endif
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_TRACK)
+/* Allocate from a single call site, which is not a tail call */
+static noinline void *malloc_test_alloc(size_t size)
+{
+	void *ptr = calloc(1, size);
+
+	if (ptr)
+		memset(ptr, 0x5a, size);
+
+	return ptr;
+}
+
+static int lib_test_malloc_track(struct unit_test_state *uts)
+{
+	struct malloc_track_info info, info2;
+	void *ptr[2];
+	int i;
+
+	/* Both blocks come from the same call, so have the same caller */
+	for (i = 0; i < 2; i++) {
+		ptr[i] = malloc_test_alloc(123);
+		ut_assertnonnull(ptr[i]);
+	}
+	ut_assertok(malloc_track_find(ptr[0], &info));
+	ut_assertok(malloc_track_find(ptr[1], &info2));
+	ut_asserteq(123, info.size);
+	ut_assert(info.phase != MALLOC_PHASE_BOARD_F);
+	ut_asserteq_ptr(info.caller, info2.caller);
+	ut_asserteq(info2.age + 1, info.age);
+
+	/* realloc() moves the record to the new block */
+	ptr[1] = realloc(ptr[1], 4567);
+	ut_assertnonnull(ptr[1]);
+	ut_assertok(malloc_track_find(ptr[1], &info2));
+	ut_asserteq(4567, info2.size);
+	ut_asserteq(0, info2.age);
+
+	for (i = 0; i < 2; i++) {
+		free(ptr[i]);
+		ut_asserteq(-ENOENT, malloc_track_find(ptr[i], &info));
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_malloc_track, 0);
+#endif
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_F_FREE_LAST)
+static int malloc_test_free_last(struct unit_test_state *uts)
+{
+	void *ptr, *ptr2;
+	ulong start;
+
+	ptr = malloc(16);
+	ptr2 = malloc(32);
+	ut_assertnonnull(ptr);
+	ut_assertnonnull(ptr2);
+	start = gd->malloc_ptr;
+
+	/* Only the last block is given back */
+	free(ptr);
+	ut_asserteq(start, gd->malloc_ptr);
+	free(ptr2);
+	ut_assert(gd->malloc_ptr < start);
+	ut_asserteq_ptr(ptr2, malloc(32));
+	ut_asserteq(start, gd->malloc_ptr);
+
+	return 0;
+}
+
+static int lib_test_malloc_free_last(struct unit_test_state *uts)
+{
+	ulong flags = gd->flags, start = gd->malloc_ptr;
+	ulong last = gd->malloc_last;
+	int ret;
+
+	/* Use the pre-relocation pool, as before relocation */
+	gd->flags &= ~GD_FLG_FULL_MALLOC_INIT;
+	ret = malloc_test_free_last(uts);
+	gd->flags = flags;
+	gd->malloc_ptr = start;
+	gd->malloc_last = last;
+
+	return ret;
+}
+LIB_TEST(lib_test_malloc_free_last, 0);
+#endif
@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the sampling profiler
+ */
+
+#include <common.h>
+#include <profile.h>
+#include <trace.h>
+#include <asm/sections.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/*
+ * Feed the profiler samples with made-up frame records, to check how it
+ * follows them. The profiler runs at 1Hz so that a real sample does not
+ * arrive during the test.
+ */
+static int lib_test_profile_unwind(struct unit_test_state *uts)
+{
+	ulong text = (ulong)&_init;
+	struct trace_output_hdr *hdr;
+	struct trace_sample *sample;
+	uint32_t *offset;
+	ulong stack[8];
+	char buf[200];
+	size_t needed;
+
+	/* Three frames, the outer one called from outside U-Boot */
+	stack[2] = (ulong)&stack[4];
+	stack[3] = text + 0x100;
+	stack[4] = (ulong)&stack[6];
+	stack[5] = text + 0x200;
+	stack[6] = 0;
+	stack[7] = 0x10;
+
+	ut_assertok(profile_start(1));
+	ut_asserteq(-EALREADY, profile_start(1));
+	profile_sample(text + 0x50, (ulong)&stack[2], (ulong)stack,
+		       (ulong)&stack[8]);
+
+	/* A frame pointing to itself must not loop */
+	stack[2] = (ulong)&stack[2];
+	profile_sample(text + 0x60, (ulong)&stack[2], (ulong)stack,
+		       (ulong)&stack[8]);
+
+	/* No stack, e.g. when the interrupted code has no frame pointer */
+	profile_sample(text + 0x70, 0, (ulong)stack, (ulong)&stack[8]);
+	profile_stop();
+
+	/* This one is ignored as sampling has stopped */
+	profile_sample(text, 0, 0, 0);
+
+	ut_asserteq(-ENOSPC, profile_list_samples(NULL, 0, &needed));
+	ut_asserteq(sizeof(*hdr) + 3 * sizeof(*sample) + 7 * sizeof(*offset),
+		    needed);
+	ut_assertok(profile_list_samples(buf, sizeof(buf), &needed));
+
+	hdr = (struct trace_output_hdr *)buf;
+	ut_asserteq(TRACE_CHUNK_SAMPLES, hdr->type);
+	ut_asserteq(3, hdr->rec_count);
+
+	sample = (struct trace_sample *)(hdr + 1);
+	offset = (uint32_t *)(sample + 1);
+	ut_asserteq(4, sample->depth);
+	ut_asserteq(0x50, offset[0]);
+	ut_asserteq(0x100, offset[1]);
+	ut_asserteq(0x200, offset[2]);
+	ut_asserteq(TRACE_SAMPLE_UNKNOWN, offset[3]);
+
+	sample = (struct trace_sample *)(offset + 4);
+	offset = (uint32_t *)(sample + 1);
+	ut_asserteq(2, sample->depth);
+	ut_asserteq(0x60, offset[0]);
+	ut_asserteq(0x100, offset[1]);
+
+	sample = (struct trace_sample *)(offset + 2);
+	offset = (uint32_t *)(sample + 1);
+	ut_asserteq(1, sample->depth);
+	ut_asserteq(0x70, offset[0]);
+
+	return 0;
+}
+
+LIB_TEST(lib_test_profile_unwind, 0);
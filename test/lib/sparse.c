@@ -0,0 +1,281 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the Android sparse image writer
+ *
+ * A sparse image is written to storage in RAM, which must then hold the
+ * image, with DONT_CARE blocks keeping what was there before. It is written
+ * both in one go and in pieces, as fastboot does when streaming.
+ */
+
+#include <common.h>
+#include <image-sparse.h>
+#include <malloc.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+/* Storage block size, and the image block size which is a multiple of it */
+#define SPARSE_TEST_BLKSZ	512
+#define SPARSE_TEST_IMG_BLKSZ	1024
+
+/* Storage size in blocks, and the block the image is written at */
+#define SPARSE_TEST_BLKS	64
+#define SPARSE_TEST_START	4
+
+/* Most blocks the storage zeroes in one go, so the rest must be written */
+#define SPARSE_TEST_ZERO_MAX	8
+
+/* What the storage holds before the image is written */
+#define SPARSE_TEST_OLD		0xa5
+
+/**
+ * struct sparse_test_priv - storage in RAM
+ *
+ * @mem: Contents of the storage
+ * @written: Number of blocks written with data
+ * @reserved: Number of blocks skipped as DONT_CARE
+ * @zeroed: Number of blocks zeroed without data
+ */
+struct sparse_test_priv {
+	u8 *mem;
+	lbaint_t written;
+	lbaint_t reserved;
+	lbaint_t zeroed;
+};
+
+static lbaint_t sparse_test_write(struct sparse_storage *info, lbaint_t blk,
+				  lbaint_t blkcnt, const void *buffer)
+{
+	struct sparse_test_priv *priv = info->priv;
+
+	memcpy(priv->mem + blk * info->blksz, buffer, blkcnt * info->blksz);
+	priv->written += blkcnt;
+
+	return blkcnt;
+}
+
+static lbaint_t sparse_test_reserve(struct sparse_storage *info, lbaint_t blk,
+				    lbaint_t blkcnt)
+{
+	struct sparse_test_priv *priv = info->priv;
+
+	priv->reserved += blkcnt;
+
+	return blkcnt;
+}
+
+static lbaint_t sparse_test_write_zeroes(struct sparse_storage *info,
+					 lbaint_t blk, lbaint_t blkcnt)
+{
+	struct sparse_test_priv *priv = info->priv;
+
+	blkcnt = min_t(lbaint_t, blkcnt, SPARSE_TEST_ZERO_MAX);
+	memset(priv->mem + blk * info->blksz, '\0', blkcnt * info->blksz);
+	priv->zeroed += blkcnt;
+
+	return blkcnt;
+}
+
+/*
+ * Add a chunk to the image and what it should produce to @expect. Returns
+ * a pointer to the next chunk.
+ */
+static char *sparse_test_chunk(char *img, u8 **expect, uint type, uint blks,
+			       u32 val)
+{
+	chunk_header_t *chunk = (chunk_header_t *)img;
+	uint size = blks * SPARSE_TEST_IMG_BLKSZ;
+	char *data = img + sizeof(*chunk);
+	uint i;
+
+	chunk->chunk_type = type;
+	chunk->reserved1 = 0;
+	chunk->chunk_sz = blks;
+	chunk->total_sz = sizeof(*chunk);
+	switch (type) {
+	case CHUNK_TYPE_RAW:
+		for (i = 0; i < size; i++)
+			data[i] = val + i / SPARSE_TEST_BLKSZ + i;
+		memcpy(*expect, data, size);
+		chunk->total_sz += size;
+		break;
+	case CHUNK_TYPE_FILL:
+		memcpy(data, &val, sizeof(val));
+		for (i = 0; i < size; i += sizeof(val))
+			memcpy(*expect + i, &val, sizeof(val));
+		chunk->total_sz += sizeof(val);
+		break;
+	}
+	*expect += size;
+
+	return img + chunk->total_sz;
+}
+
+/**
+ * sparse_test_image() - Create a sparse image with every type of chunk
+ *
+ * @expect: Filled in with what the image should leave on the storage,
+ *	which must already hold SPARSE_TEST_OLD
+ * @sizep: Returns the size of the image in bytes
+ * @return image, which must be freed, or NULL if out of memory
+ */
+static char *sparse_test_image(u8 *expect, uint *sizep)
+{
+	sparse_header_t *hdr;
+	char *img, *p;
+
+	img = malloc(SPARSE_TEST_BLKS * SPARSE_TEST_BLKSZ);
+	if (!img)
+		return NULL;
+
+	hdr = (sparse_header_t *)img;
+	hdr->magic = SPARSE_HEADER_MAGIC;
+	hdr->major_version = 1;
+	hdr->minor_version = 0;
+	hdr->file_hdr_sz = sizeof(*hdr);
+	hdr->chunk_hdr_sz = sizeof(chunk_header_t);
+	hdr->blk_sz = SPARSE_TEST_IMG_BLKSZ;
+	hdr->image_checksum = 0;
+
+	p = img + sizeof(*hdr);
+	expect += SPARSE_TEST_START * SPARSE_TEST_BLKSZ;
+	p = sparse_test_chunk(p, &expect, CHUNK_TYPE_RAW, 3, 1);
+	p = sparse_test_chunk(p, &expect, CHUNK_TYPE_DONT_CARE, 4, 0);
+	p = sparse_test_chunk(p, &expect, CHUNK_TYPE_FILL, 5, 0x12345678);
+	p = sparse_test_chunk(p, &expect, CHUNK_TYPE_FILL, 6, 0);
+	p = sparse_test_chunk(p, &expect, CHUNK_TYPE_CRC32, 0, 0);
+	p = sparse_test_chunk(p, &expect, CHUNK_TYPE_RAW, 2, 7);
+	hdr->total_blks = 3 + 4 + 5 + 6 + 2;
+	hdr->total_chunks = 6;
+	*sizep = p - img;
+
+	return img;
+}
+
+/* Set up the storage in RAM, holding SPARSE_TEST_OLD */
+static void sparse_test_storage(struct sparse_storage *info,
+				struct sparse_test_priv *priv)
+{
+	memset(priv->mem, SPARSE_TEST_OLD,
+	       SPARSE_TEST_BLKS * SPARSE_TEST_BLKSZ);
+	priv->written = 0;
+	priv->reserved = 0;
+	priv->zeroed = 0;
+
+	memset(info, '\0', sizeof(*info));
+	info->blksz = SPARSE_TEST_BLKSZ;
+	info->start = SPARSE_TEST_START;
+	info->size = SPARSE_TEST_BLKS - SPARSE_TEST_START;
+	info->priv = priv;
+	info->write = sparse_test_write;
+	info->reserve = sparse_test_reserve;
+	info->write_zeroes = sparse_test_write_zeroes;
+}
+
+static int lib_test_sparse_write(struct unit_test_state *uts)
+{
+	const uint size = SPARSE_TEST_BLKS * SPARSE_TEST_BLKSZ;
+	struct sparse_test_priv priv;
+	struct sparse_storage info;
+	char response[64];
+	u8 *expect;
+	uint len;
+	char *img;
+	int ret;
+
+	priv.mem = malloc(size);
+	expect = malloc(size);
+	ut_assertnonnull(priv.mem);
+	ut_assertnonnull(expect);
+	memset(expect, SPARSE_TEST_OLD, size);
+	img = sparse_test_image(expect, &len);
+	ut_assertnonnull(img);
+
+	sparse_test_storage(&info, &priv);
+	ret = write_sparse_image(&info, "test", img, response);
+	ut_assertok(ret);
+	ut_asserteq_mem(expect, priv.mem, size);
+
+	/* DONT_CARE is skipped, zeroes are done by the storage where it can */
+	ut_asserteq(4 * 2, priv.reserved);
+	ut_asserteq(SPARSE_TEST_ZERO_MAX, priv.zeroed);
+	ut_asserteq((3 + 5 + 6 + 2) * 2 - SPARSE_TEST_ZERO_MAX, priv.written);
+
+	free(img);
+	free(expect);
+	free(priv.mem);
+
+	return 0;
+}
+LIB_TEST(lib_test_sparse_write, 0);
+
+/* Write the image in pieces of every size, splitting headers and blocks */
+static int lib_test_sparse_stream(struct unit_test_state *uts)
+{
+	static const uint pieces[] = { 1, 5, 12, 100, 511, 512, 1500, 8192 };
+	const uint size = SPARSE_TEST_BLKS * SPARSE_TEST_BLKSZ;
+	struct sparse_test_priv priv;
+	struct sparse_storage info;
+	struct sparse_stream ss;
+	char response[64];
+	uint len, ofs, n;
+	chunk_header_t *chunk;
+	u8 *expect;
+	char *img;
+	int i;
+
+	priv.mem = malloc(size);
+	expect = malloc(size);
+	ut_assertnonnull(priv.mem);
+	ut_assertnonnull(expect);
+	memset(expect, SPARSE_TEST_OLD, size);
+	img = sparse_test_image(expect, &len);
+	ut_assertnonnull(img);
+
+	/* The last run uses all the sizes in turn */
+	for (i = 0; i <= ARRAY_SIZE(pieces); i++) {
+		sparse_test_storage(&info, &priv);
+		ut_assertok(sparse_stream_start(&ss, &info, "test"));
+		for (ofs = 0; ofs < len; ofs += n) {
+			n = pieces[i < ARRAY_SIZE(pieces) ? i :
+				   ofs % ARRAY_SIZE(pieces)];
+			n = min(n, len - ofs);
+			ut_assertok(sparse_stream_write(&ss, img + ofs, n,
+							response));
+		}
+		ut_assertok(sparse_stream_finish(&ss, response));
+		ut_asserteq_mem(expect, priv.mem, size);
+	}
+
+	/* Anything after the last chunk is ignored */
+	sparse_test_storage(&info, &priv);
+	ut_assertok(sparse_stream_start(&ss, &info, "test"));
+	ut_assertok(sparse_stream_write(&ss, img, len, response));
+	ut_assertok(sparse_stream_write(&ss, img, len, response));
+	ut_assertok(sparse_stream_finish(&ss, response));
+	ut_asserteq_mem(expect, priv.mem, size);
+
+	/* A bad chunk stops the write, and the rest is refused */
+	chunk = (chunk_header_t *)(img + sizeof(sparse_header_t));
+	chunk->chunk_type = 0;
+	sparse_test_storage(&info, &priv);
+	ut_assertok(sparse_stream_start(&ss, &info, "test"));
+	ut_asserteq(-1, sparse_stream_write(&ss, img, len, response));
+	ut_asserteq(-1, sparse_stream_write(&ss, img, len, response));
+	ut_asserteq(-1, sparse_stream_finish(&ss, response));
+	ut_asserteq(0, priv.written);
+
+	/* So does an image which ends early */
+	chunk->chunk_type = CHUNK_TYPE_RAW;
+	sparse_test_storage(&info, &priv);
+	ut_assertok(sparse_stream_start(&ss, &info, "test"));
+	ut_assertok(sparse_stream_write(&ss, img, len - 1, response));
+	ut_asserteq(-1, sparse_stream_finish(&ss, response));
+
+	free(img);
+	free(expect);
+	free(priv.mem);
+
+	return 0;
+}
+LIB_TEST(lib_test_sparse_stream, 0);
@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the log ring
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <test/log.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Get the text of the log ring, which must be freed by the caller */
+static char *get_ring_text(void)
+{
+	char *buf;
+	int size;
+
+	size = log_ring_format(NULL, 0) + 1;
+	buf = malloc(size);
+	if (buf)
+		log_ring_format(buf, size);
+
+	return buf;
+}
+
+/* Check that arguments are kept and formatted later */
+static int log_test_ring_format(struct unit_test_state *uts)
+{
+	int old_log_level = gd->default_log_level;
+	struct log_ring_stats stats;
+	char str[20], *buf;
+	ulong text;
+
+	ut_assertok(log_ring_get_stats(&stats));
+	text = stats.text;
+	log_ring_clear();
+
+	/* Keep the records off the console, so they are not formatted now */
+	gd->default_log_level = LOGL_WARNING;
+	strcpy(str, "fred");
+	log_info("int %d %s %lx %lld [%*d] [%.*s] %c %%\n", -3, str, 0x1234UL,
+		 -1234567890123LL, 5, 42, 2, str, 'x');
+	/* The string must be copied, not just its address */
+	strcpy(str, "mary");
+	log_info("[%-6s] %08x %zu\n", str, 0xabc, (size_t)17);
+	log_info("no args\n");
+	gd->default_log_level = old_log_level;
+
+	ut_assertok(log_ring_get_stats(&stats));
+	ut_asserteq(3, stats.count);
+	ut_asserteq(text, stats.text);
+
+	buf = get_ring_text();
+	ut_assertnonnull(buf);
+	ut_assertnonnull(strstr(buf, "<6>["));
+	ut_assertnonnull(strstr(buf, "log_test_ring_format() int -3 fred 1234 -1234567890123 [   42] [fr] x %\n"));
+	ut_assertnonnull(strstr(buf, "log_test_ring_format() [mary  ] 00000abc 17\n"));
+	ut_assertnonnull(strstr(buf, "log_test_ring_format() no args\n"));
+	free(buf);
+
+	/* Truncation */
+	ut_asserteq(log_ring_format(NULL, 0), log_ring_format(str, sizeof(str)));
+	ut_asserteq(sizeof(str) - 1, strlen(str));
+
+	return 0;
+}
+LOG_TEST(log_test_ring_format);
+
+/* Check that a record which cannot be kept in binary form is kept as text */
+static int log_test_ring_text(struct unit_test_state *uts)
+{
+	int old_log_level = gd->default_log_level;
+	struct log_ring_stats stats;
+	u8 mac[6] = {0, 1, 2, 3, 4, 5};
+	ulong text;
+	char *buf;
+
+	ut_assertok(log_ring_get_stats(&stats));
+	text = stats.text;
+	log_ring_clear();
+
+	gd->default_log_level = LOGL_WARNING;
+	log_info("mac %pM\n", mac);
+	gd->default_log_level = old_log_level;
+	/* The data is formatted when added, so it can change afterwards */
+	mac[0] = 0xff;
+
+	ut_assertok(log_ring_get_stats(&stats));
+	ut_asserteq(text + 1, stats.text);
+	buf = get_ring_text();
+	ut_assertnonnull(buf);
+	ut_assertnonnull(strstr(buf, "log_test_ring_text() mac 00:01:02:03:04:05\n"));
+	free(buf);
+
+	return 0;
+}
+LOG_TEST(log_test_ring_text);
+
+/* Check that the oldest records are dropped when the ring is full */
+static int log_test_ring_wrap(struct unit_test_state *uts)
+{
+	int old_log_level = gd->default_log_level;
+	struct log_ring_stats stats;
+	ulong dropped;
+	char *buf, *line;
+	int first, i;
+
+	log_ring_clear();
+	ut_assertok(log_ring_get_stats(&stats));
+	dropped = stats.dropped;
+
+	gd->default_log_level = LOGL_WARNING;
+	for (i = 0; i < 10000; i++)
+		log_info("record %d\n", i);
+	gd->default_log_level = old_log_level;
+
+	ut_assertok(log_ring_get_stats(&stats));
+	ut_assert(stats.count < 10000);
+	ut_asserteq(10000, stats.count + stats.dropped - dropped);
+	ut_assert(stats.used <= stats.size);
+
+	/* The records left must be the newest, in order */
+	buf = get_ring_text();
+	ut_assertnonnull(buf);
+	first = stats.dropped - dropped;
+	for (i = first, line = buf; i < 10000; i++) {
+		char expect[40];
+
+		snprintf(expect, sizeof(expect), "log_test_ring_wrap() record %d\n",
+			 i);
+		line = strchr(line, ']');
+		ut_assertnonnull(line);
+		ut_asserteq_strn(expect, line + 2);
+		line = strchr(line, '\n') + 1;
+	}
+	ut_asserteq_str("", line);
+	free(buf);
+
+	log_ring_clear();
+	ut_assertok(log_ring_get_stats(&stats));
+	ut_asserteq(0, stats.count);
+	ut_asserteq(0, log_ring_format(NULL, 0));
+
+	return 0;
+}
+LOG_TEST(log_test_ring_wrap);
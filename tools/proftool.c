@@ -34,6 +34,14 @@ struct func_info {
 	unsigned flags;
 	/* the section this function is in */
 	struct objsection_info *objsection;
+	/* call graph totals, from the trace calls */
+	unsigned long calls;		/* number of calls */
+	unsigned long long total_us;	/* time including callees */
+	unsigned long long self_us;	/* time excluding callees */
+	int active;			/* number of calls in progress */
+	/* scratch totals for the function being reported */
+	unsigned long edge_calls;
+	unsigned long long edge_us;
 };
 
 enum trace_line_type {
@@ -51,10 +59,59 @@ struct trace_configline_info {
 /* The contents of the trace config file */
 struct trace_configline_info *trace_config_head;
 
+/*
+ * A node in the call tree, i.e. a function reached through a particular
+ * chain of callers. The tree is built as the trace calls are read, so its
+ * size depends on the number of distinct call paths and not on the length
+ * of the trace.
+ */
+struct call_node {
+	struct func_info *func;		/* NULL for the root */
+	struct call_node *parent;
+	struct call_node *child;	/* first callee */
+	struct call_node *sibling;	/* next callee of the parent */
+	unsigned long calls;
+	unsigned long long total_us;
+	unsigned long long self_us;
+};
+
+/* A call in progress while building the call tree */
+struct call_frame {
+	struct call_node *node;
+	unsigned long long start;	/* time of entry in us */
+	unsigned long long child_us;	/* time spent in callees */
+};
+
+/* Call tree and the stack of calls in progress */
+struct call_graph {
+	struct call_node root;
+	struct call_frame *stack;
+	int depth;
+	int stack_size;
+	unsigned long long now;		/* current time in us */
+	uint32_t last_time;		/* last timestamp seen */
+	int started;			/* true once a timestamp is seen */
+	unsigned long records;
+	unsigned long unmatched;	/* exits with no entry in the trace */
+	unsigned long unfinished;	/* entries with no exit in the trace */
+	int done;
+};
+
+/* A sampled call stack, innermost first */
+struct sample_info {
+	int depth;
+	uint32_t *offset;
+};
+
 struct func_info *func_list;
 int func_count;
 struct trace_call *call_list;
 int call_count;
+struct sample_info *sample_list;
+int sample_count;
+struct call_graph graph;
+int stream_calls;	/* process trace calls as read, instead of storing */
+int top_count = 20;	/* number of functions to report, 0 for all */
 int verbose;	/* Verbosity level 0=none, 1=warn, 2=notice, 3=info, 4=debug */
 unsigned long text_offset;		/* text address of first function */
 
@@ -85,9 +142,14 @@ static void usage(void)
 		"\n"
 		"Commands\n"
 		"   dump-ftrace\t\tDump out textual data in ftrace format\n"
+		"   dump-folded\t\tDump sampled call stacks in folded format\n"
+		"   dump-funcs\t\tReport functions by self time\n"
+		"   dump-callgraph\tReport callers and callees by total time\n"
+		"   dump-folded-calls\tDump traced call stacks in folded format\n"
 		"\n"
 		"Options:\n"
 		"   -m <map>\tSpecify Systen.map file\n"
+		"   -n <count>\tNumber of functions to report (0 for all)\n"
 		"   -t <trace>\tSpecific trace data file (from U-Boot)\n"
 		"   -v <0-4>\tSpecify verbosity\n");
 	exit(EXIT_FAILURE);
@@ -201,16 +263,156 @@ static struct func_info *find_caller_by_offset(uint32_t offset)
 		else
 			return &func_list[mid];
 	}
+	if (high > low && h_cmp_offset(&key, &func_list[high]) >= 0)
+		return &func_list[high];
 
 	return low >= 0 ? &func_list[low] : NULL;
 }
 
+/* Find the callee of a call tree node, adding it if needed */
+static struct call_node *call_node_get(struct call_node *parent,
+				       struct func_info *func)
+{
+	struct call_node *node, **prevp;
+
+	for (prevp = &parent->child; *prevp; prevp = &(*prevp)->sibling) {
+		node = *prevp;
+		if (node->func == func) {
+			/* Move it to the front, since calls tend to repeat */
+			*prevp = node->sibling;
+			node->sibling = parent->child;
+			parent->child = node;
+			return node;
+		}
+	}
+
+	node = calloc(1, sizeof(*node));
+	if (!node)
+		return NULL;
+	node->func = func;
+	node->parent = parent;
+	node->sibling = parent->child;
+	parent->child = node;
+
+	return node;
+}
+
+/* Finish the call at the top of the stack */
+static void graph_pop(void)
+{
+	struct call_frame *frame = &graph.stack[--graph.depth];
+	struct call_node *node = frame->node;
+	unsigned long long total = graph.now - frame->start;
+	struct func_info *func = node->func;
+
+	node->total_us += total;
+	node->self_us += total - frame->child_us;
+	func->self_us += total - frame->child_us;
+	/* Only count the outermost call of a recursive function */
+	if (!--func->active)
+		func->total_us += total;
+	if (graph.depth)
+		graph.stack[graph.depth - 1].child_us += total;
+	else
+		graph.root.total_us += total;
+}
+
+/* Add a trace call record to the call graph */
+static int graph_add_call(struct trace_call *call)
+{
+	uint32_t time = call->flags & FUNCF_TIMESTAMP_MASK;
+	struct call_frame *frame;
+	struct func_info *func;
+	int i;
+
+	if (TRACE_CALL_TYPE(call) != FUNCF_ENTRY &&
+	    TRACE_CALL_TYPE(call) != FUNCF_EXIT)
+		return 0;
+	func = find_func_by_offset(call->func);
+	if (!func || !(func->flags & FUNCF_TRACE))
+		return 0;
+
+	/* The timestamp wraps, so track the time since the first record */
+	if (graph.started)
+		graph.now += (time - graph.last_time) & FUNCF_TIMESTAMP_MASK;
+	graph.last_time = time;
+	graph.started = 1;
+	graph.records++;
+
+	if (TRACE_CALL_TYPE(call) == FUNCF_EXIT) {
+		/*
+		 * Find the matching entry. Calls above it have lost their
+		 * exits, e.g. due to the trace depth limit, so finish them
+		 * now. If there is none, the call started before tracing.
+		 */
+		for (i = graph.depth - 1; i >= 0; i--) {
+			if (graph.stack[i].node->func == func)
+				break;
+		}
+		if (i < 0) {
+			graph.unmatched++;
+			return 0;
+		}
+		while (graph.depth > i)
+			graph_pop();
+		return 0;
+	}
+
+	if (graph.depth == graph.stack_size) {
+		graph.stack_size = graph.stack_size * 2 + 64;
+		graph.stack = realloc(graph.stack,
+				      graph.stack_size * sizeof(*graph.stack));
+		if (!graph.stack) {
+			error("Cannot allocate call stack\n");
+			return -1;
+		}
+	}
+	frame = &graph.stack[graph.depth];
+	frame->node = call_node_get(graph.depth ?
+				    graph.stack[graph.depth - 1].node :
+				    &graph.root, func);
+	if (!frame->node) {
+		error("Cannot allocate call node\n");
+		return -1;
+	}
+	frame->start = graph.now;
+	frame->child_us = 0;
+	graph.depth++;
+	frame->node->calls++;
+	func->calls++;
+	func->active++;
+
+	return 0;
+}
+
+/* Finish any calls still in progress at the end of the trace */
+static void graph_finish(void)
+{
+	graph.unfinished = graph.depth;
+	while (graph.depth)
+		graph_pop();
+	graph.done = 1;
+	notice("call graph: %lu records, %lu exits without entry, %lu entries without exit\n",
+	       graph.records, graph.unmatched, graph.unfinished);
+}
+
 static int read_calls(FILE *fin, size_t count)
 {
 	struct trace_call *call_data;
 	int i;
 
 	notice("call count: %zu\n", count);
+	if (stream_calls) {
+		struct trace_call call;
+
+		for (i = 0; i < count; i++) {
+			if (read_data(fin, &call, sizeof(call)))
+				return 1;
+			if (graph_add_call(&call))
+				return -1;
+		}
+		return 0;
+	}
 	call_list = (struct trace_call *)calloc(count, sizeof(*call_data));
 	if (!call_list) {
 		error("Cannot allocate call_list\n");
@@ -226,6 +428,38 @@ static int read_calls(FILE *fin, size_t count)
 	return 0;
 }
 
+static int read_samples(FILE *fin, size_t count)
+{
+	struct sample_info *sample;
+	struct trace_sample hdr;
+	int i;
+
+	notice("sample count: %zu\n", count);
+	sample_list = realloc(sample_list,
+			      (sample_count + count) * sizeof(*sample_list));
+	if (!sample_list) {
+		error("Cannot allocate sample_list\n");
+		return -1;
+	}
+
+	sample = sample_list + sample_count;
+	for (i = 0; i < count; i++, sample++) {
+		if (read_data(fin, &hdr, sizeof(hdr)))
+			return 1;
+		sample->depth = hdr.depth;
+		sample->offset = calloc(hdr.depth, sizeof(uint32_t));
+		if (!sample->offset) {
+			error("Cannot allocate sample\n");
+			return -1;
+		}
+		if (hdr.depth && read_data(fin, sample->offset,
+					   hdr.depth * sizeof(uint32_t)))
+			return 1;
+		sample_count++;
+	}
+	return 0;
+}
+
 static int read_profile(FILE *fin, int *not_found)
 {
 	struct trace_output_hdr hdr;
@@ -243,12 +477,20 @@ static int read_profile(FILE *fin, int *not_found)
 		switch (hdr.type) {
 		case TRACE_CHUNK_FUNCS:
 			/* Ignored at present */
+			if (fseek(fin, hdr.rec_count *
+				  sizeof(struct trace_output_func), SEEK_CUR))
+				return 1;
 			break;
 
 		case TRACE_CHUNK_CALLS:
 			if (read_calls(fin, hdr.rec_count))
 				return 1;
 			break;
+
+		case TRACE_CHUNK_SAMPLES:
+			if (read_samples(fin, hdr.rec_count))
+				return 1;
+			break;
 		}
 	}
 	return 0;
@@ -532,26 +774,378 @@ static int make_ftrace(void)
 	return 0;
 }
 
+/* Get the name of the function holding a sampled code offset */
+static const char *sample_func_name(uint32_t offset, int is_return)
+{
+	struct func_info *func;
+
+	if (offset == TRACE_SAMPLE_UNKNOWN || !func_count)
+		return "[unknown]";
+
+	/* A return address may be just past the end of the calling function */
+	func = find_caller_by_offset(is_return ? offset - 1 : offset);
+
+	return func ? func->name : "[unknown]";
+}
+
+static int h_cmp_string(const void *v1, const void *v2)
+{
+	return strcmp(*(const char **)v1, *(const char **)v2);
+}
+
+/*
+ * Write each distinct call stack with the number of times it was sampled,
+ * as used by flamegraph.pl:
+ *
+ *	board_init_r;run_main_loop;cli_loop;...;mmc_read_blocks 42
+ */
+static int make_folded(void)
+{
+	struct sample_info *sample;
+	char **stacks;
+	int i, j, count;
+
+	stacks = calloc(sample_count, sizeof(char *));
+	if (!stacks) {
+		error("Cannot allocate stacks\n");
+		return -1;
+	}
+
+	for (i = 0, sample = sample_list; i < sample_count; i++, sample++) {
+		size_t len = 1;
+		int depth;
+
+		/* Drop callers outside U-Boot, e.g. the C library in sandbox */
+		for (depth = sample->depth; depth > 1; depth--) {
+			if (sample->offset[depth - 1] != TRACE_SAMPLE_UNKNOWN)
+				break;
+		}
+		for (j = 0; j < depth; j++)
+			len += strlen(sample_func_name(sample->offset[j],
+						       j)) + 1;
+		stacks[i] = malloc(len);
+		if (!stacks[i]) {
+			error("Cannot allocate stack\n");
+			return -1;
+		}
+		*stacks[i] = '\0';
+		for (j = depth - 1; j >= 0; j--) {
+			strcat(stacks[i], sample_func_name(sample->offset[j],
+							   j));
+			if (j)
+				strcat(stacks[i], ";");
+		}
+	}
+
+	qsort(stacks, sample_count, sizeof(char *), h_cmp_string);
+	for (i = 0; i < sample_count; i += count) {
+		for (count = 1; i + count < sample_count; count++) {
+			if (strcmp(stacks[i], stacks[i + count]))
+				break;
+		}
+		printf("%s %d\n", stacks[i], count);
+	}
+	info("folded: %d samples\n", sample_count);
+
+	for (i = 0; i < sample_count; i++)
+		free(stacks[i]);
+	free(stacks);
+
+	return 0;
+}
+
+/* Build the call graph from the stored trace calls, if not done already */
+static int build_graph(void)
+{
+	int i;
+
+	if (graph.done)
+		return 0;
+	for (i = 0; i < call_count; i++) {
+		if (graph_add_call(&call_list[i]))
+			return -1;
+	}
+	graph_finish();
+
+	return 0;
+}
+
+static int h_cmp_self(const void *v1, const void *v2)
+{
+	const struct func_info *f1 = *(struct func_info **)v1;
+	const struct func_info *f2 = *(struct func_info **)v2;
+
+	if (f1->self_us != f2->self_us)
+		return f1->self_us < f2->self_us ? 1 : -1;
+
+	return strcmp(f1->name, f2->name);
+}
+
+static int h_cmp_total(const void *v1, const void *v2)
+{
+	const struct func_info *f1 = *(struct func_info **)v1;
+	const struct func_info *f2 = *(struct func_info **)v2;
+
+	if (f1->total_us != f2->total_us)
+		return f1->total_us < f2->total_us ? 1 : -1;
+
+	return strcmp(f1->name, f2->name);
+}
+
+static int h_cmp_edge(const void *v1, const void *v2)
+{
+	const struct func_info *f1 = *(struct func_info **)v1;
+	const struct func_info *f2 = *(struct func_info **)v2;
+
+	if (f1->edge_us != f2->edge_us)
+		return f1->edge_us < f2->edge_us ? 1 : -1;
+
+	return strcmp(f1->name, f2->name);
+}
+
+/**
+ * Get the called functions, sorted and limited to the top_count
+ *
+ * @param cmp		Comparison function for qsort()
+ * @param countp	Returns the number of functions in the list
+ * @return list of functions, or NULL if out of memory
+ */
+static struct func_info **sort_called(int (*cmp)(const void *, const void *),
+				      int *countp)
+{
+	struct func_info **list;
+	int i, count;
+
+	list = calloc(func_count + 1, sizeof(*list));
+	if (!list) {
+		error("Cannot allocate function list\n");
+		return NULL;
+	}
+	for (i = count = 0; i < func_count; i++) {
+		if (func_list[i].calls)
+			list[count++] = &func_list[i];
+	}
+	qsort(list, count, sizeof(*list), cmp);
+	if (top_count && count > top_count)
+		count = top_count;
+	*countp = count;
+
+	return list;
+}
+
+static double percent(unsigned long long us)
+{
+	return graph.root.total_us ? us * 100.0 / graph.root.total_us : 0;
+}
+
+/*
+ *       calls       self us  self %      total us  function
+ *        1234        456789   12.3%       5678901  mmc_read_blocks
+ */
+static int make_funcs(void)
+{
+	struct func_info **list;
+	int i, count;
+
+	if (build_graph())
+		return -1;
+	list = sort_called(h_cmp_self, &count);
+	if (!list)
+		return -1;
+
+	printf("Traced time: %llu us\n\n", graph.root.total_us);
+	printf("%12s  %12s  %6s  %12s  %s\n", "calls", "self us", "self %",
+	       "total us", "function");
+	for (i = 0; i < count; i++) {
+		struct func_info *func = list[i];
+
+		printf("%12lu  %12llu  %5.1f%%  %12llu  %s\n", func->calls,
+		       func->self_us, percent(func->self_us), func->total_us,
+		       func->name);
+	}
+	free(list);
+
+	return 0;
+}
+
+/* Add up the callers or callees of a function from the call tree */
+static void sum_edges(struct call_node *node, struct func_info *func,
+		      int callers)
+{
+	struct call_node *child;
+
+	for (child = node->child; child; child = child->sibling) {
+		if (child->func == func) {
+			struct call_node *edge;
+
+			if (callers && node->func) {
+				node->func->edge_calls += child->calls;
+				node->func->edge_us += child->total_us;
+			}
+			for (edge = child->child; !callers && edge;
+			     edge = edge->sibling) {
+				edge->func->edge_calls += edge->calls;
+				edge->func->edge_us += edge->total_us;
+			}
+		}
+		sum_edges(child, func, callers);
+	}
+}
+
+/* Print the callers or callees of a function, by time */
+static int print_edges(struct func_info *func, int callers)
+{
+	struct func_info **list;
+	int i, count;
+
+	for (i = 0; i < func_count; i++) {
+		func_list[i].edge_calls = 0;
+		func_list[i].edge_us = 0;
+	}
+	sum_edges(&graph.root, func, callers);
+
+	list = calloc(func_count + 1, sizeof(*list));
+	if (!list) {
+		error("Cannot allocate function list\n");
+		return -1;
+	}
+	for (i = count = 0; i < func_count; i++) {
+		if (func_list[i].edge_calls)
+			list[count++] = &func_list[i];
+	}
+	qsort(list, count, sizeof(*list), h_cmp_edge);
+
+	printf("    %s:\n", callers ? "called from" : "calls");
+	for (i = 0; i < count; i++)
+		printf("%12lu  %12llu  %6s      %s\n", list[i]->edge_calls,
+		       list[i]->edge_us, "", list[i]->name);
+	free(list);
+
+	return 0;
+}
+
+/*
+ * For each function by total time, show where it is called from and what it
+ * calls, with the number of calls and the total time of each:
+ *
+ *       calls      total us  total %
+ *        1234       5678901    12.3%  mmc_read_blocks
+ *     called from:
+ *        1234       5678901           blk_dread
+ *     calls:
+ *        1234       5000000           sdhci_send_command
+ */
+static int make_callgraph(void)
+{
+	struct func_info **list;
+	int i, count;
+
+	if (build_graph())
+		return -1;
+	list = sort_called(h_cmp_total, &count);
+	if (!list)
+		return -1;
+
+	printf("Traced time: %llu us\n\n", graph.root.total_us);
+	printf("%12s  %12s  %7s\n", "calls", "total us", "total %");
+	for (i = 0; i < count; i++) {
+		struct func_info *func = list[i];
+
+		printf("%12lu  %12llu  %6.1f%%  %s\n", func->calls,
+		       func->total_us, percent(func->total_us), func->name);
+		if (print_edges(func, 1) || print_edges(func, 0)) {
+			free(list);
+			return -1;
+		}
+		printf("\n");
+	}
+	free(list);
+
+	return 0;
+}
+
+/* Print the stacks below a node, with the path to it in @path */
+static int print_folded(struct call_node *node, char *path, int len)
+{
+	struct call_node *child;
+
+	for (child = node->child; child; child = child->sibling) {
+		int size = len + strlen(child->func->name) + 2;
+		char *child_path;
+
+		child_path = malloc(size);
+		if (!child_path) {
+			error("Cannot allocate path\n");
+			return -1;
+		}
+		snprintf(child_path, size, "%s%s%s", path, len ? ";" : "",
+			 child->func->name);
+		if (child->self_us)
+			printf("%s %llu\n", child_path, child->self_us);
+		if (print_folded(child, child_path, size - 1)) {
+			free(child_path);
+			return -1;
+		}
+		free(child_path);
+	}
+
+	return 0;
+}
+
+/*
+ * Write each distinct traced call stack with its self time in microseconds,
+ * as used by flamegraph.pl
+ */
+static int make_folded_calls(void)
+{
+	if (build_graph())
+		return -1;
+
+	return print_folded(&graph.root, "", 0);
+}
+
 static int prof_tool(int argc, char *const argv[],
 		     const char *prof_fname, const char *map_fname,
 		     const char *trace_config_fname)
 {
 	int err = 0;
 
+	int i;
+
 	if (read_map_file(map_fname))
 		return -1;
-	if (prof_fname && read_profile_file(prof_fname))
-		return -1;
 	if (trace_config_fname && read_trace_config_file(trace_config_fname))
 		return -1;
 
 	check_functions();
 
+	/*
+	 * The call graph can be built as the trace calls are read, so only
+	 * keep them in memory if they are dumped
+	 */
+	stream_calls = 1;
+	for (i = 0; i < argc; i++) {
+		if (0 == strcmp(argv[i], "dump-ftrace"))
+			stream_calls = 0;
+	}
+	if (prof_fname && read_profile_file(prof_fname))
+		return -1;
+	if (stream_calls && !graph.done)
+		graph_finish();
+
 	for (; argc; argc--, argv++) {
 		const char *cmd = *argv;
 
 		if (0 == strcmp(cmd, "dump-ftrace"))
 			err = make_ftrace();
+		else if (0 == strcmp(cmd, "dump-folded"))
+			err = make_folded();
+		else if (0 == strcmp(cmd, "dump-funcs"))
+			err = make_funcs();
+		else if (0 == strcmp(cmd, "dump-callgraph"))
+			err = make_callgraph();
+		else if (0 == strcmp(cmd, "dump-folded-calls"))
+			err = make_folded_calls();
 		else
 			warn("Unknown command '%s'\n", cmd);
 	}
@@ -567,12 +1161,16 @@ int main(int argc, char *argv[])
 	int opt;
 
 	verbose = 2;
-	while ((opt = getopt(argc, argv, "m:p:t:v:")) != -1) {
+	while ((opt = getopt(argc, argv, "m:n:p:t:v:")) != -1) {
 		switch (opt) {
 		case 'm':
 			map_fname = optarg;
 			break;
 
+		case 'n':
+			top_count = atoi(optarg);
+			break;
+
 		case 'p':
 			prof_fname = optarg;
 			break;